@@ -104,8 +104,11 @@ class MPIFile:
                         F08_TO_C_ARG_LIST = func['f08_to_c_arg_list'],
                         TAGS = func['tags'],
                         MPI_KEYNAME = func['name'][4:],
+                        CALL_FLAGS = func['call_flags'],
                         BEFORE_FUNC = func['before'],
-                        AFTER_FUNC = func['after']
+                        AFTER_FUNC = func['after'],
+                        BEFORE_FUNC_F = func['before_f'],
+                        AFTER_FUNC_F = func['after_f']
                         )
                 except KeyError:
                     print("Parse block failed at function " + func['name'])
@@ -493,6 +496,18 @@ def enrich(mpi_calls, mpi_std, lib_version):
         if func['tags'] == '':
             func['tags'] = '_Unknown'
 
+        # Constant flags of the call, so that the wrappers do not need to
+        # classify the call at run time
+        tags = func['tags'].split('|')
+        call_flags = []
+        if '_Blocking' in tags:
+            call_flags.append('MPI_CALL_BLOCKING')
+            if '_Collective' in tags:
+                call_flags.append('MPI_CALL_COLLECTIVE')
+            if func['name'] == 'MPI_Barrier':
+                call_flags.append('MPI_CALL_BARRIER')
+        func['call_flags'] = '|'.join(call_flags) if call_flags else 'MPI_CALL_NONE'
+
         # Set before and after funtions
         if func['name'] in ('MPI_Init', 'MPI_Init_thread'):
             func['before'] = 'before_init()'
@@ -500,9 +515,41 @@ def enrich(mpi_calls, mpi_std, lib_version):
         elif func['name'] == 'MPI_Finalize':
             func['before'] = 'before_finalize()'
             func['after'] = 'after_finalize()'
+        elif func.get('wait_requests'):
+            # Wait calls check their requests first, they may not block
+            wait = func['wait_requests']
+            f_count = wait['count'] if wait['count'] == '1' else '*' + wait['count']
+            func['before'] = 'before_mpi_wait({0}, {1}, {2}, {3}, {4})'.format(
+                func['name'].replace('MPI_', ''), func['call_flags'],
+                wait['count'], wait['requests'], 'true' if wait['all'] else 'false')
+            func['after'] = 'after_mpi_wait({0})'.format(func['name'].replace('MPI_', ''))
+            func['before_f'] = 'before_mpi_wait_f({0}, {1}, {2}, {3}, {4})'.format(
+                func['name'].replace('MPI_', ''), func['call_flags'],
+                f_count, wait['requests'], 'true' if wait['all'] else 'false')
+            func['after_f'] = func['after']
         else:
-            func['before'] = 'before_mpi({0})'.format(func['name'].replace('MPI_', ''))
-            func['after'] = 'after_mpi({0})'.format(func['name'].replace('MPI_', ''))
+            func['before'] = 'before_mpi({0}, {1})'.format(
+                func['name'].replace('MPI_', ''), func['call_flags'])
+            func['after'] = 'after_mpi({0}, {1})'.format(
+                func['name'].replace('MPI_', ''), func['call_flags'])
+
+        # Fortran wrappers use the same functions, unless specified
+        func.setdefault('before_f', func['before'])
+        func.setdefault('after_f', func['after'])
+
+
+def check_names(mpi_calls):
+    # Every MPI call, of any standard version, must follow the standard
+    # capitalization, i.e., MPI_ followed by an uppercase letter, and the
+    # names must be unique since they are used as enum keys
+    match_name = re.compile(r'MPI_[A-Z]\w*\Z')
+    names = set()
+    for func in (x for x in mpi_calls if isinstance(x, dict)):
+        if not match_name.match(func['name']):
+            sys.exit('Invalid MPI call name: ' + func['name'])
+        if func['name'] in names:
+            sys.exit('Duplicated MPI call name: ' + func['name'])
+        names.add(func['name'])
 
 
 def main(argv):
@@ -540,6 +587,9 @@ def main(argv):
     with open(jsonfile, 'r') as json_data:
         mpi_calls = json.load(json_data)['mpi_calls']
 
+    # Check the database before generating any file
+    check_names(mpi_calls)
+
     # Enrich dictionary by adding derived keys
     enrich(mpi_calls, mpistd, libversion)
 
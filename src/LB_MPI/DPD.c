@@ -104,8 +104,8 @@ unsigned int level_index[MAX_LEVELS];
 
 int dynais_init(unsigned int window, unsigned int levels)
 {
-	unsigned long *p_smpls;
-	unsigned int *p_zeros, *p_sizes, *p_indes;
+	unsigned long *p_smpls = NULL;
+	unsigned int *p_zeros = NULL, *p_sizes = NULL, *p_indes = NULL;
 	int mem_res1, mem_res2, mem_res3, mem_res4;
 	unsigned int i, k;
 	///
@@ -123,22 +123,26 @@ int dynais_init(unsigned int window, unsigned int levels)
 	_window = (window < METRICS_WINDOW) ? window : METRICS_WINDOW;
 	_levels = (levels < MAX_LEVELS) ? levels : MAX_LEVELS;
 
-	mem_res1 = posix_memalign((void *) &p_smpls, sizeof(__dyn_size), sizeof(long) * _window * levels);
-	mem_res3 = posix_memalign((void *) &p_sizes, sizeof(__dyn_size), sizeof(int)  * _window * levels);
-	mem_res2 = posix_memalign((void *) &p_zeros, sizeof(__dyn_size), sizeof(int)  * (_window + 8) * levels);
-	mem_res4 = posix_memalign((void *) &p_indes, sizeof(__dyn_size), sizeof(int)  * (_window + 8) * levels);
-	
-	p_smpls = malloc(sizeof(long) * _window * levels);
-	p_sizes = malloc(sizeof(int) * _window * levels);
-	p_zeros = malloc(sizeof(int) * (_window+8) * levels);
-	p_indes = malloc(sizeof(int) * (_window+8) * levels);
+	mem_res1 = posix_memalign((void *) &p_smpls, sizeof(__dyn_size), sizeof(long) * _window * _levels);
+	mem_res3 = posix_memalign((void *) &p_sizes, sizeof(__dyn_size), sizeof(int)  * _window * _levels);
+	mem_res2 = posix_memalign((void *) &p_zeros, sizeof(__dyn_size), sizeof(int)  * (_window + 8) * _levels);
+	mem_res4 = posix_memalign((void *) &p_indes, sizeof(__dyn_size), sizeof(int)  * (_window + 8) * _levels);
 
     	//EINVAL = 22, ENOMEM = 12
 	if (mem_res1 != 0 || mem_res2 != 0 || mem_res3 != 0 || mem_res4 != 0) {
+		free(p_smpls);
+		free(p_sizes);
+		free(p_zeros);
+		free(p_indes);
         	return -1;
 	}
 
-    	for (i = 0; i < levels; ++i)
+	memset(p_smpls, 0, sizeof(long) * _window * _levels);
+	memset(p_sizes, 0, sizeof(int)  * _window * _levels);
+	memset(p_zeros, 0, sizeof(int)  * (_window + 8) * _levels);
+	memset(p_indes, 0, sizeof(int)  * (_window + 8) * _levels);
+
+    	for (i = 0; i < _levels; ++i)
     	{
         	level_limit[i] = 0;
         	level_index[i] = 0;
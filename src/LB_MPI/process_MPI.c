@@ -25,7 +25,9 @@
 
 #include "LB_MPI/process_MPI.h"
 
+#include "LB_MPI/DPD.h"
 #include "LB_MPI/MPI_calls_coded.h"
+#include "LB_MPI/wait_requests.h"
 #include "LB_core/DLB_kernel.h"
 #include "LB_core/spd.h"
 #include "apis/dlb.h"
@@ -35,6 +37,7 @@
 #include "support/types.h"
 #include "talp/talp_mpi.h"
 #include <mpi.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <limits.h>
 #include <string.h>
@@ -49,13 +52,22 @@ int _process_id = -1;
 
 static int init_from_mpi = 0;
 static int mpi_ready = 0;
-static mpi_set_t lewi_mpi_calls = MPISET_ALL;
+static mpi_call_flags_t lewi_mpi_calls_mask = MPI_CALL_BLOCKING;
+static __thread mpi_call_flags_t wait_call_flags = MPI_CALL_NONE;
+static __thread bool wait_do_lewi = false;
 
-static MPI_Comm mpi_comm_world;         /* DLB's own MPI_COMM_WORLD */
-static MPI_Comm mpi_comm_node;          /* MPI Communicator specific to the node */
-static MPI_Comm mpi_comm_internode;     /* MPI Communicator with 1 representative per node */
+static MPI_Comm mpi_comm_world = MPI_COMM_NULL;     /* DLB's own MPI_COMM_WORLD */
+static MPI_Comm mpi_comm_node = MPI_COMM_NULL;      /* MPI Communicator specific to the node */
+static MPI_Comm mpi_comm_internode = MPI_COMM_NULL; /* MPI Communicator with 1 representative per node */
 
 static MPI_Datatype mpi_int64_type;     /* MPI datatype representing int64_t */
+static bool mpi_comms_created = false;
+
+/* DynAIS parameters for detecting iterations from the blocking MPI calls */
+enum { DYNAIS_WINDOW = 200 };
+enum { DYNAIS_LEVELS = 4 };
+static bool detect_iterations = false;
+static pthread_mutex_t dynais_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 void before_init(void) {
 #if MPI_VERSION >= 3 && defined(MPI_LIBRARY_VERSION)
@@ -80,13 +92,11 @@ void before_init(void) {
 #endif
 }
 
-/* Compute global, local ids and create the node communicator */
+/* Compute global ids, these are local operations */
 static void get_mpi_info(void) {
 
-    /* Duplicate MPI_COMM_WORLD and get info */
-    PMPI_Comm_dup(MPI_COMM_WORLD, &mpi_comm_world);
-    PMPI_Comm_rank(mpi_comm_world, &_mpi_rank);
-    PMPI_Comm_size(mpi_comm_world, &_mpi_size);
+    PMPI_Comm_rank(MPI_COMM_WORLD, &_mpi_rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &_mpi_size);
 
     /* Initialize MPI type */
 #if MPI_VERSION >= 3
@@ -94,6 +104,38 @@ static void get_mpi_info(void) {
 #else
     PMPI_Type_match_size(MPI_TYPECLASS_INTEGER, sizeof(int64_t), &mpi_int64_type);
 #endif
+}
+
+/* Only TALP reductions, MPI node barriers, and the MPI node id in the verbose
+ * format need DLB's communicators. Other set-ups skip their creation.
+ * The communicators are never created later because it is a collective
+ * operation over MPI_COMM_WORLD, and a lazy creation would deadlock if only
+ * some processes request them. */
+static bool mpi_comms_needed(void) {
+    /* DLB may have been initialized before MPI with other options */
+    const subprocess_descriptor_t *spd = thread_spd;
+    if (spd != NULL && spd->dlb_initialized
+            && (spd->options.talp || spd->options.barrier)) {
+        return true;
+    }
+
+    bool talp, barrier;
+    verbose_fmt_t verbose_fmt;
+    options_parse_entry("--talp", &talp);
+    options_parse_entry("--barrier", &barrier);
+    options_parse_entry("--verbose-format", &verbose_fmt);
+    return talp || barrier || verbose_fmt & VBF_MPINODE;
+}
+
+/* Compute local ids and create the node communicators.
+ * Collective operation over MPI_COMM_WORLD */
+static void create_mpi_comms(void) {
+
+    if (mpi_comms_created) return;
+    mpi_comms_created = true;
+
+    /* Duplicate MPI_COMM_WORLD */
+    PMPI_Comm_dup(MPI_COMM_WORLD, &mpi_comm_world);
 
 #if MPI_VERSION >= 3
     /* Node communicator, obtain also local id and number of MPIs in this node */
@@ -196,9 +238,46 @@ static void get_mpi_info(void) {
 #endif
 }
 
+/* With --lewi-shrink, the iterations are detected from the sequence of blocking
+ * MPI calls, unless they are delimited by a TALP region */
+static void init_iteration_detection(const options_t *options) {
+    detect_iterations = options->lewi
+        && options->lewi_shrink
+        && options->lewi_shrink_region[0] == '\0';
+    if (detect_iterations && dynais_init(DYNAIS_WINDOW, DYNAIS_LEVELS) != 0) {
+        warning("Could not initialize the iteration detection for --lewi-shrink");
+        detect_iterations = false;
+    }
+}
+
+static void finalize_iteration_detection(void) {
+    if (detect_iterations) {
+        detect_iterations = false;
+        dynais_dispose();
+    }
+}
+
+static void detect_iteration(mpi_call_t mpi_call) {
+    /* DynAIS is not thread-safe, skip the samples of concurrent calls */
+    if (pthread_mutex_trylock(&dynais_mutex) == 0) {
+        unsigned int size, level;
+        int state = dynais(mpi_call, &size, &level);
+        pthread_mutex_unlock(&dynais_mutex);
+
+        if (state == NEW_ITERATION) {
+            new_iteration(thread_spd, false);
+        } else if (state == NEW_LOOP || state == END_NEW_LOOP) {
+            new_iteration(thread_spd, true);
+        }
+    }
+}
+
 void after_init(void) {
     /* Fill MPI global variables */
     get_mpi_info();
+    if (mpi_comms_needed()) {
+        create_mpi_comms();
+    }
 
     if (DLB_Init(0, NULL, NULL) == DLB_SUCCESS) {
         init_from_mpi = 1;
@@ -208,25 +287,31 @@ void after_init(void) {
     }
 
     talp_mpi_init(thread_spd);
-    lewi_mpi_calls = thread_spd->options.lewi_mpi_calls;
+
+    /* Precompute which call flags trigger LeWI, so that the hot path is a
+     * single bitwise check per MPI call */
+    switch (thread_spd->options.lewi ? thread_spd->options.lewi_mpi_calls : MPISET_NONE) {
+        case MPISET_NONE:           lewi_mpi_calls_mask = MPI_CALL_NONE;        break;
+        case MPISET_ALL:            lewi_mpi_calls_mask = MPI_CALL_BLOCKING;    break;
+        case MPISET_BARRIER:        lewi_mpi_calls_mask = MPI_CALL_BARRIER;     break;
+        case MPISET_COLLECTIVES:    lewi_mpi_calls_mask = MPI_CALL_COLLECTIVE;  break;
+    }
+
+    init_iteration_detection(&thread_spd->options);
 
     mpi_ready = 1;
 }
 
-void before_mpi(mpi_call_t mpi_call) {
+static void before_mpi_call(mpi_call_t mpi_call, mpi_call_flags_t call_flags,
+        bool do_lewi) {
     if(mpi_ready) {
         instrument_event(RUNTIME_EVENT, EVENT_INTO_MPI, EVENT_BEGIN);
 
-        bool is_blocking = is_mpi_blocking(mpi_call);
-        bool is_collective = is_mpi_collective(mpi_call);
         sync_call_flags_t flags = (const sync_call_flags_t) {
             .is_mpi = true,
-            .is_blocking = is_blocking,
-            .is_collective = is_collective,
-            .do_lewi = is_blocking && (
-                        lewi_mpi_calls == MPISET_ALL
-                        || (lewi_mpi_calls == MPISET_BARRIER && mpi_call == Barrier)
-                        || (lewi_mpi_calls == MPISET_COLLECTIVES && is_collective)),
+            .is_blocking = call_flags & MPI_CALL_BLOCKING,
+            .is_collective = call_flags & MPI_CALL_COLLECTIVE,
+            .do_lewi = do_lewi,
         };
         into_sync_call(flags);
 
@@ -234,32 +319,100 @@ void before_mpi(mpi_call_t mpi_call) {
     }
 }
 
-void after_mpi(mpi_call_t mpi_call) {
+static void after_mpi_call(mpi_call_t mpi_call, mpi_call_flags_t call_flags,
+        bool do_lewi) {
     if (mpi_ready) {
         instrument_event(RUNTIME_EVENT, EVENT_OUTOF_MPI, EVENT_BEGIN);
 
-        bool is_blocking = is_mpi_blocking(mpi_call);
-        bool is_collective = is_mpi_collective(mpi_call);
         sync_call_flags_t flags = (const sync_call_flags_t) {
             .is_mpi = true,
-            .is_blocking = is_blocking,
-            .is_collective = is_collective,
-            .do_lewi = is_blocking && (
-                    lewi_mpi_calls == MPISET_ALL
-                    || (lewi_mpi_calls == MPISET_BARRIER && mpi_call == Barrier)
-                    || (lewi_mpi_calls == MPISET_COLLECTIVES && is_collective)),
+            .is_blocking = call_flags & MPI_CALL_BLOCKING,
+            .is_collective = call_flags & MPI_CALL_COLLECTIVE,
+            .do_lewi = do_lewi,
         };
         out_of_sync_call(flags);
 
+        if (detect_iterations && (call_flags & MPI_CALL_BLOCKING)) {
+            detect_iteration(mpi_call);
+        }
+
         instrument_event(RUNTIME_EVENT, EVENT_OUTOF_MPI, EVENT_END);
     }
-    // Poll DROM and update mask if necessary
-    DLB_PollDROM_Update();
+
+    /* Poll DROM and update mask if necessary. Non-blocking calls, such as
+     * MPI_Test, may be issued millions of times in polling loops, skip them. */
+    if (call_flags & MPI_CALL_BLOCKING) {
+        DLB_PollDROM_Update();
+    }
+}
+
+void before_mpi(mpi_call_t mpi_call, mpi_call_flags_t call_flags) {
+    before_mpi_call(mpi_call, call_flags, call_flags & lewi_mpi_calls_mask);
+}
+
+void after_mpi(mpi_call_t mpi_call, mpi_call_flags_t call_flags) {
+    after_mpi_call(mpi_call, call_flags, call_flags & lewi_mpi_calls_mask);
+}
+
+/* Non-destructive query of the state of a request */
+static wait_request_state_t get_request_state(MPI_Request request) {
+    if (request == MPI_REQUEST_NULL) return WAIT_REQUEST_NULL;
+    int flag;
+    PMPI_Request_get_status(request, &flag, MPI_STATUS_IGNORE);
+    return flag ? WAIT_REQUEST_COMPLETED : WAIT_REQUEST_PENDING;
+}
+
+static wait_request_state_t get_c_request_state(int index, const void *requests) {
+    return get_request_state(((const MPI_Request*)requests)[index]);
+}
+
+static wait_request_state_t get_f_request_state(int index, const void *requests) {
+    return get_request_state(PMPI_Request_f2c(((const MPI_Fint*)requests)[index]));
+}
+
+/* Check whether a wait call on these requests would return immediately.
+ * Either C or Fortran handles are provided. */
+static bool requests_completed(int count, const MPI_Request c_requests[],
+        const MPI_Fint f_requests[], bool wait_all) {
+    return c_requests
+        ? wait_requests_completed(count, c_requests, get_c_request_state, wait_all)
+        : wait_requests_completed(count, f_requests, get_f_request_state, wait_all);
+}
+
+/* LeWI does not lend and reclaim the CPUs for a wait call whose requests are
+ * already completed, since it returns immediately. The call is still blocking
+ * for TALP and DROM. The flags are kept until after_mpi_wait. */
+static void before_mpi_wait_requests(mpi_call_t mpi_call, mpi_call_flags_t call_flags,
+        int count, const MPI_Request c_requests[], const MPI_Fint f_requests[],
+        bool wait_all) {
+    bool do_lewi = call_flags & lewi_mpi_calls_mask;
+    if (mpi_ready && do_lewi
+            && requests_completed(count, c_requests, f_requests, wait_all)) {
+        do_lewi = false;
+    }
+    wait_call_flags = call_flags;
+    wait_do_lewi = do_lewi;
+    before_mpi_call(mpi_call, call_flags, do_lewi);
+}
+
+void before_mpi_wait(mpi_call_t mpi_call, mpi_call_flags_t call_flags,
+        int count, const MPI_Request requests[], bool wait_all) {
+    before_mpi_wait_requests(mpi_call, call_flags, count, requests, NULL, wait_all);
+}
+
+void before_mpi_wait_f(mpi_call_t mpi_call, mpi_call_flags_t call_flags,
+        int count, const MPI_Fint requests[], bool wait_all) {
+    before_mpi_wait_requests(mpi_call, call_flags, count, NULL, requests, wait_all);
+}
+
+void after_mpi_wait(mpi_call_t mpi_call) {
+    after_mpi_call(mpi_call, wait_call_flags, wait_do_lewi);
 }
 
 void before_finalize(void) {
     if (mpi_ready) {
         mpi_ready = 0;
+        finalize_iteration_detection();
         talp_mpi_finalize(thread_spd);
     }
     if (init_from_mpi) {
@@ -279,10 +432,13 @@ void process_MPI__finalize(void) {
     if (mpi_ready) {
         mpi_ready = 0;
         init_from_mpi = 0;
+        finalize_iteration_detection();
         talp_mpi_finalize(thread_spd);
     }
 }
 
+/* These functions return MPI_COMM_NULL if the communicators were not
+ * created at MPI_Init */
 MPI_Comm getWorldComm(void) {
     return mpi_comm_world;
 }
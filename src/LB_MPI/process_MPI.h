@@ -22,6 +22,7 @@
 
 #include "LB_MPI/MPI_calls_coded.h"
 
+#include <stdbool.h>
 #include <unistd.h>
 #include <mpi.h>
 
@@ -34,8 +35,13 @@ extern int _mpis_per_node;    /* Numer of MPI processes per node */
 
 void before_init(void);
 void after_init(void);
-void before_mpi(mpi_call_t mpi_call);
-void after_mpi(mpi_call_t mpi_call);
+void before_mpi(mpi_call_t mpi_call, mpi_call_flags_t call_flags);
+void after_mpi(mpi_call_t mpi_call, mpi_call_flags_t call_flags);
+void before_mpi_wait(mpi_call_t mpi_call, mpi_call_flags_t call_flags,
+        int count, const MPI_Request requests[], bool wait_all);
+void before_mpi_wait_f(mpi_call_t mpi_call, mpi_call_flags_t call_flags,
+        int count, const MPI_Fint requests[], bool wait_all);
+void after_mpi_wait(mpi_call_t mpi_call);
 void before_finalize(void);
 void after_finalize(void);
 int  is_mpi_ready(void);
@@ -0,0 +1,55 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef WAIT_REQUESTS_H
+#define WAIT_REQUESTS_H
+
+#include <stdbool.h>
+
+/* Decision of whether a wait call on a list of requests returns immediately.
+ * It does not depend on MPI, the state of each request is queried through a
+ * callback, in order, and only until the result is known. */
+
+typedef enum wait_request_state_t {
+    WAIT_REQUEST_NULL,
+    WAIT_REQUEST_PENDING,
+    WAIT_REQUEST_COMPLETED,
+} wait_request_state_t;
+
+typedef wait_request_state_t (*wait_request_state_fn)(int index, const void *requests);
+
+/* Wait-all returns immediately if no request is pending. Wait-any returns
+ * immediately if some request is completed, or if all of them are null. */
+static inline bool wait_requests_completed(int count, const void *requests,
+        wait_request_state_fn get_state, bool wait_all) {
+    int num_null_requests = 0;
+    for (int i = 0; i < count; ++i) {
+        wait_request_state_t state = get_state(i, requests);
+        if (state == WAIT_REQUEST_NULL) {
+            ++num_null_requests;
+        } else if (state == WAIT_REQUEST_COMPLETED && !wait_all) {
+            return true;
+        } else if (state == WAIT_REQUEST_PENDING && wait_all) {
+            return false;
+        }
+    }
+    return wait_all || num_null_requests == count;
+}
+
+#endif /* WAIT_REQUESTS_H */
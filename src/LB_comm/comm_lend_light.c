@@ -20,18 +20,38 @@
 #include "LB_comm/comm_lend_light.h"
 
 #include "LB_comm/shmem.h"
+#include "support/atomic.h"
 #include "support/tracing.h"
 #include "support/debug.h"
+#include "support/mask_utils.h"
 #include "support/types.h"
 
+#include <limits.h>
 #include <stdlib.h>
 
+/* Idle CPUs are counted per NUMA domain, each counter in its own cache line.
+ * A process lends and reclaims its CPUs in its local domain, and borrows from
+ * its local domain first. A negative counter means that some owners have
+ * reclaimed CPUs that are still borrowed by other processes.
+ *
+ * All operations are wait-free, a bounded number of atomic operations per
+ * domain. Taking idle CPUs subtracts them first and gives back the excess, so
+ * a counter may be transiently lower than its actual value, but CPUs are never
+ * created nor lost. */
+
+enum { SHMEM_LEWI_VERSION = 1 };
+
+typedef struct DLB_ALIGN_CACHE IdleDomain {
+    atomic_int idle_cpus;
+} idle_domain_t;
+
 int defaultCPUS;
 int greedy;
 //pointers to the shared memory structures
 struct shdata {
-    int   idleCpus;
-    int   attached_nprocs;
+    atomic_int      attached_nprocs;
+    int             num_domains;
+    idle_domain_t   domains[];
 };
 
 struct shdata *shdata;
@@ -39,26 +59,42 @@ static shmem_handler_t *shm_handler = NULL;
 static const char *shmem_name = "lewi";
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static int subprocesses_attached = 0;
+static int num_domains = 0;
+static int local_domain = 0;
+
+/* Number of NUMA nodes in the system */
+static int get_num_domains(void) {
+    return max_int(1, mu_get_num_nodes());
+}
+
+/* NUMA node of the first CPU in mask */
+static int get_domain(const cpu_set_t *mask) {
+    if (mask == NULL || CPU_COUNT(mask) == 0) return 0;
+
+    int node_id = mu_get_node_id(mu_get_first_cpu(mask));
+    return node_id >= 0 && node_id < num_domains ? node_id : 0;
+}
 
 static void cleanup_shmem(void *shdata_ptr, int pid) {
     struct shdata *shared_data = shdata_ptr;
-    __sync_fetch_and_sub(&shared_data->attached_nprocs, 1);
+    DLB_ATOMIC_SUB(&shared_data->attached_nprocs, 1);
 }
 
 static bool is_shmem_empty(void) {
-    return shdata && shdata->attached_nprocs == 0;
+    return shdata && DLB_ATOMIC_LD(&shdata->attached_nprocs) == 0;
 }
 
 static void open_shmem(const char *shmem_key) {
     pthread_mutex_lock(&mutex);
     {
         if (shm_handler == NULL) {
+            num_domains = get_num_domains();
             shm_handler = shmem_init((void**)&shdata,
                     &(const shmem_props_t) {
-                        .size = sizeof(struct shdata),
+                        .size = comm_lend_light__size(),
                         .name = shmem_name,
                         .key = shmem_key,
-                        .version = SHMEM_VERSION_IGNORE,
+                        .version = SHMEM_LEWI_VERSION,
                         .cleanup_fn = cleanup_shmem,
                     });
             subprocesses_attached = 1;
@@ -69,20 +105,25 @@ static void open_shmem(const char *shmem_key) {
     pthread_mutex_unlock(&mutex);
 }
 
-void ConfigShMem(int defCPUS, int is_greedy, const char *shmem_key) {
+void ConfigShMem(int defCPUS, int is_greedy, const cpu_set_t *process_mask,
+        const char *shmem_key) {
     verbose(VB_SHMEM, "LoadCommonConfig");
     defaultCPUS=defCPUS;
     greedy=is_greedy;
 
     // Shared memory creation
     open_shmem(shmem_key);
+    local_domain = get_domain(process_mask);
 
-    if (__sync_fetch_and_add(&shdata->attached_nprocs, 1) == 0) {
+    if (DLB_ATOMIC_ADD(&shdata->attached_nprocs, 1) == 0) {
         // Initialize shared memory if this is the 1st process attached
         verbose(VB_SHMEM, "setting values to the shared mem");
 
         /* idleCPUS */
-        shdata->idleCpus = 0;
+        shdata->num_domains = num_domains;
+        for (int i = 0; i < num_domains; ++i) {
+            DLB_ATOMIC_ST(&shdata->domains[i].idle_cpus, 0);
+        }
         add_event(IDLE_CPUS_EVENT, 0);
 
         verbose(VB_SHMEM, "Finished setting values to the shared mem");
@@ -103,18 +144,69 @@ static void close_shmem(void) {
 
 void finalize_comm() {
     if (shm_handler) {
-        __sync_fetch_and_sub(&shdata->attached_nprocs, 1);
+        DLB_ATOMIC_SUB(&shdata->attached_nprocs, 1);
         close_shmem();
     }
 }
 
+/* Sum of all domains, only for reporting */
+static int get_idle_cpus(void) {
+    int idle_cpus = 0;
+    for (int i = 0; i < num_domains; ++i) {
+        idle_cpus += DLB_ATOMIC_LD_RLX(&shdata->domains[i].idle_cpus);
+    }
+    return idle_cpus;
+}
+
+/* Take up to 'cpus' idle CPUs from a domain and return how many were taken */
+static int take_idle_cpus(idle_domain_t *domain, int cpus) {
+    int observed = DLB_ATOMIC_LD_RLX(&domain->idle_cpus);
+    cpus = min_int(cpus, observed);
+    if (cpus <= 0) return 0;
+
+    /* Fetch-and-sub, then give back what was not idle anymore */
+    int old_value = DLB_ATOMIC_SUB(&domain->idle_cpus, cpus);
+    int taken = max_int(0, min_int(old_value, cpus));
+    if (taken < cpus) {
+        DLB_ATOMIC_ADD(&domain->idle_cpus, cpus - taken);
+    }
+    return taken;
+}
+
+/* Take up to 'cpus' idle CPUs, from the local domain first */
+static int take_idle_cpus_from_any_domain(int cpus) {
+    int taken = 0;
+    for (int i = 0; i < num_domains && taken < cpus; ++i) {
+        idle_domain_t *domain = &shdata->domains[(local_domain + i) % num_domains];
+        taken += take_idle_cpus(domain, cpus - taken);
+    }
+    return taken;
+}
+
+/* Give back up to 'cpus' borrowed CPUs to the domains whose owners reclaimed
+ * them, from the local domain first, and return how many were given back */
+static int repay_borrowed_cpus(int cpus) {
+    int repaid = 0;
+    for (int i = 0; i < num_domains && repaid < cpus; ++i) {
+        idle_domain_t *domain = &shdata->domains[(local_domain + i) % num_domains];
+        int debt = -DLB_ATOMIC_LD_RLX(&domain->idle_cpus);
+        if (debt > 0) {
+            int amount = min_int(debt, cpus - repaid);
+            DLB_ATOMIC_ADD(&domain->idle_cpus, amount);
+            repaid += amount;
+        }
+    }
+    return repaid;
+}
+
 int releaseCpus(int cpus) {
     verbose(VB_SHMEM, "Releasing CPUS...");
 
-    __sync_fetch_and_add (&(shdata->idleCpus), cpus);
-    add_event(IDLE_CPUS_EVENT, shdata->idleCpus);
+    DLB_ATOMIC_ADD(&shdata->domains[local_domain].idle_cpus, cpus);
+    int idle_cpus = get_idle_cpus();
+    add_event(IDLE_CPUS_EVENT, idle_cpus);
 
-    verbose(VB_SHMEM, "DONE Releasing CPUS (idle %d)", shdata->idleCpus);
+    verbose(VB_SHMEM, "DONE Releasing CPUS (idle %d)", idle_cpus);
 
     return 0;
 }
@@ -127,14 +219,16 @@ int acquireCpus(int current_cpus) {
     verbose(VB_SHMEM, "Acquiring CPUS...");
     int cpus = defaultCPUS-current_cpus;
 
-//I don't care if there aren't enough cpus
+    /* Owned CPUs are reclaimed even if they are not idle */
+    DLB_ATOMIC_SUB(&shdata->domains[local_domain].idle_cpus, cpus);
 
-    if((__sync_sub_and_fetch (&(shdata->idleCpus), cpus)>0) && greedy) {
-        cpus+=__sync_val_compare_and_swap(&(shdata->idleCpus), shdata->idleCpus, 0);
+    if (greedy) {
+        cpus += take_idle_cpus_from_any_domain(INT_MAX);
     }
-    add_event(IDLE_CPUS_EVENT, shdata->idleCpus);
+    int idle_cpus = get_idle_cpus();
+    add_event(IDLE_CPUS_EVENT, idle_cpus);
 
-    verbose(VB_SHMEM, "Using %d CPUS... %d Idle", cpus, shdata->idleCpus);
+    verbose(VB_SHMEM, "Using %d CPUS... %d Idle", cpus, idle_cpus);
 
     return cpus+current_cpus;
 }
@@ -144,29 +238,36 @@ Returns de number of cpus
 that are assigned
 */
 int checkIdleCpus(int myCpus, int maxResources) {
-    verbose(VB_SHMEM, "Checking idle CPUS... %d", shdata->idleCpus);
-    int cpus;
-    int aux;
-//WARNING//
-    //if more CPUS than the availables are used release some
-    if ((shdata->idleCpus < 0) && (myCpus>defaultCPUS) ) {
-        aux=shdata->idleCpus;
-        cpus=min_int(abs(aux), myCpus-defaultCPUS);
-        if(__sync_bool_compare_and_swap(&(shdata->idleCpus), aux, aux+cpus)) {
-            myCpus-=cpus;
-        }
-
-        //if there are idle CPUS use them
-    } else if( shdata->idleCpus > 0) {
-        aux=shdata->idleCpus;
-        if(aux>maxResources) { aux=maxResources; }
+    verbose(VB_SHMEM, "Checking idle CPUS...");
 
-        if(__sync_bool_compare_and_swap(&(shdata->idleCpus), shdata->idleCpus, shdata->idleCpus-aux)) {
-            myCpus+=aux;
-        }
+    /* If more CPUs than the owned ones are used and some owner reclaimed
+     * them, give them back. Otherwise, if there are idle CPUs, use them */
+    int repaid = 0;
+    if (myCpus > defaultCPUS) {
+        repaid = repay_borrowed_cpus(myCpus - defaultCPUS);
+        myCpus -= repaid;
+    }
+    if (repaid == 0 && maxResources > 0) {
+        myCpus += take_idle_cpus_from_any_domain(maxResources);
     }
-    add_event(IDLE_CPUS_EVENT, shdata->idleCpus);
+    int idle_cpus = get_idle_cpus();
+    add_event(IDLE_CPUS_EVENT, idle_cpus);
 
-    verbose(VB_SHMEM, "Using %d CPUS... %d Idle", myCpus, shdata->idleCpus);
+    verbose(VB_SHMEM, "Using %d CPUS... %d Idle", myCpus, idle_cpus);
     return myCpus;
 }
+
+int comm_lend_light__version(void) {
+    return SHMEM_LEWI_VERSION;
+}
+
+size_t comm_lend_light__size(void) {
+    return sizeof(struct shdata) + sizeof(idle_domain_t) * (
+            num_domains > 0 ? num_domains : get_num_domains());
+}
+
+/* Idle CPUs of a domain, or of all of them if domain is negative */
+int comm_lend_light_testing__get_idle_cpus(int domain) {
+    return domain < 0 ? get_idle_cpus()
+        : DLB_ATOMIC_LD(&shdata->domains[domain].idle_cpus);
+}
@@ -20,7 +20,11 @@
 #ifndef COMM_LEND_LIGHT_H
 #define COMM_LEND_LIGHT_H
 
-void ConfigShMem(int defCPUS, int is_greedy, const char *shmem_key);
+#include <sched.h>
+#include <stddef.h>
+
+void ConfigShMem(int defCPUS, int is_greedy, const cpu_set_t *process_mask,
+        const char *shmem_key);
 
 int releaseCpus(int cpus);
 
@@ -30,5 +34,11 @@ int checkIdleCpus(int myCpus, int maxResources);
 
 void finalize_comm();
 
+int comm_lend_light__version(void);
+
+size_t comm_lend_light__size(void);
+
+int comm_lend_light_testing__get_idle_cpus(int domain);
+
 #endif //COMM_LEND_LIGHT
 
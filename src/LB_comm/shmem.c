@@ -24,6 +24,7 @@
 #include "LB_comm/shmem.h"
 
 #include "support/debug.h"
+#include "support/timers.h"
 
 #include <unistd.h>
 #include <sys/mman.h>
@@ -38,6 +39,7 @@
 #include <errno.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 
 #ifndef _POSIX_THREAD_PROCESS_SHARED
 #error This system does not support process shared mutexes
@@ -107,7 +109,7 @@ static void shmem_consistency_check_version(unsigned int creator_version,
     }
 }
 
-static void get_shmem_filename(char *filename, const char *shmem_module,
+void get_shmem_filename(char *filename, const char *shmem_module,
         const char *shmem_key, int shmem_color) {
     if (shmem_key && shmem_key[0] != '\0') {
         if (shmem_color <= 0) {
@@ -224,6 +226,64 @@ shmem_handler_t* shmem_init(void **shdata, const shmem_props_t *shmem_props) {
     return handler;
 }
 
+/* Attach to an existing shmem only for reading. The process is neither
+ * registered nor does it acquire the lock, so it can be used by monitoring
+ * tools at any rate without disturbing the processes using the shmem.
+ * Data must be read with shmem_snapshot. Returns NULL if the shmem does not
+ * exist or is not compatible. */
+shmem_handler_t* shmem_init_readonly(void **shdata, const shmem_props_t *shmem_props) {
+    const char *shmem_module = shmem_props->name;
+    char shm_filename[SHM_NAME_LENGTH];
+    get_shmem_filename(shm_filename, shmem_module, shmem_props->key, shmem_props->color);
+
+    int fd = shm_open(shm_filename, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    /* The size must match, otherwise it was created with other options */
+    size_t shsync_size = shmem_shsync__size();
+    size_t shm_size = shsync_size + shmem_props->size;
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) == -1 || (size_t)statbuf.st_size != shm_size) {
+        verbose(VB_SHMEM, "Shared memory %s size differs, ignoring", shm_filename);
+        close(fd);
+        return NULL;
+    }
+
+    char *shm_addr = mmap(NULL, shm_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm_addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    const shmem_sync_t *shsync = (shmem_sync_t*) shm_addr;
+    if (!shsync->initialized
+            || shsync->shsync_version != SHMEM_SYNC_VERSION
+            || (shmem_props->version != SHMEM_VERSION_IGNORE
+                && shsync->shmem_version != shmem_props->version)) {
+        verbose(VB_SHMEM, "Shared memory %s version differs, ignoring", shm_filename);
+        munmap(shm_addr, shm_size);
+        return NULL;
+    }
+
+    shmem_handler_t *handler = malloc(sizeof(shmem_handler_t));
+    handler->shm_size = shm_size;
+    snprintf(handler->shm_filename, SHM_NAME_LENGTH, "%s", shm_filename);
+    handler->shm_addr = shm_addr;
+    handler->shsync = (shmem_sync_t*) shm_addr;
+    *shdata = shm_addr + shsync_size;
+
+    return handler;
+}
+
+void shmem_finalize_readonly(shmem_handler_t *handler) {
+    if (munmap(handler->shm_addr, handler->shm_size) != 0) {
+        fatal("munmap error: %s", strerror(errno));
+    }
+    free(handler);
+}
+
 void shmem_finalize(shmem_handler_t* handler, bool (*is_empty_fn)(void)) {
 #ifdef IS_BGQ_MACHINE
     // BG/Q have some problems deallocating shmem
@@ -257,14 +317,62 @@ void shmem_finalize(shmem_handler_t* handler, bool (*is_empty_fn)(void)) {
     free(handler);
 }
 
+/* Every lock and unlock increments the sequence counter, so that readers
+ * can take consistent snapshots of the shmem without acquiring the lock */
+static inline void shmem_seq_begin(shmem_handler_t *handler) {
+    DLB_ATOMIC_ADD(&handler->shsync->seq, 1);
+}
+
+static inline void shmem_seq_end(shmem_handler_t *handler) {
+    DLB_ATOMIC_ADD(&handler->shsync->seq, 1);
+}
+
 void shmem_lock( shmem_handler_t* handler ) {
+    int64_t timer = timer_start();
     pthread_mutex_lock(&handler->shsync->shmem_mutex);
+    shmem_seq_begin(handler);
+    if (unlikely(timers_enabled)) {
+        timer_stop(TIMER_SHMEM_LOCK_WAIT, timer);
+        handler->lock_start = timer_start();
+    }
 }
 
 void shmem_unlock( shmem_handler_t* handler ) {
+    if (unlikely(timers_enabled)) {
+        timer_stop(TIMER_SHMEM_LOCK_HOLD, handler->lock_start);
+    }
+    shmem_seq_end(handler);
     pthread_mutex_unlock(&handler->shsync->shmem_mutex);
 }
 
+/* Copy 'size' bytes from 'src', an address inside the shmem, without
+ * acquiring the lock. The copy is retried until no process has modified the
+ * shmem in between. Only data modified under the shmem lock is guaranteed to
+ * be consistent; fields updated atomically outside the lock may be newer. */
+void shmem_snapshot(const shmem_handler_t *handler, void *dest, const void *src,
+        size_t size) {
+    enum { SNAPSHOT_MAX_RETRIES = 10000 };
+    atomic_uint *seq = &handler->shsync->seq;
+    for (int retries = 0; retries < SNAPSHOT_MAX_RETRIES; ++retries) {
+        unsigned int seq_begin = DLB_ATOMIC_LD_ACQ(seq);
+        if (seq_begin % 2 == 1) {
+            /* A writer holds the lock */
+            sched_yield();
+            continue;
+        }
+        memcpy(dest, src, size);
+        __sync_synchronize();
+        if (DLB_ATOMIC_LD_RLX(seq) == seq_begin) {
+            return;
+        }
+    }
+
+    /* The lock may be held by a process that died, return the current data */
+    verbose(VB_SHMEM, "Could not obtain a consistent snapshot of %s",
+            handler->shm_filename);
+    memcpy(dest, src, size);
+}
+
 /* Shared memory states    (BUSY(0-n)  <-  READY(0-n)  ->  MAINTENANCE(1)):
  *  - READY: the shared memory can be locked or moved to another state.
  *  - BUSY: the shared memory is being used, each process still needs to
@@ -288,6 +396,7 @@ void shmem_lock_maintenance( shmem_handler_t* handler ) {
         switch(*state) {
             case SHMEM_READY:
                 /* Lock successfully acquired: READY -> MAINTENANCE */
+                shmem_seq_begin(handler);
                 *state = SHMEM_MAINTENANCE;
                 return;
             case SHMEM_BUSY:
@@ -309,6 +418,7 @@ void shmem_unlock_maintenance( shmem_handler_t* handler ) {
     /* Unlock MAINTENANCE -> READY */
     int error = handler->shsync->state != SHMEM_MAINTENANCE;
     handler->shsync->state = SHMEM_READY;
+    shmem_seq_end(handler);
     pthread_mutex_unlock(&handler->shsync->shmem_mutex);
 
     /* This should not happen */
@@ -20,8 +20,11 @@
 #ifndef SHMEM_H
 #define SHMEM_H
 
+#include "support/atomic.h"
+
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <pthread.h>
 
 // Shared Memory State. Used for state-based locks.
@@ -39,10 +42,11 @@ typedef struct {
     int                 initialized;    // Only the first process sets 0 -> 1
     shmem_state_t       state;          // Shared memory state
     pthread_mutex_t     shmem_mutex;    // Mutex to grant exclusive access to the shmem
+    atomic_uint         seq;            // Sequence counter, odd while the lock is held
     pid_t               pidlist[];      // Array of attached PIDs
 } shmem_sync_t;
 
-enum { SHMEM_SYNC_VERSION = 3 };
+enum { SHMEM_SYNC_VERSION = 4 };
 
 enum { SHM_NAME_LENGTH = 64 };
 
@@ -51,6 +55,7 @@ typedef struct {
     char            shm_filename[SHM_NAME_LENGTH];
     char            *shm_addr;
     shmem_sync_t    *shsync;
+    int64_t         lock_start;     // Only valid while the lock is held
 } shmem_handler_t;
 
 typedef struct {
@@ -66,13 +71,19 @@ enum { SHMEM_VERSION_IGNORE = 0 };
 
 shmem_handler_t* shmem_init(void **shdata, const shmem_props_t *shmem_props);
 void shmem_finalize(shmem_handler_t *handler, bool (*is_empty_fn)(void));
+shmem_handler_t* shmem_init_readonly(void **shdata, const shmem_props_t *shmem_props);
+void shmem_finalize_readonly(shmem_handler_t *handler);
 void shmem_lock(shmem_handler_t *handler);
 void shmem_unlock(shmem_handler_t *handler);
+void shmem_snapshot(const shmem_handler_t *handler, void *dest, const void *src,
+        size_t size);
 void shmem_lock_maintenance( shmem_handler_t* handler );
 void shmem_unlock_maintenance( shmem_handler_t* handler );
 void shmem_acquire_busy( shmem_handler_t* handler );
 void shmem_release_busy( shmem_handler_t* handler );
 char *get_shm_filename(shmem_handler_t *handler);
+void get_shmem_filename(char *filename, const char *shmem_module,
+        const char *shmem_key, int shmem_color);
 bool shmem_exists(const char *shmem_module, const char *shmem_key);
 void shmem_destroy(const char *shmem_module, const char *shmem_key);
 int shmem_shsync__version(void);
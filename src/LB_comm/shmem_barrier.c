@@ -24,50 +24,178 @@
 #include "LB_comm/shmem_barrier.h"
 
 #include "LB_core/DLB_kernel.h"
+#include "LB_core/spd.h"
 #include "LB_comm/shmem.h"
 #include "apis/dlb_errors.h"
 #include "support/atomic.h"
 #include "support/debug.h"
 #include "support/mask_utils.h"
 #include "support/mytime.h"
+#include "support/small_array.h"
+#include "support/types.h"
 #include "talp/talp.h"
 
-#include <errno.h>
-#include <pthread.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sched.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 typedef struct barrier_flags {
     bool initialized:1;
     bool lewi:1;
 } barrier_flags_t;
 
+/* Node barrier implemented as a sense-reversing counter:
+ *  - 'state' packs the number of participants (upper 32 bits) and the number
+ *    of arrived participants (lower 32 bits), so that a single fetch-and-add
+ *    tells each process whether it is the last one to arrive. Attach and
+ *    detach only modify the number of participants while no barrier is in
+ *    progress (count == 0), i.e., between two barrier epochs.
+ *  - 'generation' is the futex word that the last participant increments to
+ *    release the rest. Waiters spin for a while and then sleep on it.
+ *  - Each group of fields lives in its own cache line to avoid false sharing
+ *    between arriving and waiting processes.
+ */
 typedef struct barrier_t {
     char name[BARRIER_NAME_MAX];
     barrier_flags_t flags;
-    unsigned int participants;
-    atomic_uint ntimes;
-    atomic_uint count;
-    pthread_barrier_t barrier;
-    pthread_rwlock_t rwlock;
+    atomic_uint spin_limit;
+    DLB_ALIGN_CACHE atomic_uint_least64_t state;
+    DLB_ALIGN_CACHE atomic_uint generation;
+    atomic_uint sleepers;
+    DLB_ALIGN_CACHE atomic_uint ntimes;
+    atomic_uint nsleeps;
+    atomic_uint_least64_t wait_time;
+    atomic_uint_least64_t max_wait_time;
 } barrier_t;
 
+enum { BARRIER_COUNT_BITS = 32 };
+#define BARRIER_COUNT_MASK  ((UINT64_C(1) << BARRIER_COUNT_BITS) - 1)
+#define BARRIER_ONE_PARTICIPANT (UINT64_C(1) << BARRIER_COUNT_BITS)
+
+enum {
+    BARRIER_SPIN_MIN     = 64,
+    BARRIER_SPIN_INITIAL = 1024,
+    BARRIER_SPIN_MAX     = 65536,
+};
+
+static inline unsigned int get_participants(uint64_t state) {
+    return state >> BARRIER_COUNT_BITS;
+}
+
+static inline unsigned int get_count(uint64_t state) {
+    return state & BARRIER_COUNT_MASK;
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield" ::: "memory");
+#elif defined(__powerpc__) || defined(__ppc__) || defined(__PPC__)
+    __asm__ __volatile__("or 27,27,27" ::: "memory");
+#endif
+}
+
+/* The barrier is allocated in shared memory, futex must not be private */
+static inline void futex_wait(atomic_uint *uaddr, unsigned int val) {
+    syscall(SYS_futex, (void*)uaddr, FUTEX_WAIT, val, NULL, NULL, 0);
+}
+
+static inline void futex_wake_all(atomic_uint *uaddr) {
+    syscall(SYS_futex, (void*)uaddr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* Per-process information of each barrier. It allows a process arriving
+ * early to a LeWI barrier to know which participants are still running, so
+ * that its CPUs can be handed off to them (--lewi-barrier-handoff).
+ * The table of each barrier is located after the barriers array. */
+typedef struct barrier_proc_t {
+    pid_t pid;
+    bool handoff;
+    atomic_uint attached;   // number of attached participants of this process
+    atomic_uint arrived;    // number of them currently blocked in the barrier
+} barrier_proc_t;
+
 typedef struct {
     bool initialized;
     int max_barriers;   // capacity
     int num_barriers;   // size, although detached may be counted
     barrier_t barriers[];
+    /* barrier_proc_t procs[max_barriers][procs_per_barrier]; */
 } shdata_t;
 
-enum { SHMEM_BARRIER_VERSION = 7 };
+enum { SHMEM_BARRIER_VERSION = 10 };
 enum { SHMEM_TIMEOUT_SECONDS = 1 };
 
+/* Processes may oversubscribe small nodes, and a process that does not fit in
+ * the table of a barrier cannot attach to it */
+enum { MIN_PROCS_PER_BARRIER = 64 };
+
+static inline int get_procs_per_barrier(void) {
+    return max_int(mu_get_system_size(), MIN_PROCS_PER_BARRIER);
+}
+
 static int max_barriers = 0;
+static int procs_per_barrier = 0;
 static shmem_handler_t *shm_handler = NULL;
 static shdata_t *shdata = NULL;
 static const char *shmem_name = "barrier";
 
+static inline barrier_proc_t* get_barrier_procs(shdata_t *shared_data,
+        const barrier_t *barrier) {
+    barrier_proc_t *procs =
+        (barrier_proc_t*)&shared_data->barriers[shared_data->max_barriers];
+    return &procs[(barrier - shared_data->barriers) * procs_per_barrier];
+}
+
+static barrier_proc_t* find_barrier_proc(barrier_proc_t *procs, pid_t pid) {
+    for (int i = 0; i < procs_per_barrier; ++i) {
+        if (procs[i].pid == pid) {
+            return &procs[i];
+        }
+    }
+    return NULL;
+}
+
+/* Shmem lock must be acquired */
+static int add_barrier_proc(barrier_proc_t *procs, pid_t pid, bool handoff) {
+    barrier_proc_t *proc = find_barrier_proc(procs, pid);
+    if (proc == NULL) {
+        proc = find_barrier_proc(procs, 0);
+        if (proc == NULL) return DLB_ERR_NOMEM;
+        proc->pid = pid;
+        proc->handoff = handoff;
+    }
+    DLB_ATOMIC_ADD(&proc->attached, 1);
+    return DLB_SUCCESS;
+}
+
+/* Shmem lock must be acquired */
+static void remove_barrier_proc(barrier_proc_t *procs, pid_t pid) {
+    barrier_proc_t *proc = find_barrier_proc(procs, pid);
+    if (proc != NULL
+            && DLB_ATOMIC_SUB_FETCH(&proc->attached, 1) == 0) {
+        *proc = (const barrier_proc_t){};
+    }
+}
+
+static void clear_barrier_procs(barrier_proc_t *procs) {
+    memset(procs, 0, sizeof(barrier_proc_t) * procs_per_barrier);
+}
+
+static inline pid_t get_self_pid(void) {
+    return thread_spd != NULL && thread_spd->id != 0 ? thread_spd->id : getpid();
+}
+
+static inline bool handoff_enabled(void) {
+    return thread_spd != NULL && thread_spd->options.lewi_barrier_handoff;
+}
+
 static void cleanup_shmem(void *shdata_ptr, int pid) {
 
     bool shmem_empty = true;
@@ -75,8 +203,19 @@ static void cleanup_shmem(void *shdata_ptr, int pid) {
     int num_barriers = shared_data->num_barriers;
     for (int i = 0; i < num_barriers; i++) {
         barrier_t *barrier = &shared_data->barriers[i];
-        if (--barrier->participants == 0) {
+        barrier_proc_t *procs = get_barrier_procs(shared_data, barrier);
+        barrier_proc_t *proc = find_barrier_proc(procs, pid);
+        uint64_t state = DLB_ATOMIC_LD(&barrier->state);
+        if (proc != NULL) {
+            /* Remove all the participants of the process */
+            uint64_t attached = DLB_ATOMIC_LD(&proc->attached);
+            state = DLB_ATOMIC_SUB_FETCH(&barrier->state,
+                    attached * BARRIER_ONE_PARTICIPANT);
+            *proc = (const barrier_proc_t){};
+        }
+        if (get_participants(state) == 0) {
             *barrier = (const barrier_t){};
+            clear_barrier_procs(procs);
         } else {
             shmem_empty = false;
         }
@@ -91,6 +230,7 @@ static void cleanup_shmem(void *shdata_ptr, int pid) {
 static void open_shmem(const char *shmem_key, int shmem_size_multiplier) {
 
     max_barriers = mu_get_system_size() * shmem_size_multiplier;
+    procs_per_barrier = get_procs_per_barrier();
     shm_handler = shmem_init((void**)&shdata,
             &(const shmem_props_t) {
                 .size = shmem_barrier__size(),
@@ -187,17 +327,55 @@ barrier_t* shmem_barrier__find(const char *barrier_name) {
 
     int num_barriers = shdata->num_barriers;
     for (int i = 0; i < num_barriers; ++i) {
-        if (shdata->barriers[i].participants > 0
-                && shdata->barriers[i].flags.initialized
-                && strncmp(shdata->barriers[i].name, barrier_name,
+        barrier_t *barrier = &shdata->barriers[i];
+        if (get_participants(DLB_ATOMIC_LD(&barrier->state)) > 0
+                && barrier->flags.initialized
+                && strncmp(barrier->name, barrier_name,
                     BARRIER_NAME_MAX-1) == 0) {
-            return &shdata->barriers[i];
+            return barrier;
         }
     }
 
     return NULL;
 }
 
+/* Add 'delta' participants to the barrier. The number of participants can
+ * only be modified between barrier epochs, i.e., when no process is blocked in
+ * the barrier. Return the updated number of participants, or an error code. */
+static int update_participants(barrier_t *barrier, int delta, bool timed) {
+
+    struct timespec start;
+    get_time_coarse(&start);
+
+    uint64_t state = DLB_ATOMIC_LD(&barrier->state);
+    while (true) {
+        if (!barrier->flags.initialized
+                || get_participants(state) == 0) {
+            return DLB_ERR_PERM;
+        }
+
+        if (get_count(state) == 0) {
+            /* Barrier is not in progress, try to update participants */
+            uint64_t new_state = state + (int64_t)delta * BARRIER_ONE_PARTICIPANT;
+            if (DLB_ATOMIC_CMP_EXCH_WEAK(&barrier->state, state, new_state)) {
+                return get_participants(new_state);
+            }
+            state = DLB_ATOMIC_LD(&barrier->state);
+        } else {
+            /* Some participants are blocked, wait until the epoch ends */
+            if (timed) {
+                struct timespec now;
+                get_time_coarse(&now);
+                if (now.tv_sec - start.tv_sec > SHMEM_TIMEOUT_SECONDS) {
+                    return DLB_ERR_TIMEOUT;
+                }
+            }
+            sched_yield();
+            state = DLB_ATOMIC_LD(&barrier->state);
+        }
+    }
+}
+
 /* Register and attach process to barrier.
  *   barrier_name: barrier name
  *   lewi: whether this barrier does lewi
@@ -209,8 +387,7 @@ barrier_t* shmem_barrier__register(const char *barrier_name, bool lewi) {
     /* Obtain the shared memory lock to find the appropriate place for the new
      * barrier. If the barrier is not created, the first process must
      * initialize it before releasing the lock. If the barrier was already
-     * created, new processes may attach after acquiring both the shmem and the
-     * barrier specific lock. */
+     * created, new processes attach once the barrier is not in progress. */
     int participants = -1;
     barrier_t *barrier = NULL;
     shmem_lock(shm_handler);
@@ -219,12 +396,14 @@ barrier_t* shmem_barrier__register(const char *barrier_name, bool lewi) {
         barrier_t *empty_spot = NULL;
         int num_barriers = shdata->num_barriers;
         for (int i = 0; i < num_barriers; ++i) {
+            unsigned int barrier_participants =
+                get_participants(DLB_ATOMIC_LD(&shdata->barriers[i].state));
             if (empty_spot == NULL
-                    && shdata->barriers[i].participants == 0
+                    && barrier_participants == 0
                     && !shdata->barriers[i].flags.initialized) {
                 empty_spot = &shdata->barriers[i];
             }
-            else if (shdata->barriers[i].participants > 0
+            else if (barrier_participants > 0
                     && shdata->barriers[i].flags.initialized
                     && strncmp(shdata->barriers[i].name, barrier_name,
                         BARRIER_NAME_MAX-1) == 0) {
@@ -239,64 +418,42 @@ barrier_t* shmem_barrier__register(const char *barrier_name, bool lewi) {
             ++shdata->num_barriers;
         }
 
-        /* New barrier, lock first and initialize required fields */
         if (barrier == NULL && empty_spot != NULL) {
+            /* New barrier, initialize all fields. No other process can
+             * observe it until 'initialized' is set under the shmem lock. */
             barrier = empty_spot;
-            *barrier = (const barrier_t){};
-
-            pthread_rwlockattr_t rwlockattr;
-            pthread_rwlockattr_init(&rwlockattr);
-            pthread_rwlockattr_setpshared(&rwlockattr, PTHREAD_PROCESS_SHARED);
-            pthread_rwlock_init(&barrier->rwlock, &rwlockattr);
-            pthread_rwlockattr_destroy(&rwlockattr);
-
-            /* Initialize only once the lock is acquired */
-            pthread_rwlock_wrlock(&barrier->rwlock);
-            {
-                barrier->flags = (const barrier_flags_t) {
+            *barrier = (const barrier_t){
+                .flags = {
                     .initialized = true,
                     .lewi = lewi,
-                };
-                barrier->participants = 1;
-                participants = 1;
-                snprintf(barrier->name, BARRIER_NAME_MAX, "%s", barrier_name);
-                pthread_barrierattr_t barrierattr;
-                pthread_barrierattr_init(&barrierattr);
-                pthread_barrierattr_setpshared(&barrierattr, PTHREAD_PROCESS_SHARED);
-                pthread_barrier_init(&barrier->barrier, &barrierattr, barrier->participants);
-                pthread_barrierattr_destroy(&barrierattr);
-            }
-            pthread_rwlock_unlock(&barrier->rwlock);
+                },
+                .spin_limit = BARRIER_SPIN_INITIAL,
+                .state = BARRIER_ONE_PARTICIPANT,
+            };
+            snprintf(barrier->name, BARRIER_NAME_MAX, "%s", barrier_name);
+            barrier_proc_t *procs = get_barrier_procs(shdata, barrier);
+            clear_barrier_procs(procs);
+            add_barrier_proc(procs, get_self_pid(), handoff_enabled());
+            participants = 1;
 
         } else if (barrier != NULL){
             /* Barrier was created by another participant, attach.
-             * (timedlock is used to avoid potential deadlocks) */
-            struct timespec timeout;
-            get_time_real(&timeout);
-            timeout.tv_sec += SHMEM_TIMEOUT_SECONDS;
-            int timedwrlock_error = pthread_rwlock_timedwrlock(&barrier->rwlock, &timeout);
-            if (likely(timedwrlock_error == 0)) {
-                /* Update participants */
-                participants = ++barrier->participants;
-
-                /* Create new barrier with the number of participants updated */
-                pthread_barrier_destroy(&barrier->barrier);
-                pthread_barrierattr_t attr;
-                pthread_barrierattr_init(&attr);
-                pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-                pthread_barrier_init(&barrier->barrier, &attr, barrier->participants);
-                pthread_barrierattr_destroy(&attr);
-
-                pthread_rwlock_unlock(&barrier->rwlock);
-
-            } else if (timedwrlock_error == ETIMEDOUT || timedwrlock_error == EDEADLK) {
+             * (timeout is used to avoid potential deadlocks) */
+            participants = update_participants(barrier, 1, true);
+            if (participants == DLB_ERR_TIMEOUT) {
                 shmem_unlock(shm_handler);
                 fatal("Timed out while creating shmem_barrier.\n"
                         "Please, report at " PACKAGE_BUGREPORT);
-            } else if (timedwrlock_error == EINVAL) {
-                shmem_unlock(shm_handler);
-                fatal("Error acquiring timedwrlock while creating shmem_barrier.\n"
-                        "Please, report at " PACKAGE_BUGREPORT);
+            }
+            if (participants > 0
+                    && add_barrier_proc(get_barrier_procs(shdata, barrier),
+                        get_self_pid(), handoff_enabled()) != DLB_SUCCESS) {
+                /* Participants without an entry could not be removed if the
+                 * process dies, so the attach is undone */
+                update_participants(barrier, -1, true);
+                warning("Process table of barrier %s is full, process %d cannot"
+                        " attach", barrier_name, get_self_pid());
+                barrier = NULL;
             }
         }
     }
@@ -313,209 +470,242 @@ barrier_t* shmem_barrier__register(const char *barrier_name, bool lewi) {
 
 /* The attach function should not have any races with the global shared memory.
  * At most, 'barrier' points to an unitialized barrier and error is returned.
+ * The shmem lock is only needed to update the per-process table.
  * */
 int shmem_barrier__attach(barrier_t *barrier) {
     if (barrier == NULL) return DLB_ERR_UNKNOWN;
     if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
 
-#ifdef DEBUG_VERSION
-    int count;
-#endif
-    int participants;
-    pthread_rwlock_wrlock(&barrier->rwlock);
-    {
-        if (!barrier->flags.initialized
-                || barrier->participants == 0) {
-            pthread_rwlock_unlock(&barrier->rwlock);
-            return DLB_ERR_PERM;
+    int participants = update_participants(barrier, 1, false);
+    if (participants > 0) {
+        shmem_lock(shm_handler);
+        {
+            /* Participants without an entry could not be removed if the
+             * process dies, so the attach is undone if the table is full */
+            if (add_barrier_proc(get_barrier_procs(shdata, barrier),
+                        get_self_pid(), handoff_enabled()) != DLB_SUCCESS) {
+                update_participants(barrier, -1, true);
+                participants = DLB_ERR_NOMEM;
+            }
         }
-
-        /* Update participants */
-        participants = ++barrier->participants;
-
-        /* Create new barrier with the number of participants updated */
-        pthread_barrier_destroy(&barrier->barrier);
-        pthread_barrierattr_t attr;
-        pthread_barrierattr_init(&attr);
-        pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-        pthread_barrier_init(&barrier->barrier, &attr, barrier->participants);
-        pthread_barrierattr_destroy(&attr);
-
-#ifdef DEBUG_VERSION
-        count = barrier->count;
-#endif
+        shmem_unlock(shm_handler);
     }
-    pthread_rwlock_unlock(&barrier->rwlock);
-
-    ensure(count == 0, "Barrier Shared memory inconsistency while attaching "
-            "barrier (count = %d).\n" "Please, report at " PACKAGE_BUGREPORT,
-            count);
 
     return participants;
 }
 
 /* The detach function may remove the barrier if 'participants' reaches 0 and
- * compete with a barrier creation. This function needs to acquire both locks. */
+ * compete with a barrier creation, so it needs to acquire the shmem lock. */
 int shmem_barrier__detach(barrier_t *barrier) {
     if (barrier == NULL) return DLB_ERR_UNKNOWN;
     if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
 
-#ifdef DEBUG_VERSION
-    int count = -1;
-#endif
-    int participants = -1;
-
+    int participants;
     shmem_lock(shm_handler);
     {
-        struct timespec timeout;
-        get_time_real(&timeout);
-        timeout.tv_sec += SHMEM_TIMEOUT_SECONDS;
-        int timedwrlock_error = pthread_rwlock_timedwrlock(&barrier->rwlock, &timeout);
-        if (likely(timedwrlock_error == 0)) {
-
-            if (!barrier->flags.initialized
-                    || barrier->participants == 0) {
-                pthread_rwlock_unlock(&barrier->rwlock);
-                shmem_unlock(shm_handler);
-                return DLB_ERR_PERM;
-            }
-
-#ifdef DEBUG_VERSION
-            count = barrier->count;
-#endif
-            /* Both locks are acquired and barrier is valid, detach: */
-
-            /* Update participants */
-            participants = --barrier->participants;
-
-            if (participants > 0) {
-                /* Create new barrier with the number of participants updated */
-                pthread_barrier_destroy(&barrier->barrier);
-                pthread_barrierattr_t attr;
-                pthread_barrierattr_init(&attr);
-                pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-                pthread_barrier_init(&barrier->barrier, &attr, barrier->participants);
-                pthread_barrierattr_destroy(&attr);
-
-                pthread_rwlock_unlock(&barrier->rwlock);
-            } else {
-                /* If this is the last participant, uninitialize barrier */
-                pthread_rwlock_unlock(&barrier->rwlock);
-                pthread_barrier_destroy(&barrier->barrier);
-                pthread_rwlock_destroy(&barrier->rwlock);
-                *barrier = (const barrier_t){};
-
-                /* Try to compact barrier list */
-                for (int i = shdata->num_barriers - 1; i >= 0; --i) {
-                    if (shdata->barriers[i].flags.initialized) {
-                        --shdata->num_barriers;
-                    } else {
-                        break;
-                    }
+        participants = update_participants(barrier, -1, true);
+        if (participants >= 0) {
+            remove_barrier_proc(get_barrier_procs(shdata, barrier), get_self_pid());
+        }
+        if (participants == 0) {
+            /* If this is the last participant, uninitialize barrier */
+            *barrier = (const barrier_t){};
+            clear_barrier_procs(get_barrier_procs(shdata, barrier));
+
+            /* Try to compact barrier list */
+            for (int i = shdata->num_barriers - 1; i >= 0; --i) {
+                if (shdata->barriers[i].flags.initialized) {
+                    --shdata->num_barriers;
+                } else {
+                    break;
                 }
             }
-        } else if (timedwrlock_error == ETIMEDOUT || timedwrlock_error == EDEADLK) {
+        } else if (participants == DLB_ERR_TIMEOUT) {
             shmem_unlock(shm_handler);
             fatal("Timed out while detaching barrier.\n"
                     "Please, report at " PACKAGE_BUGREPORT);
-        } else if (timedwrlock_error == EINVAL) {
-            shmem_unlock(shm_handler);
-            fatal("Error acquiring timedwrlock while detaching barrier.\n"
-                    "Please, report at " PACKAGE_BUGREPORT);
         }
     }
     shmem_unlock(shm_handler);
 
-    ensure(count == 0, "Barrier Shared memory inconsistency while attaching "
-            "barrier (count = %d).\n" "Please, report at " PACKAGE_BUGREPORT,
-            count);
-
     return participants;
 }
 
+/* Block until the barrier generation differs from 'generation'. Spin first,
+ * adapting the number of iterations to how long the previous waits took, and
+ * sleep on the futex afterwards. */
+static void wait_for_release(barrier_t *barrier, unsigned int generation,
+        bool allow_spin) {
+
+    if (allow_spin) {
+        unsigned int spin_limit = DLB_ATOMIC_LD_RLX(&barrier->spin_limit);
+        for (unsigned int i = 0; i < spin_limit; ++i) {
+            if (DLB_ATOMIC_LD_ACQ(&barrier->generation) != generation) {
+                /* Released while spinning, spin a bit longer next time */
+                if (spin_limit < BARRIER_SPIN_MAX) {
+                    DLB_ATOMIC_ST_RLX(&barrier->spin_limit, spin_limit * 2);
+                }
+                return;
+            }
+            cpu_relax();
+        }
+
+        /* Spinning was useless this time, spin less next time */
+        if (spin_limit > BARRIER_SPIN_MIN) {
+            DLB_ATOMIC_ST_RLX(&barrier->spin_limit, spin_limit / 2);
+        }
+    }
+
+    DLB_ATOMIC_ADD(&barrier->sleepers, 1);
+    DLB_ATOMIC_ADD_RLX(&barrier->nsleeps, 1);
+    while (DLB_ATOMIC_LD(&barrier->generation) == generation) {
+        futex_wait(&barrier->generation, generation);
+    }
+    DLB_ATOMIC_SUB(&barrier->sleepers, 1);
+}
+
+static void update_wait_stats(barrier_t *barrier, int64_t wait_time) {
+    DLB_ATOMIC_ADD_RLX(&barrier->wait_time, wait_time);
+    uint64_t max_wait_time = DLB_ATOMIC_LD_RLX(&barrier->max_wait_time);
+    while ((uint64_t)wait_time > max_wait_time
+            && !DLB_ATOMIC_CMP_EXCH_WEAK(&barrier->max_wait_time,
+                max_wait_time, (uint64_t)wait_time)) {
+        max_wait_time = DLB_ATOMIC_LD_RLX(&barrier->max_wait_time);
+    }
+}
+
+/* Fill 'pids' with the processes participating in the barrier that accept a
+ * CPU handoff and have some participant not yet arrived. Return its size. */
+static unsigned int get_running_procs(barrier_t *barrier,
+        const barrier_proc_t *self_proc, pid_t *pids) {
+    unsigned int npids = 0;
+    barrier_proc_t *procs = get_barrier_procs(shdata, barrier);
+    for (int i = 0; i < procs_per_barrier; ++i) {
+        const barrier_proc_t *proc = &procs[i];
+        if (proc != self_proc
+                && proc->pid != 0
+                && proc->handoff
+                && DLB_ATOMIC_LD(&proc->arrived) < DLB_ATOMIC_LD(&proc->attached)) {
+            pids[npids++] = proc->pid;
+        }
+    }
+    return npids;
+}
+
 void shmem_barrier__barrier(barrier_t *barrier) {
     if (unlikely(shm_handler == NULL)) return;
 
-    pthread_rwlock_rdlock(&barrier->rwlock);
-    {
-        if (unlikely(!barrier->flags.initialized)) {
-            warning("Trying to use a non initialized barrier");
-            pthread_rwlock_unlock(&barrier->rwlock);
-            return;
+    if (unlikely(!barrier->flags.initialized)) {
+        warning("Trying to use a non initialized barrier");
+        return;
+    }
+
+    /* If handoff is enabled, mark this process as arrived before the barrier
+     * count is incremented, so that the rest of participants do not hand
+     * off any CPU to this process from now on */
+    barrier_proc_t *self_proc = NULL;
+    if (barrier->flags.lewi && handoff_enabled()) {
+        self_proc = find_barrier_proc(get_barrier_procs(shdata, barrier),
+                get_self_pid());
+        if (self_proc != NULL) {
+            DLB_ATOMIC_ADD(&self_proc->arrived, 1);
         }
+    }
 
-        unsigned int participant_number = DLB_ATOMIC_ADD_FETCH(&barrier->count, 1);
-        bool last_in = participant_number == barrier->participants;
+    /* The generation must be read before arriving, the last participant
+     * cannot increment it until this process has arrived */
+    unsigned int generation = DLB_ATOMIC_LD_ACQ(&barrier->generation);
+    uint64_t state = DLB_ATOMIC_ADD_FETCH(&barrier->state, 1);
+    unsigned int participants = get_participants(state);
+    bool last_in = get_count(state) == participants;
 
-        verbose(VB_BARRIER, "Entering barrier %s%s", barrier->name, last_in ? " (last)" : "");
+    verbose(VB_BARRIER, "Entering barrier %s%s", barrier->name, last_in ? " (last)" : "");
 
-        if (last_in) {
-            // Barrier
-            pthread_barrier_wait(&barrier->barrier);
+    if (last_in) {
+        // Increase ntimes counter
+        DLB_ATOMIC_ADD_RLX(&barrier->ntimes, 1);
 
-            // Increase ntimes counter
-            DLB_ATOMIC_ADD_RLX(&barrier->ntimes, 1);
-        } else {
-            // Only if this process is not the last one, act as a blocking call
-            if (barrier->flags.lewi) {
-                sync_call_flags_t mpi_flags = (const sync_call_flags_t) {
-                    .is_dlb_barrier = true,
-                    .is_blocking = true,
-                    .is_collective = true,
-                    .do_lewi = true,
-                };
+        // Start a new epoch and release the rest of participants
+        DLB_ATOMIC_SUB(&barrier->state, participants);
+        DLB_ATOMIC_ADD(&barrier->generation, 1);
+        if (DLB_ATOMIC_LD(&barrier->sleepers) > 0) {
+            futex_wake_all(&barrier->generation);
+        }
+    } else {
+        int64_t wait_start = get_time_in_ns();
+
+        // Only if this process is not the last one, act as a blocking call
+        if (barrier->flags.lewi) {
+            sync_call_flags_t mpi_flags = (const sync_call_flags_t) {
+                .is_dlb_barrier = true,
+                .is_blocking = true,
+                .is_collective = true,
+                .do_lewi = true,
+            };
+            if (self_proc != NULL) {
+                /* Hand off CPUs to the processes that have not arrived yet */
+                small_array_pid_t recipients;
+                pid_t *pids = small_array_pid_t_init(&recipients, procs_per_barrier);
+                unsigned int nrecipients = get_running_procs(barrier, self_proc, pids);
+                into_sync_call_handoff(mpi_flags, pids, nrecipients);
+                small_array_pid_t_free(&recipients);
+            } else {
                 into_sync_call(mpi_flags);
             }
-
-            // Barrier
-            pthread_barrier_wait(&barrier->barrier);
-
-            // Recover resources for those processes that simulated a blocking call
-            if (barrier->flags.lewi) {
-                sync_call_flags_t mpi_flags = (const sync_call_flags_t) {
-                    .is_dlb_barrier = true,
-                    .is_blocking = true,
-                    .is_collective = true,
-                    .do_lewi = true,
-                };
-                out_of_sync_call(mpi_flags);
-            }
         }
 
-        unsigned int participants_left = DLB_ATOMIC_SUB_FETCH(&barrier->count, 1);
-        bool last_out = participants_left == 0;
+        // Barrier. Do not spin if the CPUs have been lent
+        wait_for_release(barrier, generation, !barrier->flags.lewi);
+
+        // Recover resources for those processes that simulated a blocking call
+        if (barrier->flags.lewi) {
+            sync_call_flags_t mpi_flags = (const sync_call_flags_t) {
+                .is_dlb_barrier = true,
+                .is_blocking = true,
+                .is_collective = true,
+                .do_lewi = true,
+            };
+            out_of_sync_call(mpi_flags);
+        }
 
-        verbose(VB_BARRIER, "Leaving barrier %s%s", barrier->name, last_out ? " (last)" : "");
+        update_wait_stats(barrier, get_time_in_ns() - wait_start);
+    }
 
-        /* WARNING: There may be a race condition with the 'count' value in
-         *          consecutive barriers (A -> B), if one process increases the
-         *          'count' value after entering B, while another process still
-         *          hasn't decreased it in B. Anyway, this is completely harmless
-         *          since it only affects the verbose message.
-         */
+    if (self_proc != NULL) {
+        DLB_ATOMIC_SUB(&self_proc->arrived, 1);
     }
-    pthread_rwlock_unlock(&barrier->rwlock);
+
+    verbose(VB_BARRIER, "Leaving barrier %s", barrier->name);
 }
 
 void shmem_barrier__print_info(const char *shmem_key, int shmem_size_multiplier) {
 
-    /* If the shmem is not opened, obtain a temporary fd */
-    bool temporary_shmem = shm_handler == NULL;
+    /* If the shmem is not opened, attach to it only for reading */
+    shmem_handler_t *handler = shm_handler;
+    shdata_t *shared_data = shdata;
+    size_t size = shmem_barrier__size();
+    bool temporary_shmem = handler == NULL;
     if (temporary_shmem) {
-        shmem_barrier_ext__init(shmem_key, shmem_size_multiplier);
+        size = sizeof(shdata_t)
+            + (sizeof(barrier_t) + sizeof(barrier_proc_t) * get_procs_per_barrier())
+            * mu_get_system_size() * shmem_size_multiplier;
+        handler = shmem_init_readonly((void**)&shared_data,
+                &(const shmem_props_t) {
+                    .size = size,
+                    .name = shmem_name,
+                    .key = shmem_key,
+                    .version = SHMEM_BARRIER_VERSION,
+                });
+        if (handler == NULL) return;
     }
 
-    /* Make a full copy of the shared memory */
-    shdata_t *shdata_copy = malloc(shmem_barrier__size());
-    shmem_lock(shm_handler);
-    {
-        memcpy(shdata_copy, shdata, shmem_barrier__size());
-    }
-    shmem_unlock(shm_handler);
+    /* Make a full copy of the shared memory without locking it */
+    shdata_t *shdata_copy = malloc(size);
+    shmem_snapshot(handler, shdata_copy, shared_data, size);
 
     /* Close shmem if needed */
     if (temporary_shmem) {
-        shmem_barrier_ext__finalize();
+        shmem_finalize_readonly(handler);
     }
 
     /* Initialize buffer */
@@ -523,7 +713,7 @@ void shmem_barrier__print_info(const char *shmem_key, int shmem_size_multiplier)
     printbuffer_init(&buffer);
 
     /* Set up line buffer */
-    enum { MAX_LINE_LEN = 128 };
+    enum { MAX_LINE_LEN = 160 };
     char line[MAX_LINE_LEN];
 
     int num_barriers = shdata_copy->num_barriers;
@@ -531,17 +721,29 @@ void shmem_barrier__print_info(const char *shmem_key, int shmem_size_multiplier)
         barrier_t *barrier = &shdata_copy->barriers[i];
         if (barrier->flags.initialized) {
 
+            /* Average wait time per non-last participant */
+            uint64_t state = barrier->state;
+            unsigned int participants = get_participants(state);
+            unsigned int nwaits = barrier->ntimes * (participants > 0 ? participants-1 : 0);
+            char avg_wait[16];
+            char max_wait[16];
+            ns_to_human(avg_wait, sizeof(avg_wait),
+                    nwaits > 0 ? (int64_t)(barrier->wait_time / nwaits) : 0);
+            ns_to_human(max_wait, sizeof(max_wait), barrier->max_wait_time);
+
             /* Append line to buffer */
             snprintf(line, MAX_LINE_LEN,
-                    "  | %14s | %12u | %12u | %12u |",
-                    barrier->name, barrier->participants, barrier->count, barrier->ntimes);
+                    "  | %14s | %12u | %12u | %12u | %10s | %10s | %8u |",
+                    barrier->name, participants, get_count(state), barrier->ntimes,
+                    avg_wait, max_wait, barrier->nsleeps);
             printbuffer_append(&buffer, line);
         }
     }
 
     if (buffer.addr[0] != '\0' ) {
         info0("=== Barriers ===\n"
-              "  |  Barrier Name  | Participants | Num. blocked | Times compl. |\n"
+              "  |  Barrier Name  | Participants | Num. blocked | Times compl. |"
+              " Avg. wait  | Max. wait  |  Sleeps  |\n"
               "%s", buffer.addr);
     }
     printbuffer_destroy(&buffer);
@@ -559,6 +761,7 @@ int shmem_barrier__version(void) {
 size_t shmem_barrier__size(void) {
     // max_barriers contains a value once shmem is initialized,
     // otherwise return default size
-    return sizeof(shdata_t) + sizeof(barrier_t) * (
-            max_barriers > 0 ? max_barriers : mu_get_system_size());
+    return sizeof(shdata_t)
+        + (sizeof(barrier_t) + sizeof(barrier_proc_t) * get_procs_per_barrier())
+        * (max_barriers > 0 ? max_barriers : mu_get_system_size());
 }
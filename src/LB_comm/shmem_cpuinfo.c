@@ -55,16 +55,29 @@
 #include "support/queue_template.h"
 
 /* queue_lewi_mask_request_t */
+enum { NO_TICKET_SLOT = -1 };
 typedef struct {
     pid_t        pid;
     unsigned int howmany;
     cpu_set_t    allowed;
+    int          ticket_slot;   /* ticket_requests index of asynchronous requests,
+                                   which are never merged, or NO_TICKET_SLOT */
 } lewi_mask_request_t;
 #define QUEUE_T lewi_mask_request_t
 #define QUEUE_KEY_T pid_t
 #define QUEUE_SIZE 1024
 #include "support/queue_template.h"
 
+/* CPUs still enqueued by an asynchronous request, updated atomically by the
+ * process that serves it so that its owner can test it without locking.
+ * The slot is released by its owner once the request is no longer enqueued */
+enum { MAX_TICKET_REQUESTS = 1024 };
+enum { TICKET_SLOT_FREE = -1 };
+typedef struct {
+    pid_t           pid;
+    atomic_int      ncpus;      /* 0 if served or removed, TICKET_SLOT_FREE if unused */
+} ticket_request_t;
+
 
 /* NOTE on default values:
  * The shared memory will be initializated to 0 when created,
@@ -86,6 +99,7 @@ typedef struct {
     pid_t           owner;                  // Current owner
     pid_t           guest;                  // Current user of the CPU
     cpu_state_t     state;                  // owner's POV state (busy or lent)
+    unsigned int    owner_max_parallelism;  // owner's max parallelism, 0 if unlimited
     queue_pid_t     requests;               // List of PIDs requesting the CPU
 } cpuinfo_t;
 
@@ -105,10 +119,15 @@ typedef struct {
     cpu_set_t                   occupied_cores;     /* redundant info for speeding up queries:
                                                        lent or busy cores and guested by other
                                                        than the owner (lent or reclaimed) */
+    uint64_t                    num_cpus_lent;      /* accumulated number of CPUs released */
+    uint64_t                    num_cpus_borrowed;  /* accumulated number of CPUs acquired */
+    atomic_uint_least64_t       bindings_version;   /* incremented on every change of owner,
+                                                       guest or state of any CPU */
+    ticket_request_t            ticket_requests[MAX_TICKET_REQUESTS];
     cpuinfo_t                   node_info[];
 } shdata_t;
 
-enum { SHMEM_CPUINFO_VERSION = 6 };
+enum { SHMEM_CPUINFO_VERSION = 11 };
 
 static shmem_handler_t *shm_handler = NULL;
 static shdata_t *shdata = NULL;
@@ -118,16 +137,25 @@ static bool respect_cpuset = true;
 static const char *shmem_name = "cpuinfo";
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static int subprocesses_attached = 0;
+static unsigned int shmem_attachment = 0;   /* incremented every time the shmem is opened */
 
 static inline bool is_idle(int cpu) __attribute__((unused));
 static inline bool is_borrowed(pid_t pid, int cpu) __attribute__((unused));
 static inline bool is_shmem_empty(void);
+static int find_free_ticket_slot(void);
+static void remove_global_requests(pid_t pid, bool release_tickets);
 
 
 static void update_shmem_timestamp(void) {
     DLB_ATOMIC_ST_REL(&shdata->timestamp_cpu_lent, get_time_in_ns());
 }
 
+/* Invalidate the binding caches of all processes. Must be called with the
+ * shmem locked, after modifying the owner, guest or state of some CPU */
+static inline void update_bindings_version(void) {
+    DLB_ATOMIC_ADD(&shdata->bindings_version, 1);
+}
+
 /* A core is eligible if all the CPUs in the core are not guested, or guested
  * by the process, and none of them are reclaimed */
 static bool core_is_eligible(pid_t pid, int cpuid) {
@@ -241,7 +269,12 @@ static pid_t find_new_guest(cpuinfo_t *cpuinfo) {
                 if (CPU_ISSET(cpuinfo->id, &it->allowed)
                         && core_is_eligible(it->pid, cpuinfo->id)) {
                     new_guest = it->pid;
-                    if (--(it->howmany) == 0) {
+                    --(it->howmany);
+                    if (it->ticket_slot != NO_TICKET_SLOT) {
+                        DLB_ATOMIC_ST_REL(&shdata->ticket_requests[it->ticket_slot].ncpus,
+                                (int)it->howmany);
+                    }
+                    if (it->howmany == 0) {
                         queue_lewi_mask_request_t_delete(&shdata->lewi_mask_requests, it);
                     }
                 }
@@ -264,6 +297,7 @@ static void register_cpu(cpuinfo_t *cpuinfo, int pid, int preinit_pid) {
     /* Set basic fields */
     cpuinfo->owner = pid;
     cpuinfo->state = CPU_BUSY;
+    cpuinfo->owner_max_parallelism = 0;
     if (cpuinfo->guest == NOBODY || cpuinfo->guest == preinit_pid) {
         cpuinfo->guest = pid;
     }
@@ -274,6 +308,8 @@ static void register_cpu(cpuinfo_t *cpuinfo, int pid, int preinit_pid) {
 
     /* Clear requests queue */
     queue_pid_t_clear(&cpuinfo->requests);
+
+    update_bindings_version();
 }
 
 static void deregister_cpu(cpuinfo_t *cpuinfo, int pid) {
@@ -310,6 +346,8 @@ static void deregister_cpu(cpuinfo_t *cpuinfo, int pid) {
             queue_pid_t_remove(&cpuinfo->requests, pid);
         }
     }
+
+    update_bindings_version();
 }
 
 
@@ -341,6 +379,7 @@ static void open_shmem(const char *shmem_key, int shmem_color) {
                         .cleanup_fn = cleanup_shmem,
                     });
             subprocesses_attached = 1;
+            ++shmem_attachment;
         } else {
             ++subprocesses_attached;
         }
@@ -364,6 +403,12 @@ static void init_shmem(void) {
 
         /* Initialize global requests */
         queue_lewi_mask_request_t_init(&shdata->lewi_mask_requests);
+        for (int i = 0; i < MAX_TICKET_REQUESTS; ++i) {
+            shdata->ticket_requests[i] = (const ticket_request_t) {
+                .pid = NOBODY,
+                .ncpus = TICKET_SLOT_FREE,
+            };
+        }
 
         /* Initialize CPU ids */
         struct timespec now;
@@ -532,7 +577,7 @@ static void deregister_process(pid_t pid) {
 
     // Remove any previous global request
     if (shdata->flags.queues_enabled) {
-        queue_lewi_mask_request_t_remove(&shdata->lewi_mask_requests, pid);
+        remove_global_requests(pid, true);
     }
 }
 
@@ -614,6 +659,7 @@ static void lend_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks)
     // If the process is the guest, free it
     if (cpuinfo->guest == pid) {
         cpuinfo->guest = NOBODY;
+        ++shdata->num_cpus_lent;
     }
 
     // If the CPU is free, find a new guest
@@ -664,6 +710,8 @@ static void lend_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks)
 
     // Add or remove CPUs in core to the occupied cores set
     update_occupied_cores(cpuinfo->owner, cpuinfo->id);
+
+    update_bindings_version();
 }
 
 int shmem_cpuinfo__lend_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks) {
@@ -745,6 +793,70 @@ int shmem_cpuinfo__lend_cpu_mask(pid_t pid, const cpu_set_t *restrict mask,
     return error;
 }
 
+static int borrow_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks);
+
+/* Lend the CPUs in mask and hand off those that remain idle to the processes
+ * in 'recipients', in a round-robin fashion. Used when a process blocks
+ * before others that are still computing towards the same synchronization
+ * point, e.g., early arrivers to a node barrier. */
+int shmem_cpuinfo__lend_cpu_mask_to(pid_t pid, const cpu_set_t *restrict mask,
+        const pid_t *restrict recipients, unsigned int nrecipients,
+        array_cpuinfo_task_t *restrict tasks) {
+
+    shmem_lock(shm_handler);
+    {
+        for (int cpuid = mu_get_first_cpu(mask);
+                cpuid >= 0;
+                cpuid = mu_get_next_cpu(mask, cpuid)) {
+            lend_cpu(pid, cpuid, tasks);
+        }
+
+        /* Number of CPUs that each recipient may still guest according to
+         * its max parallelism, or -1 if unlimited */
+        SMALL_ARRAY(int, room, nrecipients);
+        for (unsigned int i = 0; i < nrecipients; ++i) {
+            room[i] = -1;
+        }
+        for (int cpuid = 0; cpuid < node_size; ++cpuid) {
+            const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+            if (cpuinfo->owner_max_parallelism == 0) continue;
+            for (unsigned int i = 0; i < nrecipients; ++i) {
+                if (recipients[i] == cpuinfo->owner && room[i] == -1) {
+                    room[i] = cpuinfo->owner_max_parallelism;
+                    for (int id = 0; id < node_size; ++id) {
+                        if (shdata->node_info[id].guest == recipients[i]) {
+                            --room[i];
+                        }
+                    }
+                    room[i] = max_int(room[i], 0);
+                }
+            }
+        }
+
+        unsigned int next = 0;
+        for (int cpuid = mu_get_first_cpu(mask);
+                cpuid >= 0 && nrecipients > 0;
+                cpuid = mu_get_next_cpu(mask, cpuid)) {
+            if (shdata->node_info[cpuid].guest != NOBODY) continue;
+            for (unsigned int i = 0; i < nrecipients; ++i) {
+                unsigned int index = (next + i) % nrecipients;
+                if (recipients[index] != pid
+                        && room[index] != 0
+                        && borrow_cpu(recipients[index], cpuid, tasks) == DLB_SUCCESS) {
+                    if (room[index] > 0) --room[index];
+                    next = index + 1;
+                    break;
+                }
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+
+    update_shmem_timestamp();
+
+    return DLB_SUCCESS;
+}
+
 
 /*********************************************************************************/
 /*  Reclaim CPU                                                                  */
@@ -792,6 +904,7 @@ static int reclaim_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict task
                     });
             error = DLB_NOTED;
         }
+        update_bindings_version();
     } else {
         error = DLB_ERR_PERM;
     }
@@ -1064,6 +1177,7 @@ static int acquire_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict task
 
             error = DLB_NOTED;
         }
+        update_bindings_version();
     } else if (cpuinfo->guest == NOBODY
                 && cpuinfo->state == CPU_LENT
                 && core_is_eligible(pid, cpuid)) {
@@ -1083,6 +1197,7 @@ static int acquire_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict task
         }
 
         CPU_CLR(cpuid, &shdata->free_cpus);
+        update_bindings_version();
 
         error = DLB_SUCCESS;
     } else if (cpuinfo->state != CPU_DISABLED) {
@@ -1217,8 +1332,58 @@ static int borrow_cpus_in_array_cpuid_t(pid_t pid,
         const array_cpuid_t *restrict array_cpuid,
         int *restrict ncpus, array_cpuinfo_task_t *restrict tasks);
 
-int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
-        pid_t pid, int *restrict requested_ncpus,
+/* Arrays for temporary CPU priority, allocated per thread so that threads of
+ * independent subprocesses do not share any buffer, and freed on thread exit */
+typedef struct cpu_priority_arrays_t {
+    array_cpuid_t owned_idle;
+    array_cpuid_t owned_non_idle;
+    array_cpuid_t non_owned;
+} cpu_priority_arrays_t;
+
+static __thread cpu_priority_arrays_t *cpu_priority_arrays = NULL;
+static pthread_key_t cpu_priority_arrays_key;
+static pthread_once_t cpu_priority_arrays_once = PTHREAD_ONCE_INIT;
+
+static void cpu_priority_arrays_destroy(void *ptr) {
+    cpu_priority_arrays_t *arrays = ptr;
+    array_cpuid_t_destroy(&arrays->owned_idle);
+    array_cpuid_t_destroy(&arrays->owned_non_idle);
+    array_cpuid_t_destroy(&arrays->non_owned);
+    free(arrays);
+}
+
+static void cpu_priority_arrays_key_create(void) {
+    pthread_key_create(&cpu_priority_arrays_key, cpu_priority_arrays_destroy);
+}
+
+/* Return the cleared arrays of this thread, (re)allocated if node_size grew */
+static cpu_priority_arrays_t* get_cpu_priority_arrays(void) {
+    cpu_priority_arrays_t *arrays = cpu_priority_arrays;
+    if (unlikely(arrays == NULL || arrays->owned_idle.capacity < (size_t)node_size)) {
+        if (arrays == NULL) {
+            pthread_once(&cpu_priority_arrays_once, cpu_priority_arrays_key_create);
+            arrays = malloc(sizeof(cpu_priority_arrays_t));
+            fatal_cond(!arrays, "Could not allocate CPU priority arrays");
+            cpu_priority_arrays = arrays;
+            pthread_setspecific(cpu_priority_arrays_key, arrays);
+        } else {
+            array_cpuid_t_destroy(&arrays->owned_idle);
+            array_cpuid_t_destroy(&arrays->owned_non_idle);
+            array_cpuid_t_destroy(&arrays->non_owned);
+        }
+        array_cpuid_t_init(&arrays->owned_idle, node_size);
+        array_cpuid_t_init(&arrays->owned_non_idle, node_size);
+        array_cpuid_t_init(&arrays->non_owned, node_size);
+    } else {
+        array_cpuid_t_clear(&arrays->owned_idle);
+        array_cpuid_t_clear(&arrays->owned_non_idle);
+        array_cpuid_t_clear(&arrays->non_owned);
+    }
+    return arrays;
+}
+
+static int acquire_ncpus_from_cpu_subset(
+        pid_t pid, int *restrict ticket_slot, int *restrict requested_ncpus,
         const array_cpuid_t *restrict cpus_priority_array,
         lewi_affinity_t lewi_affinity, int max_parallelism,
         int64_t *restrict last_borrow, array_cpuinfo_task_t *restrict tasks) {
@@ -1269,56 +1434,46 @@ int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
         ncpus = min_int(ncpus, max_parallelism);
     }
 
-    /* Arrays for temporary CPU priority (lazy initialized and always used within the lock) */
-    static array_cpuid_t owned_idle = {};
-    static array_cpuid_t owned_non_idle = {};
-    static array_cpuid_t non_owned = {};
+    /* Arrays for temporary CPU priority */
+    cpu_priority_arrays_t *arrays = get_cpu_priority_arrays();
+    array_cpuid_t *owned_idle = &arrays->owned_idle;
+    array_cpuid_t *owned_non_idle = &arrays->owned_non_idle;
+    array_cpuid_t *non_owned = &arrays->non_owned;
 
     int error = DLB_NOUPDT;
     shmem_lock(shm_handler);
     {
-        /* Lazy init first time, clear afterwards */
-        if (likely(owned_idle.items != NULL)) {
-            array_cpuid_t_clear(&owned_idle);
-            array_cpuid_t_clear(&owned_non_idle);
-            array_cpuid_t_clear(&non_owned);
-        } else {
-            array_cpuid_t_init(&owned_idle, node_size);
-            array_cpuid_t_init(&owned_non_idle, node_size);
-            array_cpuid_t_init(&non_owned, node_size);
-        }
-
         /* Iterate cpus_priority_array and construct all sub-arrays */
         for (unsigned int i = 0; i < cpus_priority_array->count; ++i) {
             cpuid_t cpuid = cpus_priority_array->items[i];
             const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
             if (cpuinfo->owner == pid) {
                 if (cpuinfo->guest == NOBODY) {
-                    array_cpuid_t_push(&owned_idle, cpuid);
+                    array_cpuid_t_push(owned_idle, cpuid);
                 } else if (cpuinfo->guest != pid) {
-                    array_cpuid_t_push(&owned_non_idle, cpuid);
+                    array_cpuid_t_push(owned_non_idle, cpuid);
                 }
             } else if (cpuinfo->guest == NOBODY) {
-                array_cpuid_t_push(&non_owned, cpuid);
+                array_cpuid_t_push(non_owned, cpuid);
             }
         }
 
         /* Acquire first owned CPUs that are IDLE */
-        int local_error = acquire_cpus_in_array_cpuid_t(pid, &owned_idle, &ncpus, tasks);
+        int local_error = acquire_cpus_in_array_cpuid_t(pid, owned_idle, &ncpus, tasks);
         if (local_error == DLB_SUCCESS || local_error == DLB_NOTED) {
             /* Update error code if needed */
             if (error != DLB_NOTED) error = local_error;
         }
 
         /* Acquire the rest of owned CPUs */
-        local_error = acquire_cpus_in_array_cpuid_t(pid, &owned_non_idle, &ncpus, tasks);
+        local_error = acquire_cpus_in_array_cpuid_t(pid, owned_non_idle, &ncpus, tasks);
         if (local_error == DLB_SUCCESS || local_error == DLB_NOTED) {
             /* Update error code if needed */
             if (error != DLB_NOTED) error = local_error;
         }
 
         /* Borrow non-owned CPUs */
-        local_error = borrow_cpus_in_array_cpuid_t(pid, &non_owned, &ncpus, tasks);
+        local_error = borrow_cpus_in_array_cpuid_t(pid, non_owned, &ncpus, tasks);
         if (local_error == DLB_SUCCESS) {
             /* Update error code if needed */
             if (error != DLB_NOTED) error = local_error;
@@ -1332,6 +1487,7 @@ int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
             lewi_mask_request_t request = {
                 .pid = pid,
                 .howmany = ncpus,
+                .ticket_slot = NO_TICKET_SLOT,
             };
             CPU_ZERO(&request.allowed);
             for (unsigned int i=0; i<cpus_priority_array->count; ++i) {
@@ -1346,6 +1502,8 @@ int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
                     it != NULL;
                     it = queue_lewi_mask_request_t_next(&shdata->lewi_mask_requests, it)) {
                 if (it->pid == pid
+                        && ticket_slot == NULL
+                        && it->ticket_slot == NO_TICKET_SLOT
                         && CPU_EQUAL(&request.allowed, &it->allowed)) {
                     /* update entry */
                     it->howmany += request.howmany;
@@ -1353,7 +1511,22 @@ int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
                     break;
                 }
             }
-            if (it == NULL) {
+            if (it == NULL && ticket_slot != NULL) {
+                /* or add new entry with its own ticket slot */
+                request.ticket_slot = find_free_ticket_slot();
+                if (request.ticket_slot != NO_TICKET_SLOT
+                        && queue_lewi_mask_request_t_enqueue(
+                            &shdata->lewi_mask_requests, request) == 0) {
+                    ticket_request_t *ticket_request =
+                        &shdata->ticket_requests[request.ticket_slot];
+                    ticket_request->pid = pid;
+                    DLB_ATOMIC_ST_REL(&ticket_request->ncpus, (int)request.howmany);
+                    *ticket_slot = request.ticket_slot;
+                    error = DLB_NOTED;
+                } else {
+                    error = DLB_ERR_REQST;
+                }
+            } else if (it == NULL) {
                 /* or add new entry */
                 if (queue_lewi_mask_request_t_enqueue(
                             &shdata->lewi_mask_requests, request) == 0) {
@@ -1373,6 +1546,30 @@ int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
     return error;
 }
 
+int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
+        pid_t pid, int *restrict requested_ncpus,
+        const array_cpuid_t *restrict cpus_priority_array,
+        lewi_affinity_t lewi_affinity, int max_parallelism,
+        int64_t *restrict last_borrow, array_cpuinfo_task_t *restrict tasks) {
+
+    return acquire_ncpus_from_cpu_subset(pid, NULL, requested_ncpus,
+            cpus_priority_array, lewi_affinity, max_parallelism, last_borrow, tasks);
+}
+
+/* Same as above, but the remaining CPUs are enqueued in a separate request
+ * whose ticket slot is returned in ticket_slot, or NO_TICKET_SLOT if nothing
+ * was enqueued, so that its completion can be checked without locking */
+int shmem_cpuinfo__acquire_ncpus_with_ticket(
+        pid_t pid, int *restrict ticket_slot, int *restrict requested_ncpus,
+        const array_cpuid_t *restrict cpus_priority_array,
+        lewi_affinity_t lewi_affinity, int max_parallelism,
+        int64_t *restrict last_borrow, array_cpuinfo_task_t *restrict tasks) {
+
+    *ticket_slot = NO_TICKET_SLOT;
+    return acquire_ncpus_from_cpu_subset(pid, ticket_slot, requested_ncpus,
+            cpus_priority_array, lewi_affinity, max_parallelism, last_borrow, tasks);
+}
+
 
 /*********************************************************************************/
 /*  Borrow CPU                                                                   */
@@ -1417,6 +1614,11 @@ static int borrow_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks
         }
     }
 
+    if (error == DLB_SUCCESS) {
+        ++shdata->num_cpus_borrowed;
+        update_bindings_version();
+    }
+
     return error;
 }
 
@@ -1664,6 +1866,7 @@ static int return_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks
 
     // Possibly clear CPU from occupies cores set
     update_occupied_cores(cpuinfo->owner, cpuinfo->id);
+    update_bindings_version();
 
     // current subprocess to disable cpu
     array_cpuinfo_task_t_push(
@@ -1758,6 +1961,7 @@ static inline void shmem_cpuinfo__return_async(pid_t pid, cpuid_t cpuid) {
 
     // Possibly clear CPU from occupies cores set
     update_occupied_cores(cpuinfo->owner, cpuinfo->id);
+    update_bindings_version();
 
     /* Add another CPU request */
     queue_pid_t_enqueue(&cpuinfo->requests, pid);
@@ -1805,7 +2009,7 @@ int shmem_cpuinfo__deregister(pid_t pid, array_cpuinfo_task_t *restrict tasks) {
     {
         // Remove any request before acquiring and lending
         if (shdata->flags.queues_enabled) {
-            queue_lewi_mask_request_t_remove(&shdata->lewi_mask_requests, pid);
+            remove_global_requests(pid, false);
             for (int cpuid=0; cpuid<node_size; ++cpuid) {
                 cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
                 if (cpuinfo->owner != pid) {
@@ -1841,6 +2045,7 @@ int shmem_cpuinfo__deregister(pid_t pid, array_cpuinfo_task_t *restrict tasks) {
                 }
             }
         }
+        update_bindings_version();
     }
     shmem_unlock(shm_handler);
 
@@ -1857,7 +2062,7 @@ int shmem_cpuinfo__reset(pid_t pid, array_cpuinfo_task_t *restrict tasks) {
     {
         // Remove any request before acquiring and lending
         if (shdata->flags.queues_enabled) {
-            queue_lewi_mask_request_t_remove(&shdata->lewi_mask_requests, pid);
+            remove_global_requests(pid, false);
             for (int cpuid=0; cpuid<node_size; ++cpuid) {
                 cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
                 if (cpuinfo->owner != pid) {
@@ -1890,6 +2095,23 @@ int shmem_cpuinfo__reset(pid_t pid, array_cpuinfo_task_t *restrict tasks) {
     return error;
 }
 
+/* Annotate the max parallelism of pid (0 if unlimited) in its owned CPUs, so
+ * that other processes respect it when handing off CPUs to it */
+void shmem_cpuinfo__set_max_parallelism(pid_t pid, unsigned int max) {
+    if (shm_handler == NULL) return;
+
+    shmem_lock(shm_handler);
+    {
+        for (cpuid_t cpuid=0; cpuid<node_size; ++cpuid) {
+            cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+            if (cpuinfo->owner == pid) {
+                cpuinfo->owner_max_parallelism = max;
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+}
+
 /* Lend as many CPUs as needed to only guest as much as 'max' CPUs */
 int shmem_cpuinfo__update_max_parallelism(pid_t pid, unsigned int max,
         array_cpuinfo_task_t *restrict tasks) {
@@ -1961,6 +2183,7 @@ void shmem_cpuinfo__update_ownership(pid_t pid, const cpu_set_t *restrict proces
                 // Not owned: Steal CPU
                 cpuinfo->owner = pid;
                 cpuinfo->state = CPU_BUSY;
+                cpuinfo->owner_max_parallelism = 0;
                 if (cpuinfo->guest == NOBODY) {
                     cpuinfo->guest = pid;
                     CPU_CLR(cpuid, &shdata->free_cpus);
@@ -2026,38 +2249,171 @@ void shmem_cpuinfo__update_ownership(pid_t pid, const cpu_set_t *restrict proces
             }
         }
     }
+    update_bindings_version();
 
     shmem_unlock(shm_handler);
 }
 
-int shmem_cpuinfo__get_thread_binding(pid_t pid, int thread_num) {
-    if (unlikely(shm_handler == NULL || thread_num < 0)) return -1;
+int shmem_cpuinfo__get_cpu_states(dlb_cpu_state_t *states, int *nelems, int max_len) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
 
-    SMALL_ARRAY(cpuid_t, guested_cpus, node_size);
-    int owned_count = 0;
-    int guested_count = 0;
+    *nelems = 0;
+    shmem_lock(shm_handler);
+    {
+        for (int cpuid = 0; cpuid < node_size && cpuid < max_len; ++cpuid) {
+            const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+            states[(*nelems)++] =
+                cpuinfo->state == CPU_DISABLED              ? DLB_CPU_STATE_DISABLED :
+                cpuinfo->state == CPU_BUSY
+                    && cpuinfo->guest == cpuinfo->owner     ? DLB_CPU_STATE_BUSY :
+                cpuinfo->state == CPU_BUSY                  ? DLB_CPU_STATE_RECLAIMED :
+                cpuinfo->guest == NOBODY                    ? DLB_CPU_STATE_IDLE :
+                                                              DLB_CPU_STATE_LENT;
+        }
+    }
+    shmem_unlock(shm_handler);
 
-    int cpuid;
-    for (cpuid=0; cpuid<node_size; ++cpuid) {
+    return DLB_SUCCESS;
+}
+
+/* The counters are read from a snapshot without locking the shmem. If the
+ * shmem is not opened, it is attached only for reading. */
+int shmem_cpuinfo__get_lewi_counters(const char *shmem_key, int shmem_color,
+        int64_t *num_lends, int64_t *num_borrows) {
+
+    shmem_handler_t *handler = shm_handler;
+    shdata_t *shared_data = shdata;
+    bool temporary_shmem = handler == NULL;
+    if (temporary_shmem) {
+        handler = shmem_init_readonly((void**)&shared_data,
+                &(const shmem_props_t) {
+                    .size = shmem_cpuinfo__size(),
+                    .name = shmem_name,
+                    .key = shmem_key,
+                    .color = shmem_color,
+                    .version = SHMEM_CPUINFO_VERSION,
+                });
+        if (handler == NULL) return DLB_ERR_NOSHMEM;
+    }
+
+    /* The CPU table is not needed, only the common data */
+    shdata_t *shdata_copy = malloc(sizeof(shdata_t));
+    shmem_snapshot(handler, shdata_copy, shared_data, sizeof(shdata_t));
+
+    if (temporary_shmem) {
+        shmem_finalize_readonly(handler);
+    }
+
+    *num_lends = shdata_copy->num_cpus_lent;
+    *num_borrows = shdata_copy->num_cpus_borrowed;
+    free(shdata_copy);
+
+    return DLB_SUCCESS;
+}
+
+/* Per-thread cache of the CPU lists of one process, used by the OpenMP thread
+ * managers on every parallel region to find the CPU of each thread. The lists
+ * are only rebuilt if the shmem has been modified since the last query. */
+typedef struct binding_cache_t {
+    unsigned int    shmem_attachment;
+    uint64_t        bindings_version;
+    pid_t           pid;
+    int             capacity;
+    int             num_bindings;
+    int             num_non_owned_cpus;
+    int             first_non_owned_idx;
+    cpuid_t         *bindings;          /* owned and busy CPUs, then guested CPUs */
+    cpuid_t         *non_owned_cpus;    /* non-disabled CPUs not owned by pid */
+} binding_cache_t;
+
+static __thread binding_cache_t *binding_cache = NULL;
+static pthread_key_t binding_cache_key;
+static pthread_once_t binding_cache_once = PTHREAD_ONCE_INIT;
+
+static void binding_cache_destroy(void *cache) {
+    free(cache);
+}
+
+static void binding_cache_key_create(void) {
+    pthread_key_create(&binding_cache_key, binding_cache_destroy);
+}
+
+static void binding_cache_rebuild(binding_cache_t *cache, pid_t pid) {
+    cache->num_bindings = 0;
+    cache->num_non_owned_cpus = 0;
+    cache->first_non_owned_idx = 0;
+
+    /* Owned and busy CPUs first, then guested CPUs, both sorted by id */
+    bool first_owned = true;
+    for (int cpuid = 0; cpuid < node_size; ++cpuid) {
         const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
-        if (cpuinfo->owner == pid
-                && cpuinfo->state == CPU_BUSY) {
-            ++owned_count;
-            if (thread_num < owned_count) {
-                return cpuid;
+        if (cpuinfo->owner == pid) {
+            if (cpuinfo->state == CPU_BUSY) {
+                cache->bindings[cache->num_bindings++] = cpuid;
             }
-        } else if (cpuinfo->guest == pid) {
-            guested_cpus[guested_count++] = cpuid;
+            if (first_owned) {
+                cache->first_non_owned_idx = cache->num_non_owned_cpus;
+                first_owned = false;
+            }
+        } else if (cpuinfo->state != CPU_DISABLED) {
+            cache->non_owned_cpus[cache->num_non_owned_cpus++] = cpuid;
         }
     }
+    for (int cpuid = 0; cpuid < node_size; ++cpuid) {
+        const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+        if (cpuinfo->guest == pid && cpuinfo->owner != pid) {
+            cache->bindings[cache->num_bindings++] = cpuid;
+        }
+    }
+}
 
-    int binding;
-    if (thread_num - owned_count < guested_count) {
-        binding = guested_cpus[thread_num-owned_count];
-    } else {
-        binding = -1;
+/* Return the binding cache of this thread for pid, rebuilt if needed.
+ * As before, the shmem is read without locking, a concurrent modification
+ * will increase the version again and the next query will rebuild it. */
+static const binding_cache_t* get_binding_cache(pid_t pid) {
+    uint64_t bindings_version = DLB_ATOMIC_LD_ACQ(&shdata->bindings_version);
+    binding_cache_t *cache = binding_cache;
+
+    if (likely(cache != NULL
+                && cache->shmem_attachment == shmem_attachment
+                && cache->bindings_version == bindings_version
+                && cache->pid == pid)) {
+        return cache;
+    }
+
+    /* (Re)allocate, node_size may change between shmem attachments */
+    if (cache == NULL || cache->capacity < node_size) {
+        pthread_once(&binding_cache_once, binding_cache_key_create);
+        free(cache);
+        cache = malloc(sizeof(binding_cache_t) + sizeof(cpuid_t) * node_size * 2);
+        fatal_cond(!cache, "Could not allocate binding cache");
+        cache->capacity = node_size;
+        cache->bindings = (cpuid_t*)(cache + 1);
+        cache->non_owned_cpus = cache->bindings + node_size;
+        binding_cache = cache;
+        pthread_setspecific(binding_cache_key, cache);
     }
-    return binding;
+
+    binding_cache_rebuild(cache, pid);
+    cache->shmem_attachment = shmem_attachment;
+    cache->bindings_version = bindings_version;
+    cache->pid = pid;
+
+    return cache;
+}
+
+int shmem_cpuinfo__get_thread_binding(pid_t pid, int thread_num) {
+    if (unlikely(shm_handler == NULL || thread_num < 0)) return -1;
+
+    const binding_cache_t *cache = get_binding_cache(pid);
+    return thread_num < cache->num_bindings ? cache->bindings[thread_num] : -1;
+}
+
+/* Return the number of CPUs where the given PID can run, owned or guested */
+int shmem_cpuinfo__get_number_of_bindings(pid_t pid) {
+    if (unlikely(shm_handler == NULL)) return 0;
+
+    return get_binding_cache(pid)->num_bindings;
 }
 
 /* Find the nth non owned CPU for a given PID.
@@ -2068,28 +2424,12 @@ int shmem_cpuinfo__get_thread_binding(pid_t pid, int thread_num) {
  *         id > 3 -> -1
  */
 int shmem_cpuinfo__get_nth_non_owned_cpu(pid_t pid, int nth_cpu) {
-    int idx = 0;
-    int owned_cpus = 0;
-    int non_owned_cpus = 0;
-    SMALL_ARRAY(cpuid_t, non_owned_cpu_list, node_size);
-
-    /* Construct non owned CPU list */
-    int cpuid;
-    for (cpuid=0; cpuid<node_size; ++cpuid) {
-        const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
-        if (cpuinfo->owner == pid) {
-            if (owned_cpus++ == 0) {
-                idx = non_owned_cpus;
-            }
-        } else if (cpuinfo->state != CPU_DISABLED) {
-            non_owned_cpu_list[non_owned_cpus++] = cpuid;
-        }
-    }
+    const binding_cache_t *cache = get_binding_cache(pid);
 
     /* Find the nth element starting from the first owned CPU */
-    if (nth_cpu < non_owned_cpus) {
-        idx = (idx + nth_cpu) % non_owned_cpus;
-        return non_owned_cpu_list[idx];
+    if (nth_cpu < cache->num_non_owned_cpus) {
+        int idx = (cache->first_non_owned_idx + nth_cpu) % cache->num_non_owned_cpus;
+        return cache->non_owned_cpus[idx];
     } else {
         return -1;
     }
@@ -2097,16 +2437,7 @@ int shmem_cpuinfo__get_nth_non_owned_cpu(pid_t pid, int nth_cpu) {
 
 /* Return the number of registered CPUs not owned by the given PID */
 int shmem_cpuinfo__get_number_of_non_owned_cpus(pid_t pid) {
-    int num_non_owned_cpus = 0;
-    int cpuid;
-    for (cpuid=0; cpuid<node_size; ++cpuid) {
-        const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
-        if (cpuinfo->owner != pid
-                && cpuinfo->state != CPU_DISABLED) {
-            ++num_non_owned_cpus;
-        }
-    }
-    return num_non_owned_cpus;
+    return get_binding_cache(pid)->num_non_owned_cpus;
 }
 
 int shmem_cpuinfo__check_cpu_availability(pid_t pid, int cpuid) {
@@ -2127,6 +2458,7 @@ int shmem_cpuinfo__check_cpu_availability(pid_t pid, int cpuid) {
             if (cpuinfo->guest == NOBODY) {
                 cpuinfo->guest = pid;
                 CPU_CLR(cpuid, &shdata->free_cpus);
+                update_bindings_version();
                 error = DLB_SUCCESS;
             }
         }
@@ -2158,7 +2490,7 @@ void shmem_cpuinfo__remove_requests(pid_t pid) {
         /* Remove any previous request for the specific pid */
         if (shdata->flags.queues_enabled) {
             /* Remove global requests (pair <pid,howmany>) */
-            queue_lewi_mask_request_t_remove(&shdata->lewi_mask_requests, pid);
+            remove_global_requests(pid, false);
 
             /* Remove specific CPU requests */
             int cpuid;
@@ -2171,6 +2503,74 @@ void shmem_cpuinfo__remove_requests(pid_t pid) {
     shmem_unlock(shm_handler);
 }
 
+/* Get the CPUs of mask that pid has reclaimed but are still guested by
+ * another process. As with the thread bindings, the shmem is read without
+ * locking, the caller only polls until they are returned */
+void shmem_cpuinfo__get_reclaimed_cpus(pid_t pid, cpu_set_t *mask) {
+    if (shm_handler == NULL) {
+        CPU_ZERO(mask);
+        return;
+    }
+
+    for (int cpuid = mu_get_first_cpu(mask);
+            cpuid >= 0 && cpuid < node_size;
+            cpuid = mu_get_next_cpu(mask, cpuid)) {
+        const cpuinfo_t *cpuinfo = &shdata->node_info[cpuid];
+        if (!(cpuinfo->owner == pid
+                    && cpuinfo->state == CPU_BUSY
+                    && cpuinfo->guest != pid
+                    && cpuinfo->guest != NOBODY)) {
+            CPU_CLR(cpuid, mask);
+        }
+    }
+}
+
+/* Return the number of CPUs still enqueued in the request of the ticket slot,
+ * 0 if it has been served or removed. The shmem lock is not needed */
+int shmem_cpuinfo__get_ticket_ncpus(int ticket_slot) {
+    if (shm_handler == NULL
+            || ticket_slot < 0 || ticket_slot >= MAX_TICKET_REQUESTS) return 0;
+
+    int ncpus = DLB_ATOMIC_LD_ACQ(&shdata->ticket_requests[ticket_slot].ncpus);
+    return ncpus > 0 ? ncpus : 0;
+}
+
+/* Remove the request of pid of the ticket slot, if still enqueued.
+ * Return the number of CPUs removed */
+int shmem_cpuinfo__remove_ticket_request(pid_t pid, int ticket_slot) {
+    if (shm_handler == NULL
+            || ticket_slot < 0 || ticket_slot >= MAX_TICKET_REQUESTS) return 0;
+
+    int removed = 0;
+    shmem_lock(shm_handler);
+    {
+        if (shdata->flags.queues_enabled) {
+            for (lewi_mask_request_t *it =
+                    queue_lewi_mask_request_t_front(&shdata->lewi_mask_requests);
+                    it != NULL;
+                    it = queue_lewi_mask_request_t_next(&shdata->lewi_mask_requests, it)) {
+                if (it->pid == pid && it->ticket_slot == ticket_slot) {
+                    removed = it->howmany;
+                    queue_lewi_mask_request_t_delete(&shdata->lewi_mask_requests, it);
+                    DLB_ATOMIC_ST_REL(&shdata->ticket_requests[ticket_slot].ncpus, 0);
+                    break;
+                }
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+    return removed;
+}
+
+/* Release a ticket slot whose request is no longer enqueued. The shmem lock
+ * is not needed since nobody else modifies it meanwhile */
+void shmem_cpuinfo__release_ticket_slot(int ticket_slot) {
+    if (shm_handler == NULL
+            || ticket_slot < 0 || ticket_slot >= MAX_TICKET_REQUESTS) return;
+
+    DLB_ATOMIC_ST_REL(&shdata->ticket_requests[ticket_slot].ncpus, TICKET_SLOT_FREE);
+}
+
 int shmem_cpuinfo__version(void) {
     return SHMEM_CPUINFO_VERSION;
 }
@@ -2182,29 +2582,36 @@ size_t shmem_cpuinfo__size(void) {
 void shmem_cpuinfo__print_info(const char *shmem_key, int shmem_color, int columns,
         dlb_printshmem_flags_t print_flags) {
 
-    /* If the shmem is not opened, obtain a temporary fd */
-    bool temporary_shmem = shm_handler == NULL;
+    /* If the shmem is not opened, attach to it only for reading */
+    shmem_handler_t *handler = shm_handler;
+    shdata_t *shared_data = shdata;
+    bool temporary_shmem = handler == NULL;
+    int num_cpus = temporary_shmem ? mu_get_system_size() : node_size;
     if (temporary_shmem) {
-        shmem_cpuinfo_ext__init(shmem_key, shmem_color);
+        handler = shmem_init_readonly((void**)&shared_data,
+                &(const shmem_props_t) {
+                    .size = shmem_cpuinfo__size(),
+                    .name = shmem_name,
+                    .key = shmem_key,
+                    .color = shmem_color,
+                    .version = SHMEM_CPUINFO_VERSION,
+                });
+        if (handler == NULL) return;
     }
 
-    /* Make a full copy of the shared memory */
-    shdata_t *shdata_copy = malloc(sizeof(shdata_t) + sizeof(cpuinfo_t)*node_size);
-    shmem_lock(shm_handler);
-    {
-        memcpy(shdata_copy, shdata, sizeof(shdata_t) + sizeof(cpuinfo_t)*node_size);
-    }
-    shmem_unlock(shm_handler);
+    /* Make a full copy of the shared memory without locking it */
+    shdata_t *shdata_copy = malloc(shmem_cpuinfo__size());
+    shmem_snapshot(handler, shdata_copy, shared_data, shmem_cpuinfo__size());
 
     /* Close shmem if needed */
     if (temporary_shmem) {
-        shmem_cpuinfo_ext__finalize();
+        shmem_finalize_readonly(handler);
     }
 
     /* Find the largest pid registered in the shared memory */
     pid_t max_pid = 0;
     int cpuid;
-    for (cpuid=0; cpuid<node_size; ++cpuid) {
+    for (cpuid=0; cpuid<num_cpus; ++cpuid) {
         pid_t pid = shdata_copy->node_info[cpuid].owner;
         max_pid = pid > max_pid ? pid : max_pid;
     }
@@ -2248,7 +2655,7 @@ void shmem_cpuinfo__print_info(const char *shmem_key, int shmem_color, int colum
     char *l;
 
     /* Calculate number of rows and cpus per column (same) */
-    int rows = (node_size+columns-1) / columns;
+    int rows = (num_cpus+columns-1) / columns;
     int cpus_per_column = rows;
 
     /* Update flag here in case this is an external process */
@@ -2266,7 +2673,7 @@ void shmem_cpuinfo__print_info(const char *shmem_key, int shmem_color, int colum
         int column;
         for (column=0; column<columns; ++column) {
             cpuid = row + column*cpus_per_column;
-            if (cpuid < node_size) {
+            if (cpuid < num_cpus) {
                 const cpuinfo_t *cpuinfo = &shdata_copy->node_info[cpuid];
                 pid_t owner = cpuinfo->owner;
                 pid_t guest = cpuinfo->guest;
@@ -2321,13 +2728,13 @@ void shmem_cpuinfo__print_info(const char *shmem_key, int shmem_color, int colum
 
     /* Cpu requests */
     bool any_cpu_request = false;
-    for (cpuid=0; cpuid<node_size && !any_cpu_request; ++cpuid) {
+    for (cpuid=0; cpuid<num_cpus && !any_cpu_request; ++cpuid) {
         any_cpu_request = queue_pid_t_size(&shdata_copy->node_info[cpuid].requests) > 0;
     }
     if (any_cpu_request) {
         snprintf(line, MAX_LINE_LEN, "\n  Cpu requests (<cpuid>: <spids>):");
         printbuffer_append(&buffer, line);
-        for (cpuid=0; cpuid<node_size; ++cpuid) {
+        for (cpuid=0; cpuid<num_cpus; ++cpuid) {
             queue_pid_t *requests = &shdata_copy->node_info[cpuid].requests;
             if (queue_pid_t_size(requests) > 0) {
                 /* Set up line */
@@ -2363,6 +2770,35 @@ void shmem_cpuinfo__print_info(const char *shmem_key, int shmem_color, int colum
         printbuffer_append(&buffer, line);
     }
 
+    /* Per-process summary */
+    snprintf(line, MAX_LINE_LEN,
+            "\n  Process summary (<pid>: <owned>, <in use>, <lent>, <borrowed>):");
+    printbuffer_append(&buffer, line);
+    for (cpuid=0; cpuid<num_cpus; ++cpuid) {
+        pid_t pid = shdata_copy->node_info[cpuid].owner;
+        bool first_occurrence = pid != NOBODY;
+        for (int prev_cpuid=0; prev_cpuid<cpuid && first_occurrence; ++prev_cpuid) {
+            first_occurrence = shdata_copy->node_info[prev_cpuid].owner != pid;
+        }
+        if (!first_occurrence) continue;
+
+        int owned = 0, in_use = 0, lent = 0, borrowed = 0;
+        for (int i=0; i<num_cpus; ++i) {
+            const cpuinfo_t *cpuinfo = &shdata_copy->node_info[i];
+            if (cpuinfo->owner == pid) {
+                ++owned;
+                if (cpuinfo->guest == pid) ++in_use;
+                else if (cpuinfo->state == CPU_LENT) ++lent;
+            } else if (cpuinfo->guest == pid) {
+                ++in_use;
+                ++borrowed;
+            }
+        }
+        snprintf(line, MAX_LINE_LEN, "    %*d: %d, %d, %d, %d",
+                max_digits, pid, owned, in_use, lent, borrowed);
+        printbuffer_append(&buffer, line);
+    }
+
     info0("=== CPU States ===\n%s", buffer.addr);
     printbuffer_destroy(&buffer);
     free(shdata_copy);
@@ -2378,6 +2814,10 @@ int shmem_cpuinfo_testing__get_num_cpu_requests(int cpuid) {
         queue_pid_t_size(&shdata->node_info[cpuid].requests) : 0;
 }
 
+uint64_t shmem_cpuinfo_testing__get_bindings_version(void) {
+    return DLB_ATOMIC_LD_ACQ(&shdata->bindings_version);
+}
+
 const cpu_set_t* shmem_cpuinfo_testing__get_free_cpu_set(void) {
     return &shdata->free_cpus;
 }
@@ -2387,6 +2827,29 @@ const cpu_set_t* shmem_cpuinfo_testing__get_occupied_core_set(void) {
 }
 
 /*** Helper functions, the shm lock must have been acquired beforehand ***/
+static int find_free_ticket_slot(void) {
+    for (int i = 0; i < MAX_TICKET_REQUESTS; ++i) {
+        if (DLB_ATOMIC_LD_ACQ(&shdata->ticket_requests[i].ncpus) == TICKET_SLOT_FREE) {
+            return i;
+        }
+    }
+    return NO_TICKET_SLOT;
+}
+
+/* Remove the global requests of pid, their tickets are seen as completed.
+ * If the process is leaving, also release its ticket slots */
+static void remove_global_requests(pid_t pid, bool release_tickets) {
+    queue_lewi_mask_request_t_remove(&shdata->lewi_mask_requests, pid);
+    for (int i = 0; i < MAX_TICKET_REQUESTS; ++i) {
+        ticket_request_t *ticket_request = &shdata->ticket_requests[i];
+        int ncpus = DLB_ATOMIC_LD_ACQ(&ticket_request->ncpus);
+        if (ticket_request->pid == pid && ncpus != TICKET_SLOT_FREE) {
+            DLB_ATOMIC_ST_REL(&ticket_request->ncpus,
+                    release_tickets ? TICKET_SLOT_FREE : 0);
+        }
+    }
+}
+
 static inline bool is_idle(int cpu) {
     return shdata->node_info[cpu].state == CPU_LENT && shdata->node_info[cpu].guest == NOBODY;
 }
@@ -56,6 +56,9 @@ int shmem_cpuinfo_ext__postfinalize(pid_t pid);
 int shmem_cpuinfo__lend_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks);
 int shmem_cpuinfo__lend_cpu_mask(pid_t pid, const cpu_set_t *restrict mask,
         array_cpuinfo_task_t *restrict tasks);
+int shmem_cpuinfo__lend_cpu_mask_to(pid_t pid, const cpu_set_t *restrict mask,
+        const pid_t *restrict recipients, unsigned int nrecipients,
+        array_cpuinfo_task_t *restrict tasks);
 
 /* Reclaim */
 int shmem_cpuinfo__reclaim_all(pid_t pid, array_cpuinfo_task_t *restrict tasks);
@@ -75,6 +78,11 @@ int shmem_cpuinfo__acquire_ncpus_from_cpu_subset(
         const array_cpuid_t *restrict cpus_priority_array,
         lewi_affinity_t lewi_affinity, int max_parallelism,
         int64_t *restrict last_borrow, array_cpuinfo_task_t *restrict tasks);
+int shmem_cpuinfo__acquire_ncpus_with_ticket(
+        pid_t pid, int *restrict ticket_slot, int *restrict requested_ncpus,
+        const array_cpuid_t *restrict cpus_priority_array,
+        lewi_affinity_t lewi_affinity, int max_parallelism,
+        int64_t *restrict last_borrow, array_cpuinfo_task_t *restrict tasks);
 
 /* Borrow */
 int shmem_cpuinfo__borrow_cpu(pid_t pid, int cpuid, array_cpuinfo_task_t *restrict tasks);
@@ -99,17 +107,26 @@ void shmem_cpuinfo__return_async_cpu_mask(pid_t pid, const cpu_set_t *mask);
 /* Others */
 int shmem_cpuinfo__deregister(pid_t pid, array_cpuinfo_task_t *restrict tasks);
 int shmem_cpuinfo__reset(pid_t pid, array_cpuinfo_task_t *restrict tasks);
+void shmem_cpuinfo__set_max_parallelism(pid_t pid, unsigned int max);
 int shmem_cpuinfo__update_max_parallelism(pid_t pid, unsigned int max,
         array_cpuinfo_task_t *restrict tasks);
 void shmem_cpuinfo__update_ownership(pid_t pid, const cpu_set_t *restrict process_mask,
         array_cpuinfo_task_t *restrict tasks);
 int shmem_cpuinfo__get_thread_binding(pid_t pid, int thread_num);
+int shmem_cpuinfo__get_number_of_bindings(pid_t pid);
+int shmem_cpuinfo__get_cpu_states(dlb_cpu_state_t *states, int *nelems, int max_len);
+int shmem_cpuinfo__get_lewi_counters(const char *shmem_key, int shmem_color,
+        int64_t *num_lends, int64_t *num_borrows);
 int shmem_cpuinfo__get_nth_non_owned_cpu(pid_t pid, int nth_cpu);
 int shmem_cpuinfo__get_number_of_non_owned_cpus(pid_t pid);
 int shmem_cpuinfo__check_cpu_availability(pid_t pid, int cpu);
 bool shmem_cpuinfo__exists(void);
 void shmem_cpuinfo__enable_request_queues(void);
 void shmem_cpuinfo__remove_requests(pid_t pid);
+void shmem_cpuinfo__get_reclaimed_cpus(pid_t pid, cpu_set_t *mask);
+int shmem_cpuinfo__get_ticket_ncpus(int ticket_slot);
+int shmem_cpuinfo__remove_ticket_request(pid_t pid, int ticket_slot);
+void shmem_cpuinfo__release_ticket_slot(int ticket_slot);
 int shmem_cpuinfo__version(void);
 size_t shmem_cpuinfo__size(void);
 
@@ -118,6 +135,7 @@ void shmem_cpuinfo__print_info(const char *shmem_key, int shmem_color, int colum
 
 int shmem_cpuinfo_testing__get_num_proc_requests(void);
 int shmem_cpuinfo_testing__get_num_cpu_requests(int cpuid);
+uint64_t shmem_cpuinfo_testing__get_bindings_version(void);
 const cpu_set_t* shmem_cpuinfo_testing__get_free_cpu_set(void);
 const cpu_set_t* shmem_cpuinfo_testing__get_occupied_core_set(void);
 #endif /* SHMEM_CPUINFO_H */
@@ -27,6 +27,7 @@
 #include "LB_numThreads/numThreads.h"
 #include "apis/dlb_errors.h"
 #include "support/atomic.h"
+#include "support/cgroup.h"
 #include "support/debug.h"
 #include "support/types.h"
 #include "support/mytime.h"
@@ -49,6 +50,8 @@ typedef struct DLB_ALIGN_CACHE pinfo_t {
     pid_t pid;
     bool dirty;
     bool preregistered;
+    bool cgroup_cpuset;     // mask changes are enforced through its own cgroup
+    bool cgroup_pending;    // future mask pending to be written to its cgroup
     cpu_set_t current_process_mask;
     cpu_set_t future_process_mask;
     cpu_set_t stolen_cpus;
@@ -78,7 +81,7 @@ typedef struct {
     pinfo_t process_info[];
 } shdata_t;
 
-enum { SHMEM_PROCINFO_VERSION = 10 };
+enum { SHMEM_PROCINFO_VERSION = 11 };
 
 static shmem_handler_t *shm_handler = NULL;
 static shdata_t *shdata = NULL;
@@ -145,6 +148,79 @@ static pinfo_t* get_process(pid_t pid) {
     return NULL;
 }
 
+/* Number of processes flagged with cgroup_pending by this thread. The flags
+ * are set and cleared within the same critical section. */
+static __thread int num_cgroup_pending = 0;
+
+typedef struct cgroup_request_t {
+    pid_t pid;
+    cpu_set_t mask;
+} cgroup_request_t;
+
+/* If the process runs in its own cgroup created by dlb_run, its future mask
+ * is written to cpuset.cpus once the shmem lock is released, so that the
+ * change takes effect even if the process never polls. Processes that have
+ * not called DLB_Init, i.e., still preregistered, will never poll, so the new
+ * mask is applied right away. Returns whether the mask will be enforced. */
+static bool enforce_future_mask(pinfo_t *process) {
+    if (!process->cgroup_cpuset
+            || CPU_COUNT(&process->future_process_mask) == 0) {
+        return false;
+    }
+
+    if (!process->cgroup_pending) {
+        process->cgroup_pending = true;
+        ++num_cgroup_pending;
+    }
+
+    if (process->preregistered) {
+        memcpy(&process->current_process_mask, &process->future_process_mask,
+                sizeof(cpu_set_t));
+        process->dirty = false;
+    }
+
+    return true;
+}
+
+/* Collect the masks pending to be written to cgroups.
+ * The shmem lock must be held. */
+static cgroup_request_t* get_cgroup_requests(int *nrequests) {
+    *nrequests = 0;
+    if (num_cgroup_pending == 0) return NULL;
+
+    cgroup_request_t *requests = malloc(sizeof(cgroup_request_t) * num_cgroup_pending);
+    fatal_cond(requests == NULL, "Could not allocate cgroup requests");
+    int num_processes = shdata->num_processes;
+    for (int p = 0; p < num_processes && *nrequests < num_cgroup_pending; ++p) {
+        pinfo_t *process = &shdata->process_info[p];
+        if (process->cgroup_pending) {
+            requests[(*nrequests)++] = (const cgroup_request_t) {
+                .pid = process->pid,
+                .mask = process->future_process_mask,
+            };
+            process->cgroup_pending = false;
+        }
+    }
+    num_cgroup_pending = 0;
+
+    return requests;
+}
+
+/* Write the collected masks to their cgroups, without holding the shmem lock.
+ * Returns whether all of them have been written. */
+static bool apply_cgroup_requests(cgroup_request_t *requests, int nrequests) {
+    bool success = true;
+    for (int i = 0; i < nrequests; ++i) {
+        if (cgroup_cpuset_set_cpus(requests[i].pid, &requests[i].mask) != DLB_SUCCESS) {
+            warning("Could not enforce the mask of process %d through its cgroup",
+                    requests[i].pid);
+            success = false;
+        }
+    }
+    free(requests);
+    return success;
+}
+
 /*********************************************************************************/
 /*  Init / Register                                                              */
 /*********************************************************************************/
@@ -404,6 +480,8 @@ static int shmem_procinfo__init_(pid_t pid, pid_t preinit_pid, const cpu_set_t *
                             &preinit_process->current_process_mask, &inherited_cpus);
                     mu_substract(&preinit_process->future_process_mask,
                             &preinit_process->future_process_mask, &inherited_cpus);
+                    /* The cgroup is now shared, do not enforce it anymore */
+                    preinit_process->cgroup_cpuset = false;
                 }
             }
 
@@ -433,6 +511,8 @@ static int shmem_procinfo__init_(pid_t pid, pid_t preinit_pid, const cpu_set_t *
                                 &preinit_process->current_process_mask, process_mask);
                         mu_substract(&preinit_process->future_process_mask,
                                 &preinit_process->future_process_mask, process_mask);
+                        /* The cgroup is now shared, do not enforce it anymore */
+                        preinit_process->cgroup_cpuset = false;
                     } else {
                         error = DLB_ERR_PERM;
                     }
@@ -522,7 +602,10 @@ int shmem_procinfo_ext__preinit(pid_t pid, const cpu_set_t *mask, dlb_drom_flags
     bool steal = flags & DLB_STEAL_CPUS;
     bool sync = flags & DLB_SYNC_QUERY;
     bool return_stolen = flags & DLB_RETURN_STOLEN;
+    bool cgroup_cpuset = cgroup_cpuset_is_managed(pid);
     int error = DLB_SUCCESS;
+    int num_requests;
+    cgroup_request_t *requests;
     pinfo_t *process = NULL;
     shmem_lock(shm_handler);
     {
@@ -535,7 +618,8 @@ int shmem_procinfo_ext__preinit(pid_t pid, const cpu_set_t *mask, dlb_drom_flags
                 process = &shdata->process_info[p];
                 *process = (const pinfo_t){
                     .pid = pid,
-                    .preregistered = true};
+                    .preregistered = true,
+                    .cgroup_cpuset = cgroup_cpuset};
 
                 // Register process mask into the system
                 if (!steal) {
@@ -567,9 +651,13 @@ int shmem_procinfo_ext__preinit(pid_t pid, const cpu_set_t *mask, dlb_drom_flags
                 break;
             }
         }
+
+        requests = get_cgroup_requests(&num_requests);
     }
     shmem_unlock(shm_handler);
 
+    apply_cgroup_requests(requests, num_requests);
+
     if (error == DLB_ERR_INIT) {
         verbose(VB_SHMEM, "Process %d already registered", pid);
     } else if (error == DLB_ERR_PERM || error == DLB_ERR_NOCOMP) {
@@ -614,6 +702,7 @@ static int unregister_mask(pinfo_t *owner, const cpu_set_t *mask, bool return_st
                         CPU_CLR(c, &process->stolen_cpus);
                         process->dirty = true;
                         verbose(VB_DROM, "Giving back CPU %d to process %d", c, process->pid);
+                        enforce_future_mask(process);
                         break;
                     }
                 }
@@ -670,6 +759,8 @@ int shmem_procinfo__finalize(pid_t pid, bool return_stolen, const char *shmem_ke
         error = DLB_ERR_NOPROC;
     }
 
+    int num_requests;
+    cgroup_request_t *requests;
     shmem_lock(shm_handler);
     {
         if (process) {
@@ -686,9 +777,13 @@ int shmem_procinfo__finalize(pid_t pid, bool return_stolen, const char *shmem_ke
             // Clear local pointer
             my_pinfo = NULL;
         }
+
+        requests = get_cgroup_requests(&num_requests);
     }
     shmem_unlock(shm_handler);
 
+    apply_cgroup_requests(requests, num_requests);
+
     // Close shared memory only if pid was succesfully removed or if shmem was reopened
     if (process || shmem_reopened) {
         close_shmem();
@@ -713,6 +808,8 @@ int shmem_procinfo_ext__postfinalize(pid_t pid, bool return_stolen) {
     if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
 
     int error = DLB_SUCCESS;
+    int num_requests;
+    cgroup_request_t *requests;
     shmem_lock(shm_handler);
     {
         pinfo_t *process = get_process(pid);
@@ -730,8 +827,13 @@ int shmem_procinfo_ext__postfinalize(pid_t pid, bool return_stolen) {
             // Clear process fields
             *process = (const pinfo_t){0};
         }
+
+        requests = get_cgroup_requests(&num_requests);
     }
     shmem_unlock(shm_handler);
+
+    apply_cgroup_requests(requests, num_requests);
+
     return error;
 }
 
@@ -874,6 +976,8 @@ static int shmem_procinfo__setprocessmask_self(const cpu_set_t *mask, dlb_drom_f
     int error;
     bool return_stolen = flags & DLB_RETURN_STOLEN;
     bool skip_auto_update = flags & DLB_NO_SYNC;
+    int num_requests;
+    cgroup_request_t *requests;
     pinfo_t *process = my_pinfo;
     shmem_lock(shm_handler);
     {
@@ -889,9 +993,13 @@ static int shmem_procinfo__setprocessmask_self(const cpu_set_t *mask, dlb_drom_f
                     sizeof(cpu_set_t));
             process->dirty = false;
         }
+
+        requests = get_cgroup_requests(&num_requests);
     }
     shmem_unlock(shm_handler);
 
+    apply_cgroup_requests(requests, num_requests);
+
     if (error == DLB_ERR_PDIRTY) {
         verbose(VB_DROM, "Setting mask: current process is already dirty");
     } else if (error == DLB_ERR_PERM) {
@@ -924,6 +1032,9 @@ int shmem_procinfo__setprocessmask(pid_t pid, const cpu_set_t *mask, dlb_drom_fl
     bool sync = flags & DLB_SYNC_QUERY;
     bool return_stolen = flags & DLB_RETURN_STOLEN;
     int error = DLB_SUCCESS;
+    bool enforced = false;
+    int num_requests = 0;
+    cgroup_request_t *requests = NULL;
     pinfo_t *process;
     shmem_lock(shm_handler);
     {
@@ -940,9 +1051,19 @@ int shmem_procinfo__setprocessmask(pid_t pid, const cpu_set_t *mask, dlb_drom_fl
 
         // Set new mask if everything ok
         error = error ? error : set_new_mask(process, mask, sync, return_stolen, free_cpu_mask);
+
+        // The new mask will be effective once enforced through cgroups
+        enforced = !error && enforce_future_mask(process);
+
+        requests = get_cgroup_requests(&num_requests);
     }
     shmem_unlock(shm_handler);
 
+    // No need to poll if the new mask is enforced through cgroups
+    if (apply_cgroup_requests(requests, num_requests) && enforced) {
+        sync = false;
+    }
+
     // Polling until dirty is cleared
     if (!error && sync) {
         bool done = false;
@@ -1245,23 +1366,31 @@ int shmem_procinfo__setcpuusage(pid_t pid,int index, double new_avg_usage) {
 
 void shmem_procinfo__print_info(const char *shmem_key, int shmem_size_multiplier) {
 
-    /* If the shmem is not opened, obtain a temporary fd */
-    bool temporary_shmem = shm_handler == NULL;
+    /* If the shmem is not opened, attach to it only for reading */
+    shmem_handler_t *handler = shm_handler;
+    shdata_t *shared_data = shdata;
+    size_t size = shmem_procinfo__size();
+    bool temporary_shmem = handler == NULL;
     if (temporary_shmem) {
-        shmem_procinfo_ext__init(shmem_key, shmem_size_multiplier);
+        size = sizeof(shdata_t) + sizeof(pinfo_t)
+            * mu_get_system_size() * shmem_size_multiplier;
+        handler = shmem_init_readonly((void**)&shared_data,
+                &(const shmem_props_t) {
+                    .size = size,
+                    .name = shmem_name,
+                    .key = shmem_key,
+                    .version = SHMEM_PROCINFO_VERSION,
+                });
+        if (handler == NULL) return;
     }
 
-    /* Make a full copy of the shared memory */
-    shdata_t *shdata_copy = malloc(shmem_procinfo__size());
-    shmem_lock(shm_handler);
-    {
-        memcpy(shdata_copy, shdata, shmem_procinfo__size());
-    }
-    shmem_unlock(shm_handler);
+    /* Make a full copy of the shared memory without locking it */
+    shdata_t *shdata_copy = malloc(size);
+    shmem_snapshot(handler, shdata_copy, shared_data, size);
 
     /* Close shmem if needed */
     if (temporary_shmem) {
-        shmem_procinfo_ext__finalize();
+        shmem_finalize_readonly(handler);
     }
 
     /* Find the max number of characters per column */
@@ -1428,6 +1557,10 @@ static int steal_mask(pinfo_t* new_owner, const cpu_set_t *mask, bool sync, bool
     cpu_set_t cpus_left_to_steal;
     memcpy(&cpus_left_to_steal, mask, sizeof(cpu_set_t));
 
+    // CPUs already removed from their victims through cgroups
+    cpu_set_t enforced_cpus;
+    CPU_ZERO(&enforced_cpus);
+
     // Iterate per process, steal in batch
     int num_processes = shdata->num_processes;
     for (int p = 0; p < num_processes; ++p) {
@@ -1446,6 +1579,9 @@ static int steal_mask(pinfo_t* new_owner, const cpu_set_t *mask, bool sync, bool
                         CPU_OR(&victim->stolen_cpus, &victim->stolen_cpus, &target_cpus);
                         verbose(VB_DROM, "CPUs %s have been removed from process %d",
                                 mu_to_str(mask), victim->pid);
+                        if (enforce_future_mask(victim)) {
+                            CPU_OR(&enforced_cpus, &enforced_cpus, &target_cpus);
+                        }
                     }
                     mu_substract(&cpus_left_to_steal, &cpus_left_to_steal, &target_cpus);
                     if (CPU_COUNT(&cpus_left_to_steal) == 0)
@@ -1465,13 +1601,20 @@ static int steal_mask(pinfo_t* new_owner, const cpu_set_t *mask, bool sync, bool
     }
 
     if (!error && sync && !dry_run) {
-        // Relase lock and poll until victims update their masks or timeout
+        // Relase lock, write the victims' cgroups, and poll until victims
+        // update their masks or timeout
+        int num_requests;
+        cgroup_request_t *requests = get_cgroup_requests(&num_requests);
         shmem_unlock(shm_handler);
 
-        bool done = false;
+        if (!apply_cgroup_requests(requests, num_requests)) {
+            CPU_ZERO(&enforced_cpus);
+        }
+
+        bool done = mu_is_subset(mask, &enforced_cpus);
         struct timespec start, now;
         get_time_coarse(&start);
-        do {
+        while (!done && error == DLB_SUCCESS) {
             // Delay
             usleep(SYNC_POLL_DELAY);
 
@@ -1491,9 +1634,11 @@ static int steal_mask(pinfo_t* new_owner, const cpu_set_t *mask, bool sync, bool
                 }
 
                 // Polling is complete when no current_mask of any process
-                // contains any CPU from the mask we are stealing
+                // contains any CPU from the mask we are stealing, except
+                // those already enforced through cgroups
                 cpu_set_t common_cpus;
                 CPU_AND(&common_cpus, &all_current_masks, mask);
+                mu_substract(&common_cpus, &common_cpus, &enforced_cpus);
                 done = CPU_COUNT(&common_cpus) == 0;
             }
             shmem_unlock(shm_handler);
@@ -1505,7 +1650,7 @@ static int steal_mask(pinfo_t* new_owner, const cpu_set_t *mask, bool sync, bool
                     error = DLB_ERR_TIMEOUT;
                 }
             }
-        } while (!done && error == DLB_SUCCESS);
+        }
 
         shmem_lock(shm_handler);
     }
@@ -1533,6 +1678,7 @@ static int steal_mask(pinfo_t* new_owner, const cpu_set_t *mask, bool sync, bool
                     mu_substract(&victim->stolen_cpus, &victim->stolen_cpus, &cpus_to_return);
                     victim->dirty = !CPU_EQUAL(
                             &victim->current_process_mask, &victim->future_process_mask);
+                    enforce_future_mask(victim);
                 }
             }
         }
@@ -40,6 +40,10 @@ typedef struct DLB_ALIGN_CACHE talp_region_t {
     char name[DLB_MONITOR_NAME_MAX];
     atomic_int_least64_t mpi_time;
     atomic_int_least64_t useful_time;
+    atomic_int_least64_t omp_load_imbalance_time;
+    atomic_int_least64_t omp_scheduling_time;
+    atomic_int_least64_t omp_serialization_time;
+    atomic_int num_cpus;
     pid_t pid;
     float avg_cpus;
 } talp_region_t;
@@ -51,7 +55,7 @@ typedef struct {
     talp_region_t talp_region[];
 } shdata_t;
 
-enum { SHMEM_TALP_VERSION = 4 };
+enum { SHMEM_TALP_VERSION = 5 };
 
 static shmem_handler_t *shm_handler = NULL;
 static shdata_t *shdata = NULL;
@@ -316,6 +320,13 @@ int shmem_talp__get_region(talp_region_list_t *region, pid_t pid, const char *na
                     .region_id = region_id,
                     .mpi_time = DLB_ATOMIC_LD_RLX(&talp_region->mpi_time),
                     .useful_time = DLB_ATOMIC_LD_RLX(&talp_region->useful_time),
+                    .omp_load_imbalance_time =
+                        DLB_ATOMIC_LD_RLX(&talp_region->omp_load_imbalance_time),
+                    .omp_scheduling_time =
+                        DLB_ATOMIC_LD_RLX(&talp_region->omp_scheduling_time),
+                    .omp_serialization_time =
+                        DLB_ATOMIC_LD_RLX(&talp_region->omp_serialization_time),
+                    .num_cpus = DLB_ATOMIC_LD_RLX(&talp_region->num_cpus),
                     .avg_cpus = talp_region->avg_cpus,
                 };
                 error = DLB_SUCCESS;
@@ -346,6 +357,13 @@ int shmem_talp__get_regionlist(talp_region_list_t *region_list, int *nelems,
                     .region_id = region_id,
                     .mpi_time = DLB_ATOMIC_LD_RLX(&talp_region->mpi_time),
                     .useful_time = DLB_ATOMIC_LD_RLX(&talp_region->useful_time),
+                    .omp_load_imbalance_time =
+                        DLB_ATOMIC_LD_RLX(&talp_region->omp_load_imbalance_time),
+                    .omp_scheduling_time =
+                        DLB_ATOMIC_LD_RLX(&talp_region->omp_scheduling_time),
+                    .omp_serialization_time =
+                        DLB_ATOMIC_LD_RLX(&talp_region->omp_serialization_time),
+                    .num_cpus = DLB_ATOMIC_LD_RLX(&talp_region->num_cpus),
                     .avg_cpus = talp_region->avg_cpus,
                 };
             }
@@ -359,6 +377,34 @@ int shmem_talp__get_regionlist(talp_region_list_t *region_list, int *nelems,
     return DLB_SUCCESS;
 }
 
+/* Get the list of unique region names, in order of registration */
+int shmem_talp__get_region_names(char (*names)[DLB_MONITOR_NAME_MAX], int *nelems,
+        int max_len) {
+    if (shm_handler == NULL) return DLB_ERR_NOSHMEM;
+
+    *nelems = 0;
+    shmem_lock(shm_handler);
+    {
+        int num_regions = shdata->num_regions;
+        for (int region_id = 0; region_id < num_regions && *nelems < max_len; ++region_id) {
+            talp_region_t *talp_region = &shdata->talp_region[region_id];
+            if (talp_region->pid != NOBODY) {
+                bool found = false;
+                for (int i = 0; i < *nelems && !found; ++i) {
+                    found = strncmp(names[i], talp_region->name, DLB_MONITOR_NAME_MAX) == 0;
+                }
+                if (!found) {
+                    snprintf(names[(*nelems)++], DLB_MONITOR_NAME_MAX, "%s",
+                            talp_region->name);
+                }
+            }
+        }
+    }
+    shmem_unlock(shm_handler);
+
+    return DLB_SUCCESS;
+}
+
 int shmem_talp__get_times(int region_id, int64_t *mpi_time, int64_t *useful_time) {
     if (unlikely(shm_handler == NULL)) return DLB_ERR_NOSHMEM;
     if (unlikely(region_id >= max_regions)) return DLB_ERR_NOMEM;
@@ -394,6 +440,25 @@ int shmem_talp__set_times(int region_id, int64_t mpi_time, int64_t useful_time)
     return DLB_SUCCESS;
 }
 
+/* OpenMP times are only needed to compute the hybrid POP metrics of the node */
+int shmem_talp__set_omp_times(int region_id, int num_cpus, int64_t omp_load_imbalance_time,
+        int64_t omp_scheduling_time, int64_t omp_serialization_time) {
+    if (unlikely(shm_handler == NULL)) return DLB_ERR_NOSHMEM;
+    if (unlikely(region_id >= max_regions)) return DLB_ERR_NOMEM;
+    if (unlikely(region_id >= shdata->num_regions)) return DLB_ERR_NOENT;
+    if (unlikely(region_id < 0)) return DLB_ERR_NOENT;
+
+    talp_region_t *talp_region = &shdata->talp_region[region_id];
+    if (unlikely(talp_region->pid == NOBODY)) return DLB_ERR_NOENT;
+
+    DLB_ATOMIC_ST_RLX(&talp_region->num_cpus, num_cpus);
+    DLB_ATOMIC_ST_RLX(&talp_region->omp_load_imbalance_time, omp_load_imbalance_time);
+    DLB_ATOMIC_ST_RLX(&talp_region->omp_scheduling_time, omp_scheduling_time);
+    DLB_ATOMIC_ST_RLX(&talp_region->omp_serialization_time, omp_serialization_time);
+
+    return DLB_SUCCESS;
+}
+
 int shmem_talp__set_avg_cpus(int region_id, float avg_cpus) {
     if (unlikely(shm_handler == NULL)) return DLB_ERR_NOSHMEM;
     if (unlikely(region_id >= max_regions)) return DLB_ERR_NOMEM;
@@ -415,23 +480,31 @@ int shmem_talp__set_avg_cpus(int region_id, float avg_cpus) {
 
 void shmem_talp__print_info(const char *shmem_key, int shmem_size_multiplier) {
 
-    /* If the shmem is not opened, obtain a temporary fd */
-    bool temporary_shmem = shm_handler == NULL;
+    /* If the shmem is not opened, attach to it only for reading */
+    shmem_handler_t *handler = shm_handler;
+    shdata_t *shared_data = shdata;
+    size_t size = shmem_talp__size();
+    bool temporary_shmem = handler == NULL;
     if (temporary_shmem) {
-        shmem_talp_ext__init(shmem_key, shmem_size_multiplier);
+        size = sizeof(shdata_t) + sizeof(talp_region_t)
+            * mu_get_system_size() * shmem_size_multiplier;
+        handler = shmem_init_readonly((void**)&shared_data,
+                &(const shmem_props_t) {
+                    .size = size,
+                    .name = shmem_name,
+                    .key = shmem_key,
+                    .version = SHMEM_TALP_VERSION,
+                });
+        if (handler == NULL) return;
     }
 
-    /* Make a full copy of the shared memory */
-    shdata_t *shdata_copy = malloc(shmem_talp__size());
-    shmem_lock(shm_handler);
-    {
-        memcpy(shdata_copy, shdata, shmem_talp__size());
-    }
-    shmem_unlock(shm_handler);
+    /* Make a full copy of the shared memory without locking it */
+    shdata_t *shdata_copy = malloc(size);
+    shmem_snapshot(handler, shdata_copy, shared_data, size);
 
     /* Close shmem if needed */
     if (temporary_shmem) {
-        shmem_talp_ext__finalize();
+        shmem_finalize_readonly(handler);
     }
 
     /* Find the max number of characters per column */
@@ -471,13 +544,19 @@ void shmem_talp__print_info(const char *shmem_key, int shmem_size_multiplier) {
         talp_region_t *talp_region = &shdata_copy->talp_region[region_id];
         if (talp_region->pid != NOBODY) {
 
+            /* MPI efficiency: useful time over useful + MPI time */
+            int64_t elapsed = talp_region->useful_time + talp_region->mpi_time;
+            float mpi_efficiency = elapsed > 0
+                ? (float)talp_region->useful_time / elapsed : 0.0f;
+
             /* Append line to buffer */
             snprintf(line, MAX_LINE_LEN,
-                    "  | %*d | %*s | %*"PRId64" | %*"PRId64" |",
+                    "  | %*d | %*s | %*"PRId64" | %*"PRId64" | %8.2f |",
                     max_pid_digits, talp_region->pid,
                     max_name, talp_region->name,
                     max_mpi, talp_region->mpi_time,
-                    max_useful, talp_region->useful_time),
+                    max_useful, talp_region->useful_time,
+                    mpi_efficiency),
             printbuffer_append(&buffer, line);
         }
     }
@@ -486,11 +565,12 @@ void shmem_talp__print_info(const char *shmem_key, int shmem_size_multiplier) {
     if (buffer.addr[0] != '\0' ) {
         /* Construct header */
         snprintf(line, MAX_LINE_LEN,
-                "  | %*s | %*s | %*s | %*s |",
+                "  | %*s | %*s | %*s | %*s | %8s |",
                 max_pid_digits, "PID",
                 max_name, "Name",
                 max_mpi, "MPI time",
-                max_useful, "Useful time");
+                max_useful, "Useful time",
+                "MPI eff.");
 
         /* Print header + buffer */
         info0("=== TALP Regions ===\n"
@@ -20,6 +20,8 @@
 #ifndef SHMEM_TALP_H
 #define SHMEM_TALP_H
 
+#include "apis/dlb_talp.h"
+
 #include <sys/types.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -29,6 +31,10 @@ typedef struct talp_region_list_t {
     int region_id;
     int_least64_t mpi_time;
     int_least64_t useful_time;
+    int_least64_t omp_load_imbalance_time;
+    int_least64_t omp_scheduling_time;
+    int_least64_t omp_serialization_time;
+    int num_cpus;
     float avg_cpus;
 } talp_region_list_t;
 
@@ -48,10 +54,14 @@ int shmem_talp__get_pidlist(pid_t *pidlist, int *nelems, int max_len);
 int shmem_talp__get_region(talp_region_list_t *region, pid_t pid, const char *name);
 int shmem_talp__get_regionlist(talp_region_list_t *region_list, int *nelems,
         int max_len, const char *name);
+int shmem_talp__get_region_names(char (*names)[DLB_MONITOR_NAME_MAX], int *nelems,
+        int max_len);
 int shmem_talp__get_times(int region_id, int64_t *mpi_time, int64_t *useful_time);
 
 /* Setters */
 int shmem_talp__set_times(int region_id, int64_t mpi_time, int64_t useful_time);
+int shmem_talp__set_omp_times(int region_id, int num_cpus, int64_t omp_load_imbalance_time,
+        int64_t omp_scheduling_time, int64_t omp_serialization_time);
 int shmem_talp__set_avg_cpus(int region_id, float avg_cpus);
 
 /* Misc */
@@ -0,0 +1,288 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "LB_comm/shmem_topology.h"
+
+#include "LB_comm/shmem.h"
+#include "apis/dlb_errors.h"
+#include "support/atomic.h"
+#include "support/debug.h"
+#include "support/mask_utils.h"
+#include "support/mytime.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Node topology shared memory:
+ *
+ * The first process of the node that initializes DLB parses the topology
+ * (HWLOC or system files) and publishes it here. The rest of processes copy
+ * it instead of parsing it again, which is expensive in nodes with many
+ * processes starting at the same time.
+ *
+ * This shmem cannot use the common shmem_init because the size of the
+ * shmem_sync_t depends on the system size, which is what we want to obtain.
+ * The content is written once by the publisher and only read afterwards, so
+ * synchronization is a simple state flag with acquire/release semantics.
+ * Attached processes register their pid in a lock-free list, so that the
+ * entries of processes that did not finalize can be cleaned up like in the
+ * rest of shared memories.
+ */
+
+enum { TOPOLOGY_MAX_CORES = CPU_SETSIZE };
+enum { TOPOLOGY_MAX_NODES = CPU_SETSIZE };
+enum { TOPOLOGY_MAX_PIDS = CPU_SETSIZE };
+
+typedef enum TopologyState {
+    TOPOLOGY_EMPTY,
+    TOPOLOGY_PUBLISHING,
+    TOPOLOGY_READY,
+    TOPOLOGY_UNAVAILABLE,
+} topology_state_t;
+
+typedef struct {
+    atomic_int      state;          // topology_state_t
+    unsigned int    version;
+    atomic_int      publisher;
+    unsigned int    num_cores;
+    unsigned int    num_nodes;
+    cpu_set_t       sys_mask;
+    cpu_set_t       core_masks[TOPOLOGY_MAX_CORES];
+    cpu_set_t       node_masks[TOPOLOGY_MAX_NODES];
+    atomic_int      pidlist[TOPOLOGY_MAX_PIDS];     // attached processes
+} shdata_t;
+
+enum { SHMEM_TOPOLOGY_VERSION = 2 };
+enum { SHMEM_TOPOLOGY_TIMEOUT_MS = 5000 };
+enum { SHMEM_TOPOLOGY_POLL_USECS = 1000 };
+
+static shdata_t *shdata = NULL;
+static char shm_filename[SHM_NAME_LENGTH];
+static const char *shmem_name = "topology";
+
+static shdata_t* open_shmem(const char *shmem_key) {
+
+    get_shmem_filename(shm_filename, shmem_name, shmem_key, 0);
+
+    int fd = shm_open(shm_filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        verbose(VB_SHMEM, "Cannot open %s: %s", shm_filename, strerror(errno));
+        return NULL;
+    }
+
+    /* A newly created shmem has size 0, any other size means that it was
+     * created by an incompatible DLB version. Concurrent truncates to the
+     * same size are harmless. */
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) == -1
+            || (statbuf.st_size == 0
+                && ftruncate(fd, shmem_topology__size()) == -1)
+            || (statbuf.st_size != 0
+                && (size_t)statbuf.st_size != shmem_topology__size())) {
+        verbose(VB_SHMEM, "Shared memory %s size differs, ignoring", shm_filename);
+        close(fd);
+        return NULL;
+    }
+
+    void *shm_addr = mmap(NULL, shmem_topology__size(), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm_addr == MAP_FAILED) {
+        verbose(VB_SHMEM, "mmap error: %s", strerror(errno));
+        return NULL;
+    }
+
+    return shm_addr;
+}
+
+/* Replace the pid in the list entry, if it has not changed */
+static void replace_pid(atomic_int *entry, pid_t pid, pid_t new_pid) {
+    while (DLB_ATOMIC_LD(entry) == pid) {
+        int expected = pid;
+        if (DLB_ATOMIC_CMP_EXCH_WEAK(entry, expected, new_pid)) break;
+    }
+}
+
+/* Clean up the processes that are registered but no longer exist. If one of
+ * them was publishing the topology, allow other process to publish it */
+static void cleanup_dead_pids(void) {
+    for (int i = 0; i < TOPOLOGY_MAX_PIDS; ++i) {
+        pid_t pid = DLB_ATOMIC_LD(&shdata->pidlist[i]);
+        if (pid != 0 && kill(pid, 0) == -1 && errno == ESRCH) {
+            verbose(VB_SHMEM, "Process %d is registered in the topology shared memory"
+                    " but does not exist, cleaning up its entry", pid);
+            if (DLB_ATOMIC_LD(&shdata->publisher) == pid) {
+                int expected = TOPOLOGY_PUBLISHING;
+                DLB_ATOMIC_CMP_EXCH_WEAK(&shdata->state, expected, TOPOLOGY_EMPTY);
+            }
+            replace_pid(&shdata->pidlist[i], pid, 0);
+        }
+    }
+}
+
+/* Register this process. If the list is full, the process still uses the
+ * shmem but the last registered process may remove it from the namespace */
+static void register_pid(void) {
+    cleanup_dead_pids();
+    pid_t pid = getpid();
+    for (int i = 0; i < TOPOLOGY_MAX_PIDS; ++i) {
+        replace_pid(&shdata->pidlist[i], 0, pid);
+        if (DLB_ATOMIC_LD(&shdata->pidlist[i]) == pid) return;
+    }
+    verbose(VB_SHMEM, "Topology shared memory process list is full");
+}
+
+/* Unregister this process, returns whether no other process is registered */
+static bool unregister_pid(void) {
+    pid_t pid = getpid();
+    bool last_one = true;
+    for (int i = 0; i < TOPOLOGY_MAX_PIDS; ++i) {
+        replace_pid(&shdata->pidlist[i], pid, 0);
+        if (DLB_ATOMIC_LD(&shdata->pidlist[i]) != 0) {
+            last_one = false;
+        }
+    }
+    return last_one;
+}
+
+static void close_shmem(void) {
+    if (unregister_pid()) {
+        shm_unlink(shm_filename);
+    }
+    munmap(shdata, shmem_topology__size());
+    shdata = NULL;
+}
+
+static void publish_topology(void) {
+    shdata->version = SHMEM_TOPOLOGY_VERSION;
+    mu_init();
+    if (mu_get_system_masks(&shdata->sys_mask,
+                shdata->core_masks, TOPOLOGY_MAX_CORES, &shdata->num_cores,
+                shdata->node_masks, TOPOLOGY_MAX_NODES, &shdata->num_nodes) == 0) {
+        DLB_ATOMIC_ST_REL(&shdata->state, TOPOLOGY_READY);
+        verbose(VB_SHMEM, "Node topology published in shared memory");
+    } else {
+        /* The topology does not fit, every process will parse it */
+        DLB_ATOMIC_ST_REL(&shdata->state, TOPOLOGY_UNAVAILABLE);
+    }
+}
+
+/* Wait for another process to publish the topology. Returns false if the
+ * publisher is no longer alive or it takes too long. */
+static bool wait_for_topology(void) {
+    int64_t start = get_time_in_ns();
+    int state;
+    while ((state = DLB_ATOMIC_LD_ACQ(&shdata->state)) == TOPOLOGY_PUBLISHING) {
+        pid_t publisher = DLB_ATOMIC_LD(&shdata->publisher);
+        if (publisher > 0 && kill(publisher, 0) == -1 && errno == ESRCH) {
+            return false;
+        }
+        if (get_time_in_ns() - start > SHMEM_TOPOLOGY_TIMEOUT_MS * 1000000LL) {
+            return false;
+        }
+        usleep(SHMEM_TOPOLOGY_POLL_USECS);
+    }
+    return state == TOPOLOGY_READY;
+}
+
+static bool load_topology(void) {
+    if (shdata->version != SHMEM_TOPOLOGY_VERSION
+            || shdata->num_cores > TOPOLOGY_MAX_CORES
+            || shdata->num_nodes > TOPOLOGY_MAX_NODES) {
+        return false;
+    }
+
+    /* A process whose affinity is not contained in the published system mask
+     * sees a different topology, e.g., HWLOC restricted by cgroups */
+    cpu_set_t process_mask;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &process_mask) == 0
+            && !mu_is_subset(&process_mask, &shdata->sys_mask)) {
+        return false;
+    }
+
+    mu_init_with_masks(&shdata->sys_mask,
+            shdata->core_masks, shdata->num_cores,
+            shdata->node_masks, shdata->num_nodes);
+    return true;
+}
+
+/* Initialize the mask_utils system topology, either from the node topology
+ * shared memory or by parsing it (and publishing it if it is the first one).
+ * Returns DLB_SUCCESS if the topology was obtained from the shared memory,
+ * DLB_NOTED if this process parsed it. */
+int shmem_topology__init(const char *shmem_key) {
+
+    if (mu_is_initialized()) return DLB_NOTED;
+
+    if (shdata == NULL) {
+        shdata = open_shmem(shmem_key);
+        if (shdata == NULL) {
+            mu_init();
+            return DLB_NOTED;
+        }
+        register_pid();
+    }
+
+    int state = TOPOLOGY_EMPTY;
+    while (state == TOPOLOGY_EMPTY) {
+        if (DLB_ATOMIC_CMP_EXCH_WEAK(&shdata->state, state, TOPOLOGY_PUBLISHING)) {
+            DLB_ATOMIC_ST(&shdata->publisher, getpid());
+            publish_topology();
+            return DLB_NOTED;
+        }
+        state = DLB_ATOMIC_LD(&shdata->state);
+    }
+
+    if (wait_for_topology() && load_topology()) {
+        verbose(VB_SHMEM, "Node topology obtained from shared memory");
+        return DLB_SUCCESS;
+    }
+
+    verbose(VB_SHMEM, "Node topology shared memory not usable, parsing topology");
+    mu_init();
+    return DLB_NOTED;
+}
+
+void shmem_topology__finalize(void) {
+    if (shdata != NULL) {
+        close_shmem();
+    }
+}
+
+bool shmem_topology__exists(void) {
+    return shdata != NULL;
+}
+
+int shmem_topology__version(void) {
+    return SHMEM_TOPOLOGY_VERSION;
+}
+
+size_t shmem_topology__size(void) {
+    return sizeof(shdata_t);
+}
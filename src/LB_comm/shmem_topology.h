@@ -0,0 +1,32 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef SHMEM_TOPOLOGY_H
+#define SHMEM_TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+int  shmem_topology__init(const char *shmem_key);
+void shmem_topology__finalize(void);
+bool shmem_topology__exists(void);
+int  shmem_topology__version(void);
+size_t shmem_topology__size(void);
+
+#endif /* SHMEM_TOPOLOGY_H */
@@ -32,10 +32,12 @@
 #include "LB_comm/shmem_cpuinfo.h"
 #include "LB_comm/shmem_procinfo.h"
 #include "LB_comm/shmem_talp.h"
+#include "LB_comm/shmem_topology.h"
 #include "apis/dlb_errors.h"
 #include "apis/dlb_talp.h"
 #include "support/debug.h"
 #include "support/mytime.h"
+#include "support/timers.h"
 #include "support/tracing.h"
 #include "support/options.h"
 #include "support/mask_utils.h"
@@ -48,6 +50,7 @@
 #include <limits.h>
 #include <sched.h>
 #include <string.h>
+#include <unistd.h>
 
 
 /* By default all threads are participants.
@@ -70,13 +73,17 @@ int Initialize(subprocess_descriptor_t *spd, pid_t id, int ncpus,
         .id = id,
         .dlb_initialized = spd->dlb_initialized,
         .dlb_preinitialized = spd->dlb_preinitialized,
+        .pthread = spd->pthread,
+        .spd_index = spd->spd_index,
     };
     options_init(&spd->options, lb_args);
     debug_init(&spd->options);
     init_tracing(&spd->options);
     instrument_event(RUNTIME_EVENT, EVENT_INIT, EVENT_BEGIN);
-    mu_init();
-    timer_init();
+    shmem_topology__init(spd->options.shm_key);
+    if (spd->options.debug_opts & DBG_TIMERS) {
+        timers_init();
+    }
 
     // Infer LeWI mode
     spd->lb_policy =
@@ -106,6 +113,16 @@ int Initialize(subprocess_descriptor_t *spd, pid_t id, int ncpus,
         return DLB_ERR_NOCOMP;
     }
 
+    if (spd->options.lewi_shrink) {
+        if (spd->lb_policy != POLICY_LEWI_MASK) {
+            warning("Option --lewi-shrink is only supported by the LeWI mask policy"
+                    " and will be ignored.");
+        } else if (spd->options.lewi_shrink_region[0] != '\0' && !spd->options.talp) {
+            warning("Option --lewi-shrink-region requires --talp, iterations will"
+                    " not be detected.");
+        }
+    }
+
     // Initialize the rest of the subprocess descriptor
     pm_init(&spd->pm);
     set_lb_funcs(&spd->lb_funcs, spd->lb_policy);
@@ -245,7 +262,10 @@ int Finish(subprocess_descriptor_t *spd) {
     if (spd->options.mode == MODE_ASYNC) {
         shmem_async_finalize(spd->id);
     }
-    timer_finalize();
+    shmem_topology__finalize();
+    if (spd->options.debug_opts & DBG_TIMERS) {
+        timers_finalize();
+    }
     instrument_event(RUNTIME_EVENT, EVENT_FINALIZE, EVENT_END);
     instrument_finalize();
     options_finalize(&spd->options);
@@ -333,6 +353,13 @@ int unset_max_parallelism(subprocess_descriptor_t *spd) {
 /* Sync-call specific (MPI, DLB_Barrier, etc.) */
 
 void into_sync_call(sync_call_flags_t flags) {
+    into_sync_call_handoff(flags, NULL, 0);
+}
+
+/* Same as into_sync_call, but the CPUs lent by LeWI are handed off to the
+ * processes in 'recipients', if the policy supports it */
+void into_sync_call_handoff(sync_call_flags_t flags,
+        const pid_t *recipients, unsigned int nrecipients) {
     /* Observer threads do not trigger LeWI nor TALP on sync calls */
     if (unlikely(thread_is_observer)) return;
 
@@ -340,7 +367,11 @@ void into_sync_call(sync_call_flags_t flags) {
     if (unlikely(spd == NULL)) return;
 
     if (spd->options.lewi && spd->lewi_enabled && flags.do_lewi) {
-        spd->lb_funcs.into_blocking_call(spd);
+        if (nrecipients == 0
+                || spd->lb_funcs.into_blocking_call_handoff(
+                    spd, recipients, nrecipients) == DLB_ERR_NOPOL) {
+            spd->lb_funcs.into_blocking_call(spd);
+        }
         omptool__into_blocking_call();
     }
     if(spd->options.talp) {
@@ -365,6 +396,17 @@ void out_of_sync_call(sync_call_flags_t flags) {
 }
 
 
+/* Iterations */
+
+/* The application starts a new iteration, or the first iteration of a new
+ * loop, as detected by DynAIS or by the start of a TALP region */
+void new_iteration(const subprocess_descriptor_t *spd, bool new_loop) {
+    if (spd->options.lewi && spd->lewi_enabled) {
+        spd->lb_funcs.new_iteration(spd, new_loop);
+    }
+}
+
+
 /* Lend */
 
 int lend(const subprocess_descriptor_t *spd) {
@@ -377,7 +419,9 @@ int lend(const subprocess_descriptor_t *spd) {
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_BEGIN);
         instrument_event(GIVE_CPUS_EVENT, CPU_SETSIZE, EVENT_BEGIN);
         omptool__lend_from_api();
+        int64_t timer = timer_start();
         error = spd->lb_funcs.lend(spd);
+        timer_stop(TIMER_LEND, timer);
         instrument_event(GIVE_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_END);
     }
@@ -393,7 +437,9 @@ int lend_cpu(const subprocess_descriptor_t *spd, int cpuid) {
     } else {
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_BEGIN);
         instrument_event(GIVE_CPUS_EVENT, 1, EVENT_BEGIN);
+        int64_t timer = timer_start();
         error = spd->lb_funcs.lend_cpu(spd, cpuid);
+        timer_stop(TIMER_LEND, timer);
         instrument_event(GIVE_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_END);
     }
@@ -409,7 +455,9 @@ int lend_cpus(const subprocess_descriptor_t *spd, int ncpus) {
     } else {
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_BEGIN);
         instrument_event(GIVE_CPUS_EVENT, ncpus, EVENT_BEGIN);
+        int64_t timer = timer_start();
         error = spd->lb_funcs.lend_cpus(spd, ncpus);
+        timer_stop(TIMER_LEND, timer);
         instrument_event(GIVE_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_END);
     }
@@ -425,7 +473,9 @@ int lend_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask) {
     } else {
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_BEGIN);
         instrument_event(GIVE_CPUS_EVENT, CPU_COUNT(mask), EVENT_BEGIN);
+        int64_t timer = timer_start();
         error = spd->lb_funcs.lend_cpu_mask(spd, mask);
+        timer_stop(TIMER_LEND, timer);
         instrument_event(GIVE_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_LEND, EVENT_END);
     }
@@ -444,7 +494,9 @@ int reclaim(const subprocess_descriptor_t *spd) {
     } else {
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_BEGIN);
         instrument_event(WANT_CPUS_EVENT, CPU_SETSIZE, EVENT_BEGIN);
+        int64_t timer = timer_start();
         error = spd->lb_funcs.reclaim(spd);
+        timer_stop(TIMER_RECLAIM, timer);
         instrument_event(WANT_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_END);
     }
@@ -460,7 +512,9 @@ int reclaim_cpu(const subprocess_descriptor_t *spd, int cpuid) {
     } else {
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_BEGIN);
         instrument_event(WANT_CPUS_EVENT, 1, EVENT_BEGIN);
+        int64_t timer = timer_start();
         error = spd->lb_funcs.reclaim_cpu(spd, cpuid);
+        timer_stop(TIMER_RECLAIM, timer);
         instrument_event(WANT_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_END);
     }
@@ -476,7 +530,9 @@ int reclaim_cpus(const subprocess_descriptor_t *spd, int ncpus) {
     } else {
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_BEGIN);
         instrument_event(WANT_CPUS_EVENT, ncpus, EVENT_BEGIN);
+        int64_t timer = timer_start();
         error = spd->lb_funcs.reclaim_cpus(spd, ncpus);
+        timer_stop(TIMER_RECLAIM, timer);
         instrument_event(WANT_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_END);
     }
@@ -492,7 +548,9 @@ int reclaim_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask)
     } else {
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_BEGIN);
         instrument_event(WANT_CPUS_EVENT, CPU_COUNT(mask), EVENT_BEGIN);
+        int64_t timer = timer_start();
         error = spd->lb_funcs.reclaim_cpu_mask(spd, mask);
+        timer_stop(TIMER_RECLAIM, timer);
         instrument_event(WANT_CPUS_EVENT, 0, EVENT_END);
         instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_END);
     }
@@ -567,6 +625,85 @@ int acquire_cpus_in_mask(const subprocess_descriptor_t *spd, int ncpus, const cp
 }
 
 
+/* Asynchronous requests */
+
+enum { TICKET_POLL_DELAY = 1000 };
+
+int acquire_cpus_async(const subprocess_descriptor_t *spd, int ncpus, dlb_ticket_t *ticket) {
+    int error;
+    *ticket = DLB_TICKET_NULL;
+    if (!spd->options.lewi) {
+        error = DLB_ERR_NOLEWI;
+    } else if (!spd->lewi_enabled) {
+        error = DLB_ERR_DISBLD;
+    } else {
+        instrument_event(RUNTIME_EVENT, EVENT_ACQUIRE, EVENT_BEGIN);
+        instrument_event(WANT_CPUS_EVENT, ncpus, EVENT_BEGIN);
+        error = spd->lb_funcs.acquire_cpus_async(spd, ncpus, ticket);
+        instrument_event(WANT_CPUS_EVENT, 0, EVENT_END);
+        instrument_event(RUNTIME_EVENT, EVENT_ACQUIRE, EVENT_END);
+    }
+    return error;
+}
+
+int reclaim_cpus_async(const subprocess_descriptor_t *spd, int ncpus, dlb_ticket_t *ticket) {
+    int error;
+    *ticket = DLB_TICKET_NULL;
+    if (!spd->options.lewi) {
+        error = DLB_ERR_NOLEWI;
+    } else if (!spd->lewi_enabled) {
+        error = DLB_ERR_DISBLD;
+    } else {
+        instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_BEGIN);
+        instrument_event(WANT_CPUS_EVENT, ncpus, EVENT_BEGIN);
+        error = spd->lb_funcs.reclaim_cpus_async(spd, ncpus, ticket);
+        instrument_event(WANT_CPUS_EVENT, 0, EVENT_END);
+        instrument_event(RUNTIME_EVENT, EVENT_RECLAIM, EVENT_END);
+    }
+    return error;
+}
+
+int test_ticket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket) {
+    int error;
+    if (!spd->options.lewi) {
+        error = DLB_ERR_NOLEWI;
+    } else {
+        error = spd->lb_funcs.test_ticket(spd, ticket);
+    }
+    return error;
+}
+
+int wait_ticket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket) {
+    int error;
+    if (!spd->options.lewi) {
+        error = DLB_ERR_NOLEWI;
+    } else if (!spd->lewi_enabled) {
+        error = DLB_ERR_DISBLD;
+    } else {
+        /* CPUs are assigned by other processes, poll until the ticket is done
+         * or LeWI is disabled from another thread, which invalidates it */
+        while ((error = spd->lb_funcs.test_ticket(spd, ticket)) == DLB_NOTED) {
+            usleep(TICKET_POLL_DELAY);
+            if (!spd->lewi_enabled) {
+                error = DLB_ERR_DISBLD;
+                break;
+            }
+        }
+    }
+    return error;
+}
+
+int cancel_ticket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket) {
+    int error;
+    if (!spd->options.lewi) {
+        error = DLB_ERR_NOLEWI;
+    } else {
+        error = spd->lb_funcs.cancel_ticket(spd, ticket);
+    }
+    return error;
+}
+
+
 /* Borrow */
 
 int borrow(const subprocess_descriptor_t *spd) {
@@ -706,6 +843,7 @@ int poll_drom(const subprocess_descriptor_t *spd, int *new_cpus, cpu_set_t *new_
         cpu_set_t local_mask;
         cpu_set_t *mask = new_mask ? new_mask : &local_mask;
 
+        int64_t timer = timer_start();
         error = shmem_procinfo__polldrom(spd->id, new_cpus, mask);
         if (error == DLB_SUCCESS) {
             if (spd->options.lewi) {
@@ -716,6 +854,7 @@ int poll_drom(const subprocess_descriptor_t *spd, int *new_cpus, cpu_set_t *new_
                 shmem_cpuinfo__update_ownership(spd->id, mask, NULL);
             }
         }
+        timer_stop(TIMER_POLLDROM, timer);
         instrument_event(RUNTIME_EVENT, EVENT_POLLDROM, EVENT_END);
     }
     return error;
@@ -49,8 +49,13 @@ int unset_max_parallelism(subprocess_descriptor_t *spd);
 
 /* Sync-call specific (MPI, DLB_Barrier, etc.) */
 void into_sync_call(sync_call_flags_t flags);
+void into_sync_call_handoff(sync_call_flags_t flags,
+        const pid_t *recipients, unsigned int nrecipients);
 void out_of_sync_call(sync_call_flags_t flags);
 
+/* Iterations */
+void new_iteration(const subprocess_descriptor_t *spd, bool new_loop);
+
 /* Lend */
 int lend(const subprocess_descriptor_t *spd);
 int lend_cpu(const subprocess_descriptor_t *spd, int cpuid);
@@ -69,6 +74,13 @@ int acquire_cpus(const subprocess_descriptor_t *spd, int ncpus);
 int acquire_cpu_mask(const subprocess_descriptor_t *spd, const cpu_set_t *mask);
 int acquire_cpus_in_mask(const subprocess_descriptor_t *spd, int ncpus, const cpu_set_t *mask);
 
+/* Asynchronous requests */
+int acquire_cpus_async(const subprocess_descriptor_t *spd, int ncpus, dlb_ticket_t *ticket);
+int reclaim_cpus_async(const subprocess_descriptor_t *spd, int ncpus, dlb_ticket_t *ticket);
+int test_ticket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket);
+int wait_ticket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket);
+int cancel_ticket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket);
+
 /* Borrow */
 int borrow(const subprocess_descriptor_t *spd);
 int borrow_cpu(const subprocess_descriptor_t *spd, int cpuid);
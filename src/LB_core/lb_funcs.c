@@ -30,6 +30,10 @@ typedef int (*lb_func_kind1)(const struct SubProcessDescriptor*);
 typedef int (*lb_func_kind2)(const struct SubProcessDescriptor*, int);
 typedef int (*lb_func_kind3)(const struct SubProcessDescriptor*, const cpu_set_t*);
 typedef int (*lb_func_kind4)(const struct SubProcessDescriptor*, int, const cpu_set_t*);
+typedef int (*lb_func_kind5)(const struct SubProcessDescriptor*, const pid_t*, unsigned int);
+typedef int (*lb_func_kind6)(const struct SubProcessDescriptor*, bool);
+typedef int (*lb_func_kind7)(const struct SubProcessDescriptor*, int, dlb_ticket_t*);
+typedef int (*lb_func_kind8)(const struct SubProcessDescriptor*, dlb_ticket_t);
 
 void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
     // Initialize all fields to a valid, but disabled, function
@@ -43,7 +47,9 @@ void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
         .into_communication     = (lb_func_kind1)disabled,
         .out_of_communication   = (lb_func_kind1)disabled,
         .into_blocking_call     = (lb_func_kind1)disabled,
+        .into_blocking_call_handoff = (lb_func_kind5)disabled,
         .out_of_blocking_call   = (lb_func_kind1)disabled,
+        .new_iteration          = (lb_func_kind6)disabled,
         .lend                   = (lb_func_kind1)disabled,
         .lend_cpu               = (lb_func_kind2)disabled,
         .lend_cpus              = (lb_func_kind2)disabled,
@@ -56,6 +62,10 @@ void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
         .acquire_cpus           = (lb_func_kind2)disabled,
         .acquire_cpu_mask       = (lb_func_kind3)disabled,
         .acquire_cpus_in_mask   = (lb_func_kind4)disabled,
+        .acquire_cpus_async     = (lb_func_kind7)disabled,
+        .reclaim_cpus_async     = (lb_func_kind7)disabled,
+        .test_ticket            = (lb_func_kind8)disabled,
+        .cancel_ticket          = (lb_func_kind8)disabled,
         .borrow                 = (lb_func_kind1)disabled,
         .borrow_cpu             = (lb_func_kind2)disabled,
         .borrow_cpus            = (lb_func_kind2)disabled,
@@ -108,7 +118,9 @@ void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
             lb_funcs->set_max_parallelism    = lewi_mask_SetMaxParallelism;
             lb_funcs->unset_max_parallelism  = lewi_mask_UnsetMaxParallelism;
             lb_funcs->into_blocking_call     = lewi_mask_IntoBlockingCall;
+            lb_funcs->into_blocking_call_handoff = lewi_mask_IntoBlockingCallHandoff;
             lb_funcs->out_of_blocking_call   = lewi_mask_OutOfBlockingCall;
+            lb_funcs->new_iteration          = lewi_mask_NewIteration;
             lb_funcs->lend                   = lewi_mask_Lend;
             lb_funcs->lend_cpu               = lewi_mask_LendCpu;
             lb_funcs->lend_cpu_mask          = lewi_mask_LendCpuMask;
@@ -120,6 +132,10 @@ void set_lb_funcs(balance_policy_t *lb_funcs, policy_t policy) {
             lb_funcs->acquire_cpus           = lewi_mask_AcquireCpus;
             lb_funcs->acquire_cpu_mask       = lewi_mask_AcquireCpuMask;
             lb_funcs->acquire_cpus_in_mask   = lewi_mask_AcquireCpusInMask;
+            lb_funcs->acquire_cpus_async     = lewi_mask_AcquireCpusAsync;
+            lb_funcs->reclaim_cpus_async     = lewi_mask_ReclaimCpusAsync;
+            lb_funcs->test_ticket            = lewi_mask_TestTicket;
+            lb_funcs->cancel_ticket          = lewi_mask_CancelTicket;
             lb_funcs->borrow                 = lewi_mask_Borrow;
             lb_funcs->borrow_cpu             = lewi_mask_BorrowCpu;
             lb_funcs->borrow_cpus            = lewi_mask_BorrowCpus;
@@ -21,8 +21,11 @@
 #define LB_FUNCS_H
 
 #include "support/types.h"
+#include "apis/dlb_types.h"
 
 #include <sched.h>
+#include <stdbool.h>
+#include <sys/types.h>
 
 struct SubProcessDescriptor;
 
@@ -38,7 +41,11 @@ typedef struct BalancePolicy {
     int (*into_communication)(const struct SubProcessDescriptor *spd);
     int (*out_of_communication)(const struct SubProcessDescriptor *spd);
     int (*into_blocking_call)(const struct SubProcessDescriptor *spd);
+    int (*into_blocking_call_handoff)(const struct SubProcessDescriptor *spd,
+            const pid_t *recipients, unsigned int nrecipients);
     int (*out_of_blocking_call)(const struct SubProcessDescriptor *spd);
+    /* Iterations */
+    int (*new_iteration)(const struct SubProcessDescriptor *spd, bool new_loop);
     /* Lend */
     int (*lend)(const struct SubProcessDescriptor *spd);
     int (*lend_cpu)(const struct SubProcessDescriptor *spd, int cpuid);
@@ -54,6 +61,11 @@ typedef struct BalancePolicy {
     int (*acquire_cpus)(const struct SubProcessDescriptor *spd, int ncpus);
     int (*acquire_cpu_mask)(const struct SubProcessDescriptor *spd, const cpu_set_t *mask);
     int (*acquire_cpus_in_mask)(const struct SubProcessDescriptor *spd, int ncpus, const cpu_set_t *mask);
+    /* Asynchronous requests */
+    int (*acquire_cpus_async)(const struct SubProcessDescriptor *spd, int ncpus, dlb_ticket_t *ticket);
+    int (*reclaim_cpus_async)(const struct SubProcessDescriptor *spd, int ncpus, dlb_ticket_t *ticket);
+    int (*test_ticket)(const struct SubProcessDescriptor *spd, dlb_ticket_t ticket);
+    int (*cancel_ticket)(const struct SubProcessDescriptor *spd, dlb_ticket_t ticket);
     /* Borrow */
     int (*borrow)(const struct SubProcessDescriptor *spd);
     int (*borrow_cpu)(const struct SubProcessDescriptor *spd, int cpuid);
@@ -31,6 +31,7 @@
 #include "support/tracing.h"
 
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -43,7 +44,26 @@ typedef struct barrier_info {
 } barrier_info_t;
 
 static const char *default_barrier_name = "default";
-static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* The barrier_list of each spd is protected by one of these mutexes, selected
+ * by the spd address, so that barriers of independent handlers rarely
+ * serialize. They are never destroyed, since other threads may still be
+ * waiting for them when an spd is finalized. */
+enum { NUM_BARRIER_MUTEXES = 16 };
+static pthread_mutex_t barrier_mutexes[NUM_BARRIER_MUTEXES];
+static pthread_once_t barrier_mutexes_once = PTHREAD_ONCE_INIT;
+
+static void init_barrier_mutexes(void) {
+    for (int i = 0; i < NUM_BARRIER_MUTEXES; ++i) {
+        pthread_mutex_init(&barrier_mutexes[i], NULL);
+    }
+}
+
+static pthread_mutex_t* get_barrier_mutex(const subprocess_descriptor_t *spd) {
+    pthread_once(&barrier_mutexes_once, init_barrier_mutexes);
+    return &barrier_mutexes[((uintptr_t)spd / sizeof(subprocess_descriptor_t))
+        % NUM_BARRIER_MUTEXES];
+}
 
 /* Parse, for the specific barrier, whether it should do LeWI based on:
  * - if barrier_name == default_barrier_name:
@@ -105,33 +125,29 @@ void node_barrier_init(subprocess_descriptor_t *spd) {
     bool lewi_barrier = parse_lewi_barrier(default_barrier_name,
             spd->options.lewi_barrier, spd->options.lewi_barrier_select, 0);
 
-    barrier_info_t *barrier_info;
-    pthread_mutex_lock(&mutex);
-    {
-        /* Initialize barrier_info */
-        barrier_info = malloc(sizeof(barrier_info_t));
-        *barrier_info = (const barrier_info_t){};
-        spd->barrier_info = barrier_info;
-
-        /* --barrier-id may be deprecated in the future, but for now we just modify
-        * the default barrier name so that processes with different barrier id's
-        * don't synchronize with each other. */
-        if (spd->options.barrier_id == 0) {
-            sprintf(barrier_info->default_barrier_name, "%s", default_barrier_name);
-        } else {
-            snprintf(barrier_info->default_barrier_name, BARRIER_NAME_MAX,
-                    "default (id: %d)", spd->options.barrier_id);
-        }
+    /* Initialize barrier_info */
+    barrier_info_t *barrier_info = malloc(sizeof(barrier_info_t));
+    *barrier_info = (const barrier_info_t){};
 
-        /* Initialize default barrier */
-        barrier_info->default_barrier = shmem_barrier__register(
-                barrier_info->default_barrier_name, lewi_barrier);
-
-        /* Initialize barrier_list */
-        barrier_info->max_barriers = shmem_barrier__get_max_barriers();
-        barrier_info->barrier_list = calloc(barrier_info->max_barriers, sizeof(void*));
+    /* --barrier-id may be deprecated in the future, but for now we just modify
+     * the default barrier name so that processes with different barrier id's
+     * don't synchronize with each other. */
+    if (spd->options.barrier_id == 0) {
+        sprintf(barrier_info->default_barrier_name, "%s", default_barrier_name);
+    } else {
+        snprintf(barrier_info->default_barrier_name, BARRIER_NAME_MAX,
+                "default (id: %d)", spd->options.barrier_id);
     }
-    pthread_mutex_unlock(&mutex);
+
+    /* Initialize default barrier */
+    barrier_info->default_barrier = shmem_barrier__register(
+            barrier_info->default_barrier_name, lewi_barrier);
+
+    /* Initialize barrier_list */
+    barrier_info->max_barriers = shmem_barrier__get_max_barriers();
+    barrier_info->barrier_list = calloc(barrier_info->max_barriers, sizeof(void*));
+
+    spd->barrier_info = barrier_info;
 
     if (barrier_info->default_barrier == NULL) {
         warning("DLB system barrier could nout be initialized");
@@ -139,11 +155,12 @@ void node_barrier_init(subprocess_descriptor_t *spd) {
 }
 
 void node_barrier_finalize(subprocess_descriptor_t *spd) {
-    pthread_mutex_lock(&mutex);
-    {
-        if (spd->barrier_info != NULL) {
+    barrier_info_t *barrier_info = spd->barrier_info;
+    if (barrier_info != NULL) {
+        pthread_mutex_t *mutex = get_barrier_mutex(spd);
+        pthread_mutex_lock(mutex);
+        {
             /* Detach all, no need to check for non NULL values */
-            barrier_info_t *barrier_info = spd->barrier_info;
             shmem_barrier__detach(barrier_info->default_barrier);
             int i;
             for (i=0; i<barrier_info->max_barriers; ++i) {
@@ -151,11 +168,11 @@ void node_barrier_finalize(subprocess_descriptor_t *spd) {
             }
             free(barrier_info->barrier_list);
             *barrier_info = (const barrier_info_t){};
-            free(spd->barrier_info);
+            free(barrier_info);
             spd->barrier_info = NULL;
         }
+        pthread_mutex_unlock(mutex);
     }
-    pthread_mutex_unlock(&mutex);
 }
 
 barrier_t* node_barrier_register(subprocess_descriptor_t *spd,
@@ -199,7 +216,7 @@ barrier_t* node_barrier_register(subprocess_descriptor_t *spd,
         /* Update the barrier list, if needed */
         int i;
         int max_barriers = barrier_info->max_barriers;
-        pthread_mutex_lock(&mutex);
+        pthread_mutex_lock(get_barrier_mutex(spd));
         {
             for (i=0; i<max_barriers; ++i) {
                 if (barrier_info->barrier_list[i] == NULL) {
@@ -208,7 +225,7 @@ barrier_t* node_barrier_register(subprocess_descriptor_t *spd,
                 }
             }
         }
-        pthread_mutex_unlock(&mutex);
+        pthread_mutex_unlock(get_barrier_mutex(spd));
 
         ensure(i < max_barriers, "Cannot register Node Barrier, no space left in"
                 " barrier_list.\nPlease, report bug at " PACKAGE_BUGREPORT);
@@ -236,7 +253,7 @@ int node_barrier(const subprocess_descriptor_t *spd, barrier_t *barrier) {
              * not been detached */
             int i = 0;
             int max_barriers = barrier_info->max_barriers;
-            pthread_mutex_lock(&mutex);
+            pthread_mutex_lock(get_barrier_mutex(spd));
             {
                 while (i<max_barriers
                         && barrier_info->barrier_list[i] != NULL
@@ -249,7 +266,7 @@ int node_barrier(const subprocess_descriptor_t *spd, barrier_t *barrier) {
                     barrier = NULL;
                 }
             }
-            pthread_mutex_unlock(&mutex);
+            pthread_mutex_unlock(get_barrier_mutex(spd));
         }
 
         /* If barrier was found, perform the actual barrier */
@@ -295,7 +312,7 @@ int node_barrier_attach(subprocess_descriptor_t *spd, barrier_t *barrier) {
         } else {
             int i = 0;
             int max_barriers = shmem_barrier__get_max_barriers();
-            pthread_mutex_lock(&mutex);
+            pthread_mutex_lock(get_barrier_mutex(spd));
             {
                 /* Find first NULL place or barrier in barrier_list */
                 while (i<max_barriers
@@ -317,7 +334,7 @@ int node_barrier_attach(subprocess_descriptor_t *spd, barrier_t *barrier) {
                     }
                 }
             }
-            pthread_mutex_unlock(&mutex);
+            pthread_mutex_unlock(get_barrier_mutex(spd));
         }
     } else {
         /* no --barrier */
@@ -352,7 +369,7 @@ int node_barrier_detach(subprocess_descriptor_t *spd, barrier_t *barrier) {
         } else {
             int i = 0;
             int max_barriers = shmem_barrier__get_max_barriers();
-            pthread_mutex_lock(&mutex);
+            pthread_mutex_lock(get_barrier_mutex(spd));
             {
                 /* Find first NULL place or barrier in barrier_list */
                 while (i<max_barriers
@@ -377,7 +394,7 @@ int node_barrier_detach(subprocess_descriptor_t *spd, barrier_t *barrier) {
                     }
                 }
             }
-            pthread_mutex_unlock(&mutex);
+            pthread_mutex_unlock(get_barrier_mutex(spd));
         }
     } else {
         /* no --barrier */
@@ -19,8 +19,9 @@
 
 #include "LB_core/spd.h"
 
+#include "apis/dlb_talp.h"
 #include "support/debug.h"
-#include "support/gtree.h"
+#include "support/dlb_common.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -29,15 +30,18 @@
 /* TLS global variable to store the spd pointer */
 __thread subprocess_descriptor_t *thread_spd = NULL;
 
+/* Epoch of the Monitoring Region handles cached by the users */
+DLB_EXPORT_SYMBOL volatile int dlb_talp_regions_epoch = 0;
+
 /* Global subprocess descriptor */
 static subprocess_descriptor_t global_spd = { 0 };
 
-/* GTree containing each subprocess descriptor */
-typedef struct SPDInfo {
-    const subprocess_descriptor_t *spd;
-    pthread_t pthread;
-} spd_info_t;
-static GTree *spd_tree = NULL;
+/* Flat table containing each registered subprocess descriptor. Each spd keeps
+ * its own index so that unregistering is O(1); the mutex is only needed to
+ * modify or traverse the table, never to access an spd. */
+static subprocess_descriptor_t **spd_table = NULL;
+static int spd_table_size = 0;
+static int spd_table_capacity = 0;
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 
@@ -45,29 +49,38 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 /*    TLS global variable                                                        */
 /*********************************************************************************/
 void spd_enter_dlb(subprocess_descriptor_t *spd) {
-    thread_spd = spd ? spd : &global_spd;
+    subprocess_descriptor_t *new_spd = spd ? spd : &global_spd;
+    if (unlikely(thread_spd != new_spd)) {
+        /* A thread that had never entered DLB has no cached regions */
+        if (thread_spd != NULL) {
+            spd_invalidate_regions();
+        }
+        thread_spd = new_spd;
+    }
 }
 
-/*********************************************************************************/
-/*    GTree modification functions                                               */
-/*********************************************************************************/
-static gint key_compare_func(gconstpointer a, gconstpointer b) {
-    return (uintptr_t)a < (uintptr_t)b ? -1 : (uintptr_t)a > (uintptr_t)b;
+/* Invalidate the Monitoring Region handles cached by the users, i.e., by
+ * DLB_MonitoringRegionRegisterStatic */
+void spd_invalidate_regions(void) {
+    __sync_fetch_and_add(&dlb_talp_regions_epoch, 1);
 }
 
+/*********************************************************************************/
+/*    Table modification functions                                               */
+/*********************************************************************************/
 void spd_register(subprocess_descriptor_t *spd) {
-    spd_info_t *spd_info = malloc(sizeof(spd_info_t));
-    spd_info->spd = spd;
-    spd_info->pthread = 0;
+    spd->pthread = 0;
 
     pthread_mutex_lock(&mutex);
     {
-        if (spd_tree == NULL) {
-            spd_tree = g_tree_new_full(
-                    (GCompareDataFunc)key_compare_func,
-                    NULL, NULL, free);
+        if (spd_table_size == spd_table_capacity) {
+            spd_table_capacity = spd_table_capacity > 0 ? spd_table_capacity * 2 : 16;
+            spd_table = realloc(spd_table,
+                    sizeof(subprocess_descriptor_t*) * spd_table_capacity);
+            fatal_cond(!spd_table, "Could not allocate subprocess descriptor table");
         }
-        g_tree_insert(spd_tree, spd, spd_info);
+        spd->spd_index = spd_table_size;
+        spd_table[spd_table_size++] = spd;
     }
     pthread_mutex_unlock(&mutex);
 }
@@ -75,60 +88,46 @@ void spd_register(subprocess_descriptor_t *spd) {
 void spd_unregister(const subprocess_descriptor_t *spd) {
     pthread_mutex_lock(&mutex);
     {
-        g_tree_remove(spd_tree, spd);
+        int index = spd->spd_index;
+        if (index >= 0 && index < spd_table_size && spd_table[index] == spd) {
+            /* Move the last spd to the free position */
+            subprocess_descriptor_t *last = spd_table[--spd_table_size];
+            spd_table[index] = last;
+            last->spd_index = index;
+        }
     }
     pthread_mutex_unlock(&mutex);
 }
 
 __attribute__((destructor))
-static void spd_tree_dtor(void) {
-    g_tree_destroy(spd_tree);
+static void spd_table_dtor(void) {
+    free(spd_table);
+    spd_table = NULL;
+    spd_table_size = 0;
+    spd_table_capacity = 0;
 }
 
 /*********************************************************************************/
 /*    Setter and getter of the assigned pthread per spd                          */
 /*********************************************************************************/
-void spd_set_pthread(const subprocess_descriptor_t *spd, pthread_t pthread) {
-    pthread_mutex_lock(&mutex);
-    {
-        spd_info_t *spd_info = g_tree_lookup(spd_tree, spd);
-        spd_info->pthread = pthread;
-    }
-    pthread_mutex_unlock(&mutex);
+void spd_set_pthread(subprocess_descriptor_t *spd, pthread_t pthread) {
+    spd->pthread = pthread;
 }
 
 pthread_t spd_get_pthread(const subprocess_descriptor_t *spd) {
-    pthread_t pthread;
-    pthread_mutex_lock(&mutex);
-    {
-        spd_info_t *spd_info = g_tree_lookup(spd_tree, spd);
-        pthread = spd_info->pthread;
-    }
-    pthread_mutex_unlock(&mutex);
-    return pthread;
+    return spd->pthread;
 }
 
 /*********************************************************************************/
 /*    Obtain a list of pointers (NULL terminated) of spds                        */
 /*********************************************************************************/
-static gint tree_to_list(gpointer key, gpointer value, gpointer data) {
-    subprocess_descriptor_t *spd = key;
-    subprocess_descriptor_t ***list_p = data;
-    **list_p = spd;
-    ++(*list_p);
-
-    /* return false to not stop traversing */
-    return false;
-}
-
 const subprocess_descriptor_t** spd_get_spds(void) {
     const subprocess_descriptor_t **spds;
     pthread_mutex_lock(&mutex);
     {
-        spds = malloc(sizeof(subprocess_descriptor_t *) * (g_tree_nnodes(spd_tree)+1));
-        const subprocess_descriptor_t **p = spds;
-        g_tree_foreach(spd_tree, tree_to_list, &p);
-        *p = NULL;
+        spds = malloc(sizeof(subprocess_descriptor_t *) * (spd_table_size+1));
+        memcpy(spds, spd_table, sizeof(subprocess_descriptor_t *) * spd_table_size);
+        spds[spd_table_size] = NULL;
     }
     pthread_mutex_unlock(&mutex);
 
@@ -27,6 +27,7 @@
 #include "support/types.h"
 
 #include <sys/types.h>
+#include <pthread.h>
 
 /* Sub-process Descriptor */
 
@@ -45,14 +46,17 @@ typedef struct SubProcessDescriptor {
     void *lewi_info;
     void *talp_info;
     void *barrier_info;
+    pthread_t pthread;          /* thread assigned to this spd, if any */
+    int spd_index;              /* position in the spd table, internal use */
 } subprocess_descriptor_t;
 
 extern __thread subprocess_descriptor_t *thread_spd;
 
 void spd_enter_dlb(subprocess_descriptor_t *spd);
+void spd_invalidate_regions(void);
 void spd_register(subprocess_descriptor_t *spd);
 void spd_unregister(const subprocess_descriptor_t *spd);
-void spd_set_pthread(const subprocess_descriptor_t *spd, pthread_t pthread);
+void spd_set_pthread(subprocess_descriptor_t *spd, pthread_t pthread);
 pthread_t spd_get_pthread(const subprocess_descriptor_t *spd);
 const subprocess_descriptor_t** spd_get_spds(void);
 
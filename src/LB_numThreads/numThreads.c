@@ -24,9 +24,13 @@
 #include "support/tracing.h"
 #include "support/debug.h"
 #include "support/mask_utils.h"
+#include "support/mytime.h"
 
 #include <sched.h>
 #include <pthread.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define OMP_SYMBOLS_DEFINED ( \
         omp_set_num_threads \
@@ -40,6 +44,69 @@ static void packed_omp_set_num_threads(int nthreads, void *arg) {
     omp_set_num_threads(nthreads);
 }
 
+/* Enabled CPUs of an interface not yet notified to the programming model */
+typedef struct PendingDelta {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;           /* signaled on new pending CPUs or finalization */
+    pthread_t       flusher;        /* notifies the pending CPUs on deadline expiry */
+    const pm_interface_t *pm;
+    bool        finalize;
+    int64_t     window;             /* in nanoseconds */
+    bool        pending;
+    cpu_set_t   cpus_to_enable;
+    int64_t     deferral_deadline;
+} pending_delta_t;
+
+static int notify_mask_delta(const pm_interface_t *pm,
+        const cpu_set_t *cpus_to_enable, const cpu_set_t *cpus_to_disable);
+
+/* Take the pending CPUs to enable and start a new window,
+ * the pending_delta mutex must be held */
+static void take_pending_delta(pending_delta_t *pending_delta, cpu_set_t *enable_set,
+        int64_t now) {
+    memcpy(enable_set, &pending_delta->cpus_to_enable, sizeof(cpu_set_t));
+    CPU_ZERO(&pending_delta->cpus_to_enable);
+    pending_delta->pending = false;
+    pending_delta->deferral_deadline = now + pending_delta->window;
+}
+
+/* The process may not call DLB again for a long time, e.g., in async mode or
+ * during a compute phase, so the deferred CPUs are also notified by this
+ * thread when the window expires */
+static void* flusher_thread_start(void *arg) {
+    pending_delta_t *pending_delta = arg;
+    cpu_set_t empty_set;
+    CPU_ZERO(&empty_set);
+
+    pthread_mutex_lock(&pending_delta->mutex);
+    while (!pending_delta->finalize) {
+        if (!pending_delta->pending) {
+            pthread_cond_wait(&pending_delta->cond, &pending_delta->mutex);
+            continue;
+        }
+
+        int64_t now = get_time_in_ns();
+        if (now < pending_delta->deferral_deadline) {
+            int64_t deadline = pending_delta->deferral_deadline;
+            struct timespec ts = {
+                .tv_sec = deadline / 1000000000LL,
+                .tv_nsec = deadline % 1000000000LL,
+            };
+            pthread_cond_timedwait(&pending_delta->cond, &pending_delta->mutex, &ts);
+            continue;
+        }
+
+        cpu_set_t enable_set;
+        take_pending_delta(pending_delta, &enable_set, now);
+        pthread_mutex_unlock(&pending_delta->mutex);
+        notify_mask_delta(pending_delta->pm, &enable_set, &empty_set);
+        pthread_mutex_lock(&pending_delta->mutex);
+    }
+    pthread_mutex_unlock(&pending_delta->mutex);
+
+    return NULL;
+}
+
 
 void pm_init(pm_interface_t *pm) {
 
@@ -54,10 +121,54 @@ void pm_init(pm_interface_t *pm) {
 }
 
 void pm_finalize(pm_interface_t *pm) {
+    /* Discard deferred changes */
+    pending_delta_t *pending_delta = pm->pending_delta;
+    if (pending_delta != NULL) {
+        pthread_mutex_lock(&pending_delta->mutex);
+        {
+            pending_delta->finalize = true;
+            pthread_cond_signal(&pending_delta->cond);
+        }
+        pthread_mutex_unlock(&pending_delta->mutex);
+        pthread_join(pending_delta->flusher, NULL);
+        pthread_cond_destroy(&pending_delta->cond);
+        pthread_mutex_destroy(&pending_delta->mutex);
+        free(pending_delta);
+    }
+
     /* Reset all fields */
     *pm = (const pm_interface_t) {};
 }
 
+/* Set the time in nanoseconds during which the CPUs to enable notified through
+ * update_mask_delta may be deferred and merged, 0 to disable */
+void pm_set_mask_delta_window(pm_interface_t *pm, int64_t window) {
+    if (pm->pending_delta == NULL) {
+        if (window <= 0) return;
+        pending_delta_t *pending_delta = malloc(sizeof(pending_delta_t));
+        fatal_cond(!pending_delta, "Could not allocate the callback window");
+        *pending_delta = (const pending_delta_t) { .pm = pm };
+        pthread_mutex_init(&pending_delta->mutex, NULL);
+        pthread_condattr_t cond_attr;
+        pthread_condattr_init(&cond_attr);
+        pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&pending_delta->cond, &cond_attr);
+        pthread_condattr_destroy(&cond_attr);
+        fatal_cond_strerror( pthread_create(&pending_delta->flusher, NULL,
+                    flusher_thread_start, pending_delta) );
+        pm->pending_delta = pending_delta;
+    }
+
+    /* Changing the window notifies the pending CPUs */
+    flush_mask_delta(pm);
+    pthread_mutex_lock(&pm->pending_delta->mutex);
+    {
+        pm->pending_delta->window = window;
+        pm->pending_delta->deferral_deadline = 0;
+    }
+    pthread_mutex_unlock(&pm->pending_delta->mutex);
+}
+
 int pm_get_num_threads(void) {
     return omp_get_max_threads ? omp_get_max_threads() : 1;
 }
@@ -101,6 +212,11 @@ int pm_callback_set(pm_interface_t *pm, dlb_callbacks_t which,
             pm->dlb_callback_disable_cpu_set_ptr = (dlb_callback_disable_cpu_set_t)callback;
             pm->dlb_callback_disable_cpu_set_arg = arg;
             break;
+        case dlb_callback_update_active_mask_delta:
+            pm->dlb_callback_update_active_mask_delta_ptr =
+                (dlb_callback_update_active_mask_delta_t)callback;
+            pm->dlb_callback_update_active_mask_delta_arg = arg;
+            break;
         default:
             return DLB_ERR_NOCBK;
     }
@@ -146,6 +262,10 @@ int pm_callback_get(const pm_interface_t *pm, dlb_callbacks_t which,
             *callback = (dlb_callback_t)pm->dlb_callback_disable_cpu_set_ptr;
             *arg = pm->dlb_callback_disable_cpu_set_arg;
             break;
+        case dlb_callback_update_active_mask_delta:
+            *callback = (dlb_callback_t)pm->dlb_callback_update_active_mask_delta_ptr;
+            *arg = pm->dlb_callback_update_active_mask_delta_arg;
+            break;
         default:
             return DLB_ERR_NOCBK;
     }
@@ -173,10 +293,19 @@ int update_threads(const pm_interface_t *pm, int threads) {
     return DLB_SUCCESS;
 }
 
+static void invoke_mask_delta(const pm_interface_t *pm,
+        const cpu_set_t *cpus_to_enable, const cpu_set_t *cpus_to_disable) {
+    instrument_event(CALLBACK_EVENT, 1, EVENT_BEGIN);
+    pm->dlb_callback_update_active_mask_delta_ptr(cpus_to_enable, cpus_to_disable,
+            pm->dlb_callback_update_active_mask_delta_arg);
+    instrument_event(CALLBACK_EVENT, 0, EVENT_END);
+}
+
 int set_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
     if (pm->dlb_callback_set_active_mask_ptr == NULL) {
         return DLB_ERR_NOCBK;
     }
+    flush_mask_delta(pm);
     instrument_event(CALLBACK_EVENT, 1, EVENT_BEGIN);
     pm->dlb_callback_set_active_mask_ptr(cpu_set, pm->dlb_callback_set_active_mask_arg);
     instrument_event(CALLBACK_EVENT, 0, EVENT_END);
@@ -187,6 +316,7 @@ int set_process_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
     if (pm->dlb_callback_set_process_mask_ptr == NULL) {
         return DLB_ERR_NOCBK;
     }
+    flush_mask_delta(pm);
     instrument_event(CALLBACK_EVENT, 1, EVENT_BEGIN);
     pm->dlb_callback_set_process_mask_ptr(cpu_set, pm->dlb_callback_set_process_mask_arg);
     instrument_event(CALLBACK_EVENT, 0, EVENT_END);
@@ -194,7 +324,15 @@ int set_process_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
 }
 
 int add_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
+    flush_mask_delta(pm);
     if (pm->dlb_callback_add_active_mask_ptr == NULL) {
+        if (pm->dlb_callback_update_active_mask_delta_ptr != NULL) {
+            /* fallback to update_active_mask_delta */
+            cpu_set_t empty_set;
+            CPU_ZERO(&empty_set);
+            invoke_mask_delta(pm, cpu_set, &empty_set);
+            return DLB_SUCCESS;
+        }
         if (pm->dlb_callback_enable_cpu_ptr != NULL) {
             /* fallback to enable_cpu */
             for (int cpuid = mu_get_first_cpu(cpu_set);
@@ -218,6 +356,7 @@ int add_process_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
     if (pm->dlb_callback_add_process_mask_ptr == NULL) {
         return DLB_ERR_NOCBK;
     }
+    flush_mask_delta(pm);
     instrument_event(CALLBACK_EVENT, 1, EVENT_BEGIN);
     pm->dlb_callback_add_process_mask_ptr(cpu_set, pm->dlb_callback_add_process_mask_arg);
     instrument_event(CALLBACK_EVENT, 0, EVENT_END);
@@ -227,7 +366,8 @@ int add_process_mask(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
 int enable_cpu(const pm_interface_t *pm, int cpuid) {
     /* fallback case */
     if (pm->dlb_callback_enable_cpu_ptr == NULL
-            && pm->dlb_callback_add_active_mask_ptr) {
+            && (pm->dlb_callback_add_active_mask_ptr
+                || pm->dlb_callback_update_active_mask_delta_ptr)) {
         cpu_set_t cpu_set;
         CPU_ZERO(&cpu_set);
         CPU_SET(cpuid, &cpu_set);
@@ -237,6 +377,7 @@ int enable_cpu(const pm_interface_t *pm, int cpuid) {
     if (pm->dlb_callback_enable_cpu_ptr == NULL) {
         return DLB_ERR_NOCBK;
     }
+    flush_mask_delta(pm);
     instrument_event(CALLBACK_EVENT, 1, EVENT_BEGIN);
     pm->dlb_callback_enable_cpu_ptr(cpuid, pm->dlb_callback_enable_cpu_arg);
     instrument_event(CALLBACK_EVENT, 0, EVENT_END);
@@ -244,7 +385,15 @@ int enable_cpu(const pm_interface_t *pm, int cpuid) {
 }
 
 int enable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
+    flush_mask_delta(pm);
     if (pm->dlb_callback_enable_cpu_set_ptr == NULL) {
+        if (pm->dlb_callback_update_active_mask_delta_ptr != NULL) {
+            /* fallback to update_active_mask_delta */
+            cpu_set_t empty_set;
+            CPU_ZERO(&empty_set);
+            invoke_mask_delta(pm, cpu_set, &empty_set);
+            return DLB_SUCCESS;
+        }
         if (pm->dlb_callback_enable_cpu_ptr != NULL) {
             /* fallback to enable_cpu */
             for (int cpuid = mu_get_first_cpu(cpu_set);
@@ -266,6 +415,13 @@ int enable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
 
 int disable_cpu(const pm_interface_t *pm, int cpuid) {
     /* fallback case */
+    if (pm->dlb_callback_disable_cpu_ptr == NULL
+            && pm->dlb_callback_update_active_mask_delta_ptr) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpuid, &cpu_set);
+        return disable_cpu_set(pm, &cpu_set);
+    }
     if (pm->dlb_callback_disable_cpu_ptr == NULL
             && pm->dlb_callback_set_active_mask_ptr) {
         cpu_set_t cpu_set;
@@ -277,6 +433,7 @@ int disable_cpu(const pm_interface_t *pm, int cpuid) {
     if (pm->dlb_callback_disable_cpu_ptr == NULL) {
         return DLB_ERR_NOCBK;
     }
+    flush_mask_delta(pm);
     instrument_event(CALLBACK_EVENT, 1, EVENT_BEGIN);
     pm->dlb_callback_disable_cpu_ptr(cpuid, pm->dlb_callback_disable_cpu_arg);
     instrument_event(CALLBACK_EVENT, 0, EVENT_END);
@@ -284,7 +441,15 @@ int disable_cpu(const pm_interface_t *pm, int cpuid) {
 }
 
 int disable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
+    flush_mask_delta(pm);
     if (pm->dlb_callback_disable_cpu_set_ptr == NULL) {
+        if (pm->dlb_callback_update_active_mask_delta_ptr != NULL) {
+            /* fallback to update_active_mask_delta */
+            cpu_set_t empty_set;
+            CPU_ZERO(&empty_set);
+            invoke_mask_delta(pm, &empty_set, cpu_set);
+            return DLB_SUCCESS;
+        }
         if (pm->dlb_callback_disable_cpu_ptr != NULL) {
             /* fallback to disable_cpu */
             for (int cpuid = mu_get_first_cpu(cpu_set);
@@ -303,3 +468,97 @@ int disable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set) {
     instrument_event(CALLBACK_EVENT, 0, EVENT_END);
     return DLB_SUCCESS;
 }
+
+static int notify_mask_delta(const pm_interface_t *pm,
+        const cpu_set_t *cpus_to_enable, const cpu_set_t *cpus_to_disable) {
+    bool enable = CPU_COUNT(cpus_to_enable) > 0;
+    bool disable = CPU_COUNT(cpus_to_disable) > 0;
+    if (!enable && !disable) {
+        return DLB_SUCCESS;
+    }
+    if (pm->dlb_callback_update_active_mask_delta_ptr != NULL) {
+        invoke_mask_delta(pm, cpus_to_enable, cpus_to_disable);
+        return DLB_SUCCESS;
+    }
+    int error_enable = enable ? enable_cpu_set(pm, cpus_to_enable) : DLB_SUCCESS;
+    int error_disable = disable ? disable_cpu_set(pm, cpus_to_disable) : DLB_SUCCESS;
+    return error_enable != DLB_SUCCESS ? error_enable : error_disable;
+}
+
+/* Notify the CPUs to enable and disable in the active mask with a single
+ * callback if update_active_mask_delta is defined, or fall back to the
+ * enable and disable callbacks otherwise.
+ *
+ * If the interface has a callback window and defer_enable is set, CPUs to
+ * enable notified less than that time after the previous notification are
+ * deferred and merged into the next one, or notified by the flusher thread
+ * when the window expires. Only the caller knows whether the
+ * process can wait for them, e.g., borrowed CPUs but not reclaimed or
+ * acquired ones. CPUs to disable are never deferred since they are usually
+ * needed by another process, but they carry any pending CPUs to enable in
+ * the same callback. */
+int update_mask_delta(const pm_interface_t *pm, const cpu_set_t *cpus_to_enable,
+        const cpu_set_t *cpus_to_disable, bool defer_enable) {
+
+    pending_delta_t *pending_delta = pm->pending_delta;
+    if (pending_delta == NULL) {
+        return notify_mask_delta(pm, cpus_to_enable, cpus_to_disable);
+    }
+
+    cpu_set_t enable_set;
+    cpu_set_t disable_set;
+    CPU_ZERO(&disable_set);
+    pthread_mutex_lock(&pending_delta->mutex);
+    {
+        /* Merge with the pending CPUs to enable. A pending CPU that is now
+         * disabled was never notified, so it is removed from both sets */
+        CPU_OR(&pending_delta->cpus_to_enable, &pending_delta->cpus_to_enable,
+                cpus_to_enable);
+        mu_substract(&disable_set, cpus_to_disable, &pending_delta->cpus_to_enable);
+        mu_substract(&pending_delta->cpus_to_enable, &pending_delta->cpus_to_enable,
+                cpus_to_disable);
+
+        int64_t now = get_time_in_ns();
+        if (defer_enable
+                && CPU_COUNT(&disable_set) == 0
+                && now < pending_delta->deferral_deadline) {
+            bool was_pending = pending_delta->pending;
+            pending_delta->pending = CPU_COUNT(&pending_delta->cpus_to_enable) > 0;
+            if (pending_delta->pending && !was_pending) {
+                /* Wake up the flusher thread to wait for the deadline */
+                pthread_cond_signal(&pending_delta->cond);
+            }
+            pthread_mutex_unlock(&pending_delta->mutex);
+            return DLB_SUCCESS;
+        }
+
+        /* Notify all changes */
+        take_pending_delta(pending_delta, &enable_set, now);
+    }
+    pthread_mutex_unlock(&pending_delta->mutex);
+
+    return notify_mask_delta(pm, &enable_set, &disable_set);
+}
+
+/* Notify the deferred CPUs to enable, if any */
+int flush_mask_delta(const pm_interface_t *pm) {
+    pending_delta_t *pending_delta = pm->pending_delta;
+    if (pending_delta == NULL) {
+        return DLB_SUCCESS;
+    }
+
+    cpu_set_t enable_set;
+    pthread_mutex_lock(&pending_delta->mutex);
+    {
+        if (!pending_delta->pending) {
+            pthread_mutex_unlock(&pending_delta->mutex);
+            return DLB_SUCCESS;
+        }
+        take_pending_delta(pending_delta, &enable_set, get_time_in_ns());
+    }
+    pthread_mutex_unlock(&pending_delta->mutex);
+
+    cpu_set_t empty_set;
+    CPU_ZERO(&empty_set);
+    return notify_mask_delta(pm, &enable_set, &empty_set);
+}
@@ -24,6 +24,7 @@
 
 #include <sched.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct pm_interface {
     /* Callbacks list */
@@ -45,10 +46,15 @@ typedef struct pm_interface {
     void                            *dlb_callback_enable_cpu_set_arg;
     dlb_callback_disable_cpu_set_t   dlb_callback_disable_cpu_set_ptr;
     void                            *dlb_callback_disable_cpu_set_arg;
+    dlb_callback_update_active_mask_delta_t dlb_callback_update_active_mask_delta_ptr;
+    void                            *dlb_callback_update_active_mask_delta_arg;
+    /* Enabled CPUs deferred by update_mask_delta, NULL if no callback window */
+    struct PendingDelta             *pending_delta;
 } pm_interface_t;
 
 void pm_init(pm_interface_t *pm);
 void pm_finalize(pm_interface_t *pm);
+void pm_set_mask_delta_window(pm_interface_t *pm, int64_t window);
 int pm_get_num_threads(void);
 int pm_callback_set(pm_interface_t *pm, dlb_callbacks_t which,
         dlb_callback_t callback, void *arg);
@@ -64,5 +70,8 @@ int enable_cpu(const pm_interface_t *pm, int cpuid);
 int disable_cpu(const pm_interface_t *pm, int cpuid);
 int enable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set);
 int disable_cpu_set(const pm_interface_t *pm, const cpu_set_t *cpu_set);
+int update_mask_delta(const pm_interface_t *pm, const cpu_set_t *cpus_to_enable,
+        const cpu_set_t *cpus_to_disable, bool defer_enable);
+int flush_mask_delta(const pm_interface_t *pm);
 
 #endif //NUMTHREADS_H
@@ -57,7 +57,7 @@ int lewi_Init(subprocess_descriptor_t *spd) {
     }
 
     //Initialize shared memory
-    ConfigShMem(default_cpus, greedy, spd->options.shm_key);
+    ConfigShMem(default_cpus, greedy, &spd->process_mask, spd->options.shm_key);
 
     if (spd->options.lewi_warmup) {
         setThreads_Lend_light(&spd->pm, mu_get_system_size());
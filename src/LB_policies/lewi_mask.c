@@ -22,10 +22,12 @@
 #include "LB_core/spd.h"
 #include "LB_comm/shmem_cpuinfo.h"
 #include "LB_comm/shmem_async.h"
+#include "LB_policies/lewi_shrink.h"
 #include "apis/dlb_errors.h"
 #include "support/debug.h"
 #include "support/gslist.h"
 #include "support/mask_utils.h"
+#include "support/mytime.h"
 #include "support/small_array.h"
 #include "support/types.h"
 
@@ -48,6 +50,13 @@
  * it is safe to be out of the shared memory */
 static int node_size = -1;
 
+/* CPUs of an asynchronous request not obtained immediately */
+typedef struct LeWI_mask_ticket {
+    dlb_ticket_t id;
+    int request_slot;                       /* shmem slot of the enqueued request, or -1 */
+    cpu_set_t reclaimed_cpus;               /* reclaimed CPUs still guested by others */
+} lewi_ticket_t;
+
 /* LeWI_mask data is private for each process */
 typedef struct LeWI_mask_info {
     int64_t last_borrow;
@@ -57,7 +66,13 @@ typedef struct LeWI_mask_info {
     cpu_set_t in_mpi_cpus;                  /* CPUs inside an MPI call */
     GSList *cpuid_arrays;                   /* thread-private pointers to free at finalize */
     GSList *cpuinfo_task_arrays;            /* thread-private pointers to free at finalize */
+    lewi_shrink_t shrink;                   /* Only if --lewi-shrink */
     pthread_mutex_t mutex;                  /* Mutex to protect lewi_info */
+    lewi_ticket_t *tickets;                 /* outstanding tickets, in request order */
+    unsigned int num_tickets;
+    unsigned int max_tickets;
+    dlb_ticket_t last_ticket;
+    pthread_mutex_t tickets_mutex;          /* Mutex to protect the tickets */
 } lewi_info_t;
 
 
@@ -200,8 +215,11 @@ static inline array_cpuinfo_task_t* get_tasks(const subprocess_descriptor_t *spd
 /*    Resolve cpuinfo tasks                                                      */
 /*********************************************************************************/
 
-static void resolve_cpuinfo_tasks(const subprocess_descriptor_t *restrict spd,
-        array_cpuinfo_task_t *restrict tasks) {
+/* CPUs to enable for this process may be deferred within the callback window
+ * only if defer_enable is set, i.e., only CPUs that the process borrows on its
+ * own initiative. Reclaimed or acquired CPUs are always notified immediately */
+static void resolve_cpuinfo_tasks_deferrable(const subprocess_descriptor_t *restrict spd,
+        array_cpuinfo_task_t *restrict tasks, bool defer_enable) {
 
     size_t tasks_count = tasks->count;
 
@@ -226,11 +244,14 @@ static void resolve_cpuinfo_tasks(const subprocess_descriptor_t *restrict spd,
             /* resolve single task */
             const cpuinfo_task_t *task = &tasks->items[i];
             if (task->pid == spd->id) {
+                cpu_set_t cpu_set = {};
+                cpu_set_t empty_set = {};
+                CPU_SET(task->cpuid, &cpu_set);
                 if (task->action == ENABLE_CPU) {
-                    enable_cpu(&spd->pm, task->cpuid);
+                    update_mask_delta(&spd->pm, &cpu_set, &empty_set, defer_enable);
                 }
                 else if (task->action == DISABLE_CPU) {
-                    disable_cpu(&spd->pm, task->cpuid);
+                    update_mask_delta(&spd->pm, &empty_set, &cpu_set, defer_enable);
                 }
             }
             else if (spd->options.mode == MODE_ASYNC) {
@@ -259,12 +280,9 @@ static void resolve_cpuinfo_tasks(const subprocess_descriptor_t *restrict spd,
             /* resolve group of tasks for the same PID */
             const cpuinfo_task_t *task = &tasks->items[i];
             if (task->pid == spd->id) {
-                if (CPU_COUNT(&cpus_to_enable) > 0) {
-                    enable_cpu_set(&spd->pm, &cpus_to_enable);
-                }
-                if (CPU_COUNT(&cpus_to_disable) > 0) {
-                    disable_cpu_set(&spd->pm, &cpus_to_disable);
-                }
+                /* enable and disable in a single callback, if possible */
+                update_mask_delta(&spd->pm, &cpus_to_enable, &cpus_to_disable,
+                        defer_enable);
             }
             else if (spd->options.mode == MODE_ASYNC) {
                 if (CPU_COUNT(&cpus_to_enable) > 0) {
@@ -281,6 +299,221 @@ static void resolve_cpuinfo_tasks(const subprocess_descriptor_t *restrict spd,
     }
 }
 
+static inline void resolve_cpuinfo_tasks(const subprocess_descriptor_t *restrict spd,
+        array_cpuinfo_task_t *restrict tasks) {
+    resolve_cpuinfo_tasks_deferrable(spd, tasks, false);
+}
+
+static inline void resolve_borrowed_cpuinfo_tasks(const subprocess_descriptor_t *restrict spd,
+        array_cpuinfo_task_t *restrict tasks) {
+    resolve_cpuinfo_tasks_deferrable(spd, tasks, true);
+}
+
+
+/*********************************************************************************/
+/*    Tickets                                                                    */
+/*********************************************************************************/
+
+/* A ticket tracks the CPUs of an asynchronous Acquire or Reclaim that could not
+ * be obtained immediately, either because they were enqueued as a request or
+ * because they were reclaimed but are still guested by another process.
+ *
+ * Enqueued CPUs are kept in their own request in the shared memory, never
+ * merged with other requests, whose remaining CPUs are published in a slot
+ * that the serving process updates atomically, so testing a ticket does not
+ * need the shmem lock. Reclaimed CPUs are tracked by identity, taken from the
+ * tasks of the request itself, until they are guested by the process again.
+ * Reclaimed CPUs that the process lends again are no longer waited for. */
+
+static int find_ticket(const lewi_info_t *lewi_info, dlb_ticket_t ticket) {
+    for (unsigned int i = 0; i < lewi_info->num_tickets; ++i) {
+        if (lewi_info->tickets[i].id == ticket) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void delete_ticket(lewi_info_t *lewi_info, unsigned int index) {
+    memmove(&lewi_info->tickets[index], &lewi_info->tickets[index+1],
+            sizeof(lewi_ticket_t) * (lewi_info->num_tickets - index - 1));
+    --lewi_info->num_tickets;
+}
+
+/* Remove the request of the ticket, if still enqueued, and release its slot */
+static void release_ticket_request(const subprocess_descriptor_t *spd,
+        lewi_ticket_t *ticket) {
+    if (ticket->request_slot >= 0) {
+        if (shmem_cpuinfo__get_ticket_ncpus(ticket->request_slot) > 0) {
+            shmem_cpuinfo__remove_ticket_request(spd->id, ticket->request_slot);
+        }
+        shmem_cpuinfo__release_ticket_slot(ticket->request_slot);
+        ticket->request_slot = -1;
+    }
+}
+
+/* Invalidate all tickets, e.g., when all requests are removed */
+static void clear_tickets(const subprocess_descriptor_t *spd) {
+    lewi_info_t *lewi_info = spd->lewi_info;
+    pthread_mutex_lock(&lewi_info->tickets_mutex);
+    {
+        for (unsigned int i = 0; i < lewi_info->num_tickets; ++i) {
+            release_ticket_request(spd, &lewi_info->tickets[i]);
+        }
+        lewi_info->num_tickets = 0;
+    }
+    pthread_mutex_unlock(&lewi_info->tickets_mutex);
+}
+
+/* Update the ticket with the progress of its CPUs, without locking the shmem,
+ * and return whether all of them have been obtained */
+static bool update_ticket(const subprocess_descriptor_t *spd, lewi_ticket_t *ticket) {
+    if (ticket->request_slot >= 0
+            && shmem_cpuinfo__get_ticket_ncpus(ticket->request_slot) == 0) {
+        shmem_cpuinfo__release_ticket_slot(ticket->request_slot);
+        ticket->request_slot = -1;
+    }
+    if (CPU_COUNT(&ticket->reclaimed_cpus) > 0) {
+        shmem_cpuinfo__get_reclaimed_cpus(spd->id, &ticket->reclaimed_cpus);
+    }
+    return ticket->request_slot < 0 && CPU_COUNT(&ticket->reclaimed_cpus) == 0;
+}
+
+/* The CPUs reclaimed by a request are those that other processes need to
+ * disable */
+static void add_reclaimed_cpus(const subprocess_descriptor_t *spd,
+        const array_cpuinfo_task_t *tasks, lewi_ticket_t *ticket) {
+    for (size_t i = 0; i < tasks->count; ++i) {
+        const cpuinfo_task_t *task = &tasks->items[i];
+        if (task->pid != spd->id && task->action == DISABLE_CPU) {
+            CPU_SET(task->cpuid, &ticket->reclaimed_cpus);
+        }
+    }
+}
+
+static int acquire_cpus_in_mask(const subprocess_descriptor_t *spd, int ncpus,
+        const cpu_set_t *mask, lewi_ticket_t *ticket);
+
+static int acquire_cpus_with_ticket(const subprocess_descriptor_t *spd, int ncpus,
+        lewi_ticket_t *ticket) {
+    return acquire_cpus_in_mask(spd, ncpus, NULL, ticket);
+}
+
+static int reclaim_cpus_with_ticket(const subprocess_descriptor_t *spd, int ncpus,
+        lewi_ticket_t *ticket) {
+    array_cpuinfo_task_t *tasks = get_tasks(spd);
+    int error = shmem_cpuinfo__reclaim_cpus(spd->id, ncpus, tasks);
+    if (error == DLB_SUCCESS || error == DLB_NOTED) {
+        add_reclaimed_cpus(spd, tasks, ticket);
+        resolve_cpuinfo_tasks(spd, tasks);
+    }
+    return error;
+}
+
+static int request_with_ticket(const subprocess_descriptor_t *spd, int ncpus,
+        dlb_ticket_t *ticket,
+        int (*request)(const subprocess_descriptor_t *spd, int ncpus,
+            lewi_ticket_t *ticket)) {
+
+    *ticket = DLB_TICKET_NULL;
+
+    /* Special values for removing requests are not allowed */
+    if (ncpus <= 0) {
+        return DLB_NOUPDT;
+    }
+
+    lewi_info_t *lewi_info = spd->lewi_info;
+    int error;
+    pthread_mutex_lock(&lewi_info->tickets_mutex);
+    {
+        lewi_ticket_t new_ticket = {
+            .id = lewi_info->last_ticket + 1,
+            .request_slot = -1,
+        };
+        error = request(spd, ncpus, &new_ticket);
+
+        /* Other processes may serve all CPUs meanwhile */
+        if (error == DLB_NOTED && !update_ticket(spd, &new_ticket)) {
+            if (lewi_info->num_tickets == lewi_info->max_tickets) {
+                lewi_info->max_tickets = lewi_info->max_tickets > 0
+                    ? lewi_info->max_tickets * 2 : 16;
+                lewi_info->tickets = realloc(lewi_info->tickets,
+                        sizeof(lewi_ticket_t) * lewi_info->max_tickets);
+                fatal_cond(!lewi_info->tickets, "Could not allocate LeWI tickets");
+            }
+            lewi_info->tickets[lewi_info->num_tickets++] = new_ticket;
+            lewi_info->last_ticket = new_ticket.id;
+            *ticket = new_ticket.id;
+        } else {
+            release_ticket_request(spd, &new_ticket);
+        }
+    }
+    pthread_mutex_unlock(&lewi_info->tickets_mutex);
+
+    return error;
+}
+
+int lewi_mask_AcquireCpusAsync(const subprocess_descriptor_t *spd, int ncpus,
+        dlb_ticket_t *ticket) {
+    return request_with_ticket(spd, ncpus, ticket, acquire_cpus_with_ticket);
+}
+
+int lewi_mask_ReclaimCpusAsync(const subprocess_descriptor_t *spd, int ncpus,
+        dlb_ticket_t *ticket) {
+    return request_with_ticket(spd, ncpus, ticket, reclaim_cpus_with_ticket);
+}
+
+/* Return DLB_SUCCESS if the ticket is fulfilled, which also releases it,
+ * or DLB_NOTED if some CPUs are still pending */
+int lewi_mask_TestTicket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket) {
+    if (ticket == DLB_TICKET_NULL) {
+        return DLB_SUCCESS;
+    }
+
+    lewi_info_t *lewi_info = spd->lewi_info;
+    int error;
+    pthread_mutex_lock(&lewi_info->tickets_mutex);
+    {
+        int index = find_ticket(lewi_info, ticket);
+        if (index < 0) {
+            error = DLB_ERR_NOENT;
+        } else if (update_ticket(spd, &lewi_info->tickets[index])) {
+            delete_ticket(lewi_info, index);
+            error = DLB_SUCCESS;
+        } else {
+            error = DLB_NOTED;
+        }
+    }
+    pthread_mutex_unlock(&lewi_info->tickets_mutex);
+
+    return error;
+}
+
+/* Remove the CPUs still requested by the ticket and release it. Reclaimed
+ * CPUs cannot be cancelled, they are returned to the process anyway */
+int lewi_mask_CancelTicket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket) {
+    if (ticket == DLB_TICKET_NULL) {
+        return DLB_SUCCESS;
+    }
+
+    lewi_info_t *lewi_info = spd->lewi_info;
+    int error;
+    pthread_mutex_lock(&lewi_info->tickets_mutex);
+    {
+        int index = find_ticket(lewi_info, ticket);
+        if (index < 0) {
+            error = DLB_ERR_NOENT;
+        } else {
+            release_ticket_request(spd, &lewi_info->tickets[index]);
+            delete_ticket(lewi_info, index);
+            error = DLB_SUCCESS;
+        }
+    }
+    pthread_mutex_unlock(&lewi_info->tickets_mutex);
+
+    return error;
+}
+
 
 /*********************************************************************************/
 /*    Init / Finalize                                                            */
@@ -296,9 +529,22 @@ int lewi_mask_Init(subprocess_descriptor_t *spd) {
     *lewi_info = (const lewi_info_t) {
         .max_parallelism = spd->options.lewi_max_parallelism,
         .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .tickets_mutex = PTHREAD_MUTEX_INITIALIZER,
     };
     array_cpuid_t_init(&lewi_info->cpus_priority_array, node_size);
     lewi_mask_UpdateOwnershipInfo(spd, &spd->process_mask);
+    shmem_cpuinfo__set_max_parallelism(spd->id, lewi_info->max_parallelism);
+
+    /* Merge the borrowed CPUs notified within the callback window */
+    if (spd->options.lewi_callback_window > 0) {
+        pm_set_mask_delta_window(&spd->pm,
+                (int64_t)spd->options.lewi_callback_window * 1000);
+    }
+
+    if (spd->options.lewi_shrink) {
+        lewi_shrink_init(&lewi_info->shrink, CPU_COUNT(&spd->process_mask),
+                get_time_in_ns());
+    }
 
     /* Enable request queues only in async mode */
     if (spd->options.mode == MODE_ASYNC) {
@@ -309,6 +555,8 @@ int lewi_mask_Init(subprocess_descriptor_t *spd) {
 }
 
 int lewi_mask_Finalize(subprocess_descriptor_t *spd) {
+    flush_mask_delta(&spd->pm);
+
     /* De-register subprocess from the shared memory */
     array_cpuinfo_task_t *tasks = get_tasks(spd);
     int error = shmem_cpuinfo__deregister(spd->id, tasks);
@@ -341,6 +589,7 @@ int lewi_mask_Finalize(subprocess_descriptor_t *spd) {
 
     /* Deallocate private structure */
     array_cpuid_t_destroy(&lewi_info->cpus_priority_array);
+    free(lewi_info->tickets);
     free(lewi_info);
     lewi_info = NULL;
 
@@ -359,6 +608,11 @@ int lewi_mask_EnableDLB(const subprocess_descriptor_t *spd) {
 }
 
 int lewi_mask_DisableDLB(const subprocess_descriptor_t *spd) {
+    flush_mask_delta(&spd->pm);
+
+    /* Resetting removes all requests */
+    clear_tickets(spd);
+
     array_cpuinfo_task_t *tasks = get_tasks(spd);
     int error = shmem_cpuinfo__reset(spd->id, tasks);
     if (error == DLB_SUCCESS) {
@@ -377,6 +631,7 @@ int lewi_mask_SetMaxParallelism(const subprocess_descriptor_t *spd, int max) {
         if (error == DLB_SUCCESS) {
             resolve_cpuinfo_tasks(spd, tasks);
         }
+        shmem_cpuinfo__set_max_parallelism(spd->id, max);
     }
     return error;
 }
@@ -384,6 +639,7 @@ int lewi_mask_SetMaxParallelism(const subprocess_descriptor_t *spd, int max) {
 int lewi_mask_UnsetMaxParallelism(const subprocess_descriptor_t *spd) {
     lewi_info_t *lewi_info = spd->lewi_info;
     lewi_info->max_parallelism = 0;
+    shmem_cpuinfo__set_max_parallelism(spd->id, 0);
     return DLB_SUCCESS;
 }
 
@@ -407,23 +663,67 @@ static inline void get_mask_for_blocking_call(
     }
 }
 
-/* Lend the CPUs of the thread encountering the blocking call */
-int lewi_mask_IntoBlockingCall(const subprocess_descriptor_t *spd) {
-    int error = DLB_NOUPDT;
+/* End of a computation interval for --lewi-shrink */
+static void shrink_into_blocking_call(const subprocess_descriptor_t *spd) {
+    if (spd->options.lewi_shrink) {
+        lewi_info_t *lewi_info = spd->lewi_info;
+        int num_cpus = shmem_cpuinfo__get_number_of_bindings(spd->id);
+        pthread_mutex_lock(&lewi_info->mutex);
+        {
+            lewi_shrink_into_blocking_call(&lewi_info->shrink, num_cpus,
+                    get_time_in_ns());
+        }
+        pthread_mutex_unlock(&lewi_info->mutex);
+    }
+}
+
+/* Start of a computation interval for --lewi-shrink */
+static void shrink_out_of_blocking_call(const subprocess_descriptor_t *spd) {
+    if (spd->options.lewi_shrink) {
+        lewi_info_t *lewi_info = spd->lewi_info;
+        pthread_mutex_lock(&lewi_info->mutex);
+        {
+            lewi_shrink_out_of_blocking_call(&lewi_info->shrink, get_time_in_ns());
+        }
+        pthread_mutex_unlock(&lewi_info->mutex);
+    }
+}
+
+/* Obtain the CPUs of the thread encountering the blocking call, to be lent.
+ * Return whether there is any CPU to lend */
+static bool get_cpus_into_blocking_call(const subprocess_descriptor_t *spd,
+        cpu_set_t *cpu_set) {
+
+    shrink_into_blocking_call(spd);
+
+    /* Do not keep deferred CPUs while the thread is blocked */
+    flush_mask_delta(&spd->pm);
 
     /* Obtain affinity mask to lend */
-    cpu_set_t cpu_set;
-    get_mask_for_blocking_call(&cpu_set,
+    get_mask_for_blocking_call(cpu_set,
             spd->options.lewi_keep_cpu_on_blocking_call);
 
-    if (mu_count(&cpu_set) > 0) {
+    if (mu_count(cpu_set) == 0) {
+        return false;
+    }
+
 #ifdef DEBUG_VERSION
-        /* Add cpu_set to in_mpi_cpus */
-        lewi_info_t *lewi_info = spd->lewi_info;
-        fatal_cond(mu_intersects(&lewi_info->in_mpi_cpus, &cpu_set),
-                    "Some CPU in %s already into blocking call", mu_to_str(&cpu_set));
-        mu_or(&lewi_info->in_mpi_cpus, &lewi_info->in_mpi_cpus, &cpu_set);
+    /* Add cpu_set to in_mpi_cpus */
+    lewi_info_t *lewi_info = spd->lewi_info;
+    fatal_cond(mu_intersects(&lewi_info->in_mpi_cpus, cpu_set),
+                "Some CPU in %s already into blocking call", mu_to_str(cpu_set));
+    mu_or(&lewi_info->in_mpi_cpus, &lewi_info->in_mpi_cpus, cpu_set);
 #endif
+
+    return true;
+}
+
+/* Lend the CPUs of the thread encountering the blocking call */
+int lewi_mask_IntoBlockingCall(const subprocess_descriptor_t *spd) {
+    int error = DLB_NOUPDT;
+
+    cpu_set_t cpu_set;
+    if (get_cpus_into_blocking_call(spd, &cpu_set)) {
         verbose(VB_MICROLB, "In blocking call, lending %s", mu_to_str(&cpu_set));
 
         /* Finally, lend mask */
@@ -432,11 +732,45 @@ int lewi_mask_IntoBlockingCall(const subprocess_descriptor_t *spd) {
     return error;
 }
 
+/* Same as IntoBlockingCall, but hand off the lent CPUs to the processes in
+ * 'recipients' if they are still idle after lending them. */
+int lewi_mask_IntoBlockingCallHandoff(const subprocess_descriptor_t *spd,
+        const pid_t *recipients, unsigned int nrecipients) {
+
+    /* CPUs handed off to another process can only be reverted in async mode */
+    if (nrecipients == 0 || spd->options.mode != MODE_ASYNC) {
+        return lewi_mask_IntoBlockingCall(spd);
+    }
+
+    int error = DLB_NOUPDT;
+
+    cpu_set_t cpu_set;
+    if (get_cpus_into_blocking_call(spd, &cpu_set)) {
+        verbose(VB_MICROLB, "In blocking call, handing off %s to %u processes",
+                mu_to_str(&cpu_set), nrecipients);
+
+        array_cpuinfo_task_t *tasks = get_tasks(spd);
+        error = shmem_cpuinfo__lend_cpu_mask_to(spd->id, &cpu_set,
+                recipients, nrecipients, tasks);
+        if (error == DLB_SUCCESS) {
+            resolve_cpuinfo_tasks(spd, tasks);
+
+            /* Clear possible pending reclaimed CPUs */
+            lewi_info_t *lewi_info = spd->lewi_info;
+            mu_substract(&lewi_info->pending_reclaimed_cpus,
+                    &lewi_info->pending_reclaimed_cpus, &cpu_set);
+        }
+    }
+    return error;
+}
+
 /* Reclaim the CPUs that were lent when encountering the blocking call.
  * The thread must have not change its affinity mask since then. */
 int lewi_mask_OutOfBlockingCall(const subprocess_descriptor_t *spd) {
     int error = DLB_NOUPDT;
 
+    shrink_out_of_blocking_call(spd);
+
     /* Obtain affinity mask to reclaim */
     cpu_set_t cpu_set;
     get_mask_for_blocking_call(&cpu_set,
@@ -521,6 +855,52 @@ int lewi_mask_OutOfBlockingCall(const subprocess_descriptor_t *spd) {
 }
 
 
+/*********************************************************************************/
+/*    Iterations                                                                 */
+/*********************************************************************************/
+
+/* With --lewi-shrink, update the maximum parallelism at the end of each
+ * iteration, lending the CPUs that do not shorten it, or reclaiming the last
+ * released CPU if the iteration has become slower */
+int lewi_mask_NewIteration(const subprocess_descriptor_t *spd, bool new_loop) {
+    if (!spd->options.lewi_shrink) return DLB_NOUPDT;
+
+    lewi_info_t *lewi_info = spd->lewi_info;
+    int num_cpus = shmem_cpuinfo__get_number_of_bindings(spd->id);
+    int old_max, new_max, initial_cpus;
+    pthread_mutex_lock(&lewi_info->mutex);
+    {
+        old_max = lewi_info->shrink.max_cpus;
+        new_max = lewi_shrink_new_iteration(&lewi_info->shrink, num_cpus,
+                new_loop, get_time_in_ns());
+        initial_cpus = lewi_info->shrink.initial_cpus;
+    }
+    pthread_mutex_unlock(&lewi_info->mutex);
+
+    if (new_max == old_max) return DLB_NOUPDT;
+
+    verbose(VB_MICROLB, "LeWI shrink: updating max parallelism from %d to %d",
+            old_max, new_max);
+
+    /* A smaller --lewi-max-parallelism is always respected */
+    int error;
+    int user_max = spd->options.lewi_max_parallelism;
+    if (user_max > 0 && user_max <= new_max) {
+        error = lewi_mask_SetMaxParallelism(spd, user_max);
+    } else if (new_max < initial_cpus) {
+        error = lewi_mask_SetMaxParallelism(spd, new_max);
+    } else {
+        error = lewi_mask_UnsetMaxParallelism(spd);
+    }
+
+    if (error == DLB_SUCCESS && new_max > old_max) {
+        lewi_mask_ReclaimCpus(spd, new_max - old_max);
+    }
+
+    return error;
+}
+
+
 /*********************************************************************************/
 /*    Lend                                                                       */
 /*********************************************************************************/
@@ -618,6 +998,7 @@ int lewi_mask_AcquireCpus(const subprocess_descriptor_t *spd, int ncpus) {
     if (ncpus == 0) {
         /* AcquireCPUs(0) has a special meaning of removing any previous request */
         shmem_cpuinfo__remove_requests(spd->id);
+        clear_tickets(spd);
         error = DLB_SUCCESS;
     } else if (ncpus > 0) {
         error = lewi_mask_AcquireCpusInMask(spd, ncpus, NULL);
@@ -631,6 +1012,12 @@ int lewi_mask_AcquireCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t
 
 int lewi_mask_AcquireCpusInMask(const subprocess_descriptor_t *spd, int ncpus,
         const cpu_set_t *mask) {
+    return acquire_cpus_in_mask(spd, ncpus, mask, NULL);
+}
+
+/* Remaining CPUs are enqueued in a request of the ticket, if not NULL */
+static int acquire_cpus_in_mask(const subprocess_descriptor_t *spd, int ncpus,
+        const cpu_set_t *mask, lewi_ticket_t *ticket) {
     lewi_info_t *lewi_info = spd->lewi_info;
     bool async = spd->options.mode == MODE_ASYNC;
     int64_t *last_borrow = async ? NULL : &lewi_info->last_borrow;
@@ -643,9 +1030,18 @@ int lewi_mask_AcquireCpusInMask(const subprocess_descriptor_t *spd, int ncpus,
     int *requested_ncpus = ncpus > 0 ? &ncpus : NULL;
 
     array_cpuinfo_task_t *tasks = get_tasks(spd);
-    int error = shmem_cpuinfo__acquire_ncpus_from_cpu_subset(spd->id,
-            requested_ncpus, cpu_subset, spd->options.lewi_affinity,
-            lewi_info->max_parallelism, last_borrow, tasks);
+    int error;
+    if (ticket == NULL) {
+        error = shmem_cpuinfo__acquire_ncpus_from_cpu_subset(spd->id,
+                requested_ncpus, cpu_subset, spd->options.lewi_affinity,
+                lewi_info->max_parallelism, last_borrow, tasks);
+    } else {
+        error = shmem_cpuinfo__acquire_ncpus_with_ticket(spd->id,
+                &ticket->request_slot, requested_ncpus, cpu_subset,
+                spd->options.lewi_affinity, lewi_info->max_parallelism,
+                last_borrow, tasks);
+        add_reclaimed_cpus(spd, tasks, ticket);
+    }
 
     if (error != DLB_NOUPDT) {
         resolve_cpuinfo_tasks(spd, tasks);
@@ -668,7 +1064,7 @@ int lewi_mask_BorrowCpu(const subprocess_descriptor_t *spd, int cpuid) {
     array_cpuinfo_task_t *tasks = get_tasks(spd);
     int error = shmem_cpuinfo__borrow_cpu(spd->id, cpuid, tasks);
     if (error == DLB_SUCCESS) {
-        resolve_cpuinfo_tasks(spd, tasks);
+        resolve_borrowed_cpuinfo_tasks(spd, tasks);
     }
     return error;
 }
@@ -699,7 +1095,7 @@ int lewi_mask_BorrowCpusInMask(const subprocess_descriptor_t *spd, int ncpus, co
             lewi_info->max_parallelism, last_borrow, tasks);
 
     if (error == DLB_SUCCESS) {
-        resolve_cpuinfo_tasks(spd, tasks);
+        resolve_borrowed_cpuinfo_tasks(spd, tasks);
     }
 
     return error;
@@ -793,6 +1189,8 @@ int lewi_mask_CheckCpuAvailability(const subprocess_descriptor_t *spd, int cpuid
 
 int lewi_mask_UpdateOwnership(const subprocess_descriptor_t *spd,
         const cpu_set_t *process_mask) {
+    lewi_info_t *lewi_info = spd->lewi_info;
+
     /* Update priority array */
     lewi_mask_UpdateOwnershipInfo(spd, process_mask);
 
@@ -800,9 +1198,9 @@ int lewi_mask_UpdateOwnership(const subprocess_descriptor_t *spd,
     array_cpuinfo_task_t *tasks = get_tasks(spd);
     shmem_cpuinfo__update_ownership(spd->id, process_mask, tasks);
     resolve_cpuinfo_tasks(spd, tasks);
+    shmem_cpuinfo__set_max_parallelism(spd->id, lewi_info->max_parallelism);
 
     /* Check possible pending reclaimed CPUs */
-    lewi_info_t *lewi_info = spd->lewi_info;
     int cpuid = mu_get_first_cpu(&lewi_info->pending_reclaimed_cpus);
     if (cpuid >= 0) {
         do {
@@ -30,8 +30,12 @@ int lewi_mask_SetMaxParallelism(const subprocess_descriptor_t *spd, int max);
 int lewi_mask_UnsetMaxParallelism(const subprocess_descriptor_t *spd);
 
 int lewi_mask_IntoBlockingCall(const subprocess_descriptor_t *spd);
+int lewi_mask_IntoBlockingCallHandoff(const subprocess_descriptor_t *spd,
+        const pid_t *recipients, unsigned int nrecipients);
 int lewi_mask_OutOfBlockingCall(const subprocess_descriptor_t *spd);
 
+int lewi_mask_NewIteration(const subprocess_descriptor_t *spd, bool new_loop);
+
 int lewi_mask_Lend(const subprocess_descriptor_t *spd);
 int lewi_mask_LendCpu(const subprocess_descriptor_t *spd, int cpuid);
 int lewi_mask_LendCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *mask);
@@ -56,6 +60,13 @@ int lewi_mask_Return(const subprocess_descriptor_t *spd);
 int lewi_mask_ReturnCpu(const subprocess_descriptor_t *spd, int cpuid);
 int lewi_mask_ReturnCpuMask(const subprocess_descriptor_t *spd, const cpu_set_t *mask);
 
+int lewi_mask_AcquireCpusAsync(const subprocess_descriptor_t *spd, int ncpus,
+        dlb_ticket_t *ticket);
+int lewi_mask_ReclaimCpusAsync(const subprocess_descriptor_t *spd, int ncpus,
+        dlb_ticket_t *ticket);
+int lewi_mask_TestTicket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket);
+int lewi_mask_CancelTicket(const subprocess_descriptor_t *spd, dlb_ticket_t ticket);
+
 int lewi_mask_CheckCpuAvailability(const subprocess_descriptor_t *spd, int cpuid);
 int lewi_mask_UpdateOwnership(const subprocess_descriptor_t *spd, const cpu_set_t *process_mask);
 
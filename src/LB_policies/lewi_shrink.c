@@ -0,0 +1,101 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "LB_policies/lewi_shrink.h"
+
+#include "support/debug.h"
+
+#include <inttypes.h>
+
+/* Relative increase of the iteration time considered a slowdown, so that
+ * the usual noise between iterations does not recover CPUs */
+static const double LEWI_SHRINK_SLOWDOWN = 0.05;
+
+void lewi_shrink_init(lewi_shrink_t *shrink, int initial_cpus, int64_t now) {
+    *shrink = (const lewi_shrink_t) {
+        .max_cpus = initial_cpus,
+        .initial_cpus = initial_cpus,
+        .in_computation = true,
+        .iteration_start = now,
+        .computation_start = now,
+    };
+}
+
+/* End of a computation interval */
+void lewi_shrink_into_blocking_call(lewi_shrink_t *shrink, int num_cpus, int64_t now) {
+    if (shrink->in_computation) {
+        shrink->computation_cpu_time += (now - shrink->computation_start) * num_cpus;
+        shrink->in_computation = false;
+    }
+}
+
+/* Start of a computation interval */
+void lewi_shrink_out_of_blocking_call(lewi_shrink_t *shrink, int64_t now) {
+    if (!shrink->in_computation) {
+        shrink->computation_start = now;
+        shrink->in_computation = true;
+    }
+}
+
+/* Close the current iteration and return the new limit of CPUs.
+ * The interval before the first iteration of a loop is not an iteration, so
+ * it is not evaluated */
+int lewi_shrink_new_iteration(lewi_shrink_t *shrink, int num_cpus, bool new_loop,
+        int64_t now) {
+
+    /* Split an ongoing computation interval between both iterations */
+    if (shrink->in_computation) {
+        shrink->computation_cpu_time += (now - shrink->computation_start) * num_cpus;
+        shrink->computation_start = now;
+    }
+
+    int64_t iteration_time = now - shrink->iteration_start;
+    int64_t computation_cpu_time = shrink->computation_cpu_time;
+
+    bool is_iteration = shrink->in_loop && !new_loop;
+    if (is_iteration && iteration_time > 0) {
+        if (shrink->has_previous_iteration
+                && shrink->max_cpus < shrink->initial_cpus
+                && iteration_time > shrink->previous_iteration_time
+                    * (1.0 + LEWI_SHRINK_SLOWDOWN)) {
+            /* The last released CPU was needed */
+            ++shrink->max_cpus;
+        } else if (shrink->max_cpus > 1
+                && computation_cpu_time / (shrink->max_cpus - 1) < iteration_time) {
+            /* The computation would fit in the iteration with one CPU less */
+            --shrink->max_cpus;
+        }
+    }
+
+    verbose(VB_MICROLB, "LeWI shrink: iteration time %"PRId64" ns, computation"
+            " %"PRId64" ns x CPU, max CPUs: %d",
+            iteration_time, computation_cpu_time, shrink->max_cpus);
+
+    shrink->iteration_start = now;
+    shrink->computation_cpu_time = 0;
+    shrink->previous_iteration_time = iteration_time;
+    shrink->has_previous_iteration = is_iteration;
+    shrink->in_loop = true;
+
+    return shrink->max_cpus;
+}
@@ -0,0 +1,55 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef LEWI_SHRINK_H
+#define LEWI_SHRINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Iteration-aware shrinking of the LeWI parallelism, based on the former
+ * PERaL policy.
+ *
+ * The computation of each iteration is measured as the length of every
+ * interval between blocking calls multiplied by the number of CPUs assigned to
+ * the process. At the end of the iteration, if that CPU time would fit in the
+ * iteration time with one CPU less, the last CPU does not shorten the
+ * iteration and the limit is decreased. If an iteration becomes slower than
+ * the previous one, the last released CPU is recovered.
+ * Not thread-safe, the caller must provide its own synchronization. */
+
+typedef struct LeWIShrink {
+    int     max_cpus;                   /* Current limit */
+    int     initial_cpus;               /* Upper bound of the limit */
+    bool    in_computation;             /* Whether outside of a blocking call */
+    bool    in_loop;                    /* Whether iteration_start is an iteration start */
+    bool    has_previous_iteration;     /* Whether previous_iteration_time is valid */
+    int64_t iteration_start;
+    int64_t computation_start;
+    int64_t computation_cpu_time;       /* Accumulated in the current iteration */
+    int64_t previous_iteration_time;
+} lewi_shrink_t;
+
+void lewi_shrink_init(lewi_shrink_t *shrink, int initial_cpus, int64_t now);
+void lewi_shrink_into_blocking_call(lewi_shrink_t *shrink, int num_cpus, int64_t now);
+void lewi_shrink_out_of_blocking_call(lewi_shrink_t *shrink, int64_t now);
+int  lewi_shrink_new_iteration(lewi_shrink_t *shrink, int num_cpus, bool new_loop,
+        int64_t now);
+
+#endif /* LEWI_SHRINK_H */
@@ -30,6 +30,7 @@
 #include "support/env.h"
 #include "support/error.h"
 #include "support/dlb_common.h"
+#include "support/timers.h"
 
 #include <unistd.h>
 #include <stdlib.h>
@@ -255,6 +256,56 @@ int DLB_AcquireCpusInMask(int ncpus, const_dlb_cpu_set_t mask) {
 }
 
 
+/* Asynchronous requests */
+
+DLB_EXPORT_SYMBOL
+int DLB_AcquireCpusAsync(int ncpus, dlb_ticket_t *ticket) {
+    spd_enter_dlb(thread_spd);
+    if (unlikely(!thread_spd->dlb_initialized)) {
+        *ticket = DLB_TICKET_NULL;
+        return DLB_ERR_NOINIT;
+    }
+    return acquire_cpus_async(thread_spd, ncpus, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_ReclaimCpusAsync(int ncpus, dlb_ticket_t *ticket) {
+    spd_enter_dlb(thread_spd);
+    if (unlikely(!thread_spd->dlb_initialized)) {
+        *ticket = DLB_TICKET_NULL;
+        return DLB_ERR_NOINIT;
+    }
+    return reclaim_cpus_async(thread_spd, ncpus, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_TestTicket(dlb_ticket_t ticket) {
+    spd_enter_dlb(thread_spd);
+    if (unlikely(!thread_spd->dlb_initialized)) {
+        return DLB_ERR_NOINIT;
+    }
+    return test_ticket(thread_spd, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_WaitTicket(dlb_ticket_t ticket) {
+    spd_enter_dlb(thread_spd);
+    if (unlikely(!thread_spd->dlb_initialized)) {
+        return DLB_ERR_NOINIT;
+    }
+    return wait_ticket(thread_spd, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_CancelTicket(dlb_ticket_t ticket) {
+    spd_enter_dlb(thread_spd);
+    if (unlikely(!thread_spd->dlb_initialized)) {
+        return DLB_ERR_NOINIT;
+    }
+    return cancel_ticket(thread_spd, ticket);
+}
+
+
 /* Borrow */
 
 DLB_EXPORT_SYMBOL
@@ -435,6 +486,19 @@ int DLB_PrintShmem(int num_columns, dlb_printshmem_flags_t print_flags) {
     return print_shmem(thread_spd, num_columns, print_flags);
 }
 
+DLB_EXPORT_SYMBOL
+int DLB_PrintInternalStats(void) {
+    spd_enter_dlb(thread_spd);
+    if (unlikely(!thread_spd->dlb_initialized)) {
+        return DLB_ERR_NOINIT;
+    }
+    if (!timers_enabled) {
+        return DLB_ERR_NOCOMP;
+    }
+    timers_report();
+    return DLB_SUCCESS;
+}
+
 DLB_EXPORT_SYMBOL
 const char* DLB_Strerror(int errnum) {
     return error_get_str(errnum);
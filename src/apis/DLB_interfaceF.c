@@ -36,7 +36,9 @@ void dlb_mpi_node_barrier(void)  {
     if (is_mpi_ready()) {
         int ierror;
         MPI_Comm mpi_comm_node = getNodeComm();
-        if (mpi_barrier_) {
+        if (mpi_comm_node == MPI_COMM_NULL) {
+            warning("dlb_mpi_node_barrier requires DLB to be initialized with --barrier");
+        } else if (mpi_barrier_) {
             mpi_barrier_(&mpi_comm_node, &ierror);
         } else {
             warning("MPI_Barrier symbol could not be found. Please report a ticket.");
@@ -186,6 +186,39 @@ int DLB_AcquireCpusInMask_sp(dlb_handler_t handler, int ncpus, const_dlb_cpu_set
 }
 
 
+/* Asynchronous requests */
+
+DLB_EXPORT_SYMBOL
+int DLB_AcquireCpusAsync_sp(dlb_handler_t handler, int ncpus, dlb_ticket_t *ticket) {
+    spd_enter_dlb(handler);
+    return acquire_cpus_async(handler, ncpus, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_ReclaimCpusAsync_sp(dlb_handler_t handler, int ncpus, dlb_ticket_t *ticket) {
+    spd_enter_dlb(handler);
+    return reclaim_cpus_async(handler, ncpus, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_TestTicket_sp(dlb_handler_t handler, dlb_ticket_t ticket) {
+    spd_enter_dlb(handler);
+    return test_ticket(handler, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_WaitTicket_sp(dlb_handler_t handler, dlb_ticket_t ticket) {
+    spd_enter_dlb(handler);
+    return wait_ticket(handler, ticket);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_CancelTicket_sp(dlb_handler_t handler, dlb_ticket_t ticket) {
+    spd_enter_dlb(handler);
+    return cancel_ticket(handler, ticket);
+}
+
+
 /* Borrow */
 
 DLB_EXPORT_SYMBOL
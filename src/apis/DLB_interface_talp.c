@@ -155,6 +155,35 @@ int DLB_TALP_QueryPOPNodeMetrics(const char *name, dlb_node_metrics_t *node_metr
     }
 }
 
+DLB_EXPORT_SYMBOL
+int DLB_TALP_QueryPOPNodeHybridMetrics(const char *name, dlb_pop_metrics_t *pop_metrics) {
+    if (shmem_talp__initialized()) {
+        /* Only if a worker process started with --talp-external-profiler */
+        return talp_query_pop_node_hybrid_metrics(name, pop_metrics);
+    } else {
+        return DLB_ERR_NOSHMEM;
+    }
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_TALP_GetRegionNames(char (*names)[DLB_MONITOR_NAME_MAX], int *nelems, int max_len) {
+    return shmem_talp__get_region_names(names, nelems, max_len);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_TALP_GetCpuStates(dlb_cpu_state_t *states, int *nelems, int max_len) {
+    return shmem_cpuinfo__get_cpu_states(states, nelems, max_len);
+}
+
+DLB_EXPORT_SYMBOL
+int DLB_TALP_GetLeWICounters(int64_t *num_lends, int64_t *num_borrows) {
+    int lewi_color;
+    char shm_key[MAX_OPTION_LENGTH];
+    options_parse_entry("--lewi-color", &lewi_color);
+    options_parse_entry("--shm-key", shm_key);
+    return shmem_cpuinfo__get_lewi_counters(shm_key, lewi_color, num_lends, num_borrows);
+}
+
 
 /*********************************************************************************/
 /*    TALP Monitoring Regions                                                    */
@@ -186,6 +215,12 @@ dlb_monitor_t* DLB_MonitoringRegionRegister(const char *name){
     return region_register(thread_spd, name);
 }
 
+DLB_EXPORT_SYMBOL
+int DLB_MonitoringRegionGetGeneration(void) {
+    spd_enter_dlb(thread_spd);
+    return region_get_generation(thread_spd);
+}
+
 DLB_EXPORT_SYMBOL
 int DLB_MonitoringRegionReset(dlb_monitor_t *handle){
     spd_enter_dlb(thread_spd);
@@ -231,6 +266,15 @@ int DLB_MonitoringRegionsUpdate(void) {
     return talp_flush_samples_to_regions(thread_spd);
 }
 
+DLB_EXPORT_SYMBOL
+int DLB_TALP_QueryPOPMetrics(dlb_monitor_t *monitor, dlb_pop_metrics_t *pop_metrics) {
+    spd_enter_dlb(thread_spd);
+    if (unlikely(!thread_spd->talp_info)) {
+        return DLB_ERR_NOTALP;
+    }
+    return talp_query_pop_metrics(thread_spd, monitor, pop_metrics);
+}
+
 DLB_EXPORT_SYMBOL
 int DLB_TALP_CollectPOPMetrics(dlb_monitor_t *monitor, dlb_pop_metrics_t *pop_metrics) {
     spd_enter_dlb(thread_spd);
@@ -316,6 +316,87 @@ int DLB_AcquireCpuMask_sp(dlb_handler_t handler, const_dlb_cpu_set_t mask);
 int DLB_AcquireCpusInMask_sp(dlb_handler_t handler, int ncpus, const_dlb_cpu_set_t mask);
 
 
+/*********************************************************************************/
+/*    Asynchronous requests                                                      */
+/*********************************************************************************/
+
+/*! \brief Acquire a specific amount of CPUs without waiting for them
+ *  \param[in] handler subprocess identifier
+ *  \param[in] ncpus Number of CPUs to acquire
+ *  \param[out] ticket Ticket to track the CPUs not immediately acquired
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_NOTED if the petition cannot be immediately fulfilled
+ *  \return DLB_NOUPDT if cannot acquire any CPU
+ *  \return DLB_ERR_DISBLD if DLB is disabled
+ *  \return DLB_ERR_NOPOL if the current policy does not support tickets
+ *  \return DLB_ERR_REQST if there are too many requests for these resources
+ *
+ *  Same as DLB_AcquireCpus_sp, but if the petition is enqueued the function
+ *  returns a ticket that can be used to check whether the enqueued CPUs have
+ *  already been assigned. Otherwise, the ticket is DLB_TICKET_NULL.
+ *  Only the LeWI_mask policy supports tickets.
+ */
+int DLB_AcquireCpusAsync_sp(dlb_handler_t handler, int ncpus, dlb_ticket_t *ticket);
+
+/*! \brief Reclaim a specific amount of CPUs without waiting for them
+ *  \param[in] handler subprocess identifier
+ *  \param[in] ncpus Number of CPUs to reclaim
+ *  \param[out] ticket Ticket to track the CPUs not immediately reclaimed
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_NOTED if the petition cannot be immediately fulfilled
+ *  \return DLB_NOUPDT if there are no CPUs to reclaim
+ *  \return DLB_ERR_DISBLD if DLB is disabled
+ *  \return DLB_ERR_NOPOL if the current policy does not support tickets
+ *
+ *  Same as DLB_ReclaimCpus_sp, but if some reclaimed CPUs are still guested by
+ *  other processes the function returns a ticket that can be used to check
+ *  whether they have already been returned. Otherwise, the ticket is
+ *  DLB_TICKET_NULL.
+ */
+int DLB_ReclaimCpusAsync_sp(dlb_handler_t handler, int ncpus, dlb_ticket_t *ticket);
+
+/*! \brief Check whether the CPUs of a ticket have been assigned
+ *  \param[in] handler subprocess identifier
+ *  \param[in] ticket Ticket obtained from an asynchronous request
+ *  \return DLB_SUCCESS if all the CPUs have been assigned
+ *  \return DLB_NOTED if some CPUs are still pending
+ *  \return DLB_ERR_NOENT if the ticket is not valid
+ *
+ *  Once this function returns DLB_SUCCESS, the ticket is released and it
+ *  cannot be used anymore. Testing DLB_TICKET_NULL always succeeds.
+ *  A ticket is fulfilled once its request is served and its reclaimed CPUs
+ *  are returned. Reclaimed CPUs that the process lends again before they are
+ *  returned are no longer part of the ticket.
+ */
+int DLB_TestTicket_sp(dlb_handler_t handler, dlb_ticket_t ticket);
+
+/*! \brief Wait until the CPUs of a ticket have been assigned
+ *  \param[in] handler subprocess identifier
+ *  \param[in] ticket Ticket obtained from an asynchronous request
+ *  \return DLB_SUCCESS if all the CPUs have been assigned
+ *  \return DLB_ERR_DISBLD if DLB is disabled
+ *  \return DLB_ERR_NOENT if the ticket is not valid
+ *
+ *  The calling thread polls the ticket until it is fulfilled, and then the
+ *  ticket is released. If DLB is disabled meanwhile, the function returns
+ *  DLB_ERR_DISBLD and the ticket is no longer valid.
+ */
+int DLB_WaitTicket_sp(dlb_handler_t handler, dlb_ticket_t ticket);
+
+/*! \brief Cancel the pending CPUs of a ticket
+ *  \param[in] handler subprocess identifier
+ *  \param[in] ticket Ticket obtained from an asynchronous request
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOENT if the ticket is not valid
+ *
+ *  Remove the CPU requests of the ticket that are still enqueued and release
+ *  the ticket. Reclaimed CPUs cannot be cancelled, they will be returned to
+ *  the process anyway. Tickets are also invalidated when all the requests of
+ *  the process are removed, e.g., with DLB_AcquireCpus_sp(handler, DLB_DELETE_REQUESTS).
+ */
+int DLB_CancelTicket_sp(dlb_handler_t handler, dlb_ticket_t ticket);
+
+
 /*********************************************************************************/
 /*    Borrow                                                                     */
 /*********************************************************************************/
@@ -20,6 +20,8 @@
 #ifndef DLB_API_TALP_H
 #define DLB_API_TALP_H
 
+#include "dlb_types.h"
+
 #include <time.h>
 #include <stdint.h>
 
@@ -327,6 +329,55 @@ int DLB_TALP_GetNodeTimes(const char *name, dlb_node_times_t *node_times_list,
  */
 int DLB_TALP_QueryPOPNodeMetrics(const char *name, dlb_node_metrics_t *node_metrics);
 
+/*! \brief From either 1st or 3rd party, query the hybrid POP metrics of the
+ *         processes in the node for one region
+ *  \param[in] name Name to identify the region
+ *  \param[out] pop_metrics Allocated structure where the computed metrics will be stored
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOENT if no data for the given name
+ *  \return DLB_ERR_NOSHMEM if cannot find shared memory
+ *
+ *  The node is treated as the whole application, so the MPI metrics refer to
+ *  the processes in the node. The elapsed time is an estimation.
+ *
+ *  Note: This function requires DLB_ARGS+=" --talp-external-profiler" even if
+ *  it's called from 1st-party programs.
+ */
+int DLB_TALP_QueryPOPNodeHybridMetrics(const char *name, dlb_pop_metrics_t *pop_metrics);
+
+/*! \brief Get the list of region names registered in the shared memory
+ *  \param[out] names The output list
+ *  \param[out] nelems Number of elements in the list
+ *  \param[in] max_len Max capacity of the list
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOSHMEM if cannot find shared memory
+ *
+ *  Note: This function requires DLB_ARGS+=" --talp-external-profiler" even if
+ *  it's called from 1st-party programs.
+ */
+int DLB_TALP_GetRegionNames(char (*names)[DLB_MONITOR_NAME_MAX], int *nelems, int max_len);
+
+/*! \brief Get the current state of each CPU in the node
+ *  \param[out] states The output list, indexed by CPU id
+ *  \param[out] nelems Number of elements in the list
+ *  \param[in] max_len Max capacity of the list
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOSHMEM if cannot find shared memory
+ */
+int DLB_TALP_GetCpuStates(dlb_cpu_state_t *states, int *nelems, int max_len);
+
+/*! \brief Get the accumulated number of CPUs lent and borrowed in the node
+ *  \param[out] num_lends Number of times a CPU has been released by a process
+ *  \param[out] num_borrows Number of times a CPU has been acquired by a process
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOSHMEM if cannot find shared memory
+ *
+ *  Both values are monotonic counters while the shared memory exists.
+ *  The shared memory is not locked, and this function does not require
+ *  DLB_TALP_Attach: if not attached, it is only opened for reading.
+ */
+int DLB_TALP_GetLeWICounters(int64_t *num_lends, int64_t *num_borrows);
+
 
 /*********************************************************************************/
 /*                                                                               */
@@ -365,6 +416,54 @@ const dlb_monitor_t* DLB_MonitoringRegionGetMPIRegion(void)
  */
 dlb_monitor_t* DLB_MonitoringRegionRegister(const char *name);
 
+/*! \brief Get the generation of the Monitoring Regions of this process
+ *  \return a positive value that identifies the current set of regions,
+ *          or 0 if TALP is not enabled
+ *
+ *  The generation changes every time TALP is initialized, and it differs
+ *  between subprocesses. A handle obtained with a different generation must
+ *  not be used.
+ */
+int DLB_MonitoringRegionGetGeneration(void);
+
+/*! \brief Epoch of the Monitoring Region handles, for internal use of
+ *         DLB_MonitoringRegionRegisterStatic
+ *
+ *  It changes every time TALP is initialized or finalized in any subprocess,
+ *  or a thread that has called DLB enters another subprocess. It must not be
+ *  modified by the user.
+ */
+extern volatile int dlb_talp_regions_epoch;
+
+/*! \brief Register a new Monitoring Region once per call site
+ *  \param[in] name Name to identify the region
+ *  \return monitor handle to be used on subsequent calls, or NULL if TALP is not enabled
+ *
+ *  Same as DLB_MonitoringRegionRegister, but the handle is saved in a
+ *  thread-local static variable of the call site together with the epoch of
+ *  the region handles, so that registering the region inside a loop only
+ *  costs the inline read of a global variable after the first time. The
+ *  region is registered again if DLB has been re-initialized or the thread
+ *  has entered another subprocess.
+ *  The name must be the same on every call (e.g., a string literal).
+ *  Requires a compiler with GNU C extensions, otherwise it is equivalent to
+ *  DLB_MonitoringRegionRegister.
+ */
+#if defined(__GNUC__)
+#define DLB_MonitoringRegionRegisterStatic(name) __extension__ ({               \
+        static __thread dlb_monitor_t *_dlb_static_monitor = NULL;              \
+        static __thread int _dlb_static_epoch = 0;                              \
+        int _dlb_epoch = dlb_talp_regions_epoch;                                \
+        if (_dlb_static_monitor == NULL || _dlb_epoch != _dlb_static_epoch) {   \
+            _dlb_static_monitor = DLB_MonitoringRegionRegister(name);           \
+            _dlb_static_epoch = _dlb_epoch;                                     \
+        }                                                                       \
+        _dlb_static_monitor;                                                    \
+    })
+#else
+#define DLB_MonitoringRegionRegisterStatic(name) DLB_MonitoringRegionRegister(name)
+#endif
+
 /*! \brief Reset monitoring region
  *  \param[in] handle Monitoring handle that identifies the region, or DLB_GLOBAL_REGION
  *  \return DLB_SUCCESS on success
@@ -414,6 +513,20 @@ int DLB_MonitoringRegionReport(const dlb_monitor_t *handle);
 */
 int DLB_MonitoringRegionsUpdate(void);
 
+/*! \brief Compute the current POP metrics of this process, without communication.
+ *  \param[in] monitor Monitoring handle that identifies the region,
+ *                     or DLB_GLOBAL_REGION macro (NULL) if global application-wide region
+ *  \param[out] pop_metrics Allocated structure where the computed metrics will be stored
+ *  \return DLB_SUCCESS on success
+ *  \return DLB_ERR_NOTALP if TALP is not enabled
+ *
+ *  Unlike DLB_TALP_CollectPOPMetrics, this function may be called by any
+ *  process at any time, e.g., to adapt the execution to the metrics of the
+ *  current region. The region does not need to be stopped, metrics include
+ *  the ongoing time. MPI metrics only refer to this process.
+ */
+int DLB_TALP_QueryPOPMetrics(dlb_monitor_t *monitor, dlb_pop_metrics_t *pop_metrics);
+
 /*! \brief Perform an MPI collective communication to collect POP metrics.
  *  \param[in] monitor Monitoring handle that identifies the region,
  *                     or DLB_GLOBAL_REGION macro (NULL) if global application-wide region
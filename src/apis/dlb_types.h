@@ -47,6 +47,15 @@ typedef enum dlb_printshmem_flags_e {
     DLB_COLOR_ALWAYS    = 2
 } dlb_printshmem_flags_t;
 
+// CPU states, as seen from the node shared memory
+typedef enum dlb_cpu_state_e {
+    DLB_CPU_STATE_DISABLED  = 0,    // Not owned by any process
+    DLB_CPU_STATE_BUSY      = 1,    // Used by its owner
+    DLB_CPU_STATE_RECLAIMED = 2,    // Reclaimed by its owner but still used by a guest
+    DLB_CPU_STATE_IDLE      = 3,    // Lent and not used
+    DLB_CPU_STATE_LENT      = 4,    // Lent and used by another process
+} dlb_cpu_state_t;
+
 // Barrier flags
 typedef enum dlb_barrier_flags_e {
     DLB_BARRIER_LEWI_OFF        = 0,
@@ -54,6 +63,10 @@ typedef enum dlb_barrier_flags_e {
     DLB_BARRIER_LEWI_RUNTIME    = 1 << 1,
 } dlb_barrier_flags_t;
 
+// Ticket of an asynchronous request
+typedef int dlb_ticket_t;
+enum { DLB_TICKET_NULL = 0 };
+
 // Generic dummy callback type
 typedef void (*dlb_callback_t)(void);
 
@@ -68,6 +81,7 @@ typedef enum dlb_callbacks_e {
     dlb_callback_disable_cpu      = 7,
     dlb_callback_enable_cpu_set   = 8,
     dlb_callback_disable_cpu_set  = 9,
+    dlb_callback_update_active_mask_delta = 10,
 } dlb_callbacks_t;
 
 // Callback signatures
@@ -80,5 +94,7 @@ typedef void (*dlb_callback_enable_cpu_t)(int cpuid, void *arg);
 typedef void (*dlb_callback_disable_cpu_t)(int cpuid, void *arg);
 typedef void (*dlb_callback_enable_cpu_set_t)(const_dlb_cpu_set_t mask, void *arg);
 typedef void (*dlb_callback_disable_cpu_set_t)(const_dlb_cpu_set_t mask, void *arg);
+typedef void (*dlb_callback_update_active_mask_delta_t)(const_dlb_cpu_set_t enable_mask,
+        const_dlb_cpu_set_t disable_mask, void *arg);
 
 #endif /* DLB_TYPES_H */
@@ -164,6 +164,43 @@
             type(c_ptr), value, intent(in) :: mask
         end function dlb_acquirecpusinmask
 
+        function dlb_acquirecpusasync(ncpus, ticket) result (ierr)      &
+     &          bind(c, name='DLB_AcquireCpusAsync')
+            use iso_c_binding
+            integer(kind=c_int) :: ierr
+            integer(kind=c_int), value, intent(in) :: ncpus
+            integer(kind=c_int), intent(out) :: ticket
+        end function dlb_acquirecpusasync
+
+        function dlb_reclaimcpusasync(ncpus, ticket) result (ierr)      &
+     &          bind(c, name='DLB_ReclaimCpusAsync')
+            use iso_c_binding
+            integer(kind=c_int) :: ierr
+            integer(kind=c_int), value, intent(in) :: ncpus
+            integer(kind=c_int), intent(out) :: ticket
+        end function dlb_reclaimcpusasync
+
+        function dlb_testticket(ticket) result (ierr)                   &
+     &          bind(c, name='DLB_TestTicket')
+            use iso_c_binding
+            integer(kind=c_int) :: ierr
+            integer(kind=c_int), value, intent(in) :: ticket
+        end function dlb_testticket
+
+        function dlb_waitticket(ticket) result (ierr)                   &
+     &          bind(c, name='DLB_WaitTicket')
+            use iso_c_binding
+            integer(kind=c_int) :: ierr
+            integer(kind=c_int), value, intent(in) :: ticket
+        end function dlb_waitticket
+
+        function dlb_cancelticket(ticket) result (ierr)                 &
+     &          bind(c, name='DLB_CancelTicket')
+            use iso_c_binding
+            integer(kind=c_int) :: ierr
+            integer(kind=c_int), value, intent(in) :: ticket
+        end function dlb_cancelticket
+
         function dlb_borrow() result (ierr)                             &
      &          bind(c, name='DLB_Borrow')
             use iso_c_binding
@@ -327,6 +364,12 @@
             integer(kind=c_int), value, intent(in) :: flags
         end function dlb_printshmem
 
+        function dlb_printinternalstats() result (ierr)                 &
+     &          bind(c, name='DLB_PrintInternalStats')
+            use iso_c_binding
+            integer(kind=c_int) :: ierr
+        end function dlb_printinternalstats
+
         function dlb_strerror(errnum) result(str)                       &
      &          bind(c, name='DLB_Strerror')
             use iso_c_binding
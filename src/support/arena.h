@@ -0,0 +1,100 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Bump allocator for objects that live until a common point (e.g., TALP
+ * regions and records until finalization). Objects are carved out of large
+ * chunks and cannot be freed individually, only all at once. Not thread-safe,
+ * the caller must provide its own synchronization. */
+
+enum { ARENA_DEFAULT_CHUNK_SIZE = 64 * 1024 };
+enum { ARENA_ALIGNMENT = 16 };
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+} arena_chunk_t;
+
+typedef struct Arena {
+    arena_chunk_t *chunks;      /* Current chunk first */
+    size_t chunk_size;          /* Size of data in new chunks, 0 for the default */
+} arena_t;
+
+static inline size_t arena_align(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+/* Return a zero-initialized block of size bytes, or NULL if out of memory */
+static inline void* arena_alloc(arena_t *arena, size_t size) {
+    size = arena_align(size);
+    arena_chunk_t *chunk = arena->chunks;
+
+    if (chunk == NULL || chunk->size - chunk->used < size) {
+        size_t chunk_size = arena->chunk_size > 0
+            ? arena->chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+        if (size > chunk_size / 4) {
+            /* Big objects get their own chunk, placed after the current one
+             * so that the current chunk can still be filled */
+            arena_chunk_t *big = malloc(sizeof(arena_chunk_t) + size);
+            if (big == NULL) return NULL;
+            big->size = size;
+            big->used = size;
+            if (chunk != NULL) {
+                big->next = chunk->next;
+                chunk->next = big;
+            } else {
+                big->next = NULL;
+                arena->chunks = big;
+            }
+            return memset(big->data, 0, size);
+        }
+
+        chunk = malloc(sizeof(arena_chunk_t) + chunk_size);
+        if (chunk == NULL) return NULL;
+        chunk->next = arena->chunks;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        arena->chunks = chunk;
+    }
+
+    void *ptr = &chunk->data[chunk->used];
+    chunk->used += size;
+    return memset(ptr, 0, size);
+}
+
+/* Free all blocks at once, the arena can be reused afterwards */
+static inline void arena_free_all(arena_t *arena) {
+    arena_chunk_t *chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = NULL;
+}
+
+#endif /* ARENA_H */
@@ -0,0 +1,269 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+
+#include "support/cgroup.h"
+
+#include "apis/dlb_errors.h"
+#include "support/debug.h"
+#include "support/dlb_common.h"
+#include "support/mask_utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { CGROUP_PATH_MAX = PATH_MAX };
+
+/* Root of the proc filesystem, only modified for testing */
+static const char *proc_root = "/proc";
+
+/* Write a string into a cgroup interface file */
+static int write_cgroup_file(const char *cgroup_path, const char *filename,
+        const char *value) {
+    char path[CGROUP_PATH_MAX];
+    snprintf(path, CGROUP_PATH_MAX, "%s/%s", cgroup_path, filename);
+    int fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd == -1) {
+        verbose(VB_DROM, "Cannot open %s: %s", path, strerror(errno));
+        return DLB_ERR_PERM;
+    }
+    size_t len = strlen(value);
+    ssize_t written = write(fd, value, len);
+    int error = (written == (ssize_t)len) ? DLB_SUCCESS : DLB_ERR_PERM;
+    if (error) {
+        verbose(VB_DROM, "Cannot write '%s' to %s: %s", value, path, strerror(errno));
+    }
+    close(fd);
+    return error;
+}
+
+/* Read the first line of a cgroup interface file, without the line feed */
+static int read_cgroup_file(const char *cgroup_path, const char *filename,
+        char *value, size_t len) {
+    char path[CGROUP_PATH_MAX];
+    if (snprintf(path, CGROUP_PATH_MAX, "%s/%s", cgroup_path, filename)
+            >= CGROUP_PATH_MAX) {
+        return DLB_ERR_NOMEM;
+    }
+    FILE *fd = fopen(path, "r");
+    if (fd == NULL) return DLB_ERR_NOENT;
+    int error = fgets(value, len, fd) != NULL ? DLB_SUCCESS : DLB_ERR_UNKNOWN;
+    fclose(fd);
+    if (error == DLB_SUCCESS) {
+        value[strcspn(value, "\n")] = '\0';
+    }
+    return error;
+}
+
+/* Format a CPU mask as a cpuset.cpus list, e.g.: 0-3,6 */
+static void mask_to_cpu_list(const cpu_set_t *mask, char *str, size_t len) {
+    /* mu_to_str returns the list enclosed in brackets */
+    const char *mask_str = mu_to_str(mask);
+    snprintf(str, len, "%.*s", (int)strlen(mask_str)-2, mask_str+1);
+}
+
+/* Obtain the cgroup v2 mount point */
+static int get_cgroup2_mount(char *mount_point, size_t len) {
+    char filename[CGROUP_PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s/self/mounts", proc_root);
+    FILE *fd = fopen(filename, "r");
+    if (fd == NULL) return DLB_ERR_NOENT;
+
+    int error = DLB_ERR_NOENT;
+    char line[CGROUP_PATH_MAX];
+    while (fgets(line, sizeof(line), fd) != NULL) {
+        char device[64], path[CGROUP_PATH_MAX], fstype[64];
+        if (sscanf(line, "%63s %4095s %63s", device, path, fstype) == 3
+                && strcmp(fstype, "cgroup2") == 0) {
+            snprintf(mount_point, len, "%s", path);
+            error = DLB_SUCCESS;
+            break;
+        }
+    }
+    fclose(fd);
+    return error;
+}
+
+/* Obtain the cgroup v2 directory of a process */
+static int get_process_cgroup(pid_t pid, char *cgroup_path, size_t len) {
+    char mount_point[CGROUP_PATH_MAX];
+    if (get_cgroup2_mount(mount_point, sizeof(mount_point)) != DLB_SUCCESS) {
+        return DLB_ERR_NOENT;
+    }
+
+    char filename[CGROUP_PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s/%d/cgroup", proc_root, pid);
+    FILE *fd = fopen(filename, "r");
+    if (fd == NULL) return DLB_ERR_NOENT;
+
+    /* The unified hierarchy entry has the format: 0::<path> */
+    int error = DLB_ERR_NOENT;
+    char line[CGROUP_PATH_MAX];
+    while (fgets(line, sizeof(line), fd) != NULL) {
+        if (strncmp(line, "0::", 3) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            int path_len = snprintf(cgroup_path, len, "%s%s", mount_point, line+3);
+            error = path_len < (int)len ? DLB_SUCCESS : DLB_ERR_NOMEM;
+            break;
+        }
+    }
+    fclose(fd);
+    return error;
+}
+
+/* Remove empty cgroups left by previous dlb_run executions */
+static void remove_stale_cgroups(const char *parent_path) {
+    DIR *dp = opendir(parent_path);
+    if (dp == NULL) return;
+
+    const size_t prefix_len = strlen(DLB_CGROUP_PREFIX);
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        if (strncmp(entry->d_name, DLB_CGROUP_PREFIX, prefix_len) == 0) {
+            pid_t pid = strtol(entry->d_name + prefix_len, NULL, 10);
+            if (pid > 0 && kill(pid, 0) == -1 && errno == ESRCH) {
+                char path[CGROUP_PATH_MAX];
+                snprintf(path, CGROUP_PATH_MAX, "%s/%s", parent_path, entry->d_name);
+                /* rmdir fails if the cgroup is still populated */
+                if (rmdir(path) == 0) {
+                    verbose(VB_DROM, "Removed stale cgroup %s", path);
+                }
+            }
+        }
+    }
+    closedir(dp);
+}
+
+/* Create a child cgroup of parent_path restricted to mask, and move the
+ * current process into it. Processes forked afterwards inherit the cgroup. */
+DLB_EXPORT_SYMBOL
+int cgroup_cpuset_create(const char *parent_path, const cpu_set_t *mask) {
+    if (CPU_COUNT(mask) == 0) return DLB_ERR_PERM;
+
+    /* Enable the cpuset controller for the children, if needed */
+    char controllers[256];
+    if (read_cgroup_file(parent_path, "cgroup.subtree_control",
+                controllers, sizeof(controllers)) != DLB_SUCCESS) {
+        warning("Cannot read cgroup.subtree_control in %s, is it a cgroup v2 directory?",
+                parent_path);
+        return DLB_ERR_NOENT;
+    }
+    if (strstr(controllers, "cpuset") == NULL
+            && write_cgroup_file(parent_path, "cgroup.subtree_control", "+cpuset")
+            != DLB_SUCCESS) {
+        warning("Cannot enable the cpuset controller in %s", parent_path);
+        return DLB_ERR_PERM;
+    }
+
+    remove_stale_cgroups(parent_path);
+
+    char cgroup_path[CGROUP_PATH_MAX];
+    snprintf(cgroup_path, CGROUP_PATH_MAX, "%s/" DLB_CGROUP_PREFIX "%d",
+            parent_path, getpid());
+    if (mkdir(cgroup_path, 0755) != 0 && errno != EEXIST) {
+        warning("Cannot create cgroup %s: %s", cgroup_path, strerror(errno));
+        return DLB_ERR_PERM;
+    }
+
+    char cpu_list[CPU_SETSIZE*4];
+    mask_to_cpu_list(mask, cpu_list, sizeof(cpu_list));
+    char pid_str[16];
+    snprintf(pid_str, sizeof(pid_str), "%d", getpid());
+    int error = write_cgroup_file(cgroup_path, "cpuset.cpus", cpu_list);
+    error = error ? error : write_cgroup_file(cgroup_path, "cgroup.procs", pid_str);
+    if (error) {
+        warning("Cannot set up cgroup %s", cgroup_path);
+        rmdir(cgroup_path);
+        return error;
+    }
+
+    verbose(VB_DROM, "Process %d moved to cgroup %s with CPUs %s",
+            getpid(), cgroup_path, cpu_list);
+
+    return DLB_SUCCESS;
+}
+
+/* Obtain the cgroup v2 directory of a process, only if it was created by
+ * cgroup_cpuset_create */
+static int get_dlb_cgroup(pid_t pid, char *cgroup_path, size_t len) {
+    if (get_process_cgroup(pid, cgroup_path, len) != DLB_SUCCESS) {
+        return DLB_ERR_NOENT;
+    }
+
+    const char *basename = strrchr(cgroup_path, '/');
+    if (basename == NULL
+            || strncmp(basename+1, DLB_CGROUP_PREFIX, strlen(DLB_CGROUP_PREFIX)) != 0) {
+        return DLB_ERR_NOENT;
+    }
+
+    return DLB_SUCCESS;
+}
+
+/* Return whether process pid runs in a cgroup created by cgroup_cpuset_create */
+bool cgroup_cpuset_is_managed(pid_t pid) {
+    char cgroup_path[CGROUP_PATH_MAX];
+    return get_dlb_cgroup(pid, cgroup_path, sizeof(cgroup_path)) == DLB_SUCCESS;
+}
+
+/* Set the CPUs of the cgroup of process pid, only if it was created by
+ * cgroup_cpuset_create. Returns DLB_ERR_NOENT if the process is not in such
+ * cgroup. */
+int cgroup_cpuset_set_cpus(pid_t pid, const cpu_set_t *mask) {
+    /* An empty cpuset.cpus would inherit all the CPUs from the parent */
+    if (CPU_COUNT(mask) == 0) return DLB_ERR_PERM;
+
+    char cgroup_path[CGROUP_PATH_MAX];
+    if (get_dlb_cgroup(pid, cgroup_path, sizeof(cgroup_path)) != DLB_SUCCESS) {
+        return DLB_ERR_NOENT;
+    }
+
+    char cpu_list[CPU_SETSIZE*4];
+    mask_to_cpu_list(mask, cpu_list, sizeof(cpu_list));
+    int error = write_cgroup_file(cgroup_path, "cpuset.cpus", cpu_list);
+    if (error == DLB_SUCCESS) {
+        verbose(VB_DROM, "Process %d restricted to CPUs %s through cgroup %s",
+                pid, cpu_list, cgroup_path);
+    }
+
+    return error;
+}
+
+/* Read the effective CPUs of the cgroup of process pid, as a cpuset.cpus list.
+ * Returns DLB_ERR_NOENT if cgroup v2 or the cpuset controller are not available. */
+int cgroup_get_cpuset_cpus(pid_t pid, char *cpu_list, size_t len) {
+    char cgroup_path[CGROUP_PATH_MAX];
+    if (get_process_cgroup(pid, cgroup_path, sizeof(cgroup_path)) != DLB_SUCCESS) {
+        return DLB_ERR_NOENT;
+    }
+
+    return read_cgroup_file(cgroup_path, "cpuset.cpus.effective", cpu_list, len);
+}
+
+void cgroup_testing__set_proc_root(const char *path) {
+    proc_root = path;
+}
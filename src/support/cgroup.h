@@ -0,0 +1,46 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <sys/types.h>
+#include <sched.h>
+#include <stdbool.h>
+
+/* cgroup v2 cpuset backend
+ *
+ * dlb_run may place itself and the launched application in a child cgroup
+ * named DLB_CGROUP_PREFIX<dlb_run pid>, inside a cgroup v2 directory with the
+ * cpuset controller available. DROM mask changes for processes in such
+ * cgroups are then enforced by the kernel through cpuset.cpus, without the
+ * cooperation of the target process.
+ */
+
+#define DLB_CGROUP_PREFIX "dlb_run."
+
+int cgroup_cpuset_create(const char *parent_path, const cpu_set_t *mask);
+bool cgroup_cpuset_is_managed(pid_t pid);
+int cgroup_cpuset_set_cpus(pid_t pid, const cpu_set_t *mask);
+int cgroup_get_cpuset_cpus(pid_t pid, char *cpu_list, size_t len);
+
+void cgroup_testing__set_proc_root(const char *path);
+
+#endif /* CGROUP_H */
@@ -33,6 +33,7 @@
 #include "LB_comm/shmem_cpuinfo.h"
 #include "LB_comm/shmem_procinfo.h"
 #include "LB_comm/shmem_talp.h"
+#include "LB_comm/shmem_topology.h"
 #include "LB_core/spd.h"
 
 #ifdef MPI_LIB
@@ -332,10 +333,11 @@ void dlb_clean(void) {
 
         /* Finalize shared memories that do not support subprocesses */
         shmem_barrier__finalize(shmem_key, shmem_size_multiplier);
+        shmem_topology__finalize();
         finalize_comm();
 
         /* Destroy shared memories if they still exist */
-        const char *shmem_names[] = {"cpuinfo", "procinfo", "talp", "async"};
+        const char *shmem_names[] = {"cpuinfo", "procinfo", "talp", "async", "topology"};
         enum { shmem_nelems = sizeof(shmem_names) / sizeof(shmem_names[0]) };
         int i;
         for (i=0; i<shmem_nelems; ++i) {
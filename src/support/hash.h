@@ -0,0 +1,49 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* 64-bit FNV-1a hash. Not suitable for cryptographic purposes, but fast and
+ * with a low collision probability for short strings such as region names */
+
+static inline uint64_t hash_fnv1a_64(const char *str, size_t max_len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < max_len && str[i] != '\0'; ++i) {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/* Case-insensitive variant */
+static inline uint64_t hash_fnv1a_64_nocase(const char *str, size_t max_len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < max_len && str[i] != '\0'; ++i) {
+        unsigned char c = (unsigned char)str[i];
+        hash ^= (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#endif /* HASH_H */
@@ -23,8 +23,11 @@
 
 #include "support/mask_utils.h"
 
+#include "support/cgroup.h"
 #include "support/debug.h"
 #include "support/dlb_common.h"
+#include "support/hash.h"
+#include "support/options.h"
 
 #ifdef HWLOC_LIB
 #include <hwloc.h>
@@ -33,7 +36,11 @@
 #endif
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
 
 #include <sched.h>
 #include <stdio.h>
@@ -526,6 +533,213 @@ static void print_sys_info(void) {
 }
 
 
+/*********************************************************************************/
+/*    Topology cache                                                             */
+/*********************************************************************************/
+
+/* The parsed topology is serialized into a file so that subsequent processes
+ * and utilities can load it with a single mmap instead of parsing it again.
+ * The file is identified by a key composed of the hostname, the kernel boot
+ * id, the cgroup cpuset and the process affinity (HWLOC only reports the
+ * allowed CPUs), and the HWLOC environment variables that modify the
+ * topology. The key is also stored in the file to discard hash collisions.
+ *
+ * File layout: topology_cache_t header, core masks, node masks */
+
+enum { TOPOLOGY_CACHE_VERSION = 2 };
+enum { TOPOLOGY_CACHE_KEY_MAX = 4096 };
+static const uint64_t TOPOLOGY_CACHE_MAGIC = 0x31504f544f424c44ULL; /* "DLBOTOP1" */
+
+typedef struct {
+    uint64_t        magic;
+    unsigned int    version;
+    unsigned int    num_cores;
+    unsigned int    num_nodes;
+    size_t          size;
+    char            key[TOPOLOGY_CACHE_KEY_MAX];
+    cpu_set_t       sys_mask;
+    cpu_set_t       masks[];
+} topology_cache_t;
+
+static size_t topology_cache_size(unsigned int num_cores, unsigned int num_nodes) {
+    return sizeof(topology_cache_t) + (num_cores + num_nodes) * sizeof(cpu_set_t);
+}
+
+/* Cpus_allowed-like hexadecimal representation of the process affinity */
+static void get_affinity_str(char *str, size_t len) {
+    str[0] = '\0';
+    cpu_set_t affinity;
+    if (len < 2 * sizeof(cpu_set_t) + 1
+            || sched_getaffinity(0, sizeof(cpu_set_t), &affinity) != 0) return;
+
+    const unsigned char *bytes = (const unsigned char*)&affinity;
+    size_t pos = 0;
+    for (int i = sizeof(cpu_set_t) - 1; i >= 0; --i) {
+        if (pos == 0 && bytes[i] == 0 && i > 0) continue;
+        pos += sprintf(&str[pos], "%02x", bytes[i]);
+    }
+}
+
+/* Compute the cache key and file name. Returns false if the cache is disabled */
+static bool get_topology_cache_filename(char *filename, size_t filename_len,
+        char *key, size_t key_len) {
+
+    bool topology_cache;
+    char topology_cache_dir[MAX_OPTION_LENGTH];
+    options_parse_entry("--topology-cache", &topology_cache);
+    options_parse_entry("--topology-cache-dir", topology_cache_dir);
+    if (!topology_cache || topology_cache_dir[0] == '\0') return false;
+
+    char hostname[HOST_NAME_MAX+1] = "";
+    gethostname(hostname, sizeof(hostname));
+
+    char boot_id[64] = "";
+    FILE *fd = fopen("/proc/sys/kernel/random/boot_id", "r");
+    if (fd != NULL) {
+        if (fgets(boot_id, sizeof(boot_id), fd) != NULL) {
+            boot_id[strcspn(boot_id, "\n")] = '\0';
+        }
+        fclose(fd);
+    }
+
+    char cpuset_cpus[TOPOLOGY_CACHE_KEY_MAX] = "";
+    cgroup_get_cpuset_cpus(getpid(), cpuset_cpus, sizeof(cpuset_cpus));
+
+    char affinity[2 * sizeof(cpu_set_t) + 1];
+    get_affinity_str(affinity, sizeof(affinity));
+
+    int len = snprintf(key, key_len, "%s\n%s\n%s\n%s", hostname, boot_id,
+            cpuset_cpus, affinity);
+    if (len < 0 || (size_t)len >= key_len) return false;
+
+    /* HWLOC may also be given a different topology through the environment */
+    const char *hwloc_vars[] = {"HWLOC_XMLFILE", "HWLOC_SYNTHETIC", "HWLOC_FSROOT",
+        "HWLOC_COMPONENTS"};
+    for (size_t i = 0; i < sizeof(hwloc_vars)/sizeof(hwloc_vars[0]); ++i) {
+        const char *value = getenv(hwloc_vars[i]);
+        if (value != NULL) {
+            len += snprintf(key+len, key_len-len, "\n%s=%s", hwloc_vars[i], value);
+            if ((size_t)len >= key_len) return false;
+        }
+    }
+
+    len = snprintf(filename, filename_len, "%s/DLB_topology_cache_%d_%016" PRIx64,
+            topology_cache_dir, getuid(), hash_fnv1a_64(key, key_len));
+    return len > 0 && (size_t)len < filename_len;
+}
+
+/* Check that the masks of the cache describe a consistent topology that
+ * contains the process affinity */
+static bool topology_cache_is_valid(const topology_cache_t *cache) {
+    const cpu_set_t *sys_mask = &cache->sys_mask;
+    if (CPU_COUNT(sys_mask) == 0 || cache->num_cores == 0) return false;
+
+    cpu_set_t affinity, tmp;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &affinity) == 0) {
+        CPU_AND(&tmp, &affinity, sys_mask);
+        if (!CPU_EQUAL(&tmp, &affinity)) return false;
+    }
+
+    /* Core masks must be non-empty, disjoint, and contained in the system mask */
+    cpu_set_t cores_union;
+    CPU_ZERO(&cores_union);
+    for (unsigned int core_id = 0; core_id < cache->num_cores; ++core_id) {
+        const cpu_set_t *core_mask = &cache->masks[core_id];
+        CPU_AND(&tmp, core_mask, &cores_union);
+        if (CPU_COUNT(core_mask) == 0 || CPU_COUNT(&tmp) > 0) return false;
+        CPU_OR(&cores_union, &cores_union, core_mask);
+    }
+    CPU_AND(&tmp, &cores_union, sys_mask);
+    if (!CPU_EQUAL(&tmp, &cores_union)) return false;
+
+    /* Node masks must be contained in the system mask */
+    for (unsigned int node_id = 0; node_id < cache->num_nodes; ++node_id) {
+        const cpu_set_t *node_mask = &cache->masks[cache->num_cores + node_id];
+        CPU_AND(&tmp, node_mask, sys_mask);
+        if (!CPU_EQUAL(&tmp, node_mask)) return false;
+    }
+
+    return true;
+}
+
+static int load_topology_cache(const char *filename, const char *key) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return -1;
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) == -1
+            || (size_t)statbuf.st_size < sizeof(topology_cache_t)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = statbuf.st_size;
+    const topology_cache_t *cache = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (cache == MAP_FAILED) return -1;
+
+    int error = -1;
+    if (cache->magic == TOPOLOGY_CACHE_MAGIC
+            && cache->version == TOPOLOGY_CACHE_VERSION
+            && cache->num_cores <= CPU_SETSIZE
+            && cache->num_nodes <= CPU_SETSIZE
+            && cache->size == size
+            && topology_cache_size(cache->num_cores, cache->num_nodes) == size
+            && strncmp(cache->key, key, TOPOLOGY_CACHE_KEY_MAX) == 0
+            && topology_cache_is_valid(cache)) {
+        init_system_masks(&cache->sys_mask,
+                &cache->masks[0], cache->num_cores,
+                &cache->masks[cache->num_cores], cache->num_nodes);
+        error = 0;
+    }
+
+    munmap((void*)cache, size);
+    return error;
+}
+
+/* Write the file with a temporary name and rename it, so that other processes
+ * never load a partially written cache */
+static void save_topology_cache(const char *filename, const char *key) {
+    if (mu_cpuset_alloc_size > sizeof(cpu_set_t)) return;
+
+    size_t size = topology_cache_size(sys.num_cores, sys.num_nodes);
+    topology_cache_t *cache = calloc(1, size);
+    if (cache == NULL) return;
+
+    cache->magic = TOPOLOGY_CACHE_MAGIC;
+    cache->version = TOPOLOGY_CACHE_VERSION;
+    cache->num_cores = sys.num_cores;
+    cache->num_nodes = sys.num_nodes;
+    cache->size = size;
+    snprintf(cache->key, TOPOLOGY_CACHE_KEY_MAX, "%s", key);
+    memcpy(&cache->sys_mask, sys.sys_mask.set, mu_cpuset_alloc_size);
+    for (unsigned int core_id = 0; core_id < sys.num_cores; ++core_id) {
+        memcpy(&cache->masks[core_id], sys.core_masks_by_coreid[core_id].set,
+                mu_cpuset_alloc_size);
+    }
+    for (unsigned int node_id = 0; node_id < sys.num_nodes; ++node_id) {
+        memcpy(&cache->masks[sys.num_cores + node_id], sys.node_masks[node_id].set,
+                mu_cpuset_alloc_size);
+    }
+
+    char tmp_filename[PATH_MAX];
+    if (snprintf(tmp_filename, PATH_MAX, "%s.%d", filename, getpid()) < PATH_MAX) {
+        int fd = open(tmp_filename, O_CREAT | O_EXCL | O_WRONLY, S_IRUSR | S_IWUSR);
+        if (fd != -1) {
+            bool written = write(fd, cache, size) == (ssize_t)size;
+            close(fd);
+            if (written && rename(tmp_filename, filename) == 0) {
+                verbose(VB_AFFINITY, "Node topology cached in %s", filename);
+            } else {
+                unlink(tmp_filename);
+            }
+        }
+    }
+
+    free(cache);
+}
+
+
 /*********************************************************************************/
 /*    Mask utils public functions                                                */
 /*********************************************************************************/
@@ -540,18 +754,76 @@ void mu_init( void ) {
         enum { BGQ_NUM_NODES = 1 };
         init_system(BGQ_NUM_CPUS, BGQ_NUM_CORES, BGQ_NUM_NODES);
 #else
-        /* Try to parse HW info from HWLOC first */
-        if (parse_hwloc() != 0) {
-            /* Fallback to system files if needed */
-            parse_system_files();
-        }
+        char cache_filename[PATH_MAX];
+        char *cache_key = malloc(TOPOLOGY_CACHE_KEY_MAX);
+        bool use_cache = get_topology_cache_filename(cache_filename, PATH_MAX,
+                cache_key, TOPOLOGY_CACHE_KEY_MAX);
+
+        if (use_cache && load_topology_cache(cache_filename, cache_key) == 0) {
+            verbose(VB_AFFINITY, "Node topology loaded from %s", cache_filename);
+        } else {
+            /* Try to parse HW info from HWLOC first */
+            if (parse_hwloc() != 0) {
+                /* Fallback to system files if needed */
+                parse_system_files();
+            }
 
-        mu_initialized = true;
+            mu_initialized = true;
+
+            if (use_cache) {
+                save_topology_cache(cache_filename, cache_key);
+            }
+        }
+        free(cache_key);
 #endif
         print_sys_info();
     }
 }
 
+/* Remove this user's topology cache files from the cache directory, even if the
+ * cache is disabled. Returns the number of removed files.
+ * Exported for dlb_shm, although it does not belong to the public API */
+DLB_EXPORT_SYMBOL
+int mu_delete_topology_cache(void) {
+    char topology_cache_dir[MAX_OPTION_LENGTH];
+    options_parse_entry("--topology-cache-dir", topology_cache_dir);
+    if (topology_cache_dir[0] == '\0') return 0;
+
+    DIR *dir = opendir(topology_cache_dir);
+    if (dir == NULL) return 0;
+
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "DLB_topology_cache_%d_", getuid());
+    size_t prefix_len = strlen(prefix);
+
+    int num_deleted = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, prefix, prefix_len) == 0) {
+            char filename[PATH_MAX];
+            if (snprintf(filename, PATH_MAX, "%s/%s", topology_cache_dir,
+                        entry->d_name) < PATH_MAX
+                    && unlink(filename) == 0) {
+                ++num_deleted;
+            }
+        }
+    }
+    closedir(dir);
+
+    return num_deleted;
+}
+
+/* Initialize 'sys' with the topology parsed by another process, e.g., from the
+ * node topology shared memory. It does nothing if already initialized. */
+void mu_init_with_masks(const cpu_set_t *sys_mask,
+        const cpu_set_t *core_masks, unsigned int num_cores,
+        const cpu_set_t *node_masks, unsigned int num_nodes) {
+    if ( !mu_initialized ) {
+        init_system_masks(sys_mask, core_masks, num_cores, node_masks, num_nodes);
+        print_sys_info();
+    }
+}
+
 /* This function used to be declared as destructor but it may be dangerous
  * with the OpenMP / DLB finalization at destruction time. */
 void mu_finalize( void ) {
@@ -575,6 +847,42 @@ void mu_finalize( void ) {
     mu_cpuset_num_ulongs = CPU_ALLOC_SIZE(CPU_SETSIZE) / sizeof(unsigned long);
 }
 
+bool mu_is_initialized(void) {
+    return mu_initialized;
+}
+
+/* Export the system topology as plain cpu sets, so that it can be published
+ * in shared memory. Returns -1 if the given capacities are not enough. */
+int mu_get_system_masks(cpu_set_t *sys_mask,
+        cpu_set_t *core_masks, unsigned int max_cores, unsigned int *num_cores,
+        cpu_set_t *node_masks, unsigned int max_nodes, unsigned int *num_nodes) {
+    if (unlikely(!mu_initialized)) mu_init();
+
+    if (sys.num_cores > max_cores || sys.num_nodes > max_nodes
+            || mu_cpuset_alloc_size > sizeof(cpu_set_t)) {
+        return -1;
+    }
+
+    CPU_ZERO(sys_mask);
+    memcpy(sys_mask, sys.sys_mask.set, mu_cpuset_alloc_size);
+
+    for (unsigned int core_id = 0; core_id < sys.num_cores; ++core_id) {
+        CPU_ZERO(&core_masks[core_id]);
+        memcpy(&core_masks[core_id], sys.core_masks_by_coreid[core_id].set,
+                mu_cpuset_alloc_size);
+    }
+    *num_cores = sys.num_cores;
+
+    for (unsigned int node_id = 0; node_id < sys.num_nodes; ++node_id) {
+        CPU_ZERO(&node_masks[node_id]);
+        memcpy(&node_masks[node_id], sys.node_masks[node_id].set,
+                mu_cpuset_alloc_size);
+    }
+    *num_nodes = sys.num_nodes;
+
+    return 0;
+}
+
 int mu_get_system_size( void ) {
     if (unlikely(!mu_initialized)) mu_init();
     return sys.sys_mask.last_cpuid + 1;
@@ -624,6 +932,26 @@ int mu_get_core_id(int cpuid) {
     return -1;
 }
 
+int mu_get_num_nodes(void) {
+    if (unlikely(!mu_initialized)) mu_init();
+
+    return sys.num_nodes;
+}
+
+int mu_get_node_id(int cpuid) {
+
+    if (cpuid < 0 || (unsigned)cpuid > sys.num_cpus) return -1;
+
+    for (unsigned int node_id = 0; node_id < sys.num_nodes; ++node_id) {
+        if (CPU_ISSET_S(cpuid, mu_cpuset_alloc_size,
+                    sys.node_masks[node_id].set)) {
+            return node_id;
+        }
+    }
+
+    return -1;
+}
+
 const mu_cpuset_t* mu_get_core_mask(int cpuid) {
 
     if (cpuid < 0 || (unsigned)cpuid > sys.num_cpus) return NULL;
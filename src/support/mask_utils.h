@@ -33,13 +33,23 @@ typedef struct mu_cpuset_t {
 
 /* System topology */
 void mu_init(void);
+void mu_init_with_masks(const cpu_set_t *sys_mask,
+        const cpu_set_t *core_masks, unsigned int num_cores,
+        const cpu_set_t *node_masks, unsigned int num_nodes);
 void mu_finalize(void);
+bool mu_is_initialized(void);
+int  mu_delete_topology_cache(void);
+int  mu_get_system_masks(cpu_set_t *sys_mask,
+        cpu_set_t *core_masks, unsigned int max_cores, unsigned int *num_cores,
+        cpu_set_t *node_masks, unsigned int max_nodes, unsigned int *num_nodes);
 int  mu_get_system_size(void);
 void mu_get_system_mask(cpu_set_t *mask);
 int  mu_get_system_hwthreads_per_core(void);
 bool mu_system_has_smt(void);
 int  mu_get_num_cores(void);
 int  mu_get_core_id(int cpuid);
+int  mu_get_num_nodes(void);
+int  mu_get_node_id(int cpuid);
 const mu_cpuset_t* mu_get_core_mask(int cpuid);
 const mu_cpuset_t* mu_get_core_mask_by_coreid(int core_id);
 void mu_get_nodes_intersecting_with_cpuset(cpu_set_t *node_set, const cpu_set_t *cpuset);
@@ -42,13 +42,6 @@ int64_t timespec_diff( const struct timespec *start, const struct timespec *fini
 void add_tv_to_ts( const struct timeval *t1, const struct timeval *t2, struct timespec *res );
 void ns_to_human( char *buf, size_t size, int64_t ns );
 
-void timer_init(void);
-void *timer_register(const char *key);
-void timer_start(void *handler);
-void timer_stop(void *handler);
-void timer_finalize(void);
-
-
 char* get_iso_8601_string(struct tm *tm_info);
 
 #endif /* MYTIME_H */
@@ -28,6 +28,7 @@
 #include "support/types.h"
 #include "support/mask_utils.h"
 #include "support/debug.h"
+#include "support/hash.h"
 #include "LB_core/spd.h"
 
 #include <string.h>
@@ -35,6 +36,7 @@
 #include <ctype.h>
 #include <stdint.h>
 #include <limits.h>
+#include <pthread.h>
 
 typedef enum OptionFlags {
     OPT_CLEAR      = 0,
@@ -289,6 +291,17 @@ static const opts_dict_t options_dictionary[] = {
         .offset         = offsetof(options_t, lewi_barrier_select),
         .type           = OPT_STR_T,
         .flags          = (option_flags_t)(OPT_OPTIONAL | OPT_READONLY | OPT_ADVANCED)
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-barrier-handoff",
+        .default_value  = "no",
+        .description    = OFFSET"When a process arrives early at a LeWI barrier, lend its CPUs\n"
+                          OFFSET"directly to the participants that have not arrived yet, and\n"
+                          OFFSET"reclaim them when the barrier is released. This option requires\n"
+                          OFFSET"--mode=async and the LeWI mask policy.",
+        .offset         = offsetof(options_t, lewi_barrier_handoff),
+        .type           = OPT_BOOL_T,
+        .flags          = (option_flags_t)(OPT_OPTIONAL | OPT_READONLY | OPT_ADVANCED)
     }, {
         .var_name       = "LB_NULL",
         .arg_name       = "--lewi-affinity",
@@ -354,6 +367,41 @@ static const opts_dict_t options_dictionary[] = {
         .offset         = offsetof(options_t, lewi_max_parallelism),
         .type           = OPT_INT_T,
         .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL)
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-shrink",
+        .default_value  = "no",
+        .description    = OFFSET"At the end of each iteration, lend the CPUs that do not\n"
+                          OFFSET"shorten the iteration time, and reclaim them back if the\n"
+                          OFFSET"iterations become slower. Iterations are detected from the\n"
+                          OFFSET"sequence of MPI calls, or delimited by the region set in\n"
+                          OFFSET"--lewi-shrink-region. This option requires the LeWI mask policy.",
+        .offset         = offsetof(options_t, lewi_shrink),
+        .type           = OPT_BOOL_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL)
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-shrink-region",
+        .default_value  = "",
+        .description    = OFFSET"Name of the TALP region whose starts delimit the iterations\n"
+                          OFFSET"for --lewi-shrink, instead of detecting them from the MPI\n"
+                          OFFSET"calls. This option requires --talp.",
+        .offset         = offsetof(options_t, lewi_shrink_region),
+        .type           = OPT_STR_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED)
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--lewi-callback-window",
+        .default_value  = "0",
+        .description    = OFFSET"Time in microseconds during which the CPUs borrowed by the\n"
+                          OFFSET"process are deferred and merged into a single callback,\n"
+                          OFFSET"notified at the next DLB call or when the window expires.\n"
+                          OFFSET"Reclaimed or acquired CPUs and CPUs to disable are never\n"
+                          OFFSET"deferred. This option is only supported by the LeWI mask\n"
+                          OFFSET"policy.",
+        .offset         = offsetof(options_t, lewi_callback_window),
+        .type           = OPT_INT_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED)
     }, {
         .var_name       = "LB_NULL",
         .arg_name       = "--lewi-color",
@@ -384,6 +432,48 @@ static const opts_dict_t options_dictionary[] = {
         .type           = OPT_BOOL_T,
         .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL)
     },
+    {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--talp-perf",
+        .default_value  = "no",
+        .description    = OFFSET"Select whether to collect hardware counters through the Linux\n"
+                          OFFSET"perf_event interface. It does not require PAPI support.",
+        .offset         = offsetof(options_t, talp_perf),
+        .type           = OPT_BOOL_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL)
+    },
+    {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--talp-counters",
+        .default_value  = "PAPI_TOT_CYC,PAPI_TOT_INS",
+        .description    = OFFSET"Comma separated list of PAPI preset or native events that\n"
+                          OFFSET"TALP collects when --talp-papi is enabled. With --talp-perf,\n"
+                          OFFSET"use perf event names (cycles, instructions, cache-misses,\n"
+                          OFFSET"stalled-cycles-backend, ...), their PAPI preset equivalents,\n"
+                          OFFSET"or raw events (r<hex>). Events that are not\n"
+                          OFFSET"available, or that cannot be counted together with the\n"
+                          OFFSET"previous ones, are discarded with a warning.\n"
+                          OFFSET"If PAPI_FP_OPS (or PAPI_DP_OPS, PAPI_SP_OPS) or PAPI_MEM_SCY\n"
+                          OFFSET"(or PAPI_RES_STL) are collected, TALP also reports GFLOP/s\n"
+                          OFFSET"and the memory-bound fraction of the useful cycles.\n"
+                          OFFSET"\n"
+                          OFFSET"e.g.: --talp-counters=PAPI_TOT_CYC,PAPI_TOT_INS,PAPI_FP_OPS",
+        .offset         = offsetof(options_t, talp_counters),
+        .type           = OPT_STR_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL)
+    },
+    {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--talp-counters-threshold",
+        .default_value  = "0",
+        .description    = OFFSET"Minimum duration in nanoseconds of a not useful interval to\n"
+                          OFFSET"exclude its hardware counters from the useful ones. Shorter\n"
+                          OFFSET"intervals skip reading the counters, at the cost of some\n"
+                          OFFSET"accuracy.",
+        .offset         = offsetof(options_t, talp_counters_threshold),
+        .type           = OPT_INT_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED)
+    },
     {
         .var_name       = "LB_TALP_SUMM",
         .arg_name       = "--talp-summary",
@@ -524,6 +614,26 @@ static const opts_dict_t options_dictionary[] = {
         .offset         = offsetof(options_t, shm_size_multiplier),
         .type           = OPT_INT_T,
         .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED)
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--topology-cache",
+        .default_value  = "no",
+        .description    = OFFSET"Cache the node topology in a file, so that subsequent DLB\n"
+                          OFFSET"processes and utilities do not need to parse it again. The\n"
+                          OFFSET"cache is identified by the hostname, the kernel boot id, and\n"
+                          OFFSET"the cgroup cpuset and affinity of the process. Cache files\n"
+                          OFFSET"are removed with dlb_shm --delete.",
+        .offset         = offsetof(options_t, topology_cache),
+        .type           = OPT_BOOL_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED)
+    }, {
+        .var_name       = "LB_NULL",
+        .arg_name       = "--topology-cache-dir",
+        .default_value  = "/dev/shm",
+        .description    = OFFSET"Directory where the node topology cache is stored.",
+        .offset         = offsetof(options_t, topology_cache_dir),
+        .type           = OPT_STR_T,
+        .flags          = (option_flags_t)(OPT_READONLY | OPT_OPTIONAL | OPT_ADVANCED)
     }, {
         .var_name       = "LB_PREINIT_PID",
         .arg_name       = "--preinit-pid",
@@ -555,14 +665,48 @@ static const opts_dict_t options_dictionary[] = {
 enum { NUM_OPTIONS = sizeof(options_dictionary)/sizeof(opts_dict_t) };
 
 
+/* Open addressing hash table of both variable and argument names. Each slot
+ * contains the index of the option in the dictionary plus one, or 0 if empty */
+enum { NAMES_TABLE_SIZE = 512 };
+static short names_table[NAMES_TABLE_SIZE];
+static pthread_once_t names_table_once = PTHREAD_ONCE_INIT;
+
+static void names_table_insert(const char *name, int index) {
+    size_t slot = hash_fnv1a_64_nocase(name, MAX_OPTION_LENGTH) & (NAMES_TABLE_SIZE - 1);
+    while (names_table[slot] != 0) {
+        /* Several entries share the same variable name (LB_NULL), keep the
+         * first one, as the former linear search did */
+        const opts_dict_t *entry = &options_dictionary[names_table[slot]-1];
+        if (strcasecmp(entry->var_name, name) == 0
+                || strcasecmp(entry->arg_name, name) == 0) {
+            return;
+        }
+        slot = (slot + 1) & (NAMES_TABLE_SIZE - 1);
+    }
+    names_table[slot] = index + 1;
+}
+
+static void names_table_init(void) {
+    static_ensure(NAMES_TABLE_SIZE >= NUM_OPTIONS * 4);
+    static_ensure((NAMES_TABLE_SIZE & (NAMES_TABLE_SIZE - 1)) == 0);
+
+    for (int i = 0; i < NUM_OPTIONS; ++i) {
+        names_table_insert(options_dictionary[i].var_name, i);
+        names_table_insert(options_dictionary[i].arg_name, i);
+    }
+}
+
 static const opts_dict_t* get_entry_by_name(const char *name) {
-    int i;
-    for (i=0; i<NUM_OPTIONS; ++i) {
-        const opts_dict_t *entry = &options_dictionary[i];
+    pthread_once(&names_table_once, names_table_init);
+
+    size_t slot = hash_fnv1a_64_nocase(name, MAX_OPTION_LENGTH) & (NAMES_TABLE_SIZE - 1);
+    while (names_table[slot] != 0) {
+        const opts_dict_t *entry = &options_dictionary[names_table[slot]-1];
         if (strcasecmp(entry->var_name, name) == 0
                 || strcasecmp(entry->arg_name, name) == 0) {
             return entry;
         }
+        slot = (slot + 1) & (NAMES_TABLE_SIZE - 1);
     }
     return NULL;
 }
@@ -974,50 +1118,121 @@ void options_finalize(options_t *options) {
     }
 }
 
-/* Obtain value of specific entry, either from DLB_ARGS or from thread_spd->options */
-void options_parse_entry(const char *var_name, void *option) {
-    const opts_dict_t *entry = get_entry_by_name(var_name);
-    ensure(entry, "%s: bad variable name '%s'", __func__, var_name);
+/* Values of DLB_ARGS parsed once for all the options_parse_entry calls before
+ * DLB is initialized. A snapshot is immutable, a new one is only built if
+ * DLB_ARGS changes. */
+typedef struct preinit_snapshot_t {
+    char *dlb_args;                     /* copy of DLB_ARGS, or NULL */
+    char *tokens;                       /* tokenized copy of DLB_ARGS */
+    const char *values[NUM_OPTIONS];    /* rhs of each option, or NULL */
+    struct preinit_snapshot_t *prev;    /* older snapshots, freed at exit */
+} preinit_snapshot_t;
 
-    if (thread_spd && thread_spd->dlb_initialized) {
-        copy_value(entry->type, option, (char*)&thread_spd->options + entry->offset);
-    } else {
-        /* Simplified options_init just for this entry */
+static preinit_snapshot_t *preinit_snapshot = NULL;
+static pthread_mutex_t preinit_snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-        /* Copy DLB_ARGS into a local buffer */
-        char *dlb_args_from_env = NULL;
-        const char *env = getenv("DLB_ARGS");
-        if (env) {
-            size_t len = strlen(env) + 1;
-            dlb_args_from_env = malloc(sizeof(char)*len);
-            strcpy(dlb_args_from_env, env);
-        }
+static preinit_snapshot_t* preinit_snapshot_new(const char *dlb_args) {
+    preinit_snapshot_t *snapshot = malloc(sizeof(preinit_snapshot_t));
+    *snapshot = (const preinit_snapshot_t) {};
+    if (dlb_args == NULL) return snapshot;
 
-        /* Pointer to rhs to be parsed */
-        const char *rhs = NULL;
+    size_t len = strlen(dlb_args) + 1;
+    snapshot->dlb_args = malloc(sizeof(char)*len);
+    strcpy(snapshot->dlb_args, dlb_args);
+    snapshot->tokens = malloc(sizeof(char)*len);
+    strcpy(snapshot->tokens, dlb_args);
 
-        /* Set-up specific argument length */
-        size_t arg_max_len;
-        switch (entry->type) {
-            case OPT_PTR_PATH_T:
-                arg_max_len = PATH_MAX-1;
-                break;
-            default:
-                arg_max_len = MAX_OPTION_LENGTH-1;
-                break;
+    /* Same format as parse_dlb_args, but all options are parsed at once */
+    char *end_space = NULL;
+    char *token = strtok_r(snapshot->tokens, " ", &end_space);
+    while (token) {
+        char *value;
+        const opts_dict_t *entry;
+        if (strchr(token, '=')) {
+            /* Option is of the form --argument=value */
+            char *end_equal;
+            char *argument = strtok_r(token, "=", &end_equal);
+            value = strtok_r(NULL, "=", &end_equal);
+            entry = get_entry_by_name(argument);
+            if (entry && strcmp(entry->arg_name, argument) != 0) entry = NULL;
+        } else {
+            /* Option is of the form --argument/--no-argument */
+            value = NULL;
+            entry = get_entry_by_name(token);
+            if (entry && strcmp(entry->arg_name, token) == 0) {
+                snapshot->values[entry - options_dictionary] = "yes";
+            } else if (strncmp(token, "--no-", 5) == 0) {
+                char argument[MAX_OPTION_LENGTH];
+                snprintf(argument, MAX_OPTION_LENGTH, "--%s", token+5);
+                entry = get_entry_by_name(argument);
+                if (entry && strcmp(entry->arg_name, argument) == 0) {
+                    snapshot->values[entry - options_dictionary] = "no";
+                }
+            }
         }
 
-        /* Preallocate a buffer large enough to save the option value */
-        char *arg_value_from_env = malloc(sizeof(char)*(arg_max_len+1));
-        arg_value_from_env[0] = '\0';
-
-        /* Parse DLB_ARGS from env */
-        if (dlb_args_from_env) {
-            parse_dlb_args(dlb_args_from_env, entry->arg_name, arg_value_from_env, arg_max_len);
-            if (strlen(arg_value_from_env) > 0) {
-                rhs = arg_value_from_env;
+        if (entry && value) {
+            /* Truncate value as parse_dlb_args does */
+            size_t arg_max_len = entry->type == OPT_PTR_PATH_T
+                ? PATH_MAX-1 : MAX_OPTION_LENGTH-1;
+            if (strlen(value) >= arg_max_len) {
+                value[arg_max_len-1] = '\0';
             }
+            snapshot->values[entry - options_dictionary] = value;
+        }
+
+        /* next token */
+        token = strtok_r(NULL, " ", &end_space);
+    }
+
+    return snapshot;
+}
+
+/* Get the snapshot of the current DLB_ARGS, building it if needed */
+static const preinit_snapshot_t* get_preinit_snapshot(void) {
+    const char *env = getenv("DLB_ARGS");
+    preinit_snapshot_t *snapshot;
+    pthread_mutex_lock(&preinit_snapshot_mutex);
+    {
+        snapshot = preinit_snapshot;
+        if (snapshot == NULL
+                || (env == NULL) != (snapshot->dlb_args == NULL)
+                || (env != NULL && strcmp(env, snapshot->dlb_args) != 0)) {
+            snapshot = preinit_snapshot_new(env);
+            snapshot->prev = preinit_snapshot;
+            preinit_snapshot = snapshot;
         }
+    }
+    pthread_mutex_unlock(&preinit_snapshot_mutex);
+    return snapshot;
+}
+
+__attribute__((destructor))
+static void preinit_snapshot_dtor(void) {
+    pthread_mutex_lock(&preinit_snapshot_mutex);
+    {
+        while (preinit_snapshot != NULL) {
+            preinit_snapshot_t *prev = preinit_snapshot->prev;
+            free(preinit_snapshot->dlb_args);
+            free(preinit_snapshot->tokens);
+            free(preinit_snapshot);
+            preinit_snapshot = prev;
+        }
+    }
+    pthread_mutex_unlock(&preinit_snapshot_mutex);
+}
+
+/* Obtain value of specific entry, either from DLB_ARGS or from thread_spd->options */
+void options_parse_entry(const char *var_name, void *option) {
+    const opts_dict_t *entry = get_entry_by_name(var_name);
+    ensure(entry, "%s: bad variable name '%s'", __func__, var_name);
+
+    if (thread_spd && thread_spd->dlb_initialized) {
+        copy_value(entry->type, option, (char*)&thread_spd->options + entry->offset);
+    } else {
+        /* Use the values of DLB_ARGS parsed at first use */
+        const preinit_snapshot_t *snapshot = get_preinit_snapshot();
+        const char *rhs = snapshot->values[entry - options_dictionary];
 
         /* Assign option = rhs, and nullify rhs if error */
         if (rhs) {
@@ -1031,12 +1246,6 @@ void options_parse_entry(const char *var_name, void *option) {
         if (!rhs) {
             set_value(entry->type, option, entry->default_value);
         }
-
-        /* Free buffers */
-        free(arg_value_from_env);
-        if (dlb_args_from_env) {
-            free(dlb_args_from_env);
-        }
     }
 }
 
@@ -51,13 +51,19 @@ typedef struct Options {
     mpi_set_t           lewi_mpi_calls;
     bool                lewi_barrier;
     char                lewi_barrier_select[MAX_OPTION_LENGTH];
+    bool                lewi_barrier_handoff;
     lewi_affinity_t     lewi_affinity;
     omptool_opts_t      lewi_ompt;
     int                 lewi_max_parallelism;
+    bool                lewi_shrink;
+    char                lewi_shrink_region[MAX_OPTION_LENGTH];
+    int                 lewi_callback_window;
     int                 lewi_color;
     /* misc */
     char                shm_key[MAX_OPTION_LENGTH];
     int                 shm_size_multiplier;
+    bool                topology_cache;
+    char                topology_cache_dir[MAX_OPTION_LENGTH];
     pid_t               preinit_pid;
     debug_opts_t        debug_opts;
     omptm_version_t     omptm_version;
@@ -65,6 +71,9 @@ typedef struct Options {
     bool                talp;
     bool                talp_openmp;
     bool                talp_papi;
+    bool                talp_perf;
+    char                talp_counters[MAX_OPTION_LENGTH];
+    int                 talp_counters_threshold;
     bool                talp_external_profiler;
     talp_summary_t      talp_summary;
     char                *talp_output_file;
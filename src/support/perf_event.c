@@ -0,0 +1,210 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "support/perf_event.h"
+
+#include "apis/dlb_errors.h"
+#include "support/debug.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static const struct {
+    const char *name;
+    const char *preset;
+    uint32_t type;
+    uint64_t config;
+} perf_event_table[] = {
+    {"cycles",                  "PAPI_TOT_CYC", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions",            "PAPI_TOT_INS", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"ref-cycles",              "PAPI_REF_CYC", PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES},
+    {"branches",                "PAPI_BR_INS",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses",           "PAPI_BR_MSP",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"cache-references",        "PAPI_L3_TCA",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache-misses",            "PAPI_L3_TCM",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"stalled-cycles-backend",  "PAPI_RES_STL", PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+    {"stalled-cycles-frontend", NULL,           PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+    {"task-clock",              NULL,           PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults",             NULL,           PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context-switches",        NULL,           PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {"cpu-migrations",          NULL,           PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+};
+
+enum { PERF_EVENT_TABLE_SIZE = sizeof(perf_event_table)/sizeof(perf_event_table[0]) };
+
+int perf_event_lookup(const char *name, perf_event_desc_t *desc, const char **preset) {
+    if (name == NULL) return DLB_ERR_NOENT;
+
+    for (int i = 0; i < PERF_EVENT_TABLE_SIZE; ++i) {
+        if (strcmp(name, perf_event_table[i].name) == 0
+                || (perf_event_table[i].preset != NULL
+                    && strcmp(name, perf_event_table[i].preset) == 0)) {
+            *desc = (const perf_event_desc_t) {
+                .type = perf_event_table[i].type,
+                .config = perf_event_table[i].config,
+            };
+            if (preset) *preset = perf_event_table[i].preset;
+            return DLB_SUCCESS;
+        }
+    }
+
+    /* Raw event, e.g.: r01c2 */
+    if (name[0] == 'r' && name[1] != '\0') {
+        char *endptr;
+        uint64_t config = strtoull(&name[1], &endptr, 16);
+        if (*endptr == '\0') {
+            *desc = (const perf_event_desc_t) {
+                .type = PERF_TYPE_RAW,
+                .config = config,
+            };
+            if (preset) *preset = NULL;
+            return DLB_SUCCESS;
+        }
+    }
+
+    return DLB_ERR_NOENT;
+}
+
+int perf_event_group_open(perf_event_group_t *group,
+        const perf_event_desc_t *descs, int num) {
+
+    *group = (const perf_event_group_t) {};
+    if (num <= 0 || num > PERF_EVENT_GROUP_MAX) return DLB_ERR_UNKNOWN;
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < num; ++i) {
+        struct perf_event_attr attr = {
+            .size = sizeof(struct perf_event_attr),
+            .type = descs[i].type,
+            .config = descs[i].config,
+            .exclude_kernel = 1,
+            .exclude_hv = 1,
+        };
+
+        /* Calling thread, any CPU, the first event is the group leader */
+        int group_fd = i == 0 ? -1 : group->fds[0];
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+        if (fd == -1) {
+            int error = errno == EACCES || errno == EPERM ? DLB_ERR_PERM : DLB_ERR_NOENT;
+            verbose(VB_TALP, "perf_event_open failed for event %d: %s", i, strerror(errno));
+            perf_event_group_close(group);
+            return error;
+        }
+        group->fds[i] = fd;
+        group->num = i + 1;
+
+        /* The mmap'd page is only needed for rdpmc, ignore errors */
+        void *page = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+        group->pages[i] = page != MAP_FAILED ? page : NULL;
+    }
+
+    return DLB_SUCCESS;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t rdpmc(uint32_t counter) {
+    uint32_t low, high;
+    __asm__ volatile("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+    return low | ((uint64_t)high << 32);
+}
+
+/* Read the counter in user space, as described in linux/perf_event.h.
+ * Return false if the event cannot be read with rdpmc */
+static inline bool read_mmap_page(const struct perf_event_mmap_page *page,
+        int64_t *value) {
+    uint32_t seq;
+    int64_t count;
+    do {
+        seq = page->lock;
+        __asm__ volatile("" ::: "memory");
+        if (!page->cap_user_rdpmc || page->index == 0) return false;
+        uint32_t index = page->index;
+        uint16_t width = page->pmc_width;
+        count = page->offset;
+        int64_t pmc = rdpmc(index - 1);
+        pmc <<= 64 - width;
+        pmc >>= 64 - width;
+        count += pmc;
+        __asm__ volatile("" ::: "memory");
+    } while (page->lock != seq);
+
+    *value = count;
+    return true;
+}
+#endif
+
+void perf_event_group_read(const perf_event_group_t *group, int64_t *values) {
+    for (int i = 0; i < group->num; ++i) {
+#if defined(__x86_64__) || defined(__i386__)
+        if (group->pages[i] != NULL
+                && read_mmap_page(group->pages[i], &values[i])) {
+            continue;
+        }
+#endif
+        uint64_t count;
+        if (read(group->fds[i], &count, sizeof(count)) == (ssize_t)sizeof(count)) {
+            values[i] = count;
+        } else {
+            values[i] = 0;
+        }
+    }
+}
+
+void perf_event_group_close(perf_event_group_t *group) {
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (int i = group->num-1; i >= 0; --i) {
+        if (group->pages[i] != NULL) {
+            munmap(group->pages[i], page_size);
+        }
+        close(group->fds[i]);
+    }
+    *group = (const perf_event_group_t) {};
+}
+
+#else /* HAVE_LINUX_PERF_EVENT_H */
+
+int perf_event_lookup(const char *name, perf_event_desc_t *desc, const char **preset) {
+    return DLB_ERR_NOCOMP;
+}
+
+int perf_event_group_open(perf_event_group_t *group,
+        const perf_event_desc_t *descs, int num) {
+    *group = (const perf_event_group_t) {};
+    return DLB_ERR_NOCOMP;
+}
+
+void perf_event_group_read(const perf_event_group_t *group, int64_t *values) {
+}
+
+void perf_event_group_close(perf_event_group_t *group) {
+}
+
+#endif /* HAVE_LINUX_PERF_EVENT_H */
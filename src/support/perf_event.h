@@ -0,0 +1,55 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef PERF_EVENT_H
+#define PERF_EVENT_H
+
+#include <stdint.h>
+
+/* Hardware counters through the Linux perf_event_open interface
+ *
+ * Each thread opens its own group of counters. The counters are never reset,
+ * the caller keeps the last values and computes the deltas. When the kernel
+ * allows it, counters are read in user space with rdpmc through the mmap'd
+ * page of each event, otherwise they fall back to a read() system call.
+ */
+
+enum { PERF_EVENT_GROUP_MAX = 8 };
+
+typedef struct perf_event_desc_t {
+    uint32_t type;
+    uint64_t config;
+} perf_event_desc_t;
+
+typedef struct perf_event_group_t {
+    int num;
+    int fds[PERF_EVENT_GROUP_MAX];
+    void *pages[PERF_EVENT_GROUP_MAX];
+} perf_event_group_t;
+
+/* Resolve an event name: perf tool names (e.g., "cycles"), the equivalent PAPI
+ * preset names (e.g., "PAPI_TOT_CYC"), or raw events ("r<hex>").
+ * If not NULL, preset is set to the equivalent PAPI preset name, or NULL. */
+int  perf_event_lookup(const char *name, perf_event_desc_t *desc, const char **preset);
+int  perf_event_group_open(perf_event_group_t *group,
+        const perf_event_desc_t *descs, int num);
+void perf_event_group_read(const perf_event_group_t *group, int64_t *values);
+void perf_event_group_close(perf_event_group_t *group);
+
+#endif /* PERF_EVENT_H */
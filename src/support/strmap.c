@@ -0,0 +1,167 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "support/strmap.h"
+
+#include "support/debug.h"
+#include "support/hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum { STRMAP_INITIAL_CAPACITY = 16 };
+enum { STRMAP_KEYS_CHUNK_SIZE = 16 * 1024 };
+
+void strmap_init(strmap_t *map, size_t max_key_len) {
+    *map = (const strmap_t) {
+        .max_key_len = max_key_len,
+        .keys = { .chunk_size = STRMAP_KEYS_CHUNK_SIZE },
+    };
+}
+
+void strmap_destroy(strmap_t *map) {
+    free(map->entries);
+    free(map->slots);
+    arena_free_all(&map->keys);
+    strmap_init(map, map->max_key_len);
+}
+
+/* Return the slot of key, either the one containing it or the empty one where
+ * it would be inserted */
+static strmap_slot_t* find_slot(const strmap_t *map, const char *key, uint64_t hash) {
+    unsigned int mask = map->num_slots - 1;
+    unsigned int i = hash & mask;
+    while (map->slots[i].index != 0) {
+        const strmap_slot_t *slot = &map->slots[i];
+        if (slot->hash == (uint32_t)hash) {
+            const strmap_entry_t *entry = &map->entries[slot->index - 1];
+            if (entry->hash == hash
+                    && strncmp(entry->key, key, map->max_key_len) == 0) {
+                break;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+    return &map->slots[i];
+}
+
+/* Keep the load factor of the slots table below 1/2 */
+static void grow(strmap_t *map) {
+    map->capacity = map->capacity > 0 ? map->capacity * 2 : STRMAP_INITIAL_CAPACITY;
+    map->entries = realloc(map->entries, sizeof(strmap_entry_t) * map->capacity);
+    fatal_cond(!map->entries, "Could not allocate hash map");
+
+    free(map->slots);
+    map->num_slots = map->capacity * 2;
+    map->slots = calloc(map->num_slots, sizeof(strmap_slot_t));
+    fatal_cond(!map->slots, "Could not allocate hash map");
+
+    /* Rehash, all keys are different */
+    unsigned int mask = map->num_slots - 1;
+    for (unsigned int index = 0; index < map->size; ++index) {
+        uint64_t hash = map->entries[index].hash;
+        unsigned int i = hash & mask;
+        while (map->slots[i].index != 0) {
+            i = (i + 1) & mask;
+        }
+        map->slots[i] = (const strmap_slot_t) {
+            .hash = (uint32_t)hash,
+            .index = index + 1,
+        };
+    }
+}
+
+void* strmap_lookup(const strmap_t *map, const char *key) {
+    if (map->size == 0) return NULL;
+
+    uint64_t hash = hash_fnv1a_64(key, map->max_key_len);
+    const strmap_slot_t *slot = find_slot(map, key, hash);
+    return slot->index != 0 ? map->entries[slot->index - 1].value : NULL;
+}
+
+/* Insert key with value, or replace the value if key exists.
+ * Return the interned key */
+const char* strmap_insert(strmap_t *map, const char *key, void *value) {
+    if (map->size == map->capacity) {
+        grow(map);
+    }
+
+    uint64_t hash = hash_fnv1a_64(key, map->max_key_len);
+    strmap_slot_t *slot = find_slot(map, key, hash);
+
+    if (slot->index != 0) {
+        strmap_entry_t *entry = &map->entries[slot->index - 1];
+        entry->value = value;
+        return entry->key;
+    }
+
+    /* Intern key */
+    size_t key_len = strnlen(key, map->max_key_len);
+    char *interned_key = arena_alloc(&map->keys, key_len + 1);
+    fatal_cond(!interned_key, "Could not allocate hash map");
+    memcpy(interned_key, key, key_len);
+
+    map->entries[map->size] = (const strmap_entry_t) {
+        .key = interned_key,
+        .hash = hash,
+        .value = value,
+    };
+    *slot = (const strmap_slot_t) {
+        .hash = (uint32_t)hash,
+        .index = ++map->size,
+    };
+
+    return interned_key;
+}
+
+unsigned int strmap_size(const strmap_t *map) {
+    return map->size;
+}
+
+/* Return the value of the index-th inserted entry */
+void* strmap_value_at(const strmap_t *map, unsigned int index) {
+    return index < map->size ? map->entries[index].value : NULL;
+}
+
+static int cmp_entry_keys(const void *a, const void *b) {
+    const strmap_entry_t *entry_a = *(const strmap_entry_t**)a;
+    const strmap_entry_t *entry_b = *(const strmap_entry_t**)b;
+    return strcmp(entry_a->key, entry_b->key);
+}
+
+/* Fill values (of at least strmap_size elements) sorted by key, e.g., for
+ * iterating in the same order in different processes */
+void strmap_sorted_values(const strmap_t *map, void **values) {
+    if (map->size == 0) return;
+
+    const strmap_entry_t **sorted = malloc(sizeof(strmap_entry_t*) * map->size);
+    fatal_cond(!sorted, "Could not allocate hash map");
+    for (unsigned int i = 0; i < map->size; ++i) {
+        sorted[i] = &map->entries[i];
+    }
+    qsort(sorted, map->size, sizeof(strmap_entry_t*), cmp_entry_keys);
+    for (unsigned int i = 0; i < map->size; ++i) {
+        values[i] = sorted[i]->value;
+    }
+    free(sorted);
+}
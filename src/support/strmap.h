@@ -0,0 +1,66 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef STRMAP_H
+#define STRMAP_H
+
+#include "support/arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* String-keyed hash map with open addressing.
+ *
+ * Entries are stored contiguously in insertion order, which is also the
+ * iteration order. The open addressing table only contains the index of the
+ * entry and the lower bits of its hash, so a lookup usually compares a single
+ * key. Keys are compared up to max_key_len characters and they are interned:
+ * the map keeps its own copy, which is valid until strmap_destroy.
+ * Entries cannot be removed. Not thread-safe. */
+
+typedef struct StrMapEntry {
+    const char  *key;           /* interned key */
+    uint64_t    hash;
+    void        *value;
+} strmap_entry_t;
+
+typedef struct StrMapSlot {
+    uint32_t    hash;           /* lower bits of the entry hash */
+    uint32_t    index;          /* entry index + 1, or 0 if empty */
+} strmap_slot_t;
+
+typedef struct StrMap {
+    strmap_entry_t  *entries;
+    unsigned int    size;
+    unsigned int    capacity;
+    strmap_slot_t   *slots;
+    unsigned int    num_slots;  /* power of two */
+    size_t          max_key_len;
+    arena_t         keys;
+} strmap_t;
+
+void strmap_init(strmap_t *map, size_t max_key_len);
+void strmap_destroy(strmap_t *map);
+void* strmap_lookup(const strmap_t *map, const char *key);
+const char* strmap_insert(strmap_t *map, const char *key, void *value);
+unsigned int strmap_size(const strmap_t *map);
+void* strmap_value_at(const strmap_t *map, unsigned int index);
+void strmap_sorted_values(const strmap_t *map, void **values);
+
+#endif /* STRMAP_H */
@@ -0,0 +1,308 @@
+/*********************************************************************************/
+/*  Copyright 2009-2021 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "support/timers.h"
+
+#include "apis/dlb_errors.h"
+#include "support/atomic.h"
+#include "support/debug.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Log-linear histogram (HDR-style): values are grouped by their power of two,
+ * and each power of two is split into HIST_SUB_COUNT linear sub-buckets.
+ * With 16 sub-buckets the relative error of any recorded value is < 6.25%.
+ * Values below HIST_SUB_COUNT ns are stored exactly, and values over
+ * 2^HIST_MAX_EXP ns (~18 minutes) are clamped into the last bucket. */
+enum {
+    HIST_SUB_BITS   = 4,
+    HIST_SUB_COUNT  = 1 << HIST_SUB_BITS,
+    HIST_MAX_EXP    = 40,
+    HIST_NBUCKETS   = (HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB_COUNT,
+};
+
+typedef struct TimerHistogram {
+    int64_t count;
+    int64_t sum;
+    int64_t min;
+    int64_t max;
+    int64_t buckets[HIST_NBUCKETS];
+} timer_hist_t;
+
+/* Per-thread timers, linked so that they can be aggregated when reporting.
+ * Only the owner thread writes its histograms; a reset only increments the
+ * global epoch, and each thread clears its own histograms on the next record
+ * if its epoch is outdated. */
+typedef struct ThreadTimers {
+    struct ThreadTimers *next;
+    atomic_uint epoch;
+    timer_hist_t hist[TIMER_NUM_TIMERS];
+} thread_timers_t;
+
+static const char* const timer_names[TIMER_NUM_TIMERS] = {
+    [TIMER_SHMEM_LOCK_WAIT] = "shmem lock wait",
+    [TIMER_SHMEM_LOCK_HOLD] = "shmem lock hold",
+    [TIMER_LEND]            = "lend",
+    [TIMER_RECLAIM]         = "reclaim",
+    [TIMER_POLLDROM]        = "polldrom",
+    [TIMER_TALP_FLUSH]      = "TALP flush",
+};
+
+bool timers_enabled = false;
+
+static pthread_mutex_t timers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int timers_users = 0;
+static atomic_uint timers_epoch = 0;
+static thread_timers_t *timers_list = NULL;
+static __thread thread_timers_t *thread_timers = NULL;
+static pthread_key_t thread_timers_key;
+static pthread_once_t thread_timers_once = PTHREAD_ONCE_INIT;
+
+/* Samples of threads that have already exited */
+static timer_hist_t retired_hist[TIMER_NUM_TIMERS];
+
+static inline int get_bucket_index(int64_t value) {
+    if (value < HIST_SUB_COUNT) {
+        return value < 0 ? 0 : (int)value;
+    }
+    uint64_t uvalue = (uint64_t)value;
+    int exp = 63 - __builtin_clzll(uvalue);
+    if (exp >= HIST_MAX_EXP) {
+        return HIST_NBUCKETS - 1;
+    }
+    int shift = exp - HIST_SUB_BITS;
+    int sub = (int)((uvalue >> shift) & (HIST_SUB_COUNT - 1));
+    return (shift + 1) * HIST_SUB_COUNT + sub;
+}
+
+static inline int64_t get_bucket_lower_bound(int index) {
+    if (index < HIST_SUB_COUNT) {
+        return index;
+    }
+    int shift = index / HIST_SUB_COUNT - 1;
+    int sub = index % HIST_SUB_COUNT;
+    return (int64_t)(HIST_SUB_COUNT + sub) << shift;
+}
+
+static inline int64_t get_bucket_width(int index) {
+    return index < HIST_SUB_COUNT ? 1 : INT64_C(1) << (index / HIST_SUB_COUNT - 1);
+}
+
+static void merge_hist(timer_hist_t *restrict result,
+        const timer_hist_t *restrict hist) {
+    if (hist->count == 0) return;
+    if (result->count == 0 || hist->min < result->min) result->min = hist->min;
+    if (hist->max > result->max) result->max = hist->max;
+    result->count += hist->count;
+    result->sum += hist->sum;
+    for (int i = 0; i < HIST_NBUCKETS; ++i) {
+        result->buckets[i] += hist->buckets[i];
+    }
+}
+
+/* Key destructor: keep the samples of the exiting thread and free its timers */
+static void thread_timers_destroy(void *arg) {
+    thread_timers_t *timers = arg;
+    pthread_mutex_lock(&timers_mutex);
+    {
+        if (DLB_ATOMIC_LD_ACQ(&timers->epoch) == DLB_ATOMIC_LD(&timers_epoch)) {
+            for (int id = 0; id < TIMER_NUM_TIMERS; ++id) {
+                merge_hist(&retired_hist[id], &timers->hist[id]);
+            }
+        }
+        thread_timers_t **prev = &timers_list;
+        while (*prev != timers) {
+            prev = &(*prev)->next;
+        }
+        *prev = timers->next;
+    }
+    pthread_mutex_unlock(&timers_mutex);
+    free(timers);
+}
+
+static void thread_timers_key_create(void) {
+    pthread_key_create(&thread_timers_key, thread_timers_destroy);
+}
+
+static thread_timers_t* register_thread_timers(void) {
+    thread_timers_t *timers = calloc(1, sizeof(thread_timers_t));
+    fatal_cond(timers == NULL, "Could not allocate internal timers");
+    pthread_once(&thread_timers_once, thread_timers_key_create);
+    pthread_setspecific(thread_timers_key, timers);
+    pthread_mutex_lock(&timers_mutex);
+    {
+        DLB_ATOMIC_ST_RLX(&timers->epoch, DLB_ATOMIC_LD(&timers_epoch));
+        timers->next = timers_list;
+        timers_list = timers;
+    }
+    pthread_mutex_unlock(&timers_mutex);
+    return timers;
+}
+
+/* Timers are reference counted, so that they stay enabled until every
+ * subprocess that enabled them has finalized */
+void timers_init(void) {
+    pthread_mutex_lock(&timers_mutex);
+    {
+        if (timers_users++ == 0) {
+            timers_enabled = true;
+        }
+    }
+    pthread_mutex_unlock(&timers_mutex);
+}
+
+/* The last user prints and disables the timers. If timers are enabled
+ * again, they start from zero. */
+void timers_finalize(void) {
+    bool last_user = false;
+    pthread_mutex_lock(&timers_mutex);
+    {
+        if (timers_users > 0) {
+            last_user = --timers_users == 0;
+        }
+    }
+    pthread_mutex_unlock(&timers_mutex);
+
+    if (last_user) {
+        timers_report();
+        timers_enabled = false;
+        timers_reset();
+    }
+}
+
+void timers_reset(void) {
+    pthread_mutex_lock(&timers_mutex);
+    {
+        DLB_ATOMIC_ADD(&timers_epoch, 1);
+        memset(retired_hist, 0, sizeof(retired_hist));
+    }
+    pthread_mutex_unlock(&timers_mutex);
+}
+
+void timer_record(timer_id_t id, int64_t elapsed) {
+    thread_timers_t *timers = thread_timers;
+    if (unlikely(timers == NULL)) {
+        timers = thread_timers = register_thread_timers();
+    }
+
+    unsigned int epoch = DLB_ATOMIC_LD_RLX(&timers_epoch);
+    if (unlikely(DLB_ATOMIC_LD_RLX(&timers->epoch) != epoch)) {
+        memset(timers->hist, 0, sizeof(timers->hist));
+        DLB_ATOMIC_ST_REL(&timers->epoch, epoch);
+    }
+
+    timer_hist_t *hist = &timers->hist[id];
+    if (hist->count == 0 || elapsed < hist->min) hist->min = elapsed;
+    if (elapsed > hist->max) hist->max = elapsed;
+    ++hist->count;
+    hist->sum += elapsed;
+    ++hist->buckets[get_bucket_index(elapsed)];
+}
+
+/* Obtain the value at the given percentile from an aggregated histogram.
+ * The middle of the bucket is returned, clamped to the recorded range. */
+static int64_t get_percentile(const timer_hist_t *hist, int percentile) {
+    int64_t rank = (hist->count * percentile + 99) / 100;
+    if (rank < 1) rank = 1;
+    int64_t accumulated = 0;
+    for (int i = 0; i < HIST_NBUCKETS; ++i) {
+        accumulated += hist->buckets[i];
+        if (accumulated >= rank) {
+            int64_t value = get_bucket_lower_bound(i) + get_bucket_width(i) / 2;
+            if (value < hist->min) value = hist->min;
+            if (value > hist->max) value = hist->max;
+            return value;
+        }
+    }
+    return hist->max;
+}
+
+/* Aggregate all threads' histograms. Other threads may be recording samples
+ * concurrently, so the result is a best-effort snapshot. Histograms from a
+ * previous epoch are pending to be cleared by their owner and are skipped. */
+static void aggregate(timer_id_t id, timer_hist_t *result) {
+    memset(result, 0, sizeof(timer_hist_t));
+    pthread_mutex_lock(&timers_mutex);
+    {
+        unsigned int epoch = DLB_ATOMIC_LD(&timers_epoch);
+        merge_hist(result, &retired_hist[id]);
+        for (thread_timers_t *timers = timers_list; timers != NULL;
+                timers = timers->next) {
+            if (DLB_ATOMIC_LD_ACQ(&timers->epoch) == epoch) {
+                merge_hist(result, &timers->hist[id]);
+            }
+        }
+    }
+    pthread_mutex_unlock(&timers_mutex);
+}
+
+int timers_get_stats(timer_id_t id, timer_stats_t *stats) {
+    if (id < 0 || id >= TIMER_NUM_TIMERS || stats == NULL) return DLB_ERR_UNKNOWN;
+
+    timer_hist_t *hist = malloc(sizeof(timer_hist_t));
+    if (hist == NULL) return DLB_ERR_NOMEM;
+    aggregate(id, hist);
+
+    if (hist->count == 0) {
+        *stats = (const timer_stats_t) {};
+    } else {
+        *stats = (const timer_stats_t) {
+            .count = hist->count,
+            .min = hist->min,
+            .max = hist->max,
+            .avg = hist->sum / hist->count,
+            .p50 = get_percentile(hist, 50),
+            .p90 = get_percentile(hist, 90),
+            .p99 = get_percentile(hist, 99),
+        };
+    }
+
+    free(hist);
+    return DLB_SUCCESS;
+}
+
+const char* timer_get_name(timer_id_t id) {
+    return id >= 0 && id < TIMER_NUM_TIMERS ? timer_names[id] : NULL;
+}
+
+void timers_report(void) {
+    enum { TIME_STR_LEN = 32 };
+    info("%-16s %10s %12s %12s %12s %12s %12s",
+            "Timer", "Count", "Avg", "p50", "p90", "p99", "Max");
+    for (int id = 0; id < TIMER_NUM_TIMERS; ++id) {
+        timer_stats_t stats;
+        if (timers_get_stats(id, &stats) != DLB_SUCCESS
+                || stats.count == 0) continue;
+        char avg[TIME_STR_LEN], p50[TIME_STR_LEN], p90[TIME_STR_LEN],
+             p99[TIME_STR_LEN], max[TIME_STR_LEN];
+        ns_to_human(avg, TIME_STR_LEN, stats.avg);
+        ns_to_human(p50, TIME_STR_LEN, stats.p50);
+        ns_to_human(p90, TIME_STR_LEN, stats.p90);
+        ns_to_human(p99, TIME_STR_LEN, stats.p99);
+        ns_to_human(max, TIME_STR_LEN, stats.max);
+        info("%-16s %10"PRId64" %12s %12s %12s %12s %12s",
+                timer_names[id], stats.count, avg, p50, p90, p99, max);
+    }
+}
@@ -0,0 +1,76 @@
+/*********************************************************************************/
+/*  Copyright 2009-2021 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include "support/dlb_common.h"
+#include "support/mytime.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Internal timers to measure DLB's own overhead. Each timer is a static
+ * handle, and each thread records its samples into a private log-linear
+ * histogram, so timer_stop never synchronizes with other threads.
+ * Timers are disabled by default and enabled with --debug-opts=timers. */
+
+typedef enum TimerId {
+    TIMER_SHMEM_LOCK_WAIT,
+    TIMER_SHMEM_LOCK_HOLD,
+    TIMER_LEND,
+    TIMER_RECLAIM,
+    TIMER_POLLDROM,
+    TIMER_TALP_FLUSH,
+    TIMER_NUM_TIMERS,
+} timer_id_t;
+
+typedef struct TimerStats {
+    int64_t count;
+    int64_t min;
+    int64_t max;
+    int64_t avg;
+    int64_t p50;
+    int64_t p90;
+    int64_t p99;
+} timer_stats_t;
+
+extern bool timers_enabled;
+
+void timers_init(void);
+void timers_finalize(void);
+void timers_reset(void);
+void timers_report(void);
+int  timers_get_stats(timer_id_t id, timer_stats_t *stats);
+const char* timer_get_name(timer_id_t id);
+void timer_record(timer_id_t id, int64_t elapsed);
+
+/* A start of 0 means that timers were disabled when the timer was started,
+ * and the sample is discarded even if they have been enabled since then */
+static inline int64_t timer_start(void) {
+    return unlikely(timers_enabled) ? get_time_in_ns() : 0;
+}
+
+static inline void timer_stop(timer_id_t id, int64_t start) {
+    if (unlikely(timers_enabled) && start != 0) {
+        timer_record(id, get_time_in_ns() - start);
+    }
+}
+
+#endif /* TIMERS_H */
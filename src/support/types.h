@@ -86,6 +86,7 @@ typedef enum DebugOptions {
     DBG_WERROR       = 1 << 1,
     DBG_LPOSTMORTEM  = 1 << 2,
     DBG_WARNMPI      = 1 << 3,
+    DBG_TIMERS       = 1 << 4,
 } debug_opts_t;
 
 typedef enum LewiAffinity {
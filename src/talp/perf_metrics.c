@@ -19,9 +19,13 @@
 
 #include "talp/perf_metrics.h"
 
+#include "LB_comm/shmem_talp.h"
 #include "LB_core/spd.h"
 #include "apis/dlb_talp.h"
 #include "support/debug.h"
+#include "support/types.h"
+#include "talp/regions.h"
+#include "talp/talp_output.h"
 #ifdef MPI_LIB
 #include "LB_MPI/process_MPI.h"
 #endif
@@ -276,6 +280,8 @@ typedef struct app_reduction_t {
     float avg_cpus;
     double cycles;
     double instructions;
+    double flops;
+    double mem_stalls;
     int64_t num_measurements;
     int64_t num_mpi_calls;
     int64_t num_omp_parallels;
@@ -304,6 +310,8 @@ static void mpi_reduction_fn(void *invec, void *inoutvec, int *len,
         inout[i].avg_cpus                += in[i].avg_cpus;
         inout[i].cycles                  += in[i].cycles;
         inout[i].instructions            += in[i].instructions;
+        inout[i].flops                   += in[i].flops;
+        inout[i].mem_stalls              += in[i].mem_stalls;
         inout[i].num_measurements        += in[i].num_measurements;
         inout[i].num_mpi_calls           += in[i].num_mpi_calls;
         inout[i].num_omp_parallels       += in[i].num_omp_parallels;
@@ -336,12 +344,17 @@ static void reduce_pop_metrics_app_reduction(app_reduction_t *app_reduction,
     double mpi_normd_of_max_useful = monitor->num_cpus == 0 ? 0.0
         : (double)monitor->mpi_time / monitor->num_cpus;
 
+    double flops, mem_stalls;
+    region_get_hwc_counts(thread_spd, monitor, &flops, &mem_stalls);
+
     const app_reduction_t app_reduction_send = {
         .num_cpus                = monitor->num_cpus,
         .num_nodes               = _process_id == 0 && node_reduction->node_used ? 1 : 0,
         .avg_cpus                = monitor->avg_cpus,
         .cycles                  = (double)monitor->cycles,
         .instructions            = (double)monitor->instructions,
+        .flops                   = flops,
+        .mem_stalls              = mem_stalls,
         .num_measurements        = monitor->num_measurements,
         .num_mpi_calls           = monitor->num_mpi_calls,
         .num_omp_parallels       = monitor->num_omp_parallels,
@@ -363,14 +376,16 @@ static void reduce_pop_metrics_app_reduction(app_reduction_t *app_reduction,
     /* MPI struct type: app_reduction_t */
     MPI_Datatype mpi_app_reduction_type;
     {
-        enum {count = 18};
-        int blocklengths[] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+        enum {count = 20};
+        int blocklengths[] = {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
         MPI_Aint displacements[] = {
             offsetof(app_reduction_t, num_cpus),
             offsetof(app_reduction_t, num_nodes),
             offsetof(app_reduction_t, avg_cpus),
             offsetof(app_reduction_t, cycles),
             offsetof(app_reduction_t, instructions),
+            offsetof(app_reduction_t, flops),
+            offsetof(app_reduction_t, mem_stalls),
             offsetof(app_reduction_t, num_measurements),
             offsetof(app_reduction_t, num_mpi_calls),
             offsetof(app_reduction_t, num_omp_parallels),
@@ -385,7 +400,7 @@ static void reduce_pop_metrics_app_reduction(app_reduction_t *app_reduction,
             offsetof(app_reduction_t, max_useful_normd_node),
             offsetof(app_reduction_t, mpi_normd_of_max_useful)};
         MPI_Datatype types[] = {MPI_INT, MPI_INT, MPI_FLOAT, MPI_DOUBLE,
-            MPI_DOUBLE, mpi_int64_type, mpi_int64_type, mpi_int64_type,
+            MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, mpi_int64_type, mpi_int64_type, mpi_int64_type,
             mpi_int64_type, mpi_int64_type, mpi_int64_type, mpi_int64_type,
             mpi_int64_type, mpi_int64_type, mpi_int64_type, MPI_DOUBLE,
             MPI_DOUBLE, MPI_DOUBLE};
@@ -424,6 +439,99 @@ static void reduce_pop_metrics_app_reduction(app_reduction_t *app_reduction,
 
 
 
+/* Construct a base metrics struct out of a single monitor of this process,
+ * without any communication. Process and node values are the process ones. */
+void perf_metrics__local_monitor_into_base_metrics(pop_base_metrics_t *base_metrics,
+        const dlb_monitor_t *monitor) {
+
+    int num_cpus = monitor->num_cpus;
+    double useful_normd_proc = num_cpus == 0 ? 0.0
+        : (double)monitor->useful_time / num_cpus;
+    double mpi_normd_proc = num_cpus == 0 ? 0.0
+        : (double)monitor->mpi_time / num_cpus;
+
+    double flops, mem_stalls;
+    region_get_hwc_counts(thread_spd, monitor, &flops, &mem_stalls);
+
+    *base_metrics = (const pop_base_metrics_t) {
+        .num_cpus                = num_cpus,
+        .num_mpi_ranks           = 0,
+        .num_nodes               = 1,
+        .avg_cpus                = monitor->avg_cpus,
+        .cycles                  = (double)monitor->cycles,
+        .instructions            = (double)monitor->instructions,
+        .flops                   = flops,
+        .mem_stalls              = mem_stalls,
+        .num_measurements        = monitor->num_measurements,
+        .num_mpi_calls           = monitor->num_mpi_calls,
+        .num_omp_parallels       = monitor->num_omp_parallels,
+        .num_omp_tasks           = monitor->num_omp_tasks,
+        .elapsed_time            = monitor->elapsed_time,
+        .useful_time             = monitor->useful_time,
+        .mpi_time                = monitor->mpi_time,
+        .omp_load_imbalance_time = monitor->omp_load_imbalance_time,
+        .omp_scheduling_time     = monitor->omp_scheduling_time,
+        .omp_serialization_time  = monitor->omp_serialization_time,
+        .useful_normd_app        = useful_normd_proc,
+        .mpi_normd_app           = mpi_normd_proc,
+        .max_useful_normd_proc   = useful_normd_proc,
+        .max_useful_normd_node   = useful_normd_proc,
+        .mpi_normd_of_max_useful = mpi_normd_proc,
+    };
+}
+
+/* Construct a base metrics struct out of the shared memory entries of all the
+ * processes in the node for one region, i.e., as if the node was the whole
+ * application. Processes that have not accumulated any time are skipped.
+ * The elapsed time is not kept in the shared memory, it is estimated as the
+ * maximum active time per CPU among processes. */
+void perf_metrics__node_regions_into_base_metrics(pop_base_metrics_t *base_metrics,
+        const talp_region_list_t *region_list, int nelems) {
+
+    *base_metrics = (const pop_base_metrics_t) {.num_nodes = 1};
+
+    double max_active_normd_proc = 0.0;
+    for (int i = 0; i < nelems; ++i) {
+        const talp_region_list_t *region = &region_list[i];
+        int64_t active_time = region->useful_time + region->mpi_time
+            + region->omp_load_imbalance_time + region->omp_scheduling_time
+            + region->omp_serialization_time;
+        if (active_time == 0) continue;
+
+        /* Processes that never flushed the OpenMP times have no num_cpus yet */
+        int num_cpus = region->num_cpus > 0 ? region->num_cpus
+            : max_int(1, (int)(region->avg_cpus + 0.5f));
+
+        ++base_metrics->num_mpi_ranks;
+        base_metrics->num_cpus += num_cpus;
+        base_metrics->avg_cpus += region->avg_cpus;
+        base_metrics->useful_time += region->useful_time;
+        base_metrics->mpi_time += region->mpi_time;
+        base_metrics->omp_load_imbalance_time += region->omp_load_imbalance_time;
+        base_metrics->omp_scheduling_time += region->omp_scheduling_time;
+        base_metrics->omp_serialization_time += region->omp_serialization_time;
+
+        double useful_normd_proc = (double)region->useful_time / num_cpus;
+        if (useful_normd_proc > base_metrics->max_useful_normd_proc) {
+            base_metrics->max_useful_normd_proc = useful_normd_proc;
+            base_metrics->mpi_normd_of_max_useful = (double)region->mpi_time / num_cpus;
+        }
+        double active_normd_proc = (double)active_time / num_cpus;
+        if (active_normd_proc > max_active_normd_proc) {
+            max_active_normd_proc = active_normd_proc;
+        }
+    }
+
+    if (base_metrics->num_cpus > 0) {
+        base_metrics->elapsed_time = (int64_t)max_active_normd_proc;
+        base_metrics->useful_normd_app =
+            (double)base_metrics->useful_time / base_metrics->num_cpus;
+        base_metrics->mpi_normd_app =
+            (double)base_metrics->mpi_time / base_metrics->num_cpus;
+        base_metrics->max_useful_normd_node = base_metrics->useful_normd_app;
+    }
+}
+
 #if MPI_LIB
 /* Construct a base metrics struct out of a monitor  */
 void perf_metrics__reduce_monitor_into_base_metrics(pop_base_metrics_t *base_metrics,
@@ -458,6 +566,8 @@ void perf_metrics__reduce_monitor_into_base_metrics(pop_base_metrics_t *base_met
         .avg_cpus                = app_reduction.avg_cpus,
         .cycles                  = app_reduction.cycles,
         .instructions            = app_reduction.instructions,
+        .flops                   = app_reduction.flops,
+        .mem_stalls              = app_reduction.mem_stalls,
         .num_measurements        = app_reduction.num_measurements,
         .num_mpi_calls           = app_reduction.num_mpi_calls,
         .num_omp_parallels       = app_reduction.num_omp_parallels,
@@ -477,6 +587,15 @@ void perf_metrics__reduce_monitor_into_base_metrics(pop_base_metrics_t *base_met
 }
 #endif
 
+/* Compute the metrics of the --talp-counters events out of a base metrics
+ * struct. GFLOP/s are computed with the elapsed time, i.e., for the whole
+ * application if the base metrics come from an MPI reduction. */
+void perf_metrics__base_to_hwc_metrics(const pop_base_metrics_t *base_metrics,
+        hwc_metrics_t *hwc_metrics) {
+    hwc_metrics_compute(hwc_metrics, base_metrics->flops, base_metrics->mem_stalls,
+            base_metrics->cycles, base_metrics->elapsed_time);
+}
+
 /* Compute POP metrics out of a base metrics struct */
 void perf_metrics__base_to_pop_metrics(const char *monitor_name,
         const pop_base_metrics_t *base_metrics, dlb_pop_metrics_t *pop_metrics) {
@@ -25,6 +25,8 @@
 
 typedef struct dlb_monitor_t dlb_monitor_t;
 typedef struct dlb_pop_metrics_t dlb_pop_metrics_t;
+typedef struct talp_region_list_t talp_region_list_t;
+typedef struct hwc_metrics_t hwc_metrics_t;
 
 /*********************************************************************************/
 /*    POP metrics - pure MPI model                                               */
@@ -64,6 +66,8 @@ typedef struct pop_base_metrics_t {
     /* Hardware counters */
     double  cycles;
     double  instructions;
+    double  flops;          /* zero if not collected */
+    double  mem_stalls;     /* zero if not collected */
     /* Statistics */
     int64_t num_measurements;
     int64_t num_mpi_calls;
@@ -86,6 +90,12 @@ typedef struct pop_base_metrics_t {
 } pop_base_metrics_t;
 
 
+void perf_metrics__local_monitor_into_base_metrics(pop_base_metrics_t *base_metrics,
+        const dlb_monitor_t *monitor);
+
+void perf_metrics__node_regions_into_base_metrics(pop_base_metrics_t *base_metrics,
+        const talp_region_list_t *region_list, int nelems);
+
 #if MPI_LIB
 void perf_metrics__reduce_monitor_into_base_metrics(pop_base_metrics_t *base_metrics,
         const dlb_monitor_t *monitor, bool all_to_all);
@@ -94,4 +104,7 @@ void perf_metrics__reduce_monitor_into_base_metrics(pop_base_metrics_t *base_met
 void perf_metrics__base_to_pop_metrics(const char *monitor_name,
         const pop_base_metrics_t *base_metrics, dlb_pop_metrics_t *pop_metrics);
 
+void perf_metrics__base_to_hwc_metrics(const pop_base_metrics_t *base_metrics,
+        hwc_metrics_t *hwc_metrics);
+
 #endif /* PERF_METRICS_H */
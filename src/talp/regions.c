@@ -24,18 +24,21 @@
 #include "talp/regions.h"
 
 #include "LB_comm/shmem_talp.h"
+#include "LB_core/DLB_kernel.h"
 #include "LB_core/spd.h"
 #include "apis/dlb_errors.h"
 #include "apis/dlb_talp.h"
+#include "support/arena.h"
 #include "support/debug.h"
-#include "support/gtree.h"
 #include "support/mask_utils.h"
+#include "support/strmap.h"
 #include "support/tracing.h"
 #include "talp/talp.h"
 #include "talp/talp_output.h"
 #include "talp/talp_types.h"
 
 #include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -118,28 +121,47 @@ static bool parse_region_select(const char *region_select, const char *region_na
     return in_inclusion_mode ? found_in_select : !found_in_select;
 }
 
-static void region_initialize(dlb_monitor_t *monitor, int id, const
-        char *name, pid_t pid, float avg_cpus, const char *region_select, bool have_shmem) {
+/* Monitoring regions are never deallocated individually, so the public
+ * monitor and its private data are allocated in a single block of the regions
+ * arena, which is freed at once in talp_finalize */
+typedef struct region_block_t {
+    dlb_monitor_t monitor;
+    monitor_data_t data;
+} region_block_t;
+
+/* Whether the starts of the region delimit the iterations of --lewi-shrink */
+static bool is_iteration_region(const options_t *options, const char *name) {
+    return options->lewi_shrink
+        && options->lewi_shrink_region[0] != '\0'
+        && strncmp(name, options->lewi_shrink_region, DLB_MONITOR_NAME_MAX) == 0;
+}
+
+/* Allocate, initialize and insert a new region. The region name is the key
+ * interned by the regions map. Must be called with the regions_mutex held */
+static dlb_monitor_t* region_new(talp_info_t *talp_info, int id, const
+        char *name, pid_t pid, float avg_cpus, const options_t *options, bool have_shmem) {
+    region_block_t *block = arena_alloc(&talp_info->regions_arena, sizeof(region_block_t));
+    fatal_cond(!block, "Could not register a new monitoring region."
+            " Please report at "PACKAGE_BUGREPORT);
+
     /* Initialize private monitor data */
-    monitor_data_t *monitor_data = malloc(sizeof(monitor_data_t));
+    monitor_data_t *monitor_data = &block->data;
     *monitor_data = (const monitor_data_t) {
         .id = id,
         .node_shared_id = -1,
     };
 
     /* Parse --talp-region-select if needed */
-    monitor_data->flags.enabled = parse_region_select(region_select, name);
-
-    /* Allocate monitor name */
-    char *allocated_name = malloc(DLB_MONITOR_NAME_MAX*sizeof(char));
-    snprintf(allocated_name, DLB_MONITOR_NAME_MAX, "%s", name);
+    monitor_data->flags.enabled = parse_region_select(options->talp_region_select, name);
+    monitor_data->flags.iteration = is_iteration_region(options, name);
 
-    /* Initialize monitor */
+    /* Initialize monitor and insert it */
+    dlb_monitor_t *monitor = &block->monitor;
     *monitor = (const dlb_monitor_t) {
-            .name = allocated_name,
             .avg_cpus = avg_cpus,
             ._data = monitor_data,
     };
+    monitor->name = strmap_insert(&talp_info->regions, name, monitor);
 
     /* Register name in the instrumentation tool */
     instrument_register_event(MONITOR_REGION, monitor_data->id, name);
@@ -159,6 +181,8 @@ static void region_initialize(dlb_monitor_t *monitor, int id, const
                     monitor->name, PACKAGE_BUGREPORT);
         }
     }
+
+    return monitor;
 }
 
 struct dlb_monitor_t* region_get_global(const subprocess_descriptor_t *spd) {
@@ -170,41 +194,92 @@ const char* region_get_global_name(void) {
     return global_region_name;
 }
 
-/* Helper function for GTree: Compare region names */
-int region_compare_by_name(const void *a, const void *b) {
-    return strncmp(a, b, DLB_MONITOR_NAME_MAX-1);
+/* Per-thread cache of registered regions, indexed by the address of the name
+ * given by the caller. Applications usually register regions with string
+ * literals inside loops, so this avoids the regions lock and the hash map
+ * lookup. Since the caller may reuse the same buffer for different names, the
+ * content is validated against the region name. Entries of previous TALP
+ * initializations are invalidated by the generation. */
+enum { REGION_CACHE_SIZE = 16 };
+
+typedef struct region_cache_entry_t {
+    const char      *name;
+    dlb_monitor_t   *monitor;
+    int             generation;
+} region_cache_entry_t;
+
+static __thread region_cache_entry_t region_cache[REGION_CACHE_SIZE];
+
+static inline region_cache_entry_t* region_cache_entry(const char *name) {
+    return &region_cache[((uintptr_t)name >> 3) % REGION_CACHE_SIZE];
 }
 
-/* Helper function for GTree: deallocate */
-void region_dealloc(void *data) {
+static dlb_monitor_t* region_cache_lookup(const talp_info_t *talp_info,
+        const char *name) {
+    const region_cache_entry_t *entry = region_cache_entry(name);
+    if (entry->name == name
+            && entry->generation == talp_info->regions_generation
+            && strncmp(entry->monitor->name, name, DLB_MONITOR_NAME_MAX) == 0) {
+        return entry->monitor;
+    }
+    return NULL;
+}
 
-    dlb_monitor_t *monitor = data;
+static void region_cache_insert(const talp_info_t *talp_info, const char *name,
+        dlb_monitor_t *monitor) {
+    /* Only names that are identical to the region name, e.g., not the
+     * global region with a different case */
+    if (strncmp(monitor->name, name, DLB_MONITOR_NAME_MAX) == 0) {
+        *region_cache_entry(name) = (const region_cache_entry_t) {
+            .name = name,
+            .monitor = monitor,
+            .generation = talp_info->regions_generation,
+        };
+    }
+}
 
-    /* Free private data */
-    monitor_data_t *monitor_data = monitor->_data;
-    free(monitor_data);
-    monitor_data = NULL;
+/* "all" is reserved to refer to every region */
+static inline bool region_name_is_forbidden(const char *name) {
+    return strncasecmp("all", name, DLB_MONITOR_NAME_MAX-1) == 0;
+}
 
-    /* Free name */
-    free((char*)monitor->name);
-    monitor->name = NULL;
+/* The global region name is matched ignoring case */
+static inline bool region_name_is_global(const char *name) {
+    return strncasecmp(global_region_name, name, DLB_MONITOR_NAME_MAX-1) == 0;
+}
 
-    /* Free monitor */
-    free(monitor);
+/* Return a new generation for the regions of a TALP initialization */
+int region_get_new_generation(void) {
+    static atomic_int generation = 0;
+    return DLB_ATOMIC_ADD_FETCH_RLX(&generation, 1);
+}
+
+/* Return the generation of the spd regions, or 0 if TALP is not enabled */
+int region_get_generation(const subprocess_descriptor_t *spd) {
+    const talp_info_t *talp_info = spd->talp_info;
+    return talp_info ? talp_info->regions_generation : 0;
 }
 
 dlb_monitor_t* region_register(const subprocess_descriptor_t *spd, const char* name) {
 
-    /* Forbidden names */
-    if (name == DLB_LAST_OPEN_REGION
-            || (name != NULL
-                && strncasecmp("all", name, DLB_MONITOR_NAME_MAX-1) == 0)) {
-        return NULL;
-    }
+    /* Forbidden pointer */
+    if (name == DLB_LAST_OPEN_REGION) return NULL;
 
     talp_info_t *talp_info = spd->talp_info;
     if (talp_info == NULL) return NULL;
 
+    /* Fast path: region already registered by this thread with the same name */
+    if (name != NULL) {
+        dlb_monitor_t *monitor = region_cache_lookup(talp_info, name);
+        if (monitor != NULL) return monitor;
+    }
+
+    /* Forbidden names */
+    if (name != NULL && region_name_is_forbidden(name)) {
+        return NULL;
+    }
+
+    const char *caller_name = name;
     dlb_monitor_t *monitor = NULL;
     bool anonymous_region = (name == NULL || *name == '\0');
     bool global_region = !anonymous_region && name == global_region_name;
@@ -213,29 +288,11 @@ dlb_monitor_t* region_register(const subprocess_descriptor_t *spd, const char* n
      * same as the global region, ignoring case */
     if (!anonymous_region
             && !global_region
-            && strncasecmp(global_region_name, name, DLB_MONITOR_NAME_MAX-1) == 0) {
+            && region_name_is_global(name)) {
         name = global_region_name;
         global_region = true;
     }
 
-    /* Found monitor if already registered */
-    if (!anonymous_region) {
-        pthread_mutex_lock(&talp_info->regions_mutex);
-        {
-            monitor = g_tree_lookup(talp_info->regions, name);
-        }
-        pthread_mutex_unlock(&talp_info->regions_mutex);
-
-        if (monitor != NULL) {
-            return monitor;
-        }
-    }
-
-    /* Otherwise, create new monitoring region */
-    monitor = malloc(sizeof(dlb_monitor_t));
-    fatal_cond(!monitor, "Could not register a new monitoring region."
-            " Please report at "PACKAGE_BUGREPORT);
-
     /* Determine the initial number of assigned CPUs for the region */
     float avg_cpus = CPU_COUNT(&spd->process_mask);
 
@@ -247,28 +304,111 @@ dlb_monitor_t* region_register(const subprocess_descriptor_t *spd, const char* n
         name = monitor_name;
     }
 
-    /* Initialize values */
     bool have_shmem = talp_info->flags.have_shmem
         || (talp_info->flags.have_minimal_shmem && global_region);
-    region_initialize(monitor, get_new_monitor_id(), name,
-            spd->id, avg_cpus, spd->options.talp_region_select, have_shmem);
 
-    /* Finally, insert */
     pthread_mutex_lock(&talp_info->regions_mutex);
     {
-        g_tree_insert(talp_info->regions, (gpointer)monitor->name, monitor);
+        /* Found monitor if already registered */
+        if (!anonymous_region) {
+            monitor = strmap_lookup(&talp_info->regions, name);
+        }
+
+        /* Otherwise, create new monitoring region */
+        if (monitor == NULL) {
+            monitor = region_new(talp_info, get_new_monitor_id(), name,
+                    spd->id, avg_cpus, &spd->options, have_shmem);
+        }
     }
     pthread_mutex_unlock(&talp_info->regions_mutex);
 
+    if (!anonymous_region) {
+        region_cache_insert(talp_info, caller_name, monitor);
+    }
+
     return monitor;
 }
 
+/* Register nnames regions, given as contiguous strings of DLB_MONITOR_NAME_MAX
+ * characters. Existing and invalid names are skipped. Unlike region_register,
+ * the regions lock is only taken once for all names. */
+void region_register_bulk(const subprocess_descriptor_t *spd, const char *names, int nnames) {
+
+    talp_info_t *talp_info = spd->talp_info;
+    if (talp_info == NULL || nnames <= 0) return;
+
+    float avg_cpus = CPU_COUNT(&spd->process_mask);
+    bool have_shmem = talp_info->flags.have_shmem;
+
+    pthread_mutex_lock(&talp_info->regions_mutex);
+    {
+        for (int i = 0; i < nnames; ++i) {
+            const char *name = &names[i*DLB_MONITOR_NAME_MAX];
+
+            /* Anonymous, forbidden or global names are never bulk registered */
+            if (name[0] == '\0'
+                    || region_name_is_forbidden(name)
+                    || region_name_is_global(name)) {
+                continue;
+            }
+
+            /* Skip if already registered */
+            if (strmap_lookup(&talp_info->regions, name) != NULL) {
+                continue;
+            }
+
+            region_new(talp_info, get_new_monitor_id(), name,
+                    spd->id, avg_cpus, &spd->options, have_shmem);
+        }
+    }
+    pthread_mutex_unlock(&talp_info->regions_mutex);
+}
+
+/* Helper functions for the intrusive list of open regions,
+ * they must be called with the regions_mutex held */
+static void open_regions_push(talp_info_t *talp_info, dlb_monitor_t *monitor) {
+    monitor_data_t *monitor_data = monitor->_data;
+    monitor_data->open_prev = NULL;
+    monitor_data->open_next = talp_info->open_regions;
+    if (talp_info->open_regions != NULL) {
+        monitor_data_t *head_data = talp_info->open_regions->_data;
+        head_data->open_prev = monitor;
+    }
+    talp_info->open_regions = monitor;
+}
+
+static void open_regions_remove(talp_info_t *talp_info, dlb_monitor_t *monitor) {
+    monitor_data_t *monitor_data = monitor->_data;
+    if (monitor_data->open_prev != NULL) {
+        monitor_data_t *prev_data = monitor_data->open_prev->_data;
+        prev_data->open_next = monitor_data->open_next;
+    } else {
+        talp_info->open_regions = monitor_data->open_next;
+    }
+    if (monitor_data->open_next != NULL) {
+        monitor_data_t *next_data = monitor_data->open_next->_data;
+        next_data->open_prev = monitor_data->open_prev;
+    }
+    monitor_data->open_prev = NULL;
+    monitor_data->open_next = NULL;
+}
+
 int region_reset(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor) {
+    talp_info_t *talp_info = spd->talp_info;
     if (monitor == DLB_GLOBAL_REGION) {
-        talp_info_t *talp_info = spd->talp_info;
         monitor = talp_info->monitor;
     }
 
+    /* A reset region is no longer open */
+    monitor_data_t *monitor_data = monitor->_data;
+    if (monitor_data->flags.started) {
+        pthread_mutex_lock(&talp_info->regions_mutex);
+        {
+            open_regions_remove(talp_info, monitor);
+        }
+        pthread_mutex_unlock(&talp_info->regions_mutex);
+    }
+
     /* Reset everything except these fields: */
     *monitor = (const dlb_monitor_t) {
         .name = monitor->name,
@@ -276,8 +416,8 @@ int region_reset(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor) {
         ._data = monitor->_data,
     };
 
-    monitor_data_t *monitor_data = monitor->_data;
     monitor_data->flags.started = false;
+    memset(monitor_data->counters, 0, sizeof(monitor_data->counters));
 
     return DLB_SUCCESS;
 }
@@ -309,7 +449,7 @@ int region_start(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor) {
         pthread_mutex_lock(&talp_info->regions_mutex);
         {
             monitor_data->flags.started = true;
-            talp_info->open_regions = g_slist_prepend(talp_info->open_regions, monitor);
+            open_regions_push(talp_info, monitor);
         }
         pthread_mutex_unlock(&talp_info->regions_mutex);
 
@@ -317,7 +457,11 @@ int region_start(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor) {
          * certain cases where neither talp_mpi_init nor talp_openmp_init have
          * been called, this is necessary */
         if (thread_sample->state != useful) {
-            talp_set_sample_state(thread_sample, useful, talp_info->flags.papi);
+            talp_set_sample_state(thread_sample, useful, talp_info->flags.counters);
+        }
+
+        if (monitor_data->flags.iteration) {
+            new_iteration(spd, false);
         }
 
         error = DLB_SUCCESS;
@@ -337,7 +481,7 @@ int region_stop(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor) {
         monitor = talp_info->monitor;
     } else if (monitor == DLB_LAST_OPEN_REGION) {
         if (talp_info->open_regions != NULL) {
-            monitor = talp_info->open_regions->data;
+            monitor = talp_info->open_regions;
         } else {
             return DLB_ERR_NOENT;
         }
@@ -359,7 +503,7 @@ int region_stop(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor) {
         pthread_mutex_lock(&talp_info->regions_mutex);
         {
             monitor_data->flags.started = false;
-            talp_info->open_regions = g_slist_remove(talp_info->open_regions, monitor);
+            open_regions_remove(talp_info, monitor);
         }
         pthread_mutex_unlock(&talp_info->regions_mutex);
 
@@ -390,13 +534,38 @@ int region_report(const subprocess_descriptor_t *spd, const dlb_monitor_t *monit
         return DLB_NOUPDT;
     }
 
-#ifdef PAPI_LIB
-    bool have_papi = talp_info->flags.papi;
-#else
-    bool have_papi = false;
-#endif
+    hwc_metrics_t hwc_metrics;
+    region_get_hwc_metrics(spd, monitor, &hwc_metrics);
     talp_output_print_monitoring_region(monitor, mu_to_str(&spd->process_mask),
-            talp_info->flags.have_mpi, talp_info->flags.have_openmp, have_papi);
+            talp_info->flags.have_mpi, talp_info->flags.have_openmp,
+            talp_info->flags.counters, &hwc_metrics);
 
     return DLB_SUCCESS;
 }
+
+void region_get_hwc_counts(const subprocess_descriptor_t *spd,
+        const dlb_monitor_t *monitor, double *flops, double *mem_stalls) {
+
+    *flops = 0.0;
+    *mem_stalls = 0.0;
+
+    const talp_info_t *talp_info = spd->talp_info;
+    const monitor_data_t *monitor_data = monitor->_data;
+    if (talp_info == NULL || monitor_data == NULL || !talp_info->flags.counters) return;
+
+    if (talp_info->counters.flops >= 0) {
+        *flops = (double)monitor_data->counters[talp_info->counters.flops];
+    }
+    if (talp_info->counters.mem_stalls >= 0) {
+        *mem_stalls = (double)monitor_data->counters[talp_info->counters.mem_stalls];
+    }
+}
+
+void region_get_hwc_metrics(const subprocess_descriptor_t *spd,
+        const dlb_monitor_t *monitor, hwc_metrics_t *hwc_metrics) {
+
+    double flops, mem_stalls;
+    region_get_hwc_counts(spd, monitor, &flops, &mem_stalls);
+    hwc_metrics_compute(hwc_metrics, flops, mem_stalls,
+            monitor->cycles, monitor->elapsed_time);
+}
@@ -24,24 +24,28 @@
 
 typedef struct dlb_monitor_t dlb_monitor_t;
 typedef struct SubProcessDescriptor subprocess_descriptor_t;
+typedef struct hwc_metrics_t hwc_metrics_t;
 
 /* Global region getters */
 struct dlb_monitor_t* region_get_global(const subprocess_descriptor_t *spd);
 const char* region_get_global_name(void);
 
-/* Helper functions for GTree structures */
-int  region_compare_by_name(const void *a, const void *b);
-void region_dealloc(void *data);
-
 /* Region functions */
+int  region_get_new_generation(void);
+int  region_get_generation(const subprocess_descriptor_t *spd);
 dlb_monitor_t*
      region_register(const subprocess_descriptor_t *spd, const char* name);
+void region_register_bulk(const subprocess_descriptor_t *spd, const char *names, int nnames);
 int  region_reset(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor);
 int  region_start(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor);
 int  region_stop(const subprocess_descriptor_t *spd, dlb_monitor_t *monitor);
 bool region_is_started(const dlb_monitor_t *monitor);
 void region_set_internal(struct dlb_monitor_t *monitor, bool internal);
 int  region_report(const subprocess_descriptor_t *spd, const dlb_monitor_t *monitor);
+void region_get_hwc_counts(const subprocess_descriptor_t *spd,
+        const dlb_monitor_t *monitor, double *flops, double *mem_stalls);
+void region_get_hwc_metrics(const subprocess_descriptor_t *spd,
+        const dlb_monitor_t *monitor, hwc_metrics_t *hwc_metrics);
 
 
 #endif /* REGIONS_H */
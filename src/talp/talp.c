@@ -32,11 +32,12 @@
 #include "support/debug.h"
 #include "support/error.h"
 #include "support/gslist.h"
-#include "support/gtree.h"
 #include "support/mytime.h"
+#include "support/timers.h"
 #include "support/tracing.h"
 #include "support/options.h"
 #include "support/mask_utils.h"
+#include "support/perf_event.h"
 #include "talp/perf_metrics.h"
 #include "talp/regions.h"
 #include "talp/talp_output.h"
@@ -46,7 +47,9 @@
 #include "LB_MPI/process_MPI.h"
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 
 #ifdef PAPI_LIB
@@ -62,6 +65,65 @@ static void talp_dealloc_samples(const subprocess_descriptor_t *spd);
 static __thread int EventSet = PAPI_NULL;
 #endif
 
+static __thread perf_event_group_t perf_group = {};
+
+/* The key destructor closes the perf events of each exiting thread */
+static pthread_key_t perf_group_key;
+static pthread_once_t perf_group_once = PTHREAD_ONCE_INIT;
+
+static void perf_group_destroy(void *arg) {
+    perf_event_group_close(arg);
+}
+
+static void perf_group_key_create(void) {
+    pthread_key_create(&perf_group_key, perf_group_destroy);
+}
+
+/* Hardware counters are never reset, each thread keeps the last read values
+ * and accumulates the deltas */
+static __thread int64_t last_counter_values[TALP_MAX_COUNTERS] = {};
+static __thread int64_t last_counter_timestamp = 0;
+
+/* Read the raw values of this thread's counters */
+static inline void read_raw_counters(const talp_info_t *talp_info, int64_t *values) {
+    if (talp_info->flags.perf) {
+        perf_event_group_read(&perf_group, values);
+        return;
+    }
+
+#ifdef PAPI_LIB
+    long long papi_values[TALP_MAX_COUNTERS];
+    int error = PAPI_read(EventSet, papi_values);
+    if (error != PAPI_OK) {
+        verbose(VB_TALP, "PAPI read return code: %d, %s", error, PAPI_strerror(error));
+        /* Assume no progress */
+        memcpy(values, last_counter_values, sizeof(int64_t) * talp_info->counters.num);
+        return;
+    }
+    for (int i = 0; i < talp_info->counters.num; ++i) {
+        values[i] = papi_values[i];
+    }
+#endif
+}
+
+/* Set the starting point of the next deltas */
+static inline void snapshot_counters(const talp_info_t *talp_info, int64_t timestamp) {
+    read_raw_counters(talp_info, last_counter_values);
+    last_counter_timestamp = timestamp;
+}
+
+/* Obtain the counter deltas since the last read or snapshot */
+static inline void read_counters(const talp_info_t *talp_info, long long *deltas,
+        int64_t timestamp) {
+    int64_t values[TALP_MAX_COUNTERS];
+    read_raw_counters(talp_info, values);
+    for (int i = 0; i < talp_info->counters.num; ++i) {
+        deltas[i] = values[i] - last_counter_values[i];
+        last_counter_values[i] = values[i];
+    }
+    last_counter_timestamp = timestamp;
+}
+
 
 /* Update all open regions with the macrosample */
 static void update_regions_with_macrosample(const subprocess_descriptor_t *spd,
@@ -71,10 +133,9 @@ static void update_regions_with_macrosample(const subprocess_descriptor_t *spd,
     /* Update all open regions */
     pthread_mutex_lock(&talp_info->regions_mutex);
     {
-        for (GSList *node = talp_info->open_regions;
-                node != NULL;
-                node = node->next) {
-            dlb_monitor_t *monitor = node->data;
+        for (dlb_monitor_t *monitor = talp_info->open_regions;
+                monitor != NULL;
+                monitor = ((monitor_data_t*)monitor->_data)->open_next) {
             monitor_data_t *monitor_data = monitor->_data;
 
             /* Update number of CPUs if needed */
@@ -86,11 +147,17 @@ static void update_regions_with_macrosample(const subprocess_descriptor_t *spd,
             monitor->omp_load_imbalance_time += macrosample->timers.not_useful_omp_in_lb;
             monitor->omp_scheduling_time += macrosample->timers.not_useful_omp_in_sched;
             monitor->omp_serialization_time += macrosample->timers.not_useful_omp_out;
-#ifdef PAPI_LIB
             /* Counters */
-            monitor->cycles += macrosample->counters.cycles;
-            monitor->instructions += macrosample->counters.instructions;
-#endif
+            for (int i = 0; i < talp_info->counters.num; ++i) {
+                monitor_data->counters[i] += macrosample->counters[i];
+            }
+            if (talp_info->counters.cycles >= 0) {
+                monitor->cycles += macrosample->counters[talp_info->counters.cycles];
+            }
+            if (talp_info->counters.instructions >= 0) {
+                monitor->instructions +=
+                    macrosample->counters[talp_info->counters.instructions];
+            }
             /* Stats */
             monitor->num_mpi_calls += macrosample->stats.num_mpi_calls;
             monitor->num_omp_parallels += macrosample->stats.num_omp_parallels;
@@ -101,6 +168,11 @@ static void update_regions_with_macrosample(const subprocess_descriptor_t *spd,
                 shmem_talp__set_times(monitor_data->node_shared_id,
                         monitor->mpi_time,
                         monitor->useful_time);
+                shmem_talp__set_omp_times(monitor_data->node_shared_id,
+                        monitor->num_cpus,
+                        monitor->omp_load_imbalance_time,
+                        monitor->omp_scheduling_time,
+                        monitor->omp_serialization_time);
             }
         }
     }
@@ -113,11 +185,78 @@ static void update_regions_with_macrosample(const subprocess_descriptor_t *spd,
 /*    Init / Finalize                                                            */
 /*********************************************************************************/
 
+#ifdef PAPI_LIB
+/* Resolve the list of events in --talp-counters and keep only those that can
+ * be added together to an event set */
+static int init_papi_events(talp_info_t *talp_info, const char *talp_counters) {
+
+    int probe_eventset = PAPI_NULL;
+    int error = PAPI_create_eventset(&probe_eventset);
+    if (error != PAPI_OK) {
+        warning("PAPI Error during eventset creation. %d: %s",
+                error, PAPI_strerror(error));
+        return -1;
+    }
+
+    /* Tokenize a copy of the option */
+    size_t len = strlen(talp_counters) + 1;
+    char *counters_copy = malloc(sizeof(char)*len);
+    strcpy(counters_copy, talp_counters);
+
+    char *saveptr;
+    char *token = strtok_r(counters_copy, ",", &saveptr);
+    while (token) {
+        int code;
+        if (talp_info->counters.num == TALP_MAX_COUNTERS) {
+            warning("TALP supports up to %d hardware counters, discarding %s",
+                    TALP_MAX_COUNTERS, token);
+        } else if (PAPI_event_name_to_code(token, &code) != PAPI_OK) {
+            warning("PAPI event %s not found, discarding it", token);
+        } else if ((error = PAPI_add_event(probe_eventset, code)) != PAPI_OK) {
+            warning("PAPI event %s cannot be counted, discarding it. %d: %s",
+                    token, error, PAPI_strerror(error));
+        } else {
+            int index = talp_info->counters.num++;
+            talp_info->counters.codes[index] = code;
+            snprintf(talp_info->counters.names[index], TALP_COUNTER_NAME_MAX, "%s", token);
+
+            /* Keep track of the events used for the derived metrics */
+            if (code == PAPI_TOT_CYC) {
+                talp_info->counters.cycles = index;
+            } else if (code == PAPI_TOT_INS) {
+                talp_info->counters.instructions = index;
+            } else if ((code == PAPI_FP_OPS || code == PAPI_DP_OPS || code == PAPI_SP_OPS)
+                    && talp_info->counters.flops == -1) {
+                talp_info->counters.flops = index;
+            } else if ((code == PAPI_MEM_SCY || code == PAPI_RES_STL)
+                    && talp_info->counters.mem_stalls == -1) {
+                talp_info->counters.mem_stalls = index;
+            }
+        }
+        token = strtok_r(NULL, ",", &saveptr);
+    }
+    free(counters_copy);
+
+    PAPI_cleanup_eventset(probe_eventset);
+    PAPI_destroy_eventset(&probe_eventset);
+
+    if (talp_info->counters.num == 0) {
+        warning("No valid PAPI events in --talp-counters=%s", talp_counters);
+        return -1;
+    }
+
+    verbose(VB_TALP, "TALP collecting %d hardware counters", talp_info->counters.num);
+
+    return 0;
+}
+#endif
+
 /* Executed once */
-static inline int init_papi(void) __attribute__((unused));
-static inline int init_papi(void) {
+static inline int init_papi(const subprocess_descriptor_t *spd) __attribute__((unused));
+static inline int init_papi(const subprocess_descriptor_t *spd) {
 #ifdef PAPI_LIB
-    ensure( ((talp_info_t*)thread_spd->talp_info)->flags.papi,
+    talp_info_t *talp_info = spd->talp_info;
+    ensure( talp_info->flags.papi,
             "Error invoking %s when PAPI has been disabled", __FUNCTION__);
 
     /* Library init */
@@ -133,16 +272,97 @@ static inline int init_papi(void) {
                 error, PAPI_strerror(error));
         return -1;
     }
+
+    /* Select events */
+    if (init_papi_events(talp_info, spd->options.talp_counters) != 0) {
+        return -1;
+    }
 #endif
     return 0;
 }
 
+/* Keep track of the perf events used for the derived metrics */
+static void set_perf_counter_role(talp_info_t *talp_info, int index, const char *preset) {
+    if (preset == NULL) return;
+
+    if (strcmp(preset, "PAPI_TOT_CYC") == 0) {
+        talp_info->counters.cycles = index;
+    } else if (strcmp(preset, "PAPI_TOT_INS") == 0) {
+        talp_info->counters.instructions = index;
+    } else if (strcmp(preset, "PAPI_RES_STL") == 0
+            && talp_info->counters.mem_stalls == -1) {
+        talp_info->counters.mem_stalls = index;
+    }
+}
+
+/* Resolve the list of events in --talp-counters and keep only those that can
+ * be opened together in a perf_event group. Executed once */
+static int init_perf(const subprocess_descriptor_t *spd) {
+    talp_info_t *talp_info = spd->talp_info;
+    const char *talp_counters = spd->options.talp_counters;
+
+    /* Tokenize a copy of the option */
+    size_t len = strlen(talp_counters) + 1;
+    char *counters_copy = malloc(sizeof(char)*len);
+    strcpy(counters_copy, talp_counters);
+
+    char *saveptr;
+    char *token = strtok_r(counters_copy, ",", &saveptr);
+    while (token) {
+        int index = talp_info->counters.num;
+        const char *preset;
+        perf_event_group_t probe_group;
+        if (index == TALP_MAX_COUNTERS) {
+            warning("TALP supports up to %d hardware counters, discarding %s",
+                    TALP_MAX_COUNTERS, token);
+        } else if (perf_event_lookup(token, &talp_info->counters.perf_events[index],
+                    &preset) != DLB_SUCCESS) {
+            warning("perf event %s not found, discarding it", token);
+        } else if (perf_event_group_open(&probe_group, talp_info->counters.perf_events,
+                    index + 1) != DLB_SUCCESS) {
+            warning("perf event %s cannot be counted, discarding it", token);
+        } else {
+            perf_event_group_close(&probe_group);
+            ++talp_info->counters.num;
+            snprintf(talp_info->counters.names[index], TALP_COUNTER_NAME_MAX, "%s", token);
+            set_perf_counter_role(talp_info, index, preset);
+        }
+        token = strtok_r(NULL, ",", &saveptr);
+    }
+    free(counters_copy);
+
+    if (talp_info->counters.num == 0) {
+        warning("No valid perf events in --talp-counters=%s", talp_counters);
+        return -1;
+    }
+
+    verbose(VB_TALP, "TALP collecting %d hardware counters with perf_event",
+            talp_info->counters.num);
+
+    return 0;
+}
+
 /* Executed once per thread */
-int talp_init_papi_counters(void) {
-#ifdef PAPI_LIB
-    ensure( ((talp_info_t*)thread_spd->talp_info)->flags.papi,
-            "Error invoking %s when PAPI has been disabled", __FUNCTION__);
+int talp_init_thread_counters(void) {
+    const talp_info_t *talp_info = thread_spd->talp_info;
+    ensure( talp_info->flags.counters,
+            "Error invoking %s when hardware counters have been disabled", __FUNCTION__);
+
+    if (talp_info->flags.perf) {
+        /* A thread may still have the events of a previous initialization */
+        perf_event_group_close(&perf_group);
+        if (perf_event_group_open(&perf_group, talp_info->counters.perf_events,
+                    talp_info->counters.num) != DLB_SUCCESS) {
+            warning("perf_event Error opening the group of events");
+            return -1;
+        }
+        pthread_once(&perf_group_once, perf_group_key_create);
+        pthread_setspecific(perf_group_key, &perf_group);
+        snapshot_counters(talp_info, get_time_in_ns());
+        return 0;
+    }
 
+#ifdef PAPI_LIB
     int error = PAPI_register_thread();
     if (error != PAPI_OK) {
         warning("PAPI Error during thread registration. %d: %s",
@@ -159,8 +379,8 @@ int talp_init_papi_counters(void) {
         return -1;
     }
 
-    int Events[2] = {PAPI_TOT_CYC, PAPI_TOT_INS};
-    error = PAPI_add_events(EventSet, Events, 2);
+    error = PAPI_add_events(EventSet, (int*)talp_info->counters.codes,
+            talp_info->counters.num);
     if (error != PAPI_OK) {
         warning("PAPI Error adding events. %d: %s",
                 error, PAPI_strerror(error));
@@ -174,20 +394,11 @@ int talp_init_papi_counters(void) {
                 error, PAPI_strerror(error));
         return -1;
     }
+    snapshot_counters(talp_info, get_time_in_ns());
 #endif
     return 0;
 }
 
-static inline void reset_papi_counters(void) {
-#ifdef PAPI_LIB
-    ensure( ((talp_info_t*)thread_spd->talp_info)->flags.papi,
-            "Error invoking %s when PAPI has been disabled", __FUNCTION__);
-
-    int error = PAPI_reset(EventSet);
-    if (error != PAPI_OK) verbose(VB_TALP, "Error resetting counters");
-#endif
-}
-
 void talp_init(subprocess_descriptor_t *spd) {
     ensure(!spd->talp_info, "TALP already initialized");
     ensure(!thread_is_observer, "An observer thread cannot call talp_init");
@@ -199,17 +410,25 @@ void talp_init(subprocess_descriptor_t *spd) {
         .flags = {
             .external_profiler = spd->options.talp_external_profiler,
             .papi = spd->options.talp_papi,
+            .perf = spd->options.talp_perf,
             .have_shmem = spd->options.talp_external_profiler,
             .have_minimal_shmem = !spd->options.talp_external_profiler
                 && spd->options.talp_summary & SUMMARY_NODE,
         },
-        .regions = g_tree_new_full(
-                (GCompareDataFunc)region_compare_by_name,
-                NULL, NULL, region_dealloc),
+        .counters = {
+            .threshold = spd->options.talp_counters_threshold,
+            .cycles = -1,
+            .instructions = -1,
+            .flops = -1,
+            .mem_stalls = -1,
+        },
+        .regions_generation = region_get_new_generation(),
         .regions_mutex = PTHREAD_MUTEX_INITIALIZER,
         .samples_mutex = PTHREAD_MUTEX_INITIALIZER,
     };
+    strmap_init(&talp_info->regions, DLB_MONITOR_NAME_MAX-1);
     spd->talp_info = talp_info;
+    spd_invalidate_regions();
 
     /* Initialize shared memory */
     if (talp_info->flags.have_shmem || talp_info->flags.have_minimal_shmem) {
@@ -229,18 +448,39 @@ void talp_init(subprocess_descriptor_t *spd) {
 
     verbose(VB_TALP, "TALP module with workers mask: %s", mu_to_str(&spd->process_mask));
 
+    /* PAPI takes precedence if both backends are requested */
+    if (talp_info->flags.papi && talp_info->flags.perf) {
+        verbose(VB_TALP, "Both --talp-papi and --talp-perf are enabled, using PAPI");
+        talp_info->flags.perf = false;
+    }
+
     /* Initialize and start running PAPI */
     if (talp_info->flags.papi) {
 #ifdef PAPI_LIB
-        if (init_papi() != 0 || talp_init_papi_counters() != 0) {
+        talp_info->flags.counters = true;
+        if (init_papi(spd) != 0 || talp_init_thread_counters() != 0) {
             warning("PAPI initialization has failed, disabling option.");
             talp_info->flags.papi = false;
+            talp_info->flags.counters = false;
+            talp_info->counters.num = 0;
         }
 #else
-        warning("DLB has not been configured with PAPI support, disabling option.");
+        warning("DLB has not been configured with PAPI support, disabling option."
+                " Hardware counters may be collected with --talp-perf.");
         talp_info->flags.papi = false;
 #endif
     }
+
+    /* Initialize and start running perf_event counters */
+    if (talp_info->flags.perf) {
+        talp_info->flags.counters = true;
+        if (init_perf(spd) != 0 || talp_init_thread_counters() != 0) {
+            warning("perf_event initialization has failed, disabling option.");
+            talp_info->flags.perf = false;
+            talp_info->flags.counters = false;
+            talp_info->counters.num = 0;
+        }
+    }
 }
 
 void talp_finalize(subprocess_descriptor_t *spd) {
@@ -257,19 +497,19 @@ void talp_finalize(subprocess_descriptor_t *spd) {
          * (Note that region_stop need to acquire the regions_mutex
          * lock, so we we need to iterate without it) */
         while(talp_info->open_regions != NULL) {
-            dlb_monitor_t *monitor = talp_info->open_regions->data;
-            region_stop(spd, monitor);
+            region_stop(spd, talp_info->open_regions);
         }
 
         pthread_mutex_lock(&talp_info->regions_mutex);
         {
-            /* Record all regions */
-            for (GTreeNode *node = g_tree_node_first(talp_info->regions);
-                    node != NULL;
-                    node = g_tree_node_next(node)) {
-                const dlb_monitor_t *monitor = g_tree_node_value(node);
-                talp_record_monitor(spd, monitor);
+            /* Record all regions, sorted by name */
+            unsigned int nregions = strmap_size(&talp_info->regions);
+            const dlb_monitor_t **monitors = malloc(sizeof(dlb_monitor_t*) * nregions);
+            strmap_sorted_values(&talp_info->regions, (void**)monitors);
+            for (unsigned int i = 0; i < nregions; ++i) {
+                talp_record_monitor(spd, monitors[i]);
             }
+            free(monitors);
         }
         pthread_mutex_unlock(&talp_info->regions_mutex);
     }
@@ -291,17 +531,23 @@ void talp_finalize(subprocess_descriptor_t *spd) {
     }
 #endif
 
+    /* Other threads close their perf events on thread exit */
+    if (talp_info->flags.perf) {
+        perf_event_group_close(&perf_group);
+        pthread_setspecific(perf_group_key, NULL);
+    }
+
     /* Deallocate monitoring regions and talp_info */
+    spd_invalidate_regions();
     pthread_mutex_lock(&talp_info->regions_mutex);
     {
-        /* Destroy GTree, each node is deallocated with the function region_dealloc */
-        g_tree_destroy(talp_info->regions);
-        talp_info->regions = NULL;
+        /* Destroy map of regions, regions are deallocated below */
+        strmap_destroy(&talp_info->regions);
         talp_info->monitor = NULL;
-
-        /* Destroy list of open regions */
-        g_slist_free(talp_info->open_regions);
         talp_info->open_regions = NULL;
+
+        /* Deallocate all regions at once */
+        arena_free_all(&talp_info->regions_arena);
     }
     pthread_mutex_unlock(&talp_info->regions_mutex);
     free(talp_info);
@@ -347,7 +593,9 @@ talp_sample_t* talp_get_thread_sample(const subprocess_descriptor_t *spd) {
         if (samples) {
             talp_info->samples = samples;
             void *new_sample;
-            if (posix_memalign(&new_sample, DLB_CACHE_LINE, sizeof(talp_sample_t)) == 0) {
+            size_t sample_size = sizeof(talp_sample_t)
+                + sizeof(atomic_int_least64_t) * talp_info->counters.num;
+            if (posix_memalign(&new_sample, DLB_CACHE_LINE, sample_size) == 0) {
                 _tls_sample = new_sample;
                 talp_info->samples[ncpus-1] = new_sample;
             }
@@ -361,8 +609,7 @@ talp_sample_t* talp_get_thread_sample(const subprocess_descriptor_t *spd) {
      * innermost open region, otherwise it is the current time */
     int64_t last_updated_timestamp;
     if (talp_info->open_regions) {
-        const dlb_monitor_t *monitor = talp_info->open_regions->data;
-        last_updated_timestamp = monitor->start_time;
+        last_updated_timestamp = talp_info->open_regions->start_time;
     } else {
         last_updated_timestamp = get_time_in_ns();
     }
@@ -370,8 +617,11 @@ talp_sample_t* talp_get_thread_sample(const subprocess_descriptor_t *spd) {
     *_tls_sample = (const talp_sample_t) {
         .last_updated_timestamp = last_updated_timestamp,
     };
+    for (int i = 0; i < talp_info->counters.num; ++i) {
+        DLB_ATOMIC_ST_RLX(&_tls_sample->counters[i], 0);
+    }
 
-    talp_set_sample_state(_tls_sample, disabled, talp_info->flags.papi);
+    talp_set_sample_state(_tls_sample, disabled, talp_info->flags.counters);
 
 #ifdef INSTRUMENTATION_VERSION
     unsigned events[] = {MONITOR_CYCLES, MONITOR_INSTR};
@@ -384,10 +634,17 @@ talp_sample_t* talp_get_thread_sample(const subprocess_descriptor_t *spd) {
 
 /* WARNING: this function may only be called when updating own thread's sample */
 void talp_set_sample_state(talp_sample_t *sample, enum talp_sample_state state,
-        bool papi) {
+        bool counters) {
     sample->state = state;
-    if (papi && state == useful) {
-        reset_papi_counters();
+    if (counters && state == useful) {
+        /* Counters were last read when the thread left the useful state. If
+         * the not useful interval is below the threshold, skip the snapshot
+         * and let the next delta absorb it */
+        const talp_info_t *talp_info = thread_spd->talp_info;
+        if (sample->last_updated_timestamp - last_counter_timestamp
+                >= talp_info->counters.threshold) {
+            snapshot_counters(talp_info, sample->last_updated_timestamp);
+        }
     }
     instrument_event(MONITOR_STATE,
             state == disabled ? MONITOR_STATE_DISABLED
@@ -400,7 +657,7 @@ void talp_set_sample_state(talp_sample_t *sample, enum talp_sample_state state,
 }
 
 /* Compute new microsample (time since last update) and update sample values */
-void talp_update_sample(talp_sample_t *sample, bool papi, int64_t timestamp) {
+void talp_update_sample(talp_sample_t *sample, bool counters, int64_t timestamp) {
     /* Observer threads ignore this function */
     if (unlikely(sample == NULL)) return;
 
@@ -427,29 +684,30 @@ void talp_update_sample(talp_sample_t *sample, bool papi, int64_t timestamp) {
             break;
     }
 
-#ifdef PAPI_LIB
-    if (papi) {
+    if (counters) {
         /* Only read counters if we are updating this thread's sample */
         if (sample == talp_get_thread_sample(thread_spd)) {
             if (sample->state == useful) {
-                /* Read */
-                long long papi_values[2];
-                int error = PAPI_read(EventSet, papi_values);
-                if (error != PAPI_OK) {
-                    verbose(VB_TALP, "stop return code: %d, %s", error, PAPI_strerror(error));
-                }
+                /* Read deltas */
+                const talp_info_t *talp_info = thread_spd->talp_info;
+                long long papi_values[TALP_MAX_COUNTERS];
+                read_counters(talp_info, papi_values, now);
 
                 /* Atomically add papi_values to sample structure */
-                DLB_ATOMIC_ADD_RLX(&sample->counters.cycles, papi_values[0]);
-                DLB_ATOMIC_ADD_RLX(&sample->counters.instructions, papi_values[1]);
+                for (int i = 0; i < talp_info->counters.num; ++i) {
+                    DLB_ATOMIC_ADD_RLX(&sample->counters[i], papi_values[i]);
+                }
 
 #ifdef INSTRUMENTATION_VERSION
                 unsigned events[] = {MONITOR_CYCLES, MONITOR_INSTR};
-                instrument_nevent(2, events, papi_values);
+                long long trace_values[] = {
+                    talp_info->counters.cycles >= 0
+                        ? papi_values[talp_info->counters.cycles] : 0,
+                    talp_info->counters.instructions >= 0
+                        ? papi_values[talp_info->counters.instructions] : 0,
+                };
+                instrument_nevent(2, events, trace_values);
 #endif
-
-                /* Counters are reset here and each time the sample is set to useful */
-                reset_papi_counters();
             }
             else {
 #ifdef INSTRUMENTATION_VERSION
@@ -461,12 +719,11 @@ void talp_update_sample(talp_sample_t *sample, bool papi, int64_t timestamp) {
             }
         }
     }
-#endif
 }
 
 /* Flush and aggregate a single sample into a macrosample */
 static inline void flush_sample_to_macrosample(talp_sample_t *sample,
-        talp_macrosample_t *macrosample) {
+        talp_macrosample_t *macrosample, int num_counters) {
 
     /* Timers */
     macrosample->timers.useful +=
@@ -480,13 +737,10 @@ static inline void flush_sample_to_macrosample(talp_sample_t *sample,
                 "Inconsistency in TALP sample metric not_useful_omp_in."
                 " Please, report bug at " PACKAGE_BUGREPORT);
 
-#ifdef PAPI_LIB
     /* Counters */
-    macrosample->counters.cycles +=
-        DLB_ATOMIC_EXCH_RLX(&sample->counters.cycles, 0);
-    macrosample->counters.instructions +=
-        DLB_ATOMIC_EXCH_RLX(&sample->counters.instructions, 0);
-#endif
+    for (int i = 0; i < num_counters; ++i) {
+        macrosample->counters[i] += DLB_ATOMIC_EXCH_RLX(&sample->counters[i], 0);
+    }
 
     /* Stats */
     macrosample->stats.num_mpi_calls +=
@@ -503,6 +757,7 @@ int talp_flush_samples_to_regions(const subprocess_descriptor_t *spd) {
     /* Observer threads don't have a valid sample so they cannot start/stop regions */
     if (unlikely(thread_is_observer)) return DLB_ERR_PERM;
 
+    int64_t timer = timer_start();
     int num_cpus;
     talp_info_t *talp_info = spd->talp_info;
 
@@ -515,8 +770,9 @@ int talp_flush_samples_to_regions(const subprocess_descriptor_t *spd) {
         /* Force-update and aggregate all samples */
         int64_t timestamp = get_time_in_ns();
         for (int i = 0; i < num_cpus; ++i) {
-            talp_update_sample(talp_info->samples[i], talp_info->flags.papi, timestamp);
-            flush_sample_to_macrosample(talp_info->samples[i], &macrosample);
+            talp_update_sample(talp_info->samples[i], talp_info->flags.counters, timestamp);
+            flush_sample_to_macrosample(talp_info->samples[i], &macrosample,
+                    talp_info->counters.num);
         }
     }
     pthread_mutex_unlock(&talp_info->samples_mutex);
@@ -524,6 +780,8 @@ int talp_flush_samples_to_regions(const subprocess_descriptor_t *spd) {
     /* Update all started regions */
     update_regions_with_macrosample(spd, &macrosample, num_cpus);
 
+    timer_stop(TIMER_TALP_FLUSH, timer);
+
     return DLB_SUCCESS;
 }
 
@@ -542,7 +800,7 @@ void talp_flush_sample_subset_to_regions(const subprocess_descriptor_t *spd,
         int64_t min_not_useful_omp_in = INT64_MAX;
         unsigned int i;
         for (i=0; i<nelems; ++i) {
-            talp_update_sample(samples[i], talp_info->flags.papi, timestamp);
+            talp_update_sample(samples[i], talp_info->flags.counters, timestamp);
             min_not_useful_omp_in = min_int64(min_not_useful_omp_in,
                     DLB_ATOMIC_LD_RLX(&samples[i]->timers.not_useful_omp_in));
         }
@@ -553,7 +811,8 @@ void talp_flush_sample_subset_to_regions(const subprocess_descriptor_t *spd,
         for (i=0; i<nelems; ++i) {
             lb_timer += DLB_ATOMIC_EXCH_RLX(&samples[i]->timers.not_useful_omp_in, 0)
                 - min_not_useful_omp_in;
-            flush_sample_to_macrosample(samples[i], &macrosample);
+            flush_sample_to_macrosample(samples[i], &macrosample,
+                    talp_info->counters.num);
         }
 
         /* Update derived timers into macrosample */
@@ -651,6 +910,79 @@ int talp_query_pop_node_metrics(const char *name, dlb_node_metrics_t *node_metri
 }
 
 
+/* Function that may be called from a third-party process to compute the hybrid
+ * POP metrics of a given region, considering the processes in the node as the
+ * whole application */
+int talp_query_pop_node_hybrid_metrics(const char *name, dlb_pop_metrics_t *pop_metrics) {
+
+    if (name == NULL) {
+        name = region_get_global_name();
+    }
+
+    /* Obtain a list of regions in the node associated with given region,
+     * processes may be oversubscribed so there may be more than one per CPU */
+    int max_procs = shmem_talp__get_max_regions();
+    talp_region_list_t *region_list = malloc(max_procs * sizeof(talp_region_list_t));
+    int nelems;
+    shmem_talp__get_regionlist(region_list, &nelems, max_procs, name);
+
+    pop_base_metrics_t base_metrics;
+    perf_metrics__node_regions_into_base_metrics(&base_metrics, region_list, nelems);
+    free(region_list);
+
+    if (base_metrics.num_mpi_ranks == 0) {
+        return DLB_ERR_NOENT;
+    }
+
+    perf_metrics__base_to_pop_metrics(name, &base_metrics, pop_metrics);
+
+    return DLB_SUCCESS;
+}
+
+
+/*********************************************************************************/
+/*    TALP query functions for 1st party programs                                */
+/*      - Local to the process, does not need to synchronize with anyone         */
+/*********************************************************************************/
+
+/* Compute the current POP metrics of the specified monitor, including the
+ * ongoing time if it is started, only with the data of this process.
+ * If monitor is NULL, the global monitoring region is assumed. */
+int talp_query_pop_metrics(const subprocess_descriptor_t *spd,
+        dlb_monitor_t *monitor, dlb_pop_metrics_t *pop_metrics) {
+
+    talp_info_t *talp_info = spd->talp_info;
+    if (monitor == NULL) {
+        monitor = talp_info->monitor;
+    }
+
+    /* Update started regions with the samples of all threads. Observer
+     * threads cannot flush, they obtain the values of the last flush */
+    talp_flush_samples_to_regions(spd);
+
+    /* Copy the monitor since other threads may be updating it */
+    dlb_monitor_t monitor_copy;
+    bool started;
+    pthread_mutex_lock(&talp_info->regions_mutex);
+    {
+        monitor_copy = *monitor;
+        started = region_is_started(monitor);
+    }
+    pthread_mutex_unlock(&talp_info->regions_mutex);
+
+    /* Account for the elapsed time of the current start-stop interval */
+    if (started) {
+        monitor_copy.elapsed_time += get_time_in_ns() - monitor_copy.start_time;
+    }
+
+    pop_base_metrics_t base_metrics;
+    perf_metrics__local_monitor_into_base_metrics(&base_metrics, &monitor_copy);
+    perf_metrics__base_to_pop_metrics(monitor_copy.name, &base_metrics, pop_metrics);
+
+    return DLB_SUCCESS;
+}
+
+
 /*********************************************************************************/
 /*    TALP collect functions for 1st party programs                              */
 /*      - Requires synchronization (MPI or node barrier) among all processes     */
@@ -714,6 +1046,11 @@ int talp_collect_pop_node_metrics(const subprocess_descriptor_t *spd,
     shmem_talp__set_times(monitor_data->node_shared_id,
             monitor->mpi_time,
             monitor->useful_time);
+    shmem_talp__set_omp_times(monitor_data->node_shared_id,
+            monitor->num_cpus,
+            monitor->omp_load_imbalance_time,
+            monitor->omp_scheduling_time,
+            monitor->omp_serialization_time);
 
     /* Perform a node barrier to ensure everyone has updated their metrics */
     node_barrier(spd, NULL);
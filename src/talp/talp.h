@@ -35,7 +35,7 @@ typedef struct SubProcessDescriptor subprocess_descriptor_t;
 
 
 /* TALP init / finalize */
-int  talp_init_papi_counters(void);
+int  talp_init_thread_counters(void);
 void talp_init(subprocess_descriptor_t *spd);
 void talp_finalize(subprocess_descriptor_t *spd);
 
@@ -43,8 +43,8 @@ void talp_finalize(subprocess_descriptor_t *spd);
 /* TALP samples */
 talp_sample_t*
      talp_get_thread_sample(const subprocess_descriptor_t *spd);
-void talp_set_sample_state(talp_sample_t *sample, enum talp_sample_state state, bool papi);
-void talp_update_sample(talp_sample_t *sample, bool papi, int64_t timestamp);
+void talp_set_sample_state(talp_sample_t *sample, enum talp_sample_state state, bool counters);
+void talp_update_sample(talp_sample_t *sample, bool counters, int64_t timestamp);
 int  talp_flush_samples_to_regions(const subprocess_descriptor_t *spd);
 void talp_flush_sample_subset_to_regions(const subprocess_descriptor_t *spd,
         talp_sample_t **samples, unsigned int nelems);
@@ -52,9 +52,15 @@ void talp_flush_sample_subset_to_regions(const subprocess_descriptor_t *spd,
 
 /* TALP collect functions for 3rd party programs */
 int talp_query_pop_node_metrics(const char *name, struct dlb_node_metrics_t *node_metrics);
+int talp_query_pop_node_hybrid_metrics(const char *name,
+        struct dlb_pop_metrics_t *pop_metrics);
 
 int talp_notify_on_collective(TALP_Collective_Callback);
 
+/* TALP query functions for 1st party programs */
+int talp_query_pop_metrics(const subprocess_descriptor_t *spd,
+        struct dlb_monitor_t *monitor, struct dlb_pop_metrics_t *pop_metrics);
+
 /* TALP collect functions for 1st party programs */
 int talp_collect_pop_metrics(const subprocess_descriptor_t *spd,
         struct dlb_monitor_t *monitor, struct dlb_pop_metrics_t *pop_metrics);
@@ -0,0 +1,426 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "talp/talp_exporter.h"
+
+#include "apis/dlb_errors.h"
+#include "support/debug.h"
+#include "support/dlb_common.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/* Max time to wait for a client to send its request or read the response */
+enum { REQUEST_TIMEOUT_MS = 1000 };
+
+/* Initial size of the region names list */
+enum { INITIAL_MAX_REGION_NAMES = 16 };
+
+static const char* const cpu_state_names[EXPORTER_NUM_CPU_STATES] = {
+    [DLB_CPU_STATE_DISABLED]  = "disabled",
+    [DLB_CPU_STATE_BUSY]      = "busy",
+    [DLB_CPU_STATE_RECLAIMED] = "reclaimed",
+    [DLB_CPU_STATE_IDLE]      = "idle",
+    [DLB_CPU_STATE_LENT]      = "lent",
+};
+
+static int64_t get_monotonic_time_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* Return the increment of a raw counter read from the shared memory. If the
+ * counter went backwards, the shared memory was recreated in between */
+static int64_t counter_delta(int64_t current, int64_t *last) {
+    int64_t delta = current >= *last ? current - *last : current;
+    *last = current;
+    return delta;
+}
+
+static exporter_region_t* get_region(talp_exporter_t *exporter, const char *name) {
+    for (int i = 0; i < exporter->num_regions; ++i) {
+        if (strcmp(exporter->regions[i].name, name) == 0) {
+            return &exporter->regions[i];
+        }
+    }
+
+    void *p = realloc(exporter->regions,
+            sizeof(exporter_region_t) * (exporter->num_regions + 1));
+    fatal_cond(p == NULL, "Could not allocate exporter regions");
+    exporter->regions = p;
+    exporter_region_t *region = &exporter->regions[exporter->num_regions++];
+    *region = (const exporter_region_t) {};
+    snprintf(region->name, DLB_MONITOR_NAME_MAX, "%s", name);
+    return region;
+}
+
+static exporter_process_t* get_process(exporter_region_t *region, pid_t pid) {
+    for (int i = 0; i < region->num_processes; ++i) {
+        if (region->processes[i].pid == pid) {
+            return &region->processes[i];
+        }
+    }
+
+    void *p = realloc(region->processes,
+            sizeof(exporter_process_t) * (region->num_processes + 1));
+    fatal_cond(p == NULL, "Could not allocate exporter processes");
+    region->processes = p;
+    exporter_process_t *process = &region->processes[region->num_processes++];
+    *process = (const exporter_process_t) {.pid = pid};
+    return process;
+}
+
+/* Accumulate the increments of each process' raw times in the region.
+ * Processes that are no longer registered are forgotten. */
+static void update_region_times(talp_exporter_t *exporter, exporter_region_t *region) {
+    int max_len = exporter->ncpus > 0 ? exporter->ncpus : 1;
+    dlb_node_times_t *node_times = NULL;
+    int nelems;
+    int error;
+    do {
+        /* Grow the list until all the processes fit */
+        if (node_times != NULL) max_len *= 2;
+        free(node_times);
+        node_times = malloc(sizeof(dlb_node_times_t) * max_len);
+        error = DLB_TALP_GetNodeTimes(region->name, node_times, &nelems, max_len);
+    } while (error == DLB_SUCCESS && nelems == max_len);
+
+    if (error == DLB_SUCCESS) {
+        for (int i = 0; i < region->num_processes; ++i) {
+            region->processes[i].present = false;
+        }
+        for (int i = 0; i < nelems; ++i) {
+            exporter_process_t *process = get_process(region, node_times[i].pid);
+            process->present = true;
+            region->useful_time += counter_delta(node_times[i].useful_time,
+                    &process->last_useful_time);
+            region->mpi_time += counter_delta(node_times[i].mpi_time,
+                    &process->last_mpi_time);
+        }
+        int num_present = 0;
+        for (int i = 0; i < region->num_processes; ++i) {
+            if (region->processes[i].present) {
+                region->processes[num_present++] = region->processes[i];
+            }
+        }
+        region->num_processes = num_present;
+    }
+    free(node_times);
+}
+
+DLB_EXPORT_SYMBOL
+void talp_exporter_init(talp_exporter_t *exporter) {
+    *exporter = (const talp_exporter_t) {
+        .max_region_names = INITIAL_MAX_REGION_NAMES,
+    };
+    DLB_TALP_GetNumCPUs(&exporter->ncpus);
+    exporter->cpu_states = calloc(exporter->ncpus, sizeof(dlb_cpu_state_t));
+}
+
+DLB_EXPORT_SYMBOL
+void talp_exporter_finalize(talp_exporter_t *exporter) {
+    for (int i = 0; i < exporter->num_regions; ++i) {
+        free(exporter->regions[i].processes);
+    }
+    free(exporter->regions);
+    free(exporter->cpu_states);
+    *exporter = (const talp_exporter_t) {};
+}
+
+DLB_EXPORT_SYMBOL
+void talp_exporter_sample(talp_exporter_t *exporter) {
+    int64_t now = get_monotonic_time_ns();
+    double elapsed = exporter->last_sample_time > 0
+        ? (double)(now - exporter->last_sample_time) / 1e9 : 0.0;
+    exporter->last_sample_time = now;
+
+    /* CPU states */
+    int nelems = 0;
+    if (DLB_TALP_GetCpuStates(exporter->cpu_states, &nelems, exporter->ncpus)
+            == DLB_SUCCESS) {
+        for (int cpuid = 0; cpuid < nelems; ++cpuid) {
+            exporter->state_seconds[exporter->cpu_states[cpuid]] += elapsed;
+        }
+    }
+
+    /* Processes */
+    int *pidlist = malloc(sizeof(int) * exporter->ncpus);
+    if (DLB_TALP_GetPidList(pidlist, &nelems, exporter->ncpus) == DLB_SUCCESS) {
+        exporter->num_processes = nelems;
+    }
+    free(pidlist);
+
+    /* LeWI counters */
+    int64_t num_lends, num_borrows;
+    if (DLB_TALP_GetLeWICounters(&num_lends, &num_borrows) == DLB_SUCCESS) {
+        exporter->num_lends += counter_delta(num_lends, &exporter->last_num_lends);
+        exporter->num_borrows += counter_delta(num_borrows, &exporter->last_num_borrows);
+    }
+
+    /* TALP regions */
+    for (int i = 0; i < exporter->num_regions; ++i) {
+        exporter->regions[i].present = false;
+    }
+    char (*names)[DLB_MONITOR_NAME_MAX] = NULL;
+    int error;
+    do {
+        /* Grow the list until all the names fit */
+        if (names != NULL) exporter->max_region_names *= 2;
+        free(names);
+        names = malloc(sizeof(*names) * exporter->max_region_names);
+        error = DLB_TALP_GetRegionNames(names, &nelems, exporter->max_region_names);
+    } while (error == DLB_SUCCESS && nelems == exporter->max_region_names);
+    if (error == DLB_SUCCESS) {
+        for (int i = 0; i < nelems; ++i) {
+            dlb_node_metrics_t metrics;
+            if (DLB_TALP_QueryPOPNodeMetrics(names[i], &metrics) == DLB_SUCCESS) {
+                exporter_region_t *region = get_region(exporter, names[i]);
+                region->present = true;
+                region->metrics = metrics;
+                update_region_times(exporter, region);
+            }
+        }
+    }
+    free(names);
+}
+
+DLB_EXPORT_SYMBOL
+const exporter_region_t* talp_exporter_get_region(const talp_exporter_t *exporter,
+        const char *name) {
+    for (int i = 0; i < exporter->num_regions; ++i) {
+        if (strcmp(exporter->regions[i].name, name) == 0) {
+            return &exporter->regions[i];
+        }
+    }
+    return NULL;
+}
+
+/* Write a label value escaping backslashes, double quotes and line feeds */
+static void write_label_value(FILE *out, const char *value) {
+    for (const char *c = value; *c != '\0'; ++c) {
+        switch (*c) {
+            case '\\': fputs("\\\\", out); break;
+            case '"':  fputs("\\\"", out); break;
+            case '\n': fputs("\\n", out); break;
+            default:   fputc(*c, out); break;
+        }
+    }
+}
+
+static void write_region_metric(FILE *out, const talp_exporter_t *exporter,
+        const char *metric, const char *type, const char *help,
+        double (*get_value)(const exporter_region_t*)) {
+    fprintf(out, "# TYPE %s %s\n# HELP %s %s\n", metric, type, metric, help);
+    const char *suffix = strcmp(type, "counter") == 0 ? "_total" : "";
+    for (int i = 0; i < exporter->num_regions; ++i) {
+        const exporter_region_t *region = &exporter->regions[i];
+        if (region->present) {
+            fprintf(out, "%s%s{region=\"", metric, suffix);
+            write_label_value(out, region->name);
+            fprintf(out, "\"} %g\n", get_value(region));
+        }
+    }
+}
+
+static double get_useful_seconds(const exporter_region_t *region) {
+    return region->useful_time / 1e9;
+}
+
+static double get_mpi_seconds(const exporter_region_t *region) {
+    return region->mpi_time / 1e9;
+}
+
+static double get_processes(const exporter_region_t *region) {
+    return region->metrics.processes_per_node;
+}
+
+static double get_parallel_efficiency(const exporter_region_t *region) {
+    return region->metrics.parallel_efficiency;
+}
+
+static double get_communication_efficiency(const exporter_region_t *region) {
+    return region->metrics.communication_efficiency;
+}
+
+static double get_load_balance(const exporter_region_t *region) {
+    return region->metrics.load_balance;
+}
+
+DLB_EXPORT_SYMBOL
+void talp_exporter_write_metrics(FILE *out, const talp_exporter_t *exporter) {
+    fputs("# TYPE dlb_processes gauge\n"
+          "# HELP dlb_processes Number of DLB processes in the node.\n", out);
+    fprintf(out, "dlb_processes %d\n", exporter->num_processes);
+
+    fputs("# TYPE dlb_cpus gauge\n"
+          "# HELP dlb_cpus Number of CPUs in each state.\n", out);
+    for (int state = 0; state < EXPORTER_NUM_CPU_STATES; ++state) {
+        int count = 0;
+        for (int cpuid = 0; cpuid < exporter->ncpus; ++cpuid) {
+            if (exporter->cpu_states[cpuid] == (dlb_cpu_state_t)state) ++count;
+        }
+        fprintf(out, "dlb_cpus{state=\"%s\"} %d\n", cpu_state_names[state], count);
+    }
+
+    fputs("# TYPE dlb_cpu_state_seconds counter\n"
+          "# HELP dlb_cpu_state_seconds Accumulated CPU time in each state.\n", out);
+    for (int state = 0; state < EXPORTER_NUM_CPU_STATES; ++state) {
+        fprintf(out, "dlb_cpu_state_seconds_total{state=\"%s\"} %.3f\n",
+                cpu_state_names[state], exporter->state_seconds[state]);
+    }
+
+    fputs("# TYPE dlb_lewi_lends counter\n"
+          "# HELP dlb_lewi_lends Number of CPUs released by DLB processes.\n", out);
+    fprintf(out, "dlb_lewi_lends_total %"PRId64"\n", exporter->num_lends);
+
+    fputs("# TYPE dlb_lewi_borrows counter\n"
+          "# HELP dlb_lewi_borrows Number of CPUs acquired by DLB processes.\n", out);
+    fprintf(out, "dlb_lewi_borrows_total %"PRId64"\n", exporter->num_borrows);
+
+    write_region_metric(out, exporter, "dlb_talp_useful_seconds", "counter",
+            "Accumulated CPU time of useful computation in the region.",
+            get_useful_seconds);
+    write_region_metric(out, exporter, "dlb_talp_mpi_seconds", "counter",
+            "Accumulated CPU time of communication in the region.",
+            get_mpi_seconds);
+    write_region_metric(out, exporter, "dlb_talp_processes", "gauge",
+            "Number of processes in the node that have started the region.",
+            get_processes);
+    write_region_metric(out, exporter, "dlb_talp_parallel_efficiency", "gauge",
+            "Node parallel efficiency of the region.",
+            get_parallel_efficiency);
+    write_region_metric(out, exporter, "dlb_talp_communication_efficiency", "gauge",
+            "Node communication efficiency of the region.",
+            get_communication_efficiency);
+    write_region_metric(out, exporter, "dlb_talp_load_balance", "gauge",
+            "Node load balance of the region.",
+            get_load_balance);
+
+    fputs("# EOF\n", out);
+}
+
+/* Write to a temporary file and rename it so readers never see partial data */
+DLB_EXPORT_SYMBOL
+int talp_exporter_write_file(const char *filename, const talp_exporter_t *exporter) {
+    size_t len = strlen(filename) + 5;
+    char *tmp_filename = malloc(len);
+    snprintf(tmp_filename, len, "%s.tmp", filename);
+    int error = DLB_SUCCESS;
+    FILE *out = fopen(tmp_filename, "w");
+    if (out == NULL) {
+        warning("Cannot open file %s: %s", tmp_filename, strerror(errno));
+        error = DLB_ERR_UNKNOWN;
+    } else {
+        talp_exporter_write_metrics(out, exporter);
+        fclose(out);
+        if (rename(tmp_filename, filename) != 0) {
+            warning("Cannot rename file %s: %s", tmp_filename, strerror(errno));
+            error = DLB_ERR_UNKNOWN;
+        }
+    }
+    free(tmp_filename);
+    return error;
+}
+
+/* Listen on the loopback interface. Returns the socket, or -1 on error */
+DLB_EXPORT_SYMBOL
+int talp_exporter_open_socket(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        warning("Cannot create socket: %s", strerror(errno));
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    /* The connection may be gone between poll and accept */
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+            || listen(fd, 8) != 0) {
+        warning("Cannot listen on port %d: %s", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+DLB_EXPORT_SYMBOL
+void talp_exporter_serve_request(int listen_fd, talp_exporter_t *exporter) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd == -1) return;
+
+    /* Do not let a slow client block the sampling loop */
+    struct timeval timeout = {
+        .tv_sec = REQUEST_TIMEOUT_MS / 1000,
+        .tv_usec = (REQUEST_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    /* Read the request, any path is answered with the metrics */
+    char request[1024];
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, REQUEST_TIMEOUT_MS) <= 0
+            || read(fd, request, sizeof(request)) <= 0) {
+        close(fd);
+        return;
+    }
+
+    /* Refresh counters so that each scrape gets up to date values */
+    talp_exporter_sample(exporter);
+
+    char *body = NULL;
+    size_t body_len = 0;
+    FILE *out = open_memstream(&body, &body_len);
+    talp_exporter_write_metrics(out, exporter);
+    fclose(out);
+
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+            "Content-Length: %zu\r\n"
+            "\r\n", body_len);
+    if (write(fd, header, header_len) == header_len) {
+        for (size_t written = 0; written < body_len; ) {
+            ssize_t n = write(fd, body + written, body_len - written);
+            if (n <= 0) break;
+            written += n;
+        }
+    }
+    free(body);
+    close(fd);
+}
@@ -0,0 +1,79 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+#ifndef TALP_EXPORTER_H
+#define TALP_EXPORTER_H
+
+#include "apis/dlb_talp.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/* Node metrics exporter used by the dlb_exporter utility. It samples the DLB
+ * shared memories through the TALP attach API and formats the accumulated
+ * values in the OpenMetrics text format. */
+
+enum { EXPORTER_NUM_CPU_STATES = DLB_CPU_STATE_LENT + 1 };
+
+typedef struct exporter_process_t {
+    pid_t   pid;
+    bool    present;            /* whether the process was found in the last sample */
+    int64_t last_useful_time;   /* raw value of the last sample */
+    int64_t last_mpi_time;      /* raw value of the last sample */
+} exporter_process_t;
+
+typedef struct exporter_region_t {
+    char    name[DLB_MONITOR_NAME_MAX];
+    bool    present;            /* whether the region was found in the last sample */
+    exporter_process_t *processes; /* last raw times of each process in the region */
+    int     num_processes;
+    int64_t useful_time;        /* accumulated */
+    int64_t mpi_time;           /* accumulated */
+    dlb_node_metrics_t metrics;
+} exporter_region_t;
+
+typedef struct talp_exporter_t {
+    int             ncpus;
+    dlb_cpu_state_t *cpu_states;
+    int             num_processes;
+    int64_t         last_num_lends;
+    int64_t         last_num_borrows;
+    int64_t         num_lends;
+    int64_t         num_borrows;
+    double          state_seconds[EXPORTER_NUM_CPU_STATES];
+    int64_t         last_sample_time;
+    exporter_region_t *regions;
+    int             num_regions;
+    int             max_region_names;   /* size of the region names list, grows
+                                           until all the names fit */
+} talp_exporter_t;
+
+void talp_exporter_init(talp_exporter_t *exporter);
+void talp_exporter_finalize(talp_exporter_t *exporter);
+void talp_exporter_sample(talp_exporter_t *exporter);
+const exporter_region_t* talp_exporter_get_region(const talp_exporter_t *exporter,
+        const char *name);
+void talp_exporter_write_metrics(FILE *out, const talp_exporter_t *exporter);
+int  talp_exporter_write_file(const char *filename, const talp_exporter_t *exporter);
+int  talp_exporter_open_socket(int port);
+void talp_exporter_serve_request(int listen_fd, talp_exporter_t *exporter);
+
+#endif /* TALP_EXPORTER_H */
@@ -25,6 +25,7 @@
 #include "apis/dlb_talp.h"
 #include "support/atomic.h"
 #include "support/debug.h"
+#include "support/hash.h"
 #include "support/mask_utils.h"
 #include "talp/regions.h"
 #include "talp/talp.h"
@@ -35,13 +36,99 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 extern __thread bool thread_is_observer;
 
 
+/* Merge two sorted sets of region hashes, adding up the number of processes
+ * that have each hash and keeping the lowest rank among them. 'out' must have
+ * room for na+nb elements. Returns the size of the merged set. */
+int talp_merge_region_hashes(const region_hash_count_t *a, int na,
+        const region_hash_count_t *b, int nb, region_hash_count_t *out) {
+    int i = 0, j = 0, n = 0;
+    while (i < na && j < nb) {
+        if (a[i].hash < b[j].hash) {
+            out[n++] = a[i++];
+        } else if (a[i].hash > b[j].hash) {
+            out[n++] = b[j++];
+        } else {
+            out[n++] = (const region_hash_count_t) {
+                .hash = a[i].hash,
+                .count = a[i].count + b[j].count,
+                .owner = a[i].owner < b[j].owner ? a[i].owner : b[j].owner,
+            };
+            ++i;
+            ++j;
+        }
+    }
+    while (i < na) out[n++] = a[i++];
+    while (j < nb) out[n++] = b[j++];
+    return n;
+}
+
 #ifdef MPI_LIB
-/* Communicate among all MPI processes so that everyone has the same monitoring regions */
+typedef struct region_hash_t {
+    uint64_t hash;
+    const char *name;
+} region_hash_t;
+
+enum { REGION_HASHES_TAG = 42 };
+
+static int cmp_region_hash(const void *a, const void *b) {
+    uint64_t hash_a = ((const region_hash_t*)a)->hash;
+    uint64_t hash_b = ((const region_hash_t*)b)->hash;
+    return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+/* Binomial tree reduction of the sorted sets of hashes into rank 0, followed
+ * by a broadcast of the union. Each step only transfers the union of a
+ * subtree, instead of every hash of every process. Takes ownership of 'set'
+ * and returns the union, of size *nunion. */
+static region_hash_count_t* reduce_region_hashes(region_hash_count_t *set, int nset,
+        int *nunion) {
+    MPI_Comm comm = getWorldComm();
+    for (int mask = 1; mask < _mpi_size; mask <<= 1) {
+        if (_mpi_rank & mask) {
+            PMPI_Send(set, nset * sizeof(region_hash_count_t), MPI_BYTE,
+                    _mpi_rank - mask, REGION_HASHES_TAG, comm);
+            break;
+        }
+        int child = _mpi_rank + mask;
+        if (child < _mpi_size) {
+            MPI_Status status;
+            int nbytes;
+            PMPI_Probe(child, REGION_HASHES_TAG, comm, &status);
+            PMPI_Get_count(&status, MPI_BYTE, &nbytes);
+            int nchild = nbytes / sizeof(region_hash_count_t);
+            region_hash_count_t *child_set = malloc(nbytes);
+            PMPI_Recv(child_set, nbytes, MPI_BYTE, child, REGION_HASHES_TAG, comm,
+                    MPI_STATUS_IGNORE);
+            region_hash_count_t *merged = malloc((nset + nchild) * sizeof(region_hash_count_t));
+            nset = talp_merge_region_hashes(set, nset, child_set, nchild, merged);
+            free(child_set);
+            free(set);
+            set = merged;
+        }
+    }
+
+    PMPI_Bcast(&nset, 1, MPI_INT, 0, comm);
+    if (_mpi_rank != 0) {
+        free(set);
+        set = malloc(nset * sizeof(region_hash_count_t));
+    }
+    PMPI_Bcast(set, nset * sizeof(region_hash_count_t), MPI_BYTE, 0, comm);
+
+    *nunion = nset;
+    return set;
+}
+
+/* Communicate among all MPI processes so that everyone has the same monitoring
+ * regions. The sorted sets of 64-bit hashes of the names are merged along a
+ * tree; the actual names are only exchanged for the regions that some process
+ * lacks. Two different names with the same hash would be considered the same
+ * region. */
 static void talp_register_common_mpi_regions(const subprocess_descriptor_t *spd) {
     /* Note: there's a potential race condition if this function is called
      * (which happens on talp_mpi_finalize or talp_finalize) while another
@@ -53,68 +140,109 @@ static void talp_register_common_mpi_regions(const subprocess_descriptor_t *spd)
     talp_info_t *talp_info = spd->talp_info;
 
     /* Warn about open regions */
-    for (GSList *node = talp_info->open_regions;
-            node != NULL;
-            node = node->next) {
-        const dlb_monitor_t *monitor = node->data;
+    for (const dlb_monitor_t *monitor = talp_info->open_regions;
+            monitor != NULL;
+            monitor = ((monitor_data_t*)monitor->_data)->open_next) {
         warning("Region %s is still open during MPI_Finalize."
                 " Collected data may be incomplete.",
                 monitor->name);
     }
 
-    /* Gather recvcounts for each process
-        * (Each process may have different number of monitors) */
-    int nregions = g_tree_nnodes(talp_info->regions);
-    int chars_to_send = nregions * DLB_MONITOR_NAME_MAX;
-    int *recvcounts = malloc(_mpi_size * sizeof(int));
-    PMPI_Allgather(&chars_to_send, 1, MPI_INT,
-            recvcounts, 1, MPI_INT, getWorldComm());
-
-    /* Compute total characters to gather via MPI */
+    /* Hash the local region names */
+    int nregions = strmap_size(&talp_info->regions);
+    region_hash_t *local_hashes = malloc(nregions * sizeof(region_hash_t));
     int i;
-    int total_chars = 0;
-    for (i=0; i<_mpi_size; ++i) {
-        total_chars += recvcounts[i];
+    for (i = 0; i < nregions; ++i) {
+        const dlb_monitor_t *monitor = strmap_value_at(&talp_info->regions, i);
+        local_hashes[i] = (const region_hash_t) {
+            .hash = hash_fnv1a_64(monitor->name, DLB_MONITOR_NAME_MAX),
+            .name = monitor->name,
+        };
+    }
+    qsort(local_hashes, nregions, sizeof(region_hash_t), cmp_region_hash);
+
+    /* Local set of hashes, without duplicates */
+    region_hash_count_t *set = malloc(nregions * sizeof(region_hash_count_t));
+    int nset = 0;
+    for (i = 0; i < nregions; ++i) {
+        if (nset == 0 || set[nset-1].hash != local_hashes[i].hash) {
+            set[nset++] = (const region_hash_count_t) {
+                .hash = local_hashes[i].hash,
+                .count = 1,
+                .owner = _mpi_rank,
+            };
+        }
     }
 
-    if (total_chars > 0) {
-        /* Prepare sendbuffer */
-        char *sendbuffer = malloc(nregions * DLB_MONITOR_NAME_MAX * sizeof(char));
-        char *sendptr = sendbuffer;
-        for (GTreeNode *node = g_tree_node_first(talp_info->regions);
-                node != NULL;
-                node = g_tree_node_next(node)) {
-            const dlb_monitor_t *monitor = g_tree_node_value(node);
-            strcpy(sendptr, monitor->name);
-            sendptr += DLB_MONITOR_NAME_MAX;
+    /* Union of hashes. For each hash that is not present in every process,
+     * the lowest rank that has it will send the name. */
+    int nunion;
+    region_hash_count_t *union_set = reduce_region_hashes(set, nset, &nunion);
+
+    int *recvcounts = calloc(_mpi_size, sizeof(int));
+    int *displs = malloc(_mpi_size * sizeof(int));
+    int nnames_to_send = 0;
+    const char **names_to_send = malloc(nregions * sizeof(char*));
+    int total_names = 0;
+    for (i = 0; i < nunion; ++i) {
+        if (union_set[i].count < _mpi_size) {
+            int owner = union_set[i].owner;
+            recvcounts[owner] += DLB_MONITOR_NAME_MAX;
+            ++total_names;
+            if (owner == _mpi_rank) {
+                region_hash_t key = { .hash = union_set[i].hash };
+                region_hash_t *local = bsearch(&key, local_hashes, nregions,
+                        sizeof(region_hash_t), cmp_region_hash);
+                names_to_send[nnames_to_send++] = local->name;
+            }
         }
+    }
 
-        /* Prepare recvbuffer */
-        char *recvbuffer = malloc(total_chars * sizeof(char));
+    if (total_names > 0) {
+        /* Prepare sendbuffer with only the names this process is responsible of */
+        char *sendbuffer = calloc(nnames_to_send, DLB_MONITOR_NAME_MAX);
+        for (i = 0; i < nnames_to_send; ++i) {
+            snprintf(&sendbuffer[i*DLB_MONITOR_NAME_MAX], DLB_MONITOR_NAME_MAX,
+                    "%s", names_to_send[i]);
+        }
 
         /* Compute displacements */
-        int *displs = malloc(_mpi_size * sizeof(int));
         int next_disp = 0;
-        for (i=0; i<_mpi_size; ++i) {
-            displs[i] = next_disp;
-            next_disp += recvcounts[i];
+        for (int rank = 0; rank < _mpi_size; ++rank) {
+            displs[rank] = next_disp;
+            next_disp += recvcounts[rank];
         }
 
-        /* Gather all regions */
-        PMPI_Allgatherv(sendbuffer, nregions * DLB_MONITOR_NAME_MAX, MPI_CHAR,
+        /* Gather the names not present in every process */
+        char *recvbuffer = malloc(total_names * DLB_MONITOR_NAME_MAX);
+        PMPI_Allgatherv(sendbuffer, nnames_to_send * DLB_MONITOR_NAME_MAX, MPI_CHAR,
                 recvbuffer, recvcounts, displs, MPI_CHAR, getWorldComm());
 
-        /* Register all regions. Existing ones will be skipped. */
-        for (i=0; i<total_chars; i+=DLB_MONITOR_NAME_MAX) {
-            region_register(spd, &recvbuffer[i]);
+        /* Register the names unknown to this process, all at once */
+        int nnew_names = 0;
+        for (i = 0; i < total_names; ++i) {
+            const char *name = &recvbuffer[i*DLB_MONITOR_NAME_MAX];
+            region_hash_t key = { .hash = hash_fnv1a_64(name, DLB_MONITOR_NAME_MAX) };
+            if (bsearch(&key, local_hashes, nregions,
+                        sizeof(region_hash_t), cmp_region_hash) == NULL) {
+                if (nnew_names != i) {
+                    memcpy(&recvbuffer[nnew_names*DLB_MONITOR_NAME_MAX], name,
+                            DLB_MONITOR_NAME_MAX);
+                }
+                ++nnew_names;
+            }
         }
+        region_register_bulk(spd, recvbuffer, nnew_names);
 
         free(sendbuffer);
         free(recvbuffer);
-        free(displs);
     }
 
+    free(names_to_send);
+    free(union_set);
+    free(displs);
     free(recvcounts);
+    free(local_hashes);
 }
 #endif
 
@@ -151,7 +279,7 @@ void talp_mpi_init(const subprocess_descriptor_t *spd) {
         /* Add MPI_Init statistic and set useful state */
         talp_sample_t *sample = talp_get_thread_sample(spd);
         DLB_ATOMIC_ADD_RLX(&sample->stats.num_mpi_calls, 1);
-        talp_set_sample_state(sample, useful, talp_info->flags.papi);
+        talp_set_sample_state(sample, useful, talp_info->flags.counters);
     }
 }
 
@@ -175,6 +303,11 @@ void talp_mpi_finalize(const subprocess_descriptor_t *spd) {
             shmem_talp__set_times(monitor_data->node_shared_id,
                     talp_info->monitor->mpi_time,
                     talp_info->monitor->useful_time);
+            shmem_talp__set_omp_times(monitor_data->node_shared_id,
+                    talp_info->monitor->num_cpus,
+                    talp_info->monitor->omp_load_imbalance_time,
+                    talp_info->monitor->omp_scheduling_time,
+                    talp_info->monitor->omp_serialization_time);
         }
 
 #ifdef MPI_LIB
@@ -197,11 +330,14 @@ void talp_mpi_finalize(const subprocess_descriptor_t *spd) {
                     /* Ensure everyone has the same monitoring regions */
                     talp_register_common_mpi_regions(spd);
 
-                    /* Finally, reduce data */
-                    for (GTreeNode *node = g_tree_node_first(talp_info->regions);
-                            node != NULL;
-                            node = g_tree_node_next(node)) {
-                        const dlb_monitor_t *monitor = g_tree_node_value(node);
+                    /* Finally, reduce data. All processes have the same
+                     * regions now, iterate them in the same order */
+                    unsigned int nregions = strmap_size(&talp_info->regions);
+                    const dlb_monitor_t **monitors =
+                        malloc(sizeof(dlb_monitor_t*) * nregions);
+                    strmap_sorted_values(&talp_info->regions, (void**)monitors);
+                    for (unsigned int i = 0; i < nregions; ++i) {
+                        const dlb_monitor_t *monitor = monitors[i];
                         if (spd->options.talp_summary & SUMMARY_POP_METRICS) {
                             talp_record_pop_summary(spd, monitor);
                         }
@@ -209,6 +345,7 @@ void talp_mpi_finalize(const subprocess_descriptor_t *spd) {
                             talp_record_process_summary(spd, monitor);
                         }
                     }
+                    free(monitors);
                 }
 
                 /* Synchronize all processes in node before continuing with DLB finalization  */
@@ -231,7 +368,7 @@ static inline void update_sample_on_sync_call(const subprocess_descriptor_t *spd
 
     if (!talp_info->flags.external_profiler || !is_blocking_collective) {
         /* Likely scenario, just update the sample */
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
     } else {
         /* If talp_info->flags.external_profiler && is_blocking_collective:
          * aggregate samples and update all monitoring regions */
@@ -250,7 +387,7 @@ void talp_into_sync_call(const subprocess_descriptor_t *spd, bool is_blocking_co
         update_sample_on_sync_call(spd, talp_info, sample, is_blocking_collective);
 
         /* Into Sync call -> not_useful_mpi */
-        talp_set_sample_state(sample, not_useful_mpi, talp_info->flags.papi);
+        talp_set_sample_state(sample, not_useful_mpi, talp_info->flags.counters);
     }
 }
 
@@ -268,6 +405,6 @@ void talp_out_of_sync_call(const subprocess_descriptor_t *spd, bool is_blocking_
         notify_collective_callbacks();
 
         /* Out of Sync call -> useful */
-        talp_set_sample_state(sample, useful, talp_info->flags.papi);
+        talp_set_sample_state(sample, useful, talp_info->flags.counters);
     }
 }
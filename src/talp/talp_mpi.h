@@ -21,13 +21,25 @@
 #define TALP_MPI_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct SubProcessDescriptor subprocess_descriptor_t;
 
+/* Hash of a region name, with the number of processes that have it and the
+ * lowest rank among them */
+typedef struct region_hash_count_t {
+    uint64_t hash;
+    int count;
+    int owner;
+} region_hash_count_t;
+
 /* TALP MPI functions */
 void talp_mpi_init(const subprocess_descriptor_t *spd);
 void talp_mpi_finalize(const subprocess_descriptor_t *spd);
 void talp_into_sync_call(const subprocess_descriptor_t *spd, bool is_blocking_collective);
 void talp_out_of_sync_call(const subprocess_descriptor_t *spd, bool is_blocking_collective);
 
+int talp_merge_region_hashes(const region_hash_count_t *a, int na,
+        const region_hash_count_t *b, int nb, region_hash_count_t *out);
+
 #endif /* TALP_MPI_H */
@@ -44,15 +44,14 @@ static void update_serialization_in_nested_regions(const subprocess_descriptor_t
     /* Update all open nested regions */
     pthread_mutex_lock(&talp_info->regions_mutex);
     {
-        GSList *nested_open_regions = talp_info->open_regions
-            ? talp_info->open_regions->next
+        dlb_monitor_t *nested_open_regions = talp_info->open_regions
+            ? ((monitor_data_t*)talp_info->open_regions->_data)->open_next
             : NULL;
 
-        for (GSList *node = nested_open_regions;
-                node != NULL;
-                node = node->next) {
+        for (dlb_monitor_t *monitor = nested_open_regions;
+                monitor != NULL;
+                monitor = ((monitor_data_t*)monitor->_data)->open_next) {
 
-            dlb_monitor_t *monitor = node->data;
             monitor->omp_serialization_time +=
                 sample->last_updated_timestamp - monitor->start_time;
         }
@@ -88,7 +87,7 @@ void talp_openmp_init(pid_t pid, const options_t* options) {
 
         /* Set useful state */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_set_sample_state(sample, useful, talp_info->flags.papi);
+        talp_set_sample_state(sample, useful, talp_info->flags.counters);
     }
 }
 
@@ -108,10 +107,10 @@ void talp_openmp_thread_begin() {
         talp_sample_t *sample = talp_get_thread_sample(spd);
         if (sample->state == disabled) {
             /* Not initial thread: */
-            if (talp_info->flags.papi) {
-                talp_init_papi_counters();
+            if (talp_info->flags.counters) {
+                talp_init_thread_counters();
             }
-            talp_set_sample_state(sample, not_useful_omp_out, talp_info->flags.papi);
+            talp_set_sample_state(sample, not_useful_omp_out, talp_info->flags.counters);
 
             /* The initial time of the sample is set to match the start time of
              * the innermost open region, but other nested open regions need to
@@ -127,10 +126,10 @@ void talp_openmp_thread_end(void) {
     if (talp_info) {
         /* Update thread sample with the last microsample */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         /* Update state */
-        talp_set_sample_state(sample, disabled, talp_info->flags.papi);
+        talp_set_sample_state(sample, disabled, talp_info->flags.counters);
     }
 }
 
@@ -178,7 +177,7 @@ void talp_openmp_parallel_end(omptool_parallel_data_t *parallel_data) {
     if (talp_info) {
         /* Update thread sample with the last microsample */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         if (parallel_data->level == 1) {
             /* Flush and aggregate all samples of the parallel region */
@@ -202,7 +201,7 @@ void talp_openmp_parallel_end(omptool_parallel_data_t *parallel_data) {
         }
 
         /* Update current threads's state */
-        talp_set_sample_state(sample, useful, talp_info->flags.papi);
+        talp_set_sample_state(sample, useful, talp_info->flags.counters);
 
         /* Update the state of the rest of team-worker threads
          * (note that talp_set_sample_state cannot be used here because we are
@@ -232,10 +231,10 @@ void talp_openmp_into_parallel_function(
         }
 
         /* Update thread sample with the last microsample */
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         /* Update state */
-        talp_set_sample_state(sample, useful, talp_info->flags.papi);
+        talp_set_sample_state(sample, useful, talp_info->flags.counters);
     }
 }
 
@@ -245,10 +244,10 @@ void talp_openmp_into_parallel_implicit_barrier(omptool_parallel_data_t *paralle
     if (talp_info) {
         /* Update thread sample with the last microsample */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         /* Update state */
-        talp_set_sample_state(sample, not_useful_omp_in, talp_info->flags.papi);
+        talp_set_sample_state(sample, not_useful_omp_in, talp_info->flags.counters);
     }
 }
 
@@ -258,10 +257,10 @@ void talp_openmp_into_parallel_sync(omptool_parallel_data_t *parallel_data) {
     if (talp_info) {
         /* Update thread sample with the last microsample */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         /* Update state */
-        talp_set_sample_state(sample, not_useful_omp_in, talp_info->flags.papi);
+        talp_set_sample_state(sample, not_useful_omp_in, talp_info->flags.counters);
     }
 }
 
@@ -271,10 +270,10 @@ void talp_openmp_outof_parallel_sync(omptool_parallel_data_t *parallel_data) {
     if (talp_info) {
         /* Update thread sample with the last microsample */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         /* Update state */
-        talp_set_sample_state(sample, useful, talp_info->flags.papi);
+        talp_set_sample_state(sample, useful, talp_info->flags.counters);
     }
 }
 
@@ -294,10 +293,10 @@ void talp_openmp_task_complete(void) {
     if (talp_info) {
         /* Update thread sample with the last microsample */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         /* Update state (FIXME: tasks outside of parallels? */
-        talp_set_sample_state(sample, not_useful_omp_in, talp_info->flags.papi);
+        talp_set_sample_state(sample, not_useful_omp_in, talp_info->flags.counters);
     }
 }
 
@@ -307,9 +306,9 @@ void talp_openmp_task_switch(void) {
     if (talp_info) {
         /* Update thread sample with the last microsample */
         talp_sample_t *sample = talp_get_thread_sample(spd);
-        talp_update_sample(sample, talp_info->flags.papi, TALP_NO_TIMESTAMP);
+        talp_update_sample(sample, talp_info->flags.counters, TALP_NO_TIMESTAMP);
 
         /* Update state */
-        talp_set_sample_state(sample, useful, talp_info->flags.papi);
+        talp_set_sample_state(sample, useful, talp_info->flags.counters);
     }
 }
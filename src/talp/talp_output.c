@@ -24,8 +24,9 @@
 #include "talp/talp_output.h"
 
 #include "apis/dlb_talp.h"
+#include "support/arena.h"
 #include "support/debug.h"
-#include "support/gslist.h"
+#include "support/hash.h"
 #include "support/mytime.h"
 #include "talp/talp.h"
 #include "talp/perf_metrics.h"
@@ -53,7 +54,8 @@ static float sanitized_ipc(float instructions, float cycles) {
 /*********************************************************************************/
 
 void talp_output_print_monitoring_region(const dlb_monitor_t *monitor,
-        const char *cpuset_str, bool have_mpi, bool have_openmp, bool have_papi) {
+        const char *cpuset_str, bool have_mpi, bool have_openmp, bool have_papi,
+        const hwc_metrics_t *hwc_metrics) {
 
     char elapsed_time_str[16];
     ns_to_human(elapsed_time_str, 16, monitor->elapsed_time);
@@ -79,6 +81,14 @@ void talp_output_print_monitoring_region(const dlb_monitor_t *monitor,
     if (have_papi) {
         float ipc = sanitized_ipc(monitor->instructions, monitor->cycles);
         info("### IPC:                                      %.2f ", ipc);
+        if (hwc_metrics != NULL && hwc_metrics->gflops > 0.0f) {
+            info("### GFLOP/s:                                  %.2f",
+                    hwc_metrics->gflops);
+        }
+        if (hwc_metrics != NULL && hwc_metrics->mem_bound > 0.0f) {
+            info("### Memory-bound fraction:                    %.2f",
+                    hwc_metrics->mem_bound);
+        }
     }
     if (have_mpi) {
         info("### Number of MPI calls:                      %"PRId64,
@@ -93,29 +103,78 @@ void talp_output_print_monitoring_region(const dlb_monitor_t *monitor,
 }
 
 
+/*********************************************************************************/
+/*    Record lists                                                               */
+/*********************************************************************************/
+
+/* All records are allocated in an arena and deallocated at once in
+ * talp_output_finalize. Each list node is allocated together with its data. */
+
+typedef struct record_node_t {
+    struct record_node_t *next;
+    void *data;
+} record_node_t;
+
+typedef struct record_list_t {
+    record_node_t *first;
+    record_node_t **last;       /* Address of the last next pointer */
+} record_list_t;
+
+#define RECORD_LIST_INITIALIZER(list) { .first = NULL, .last = &(list).first }
+
+static arena_t records_arena = {};
+
+/* Append a new zero-initialized record of the given size and return it */
+static void* record_list_append(record_list_t *list, size_t size) {
+    size_t node_size = arena_align(sizeof(record_node_t));
+    record_node_t *node = arena_alloc(&records_arena, node_size + size);
+    fatal_cond(!node, "Could not allocate TALP record."
+            " Please report at "PACKAGE_BUGREPORT);
+    node->data = (unsigned char*)node + node_size;
+    *list->last = node;
+    list->last = &node->next;
+    return node->data;
+}
+
+static void record_list_clear(record_list_t *list) {
+    list->first = NULL;
+    list->last = &list->first;
+}
+
+
 /*********************************************************************************/
 /*    POP Metrics                                                                */
 /*********************************************************************************/
 
-static GSList *pop_metrics_records = NULL;
+/* The POP metrics are the first member, so that records can be iterated as
+ * dlb_pop_metrics_t when the hardware counter metrics are not needed */
+typedef struct pop_metrics_record_t {
+    dlb_pop_metrics_t metrics;
+    hwc_metrics_t hwc_metrics;
+} pop_metrics_record_t;
 
-void talp_output_record_pop_metrics(const dlb_pop_metrics_t *metrics) {
+static record_list_t pop_metrics_records = RECORD_LIST_INITIALIZER(pop_metrics_records);
 
-    /* Copy structure */
-    dlb_pop_metrics_t *new_record = malloc(sizeof(dlb_pop_metrics_t));
-    *new_record = *metrics;
+void talp_output_record_pop_metrics(const dlb_pop_metrics_t *metrics,
+        const hwc_metrics_t *hwc_metrics) {
 
-    /* Add record to list */
-    pop_metrics_records = g_slist_prepend(pop_metrics_records, new_record);
+    /* Copy structure to a new record in the list */
+    pop_metrics_record_t *new_record = record_list_append(&pop_metrics_records,
+            sizeof(pop_metrics_record_t));
+    *new_record = (const pop_metrics_record_t) {
+        .metrics = *metrics,
+        .hwc_metrics = hwc_metrics ? *hwc_metrics : (const hwc_metrics_t) {},
+    };
 }
 
 static void pop_metrics_print(void) {
 
-    for (GSList *node = pop_metrics_records;
+    for (record_node_t *node = pop_metrics_records.first;
             node != NULL;
             node = node->next) {
 
         dlb_pop_metrics_t *record = node->data;
+        const hwc_metrics_t *hwc_metrics = &((pop_metrics_record_t*)node->data)->hwc_metrics;
 
         if (record->elapsed_time > 0) {
 
@@ -158,6 +217,14 @@ static void pop_metrics_print(void) {
                 info("###  - Average useful IPC:                    %1.2f", avg_ipc);
                 info("###  - Average useful frequency:              %1.2f GHz", avg_freq);
                 info("###  - Number of instructions:                %1.2E", record->instructions);
+                if (hwc_metrics->gflops > 0.0f) {
+                    info("###  - GFLOP/s:                               %1.2f",
+                            hwc_metrics->gflops);
+                }
+                if (hwc_metrics->mem_bound > 0.0f) {
+                    info("###  - Memory-bound fraction:                 %1.2f",
+                            hwc_metrics->mem_bound);
+                }
             }
         } else {
             info("############### Monitoring Region POP Metrics ###############");
@@ -169,11 +236,11 @@ static void pop_metrics_print(void) {
 
 static void pop_metrics_to_json(FILE *out_file) {
 
-    if (pop_metrics_records != NULL) {
+    if (pop_metrics_records.first != NULL) {
         fprintf(out_file,
                     "  \"Application\": {\n");
 
-        for (GSList *node = pop_metrics_records;
+        for (record_node_t *node = pop_metrics_records.first;
                 node != NULL;
                 node = node->next) {
 
@@ -254,7 +321,7 @@ static void pop_metrics_to_json(FILE *out_file) {
 
 static void pop_metrics_to_xml(FILE *out_file) {
 
-    for (GSList *node = pop_metrics_records;
+    for (record_node_t *node = pop_metrics_records.first;
             node != NULL;
             node = node->next) {
 
@@ -333,7 +400,7 @@ static void pop_metrics_to_xml(FILE *out_file) {
 
 static void pop_metrics_to_txt(FILE *out_file) {
 
-    for (GSList *node = pop_metrics_records;
+    for (record_node_t *node = pop_metrics_records.first;
             node != NULL;
             node = node->next) {
 
@@ -420,7 +487,7 @@ static void pop_metrics_to_txt(FILE *out_file) {
 
 static void pop_metrics_to_csv(FILE *out_file, bool append) {
 
-    if (pop_metrics_records == NULL) return;
+    if (pop_metrics_records.first == NULL) return;
 
     if (!append) {
         /* Print header */
@@ -460,7 +527,7 @@ static void pop_metrics_to_csv(FILE *out_file, bool append) {
             );
     }
 
-    for (GSList *node = pop_metrics_records;
+    for (record_node_t *node = pop_metrics_records.first;
             node != NULL;
             node = node->next) {
 
@@ -537,18 +604,8 @@ static void pop_metrics_to_csv(FILE *out_file, bool append) {
 
 static void pop_metrics_finalize(void) {
 
-    /* Free every record data */
-    for (GSList *node = pop_metrics_records;
-            node != NULL;
-            node = node->next) {
-
-        dlb_pop_metrics_t *record = node->data;
-        free(record);
-    }
-
-    /* Free list */
-    g_slist_free(pop_metrics_records);
-    pop_metrics_records = NULL;
+    /* Records are deallocated with the records arena */
+    record_list_clear(&pop_metrics_records);
 }
 
 
@@ -556,27 +613,24 @@ static void pop_metrics_finalize(void) {
 /*    Node                                                                       */
 /*********************************************************************************/
 
-static GSList *node_records = NULL;
+static record_list_t node_records = RECORD_LIST_INITIALIZER(node_records);
 
 void talp_output_record_node(const node_record_t *node_record) {
 
     int nelems = node_record->nelems;
 
-    /* Allocate new record */
+    /* Allocate new record in the list */
     size_t process_records_size = sizeof(process_in_node_record_t) * nelems;
     size_t node_record_size = sizeof(node_record_t) + process_records_size;
-    node_record_t *new_record = malloc(node_record_size);
+    node_record_t *new_record = record_list_append(&node_records, node_record_size);
 
     /* Memcpy the entire struct */
     memcpy(new_record, node_record, node_record_size);
-
-    /* Insert to list */
-    node_records = g_slist_prepend(node_records, new_record);
 }
 
 static void node_print(void) {
 
-    for (GSList *node = node_records;
+    for (record_node_t *node = node_records.first;
             node != NULL;
             node = node->next) {
 
@@ -613,17 +667,17 @@ static void node_print(void) {
 
 static void node_to_json(FILE *out_file) {
 
-    if (node_records == NULL) return;
+    if (node_records.first == NULL) return;
 
     /* If there are pop_metrics, append to the existing dictionary */
-    if (pop_metrics_records != NULL) {
+    if (pop_metrics_records.first != NULL) {
         fprintf(out_file,",\n");
     }
 
     fprintf(out_file,
                 "  \"node\": [\n");
 
-    for (GSList *node = node_records;
+    for (record_node_t *node = node_records.first;
             node != NULL;
             node = node->next) {
 
@@ -671,7 +725,7 @@ static void node_to_json(FILE *out_file) {
 
 static void node_to_xml(FILE *out_file) {
 
-    for (GSList *node = node_records;
+    for (record_node_t *node = node_records.first;
             node != NULL;
             node = node->next) {
 
@@ -713,7 +767,7 @@ static void node_to_xml(FILE *out_file) {
 
 static void node_to_csv(FILE *out_file, bool append) {
 
-    if (node_records == NULL) return;
+    if (node_records.first == NULL) return;
 
     if (!append) {
         /* Print header */
@@ -728,7 +782,7 @@ static void node_to_csv(FILE *out_file, bool append) {
                 "NodeMaxMPITime\n");
     }
 
-    for (GSList *node = node_records;
+    for (record_node_t *node = node_records.first;
             node != NULL;
             node = node->next) {
 
@@ -759,7 +813,7 @@ static void node_to_csv(FILE *out_file, bool append) {
 
 static void node_to_txt(FILE *out_file) {
 
-    for (GSList *node = node_records;
+    for (record_node_t *node = node_records.first;
             node != NULL;
             node = node->next) {
 
@@ -801,18 +855,8 @@ static void node_to_txt(FILE *out_file) {
 
 static void node_finalize(void) {
 
-    /* Free every record data */
-    for (GSList *node = node_records;
-            node != NULL;
-            node = node->next) {
-
-        node_record_t *record = node->data;
-        free(record);
-    }
-
-    /* Free list */
-    g_slist_free(node_records);
-    node_records = NULL;
+    /* Records are deallocated with the records arena */
+    record_list_clear(&node_records);
 }
 
 
@@ -826,39 +870,68 @@ typedef struct region_record_t {
     process_record_t process_records[];
 } region_record_t;
 
-static GSList *region_records = NULL;
+static record_list_t region_records = RECORD_LIST_INITIALIZER(region_records);
+
+/* Open addressing index of region_records by name */
+static region_record_t **region_index = NULL;
+static size_t region_index_capacity = 0;    /* power of two */
+static size_t region_index_count = 0;
+
+static region_record_t** region_index_slot(region_record_t **index, size_t capacity,
+        const char *region_name) {
+    size_t mask = capacity - 1;
+    size_t i = hash_fnv1a_64(region_name, DLB_MONITOR_NAME_MAX-1) & mask;
+    while (index[i] != NULL
+            && strncmp(index[i]->name, region_name, DLB_MONITOR_NAME_MAX-1) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &index[i];
+}
+
+static void region_index_grow(void) {
+    enum { REGION_INDEX_INITIAL_CAPACITY = 64 };
+    size_t new_capacity = region_index_capacity > 0
+        ? region_index_capacity * 2 : REGION_INDEX_INITIAL_CAPACITY;
+    region_record_t **new_index = calloc(new_capacity, sizeof(region_record_t*));
+    fatal_cond(!new_index, "Could not allocate TALP record."
+            " Please report at "PACKAGE_BUGREPORT);
+    for (size_t i = 0; i < region_index_capacity; ++i) {
+        if (region_index[i] != NULL) {
+            *region_index_slot(new_index, new_capacity, region_index[i]->name) =
+                region_index[i];
+        }
+    }
+    free(region_index);
+    region_index = new_index;
+    region_index_capacity = new_capacity;
+}
 
 void talp_output_record_process(const char *region_name,
         const process_record_t *process_record, int num_mpi_ranks) {
 
-    region_record_t *region_record = NULL;
+    /* Keep load factor below 1/2 */
+    if (2 * (region_index_count + 1) > region_index_capacity) {
+        region_index_grow();
+    }
 
     /* Find region or allocate new one */
-    for (GSList *node = region_records;
-            node != NULL;
-            node = node->next) {
-
-        region_record_t *record = node->data;
-        if (strcmp(record->name, region_name) == 0) {
-            region_record = record;
-            break;
-        }
-    }
+    region_record_t **slot = region_index_slot(region_index, region_index_capacity,
+            region_name);
+    region_record_t *region_record = *slot;
 
     /* Allocate if not found */
     if (region_record == NULL) {
-        /* Allocate and initialize new region */
+        /* Allocate and initialize new region in the list */
         size_t region_record_size = sizeof(region_record_t) +
             sizeof(process_record_t) * num_mpi_ranks;
-        region_record = malloc(region_record_size);
-        *region_record = (const region_record_t) {
-            .num_mpi_ranks = num_mpi_ranks,
-        };
+        region_record = record_list_append(&region_records, region_record_size);
+        region_record->num_mpi_ranks = num_mpi_ranks;
         snprintf(region_record->name, DLB_MONITOR_NAME_MAX, "%s",
                 region_name);
 
-        /* Insert to list */
-        region_records = g_slist_prepend(region_records, region_record);
+        /* Insert to index */
+        *slot = region_record;
+        ++region_index_count;
     }
 
     /* Copy process_record */
@@ -869,7 +942,7 @@ void talp_output_record_process(const char *region_name,
 
 static void process_print(void) {
 
-    for (GSList *node = region_records;
+    for (record_node_t *node = region_records.first;
             node != NULL;
             node = node->next) {
 
@@ -912,24 +985,32 @@ static void process_print(void) {
                         (float)process_record->monitor.instructions
                         / process_record->monitor.cycles);
             }
+            if (process_record->hwc_metrics.gflops > 0.0f) {
+                info("### GFLOP/s :                                 %.2f",
+                        process_record->hwc_metrics.gflops);
+            }
+            if (process_record->hwc_metrics.mem_bound > 0.0f) {
+                info("### Memory-bound fraction :                   %.2f",
+                        process_record->hwc_metrics.mem_bound);
+            }
         }
     }
 }
 
 static void process_to_json(FILE *out_file) {
 
-    if (region_records == NULL) return;
+    if (region_records.first == NULL) return;
 
     /* If there are pop_metrics or node_metrics, append to the existing dictionary */
-    if (pop_metrics_records != NULL
-            || node_records != NULL) {
+    if (pop_metrics_records.first != NULL
+            || node_records.first != NULL) {
         fprintf(out_file,",\n");
     }
 
     fprintf(out_file,
                 "  \"Process\": {\n");
 
-    for (GSList *node = region_records;
+    for (record_node_t *node = region_records.first;
             node != NULL;
             node = node->next) {
 
@@ -998,7 +1079,7 @@ static void process_to_json(FILE *out_file) {
 
 static void process_to_xml(FILE *out_file) {
 
-    for (GSList *node = region_records;
+    for (record_node_t *node = region_records.first;
             node != NULL;
             node = node->next) {
 
@@ -1064,7 +1145,7 @@ static void process_to_xml(FILE *out_file) {
 
 static void process_to_csv(FILE *out_file, bool append) {
 
-    if (region_records == NULL) return;
+    if (region_records.first == NULL) return;
 
     if (!append) {
         /* Print header */
@@ -1092,7 +1173,7 @@ static void process_to_csv(FILE *out_file, bool append) {
                 "OMPSerializationTime\n");
     }
 
-    for (GSList *node = region_records;
+    for (record_node_t *node = region_records.first;
             node != NULL;
             node = node->next) {
 
@@ -1151,7 +1232,7 @@ static void process_to_csv(FILE *out_file, bool append) {
 
 static void process_to_txt(FILE *out_file) {
 
-    for (GSList *node = region_records;
+    for (record_node_t *node = region_records.first;
             node != NULL;
             node = node->next) {
 
@@ -1196,18 +1277,14 @@ static void process_to_txt(FILE *out_file) {
 
 static void process_finalize(void) {
 
-    /* Free every record data */
-    for (GSList *node = region_records;
-            node != NULL;
-            node = node->next) {
+    /* Records are deallocated with the records arena */
+    record_list_clear(&region_records);
 
-        region_record_t *record = node->data;
-        free(record);
-    }
-
-    /* Free list */
-    g_slist_free(region_records);
-    region_records = NULL;
+    /* Free index */
+    free(region_index);
+    region_index = NULL;
+    region_index_capacity = 0;
+    region_index_count = 0;
 }
 
 
@@ -1375,7 +1452,7 @@ static void sanitize_records(void) {
      *  - instructions and cycles need to be >= 0
      *  - computed efficiencyes need to be [0.0, 1.0]
      */
-    for (GSList *node = pop_metrics_records;
+    for (record_node_t *node = pop_metrics_records.first;
             node != NULL;
             node = node->next) {
 
@@ -1408,7 +1485,7 @@ static void sanitize_records(void) {
     /* node_records: nothing to sanitize for now */
 
     /* region_records: */
-    for (GSList *node = region_records;
+    for (record_node_t *node = region_records.first;
             node != NULL;
             node = node->next) {
 
@@ -1433,12 +1510,6 @@ static void sanitize_records(void) {
 
 void talp_output_finalize(const char *output_file) {
 
-    /* For efficiency, all records are prepended to their respective lists and
-     * reversed here */
-    pop_metrics_records = g_slist_reverse(pop_metrics_records);
-    node_records        = g_slist_reverse(node_records);
-    region_records      = g_slist_reverse(region_records);
-
     /* Sanitize erroneous values */
     sanitize_records();
 
@@ -1459,9 +1530,9 @@ void talp_output_finalize(const char *output_file) {
         process_print();
     } else {
         /* Do not open file if process has no data */
-        if (pop_metrics_records == NULL
-                && node_records == NULL
-                && region_records == NULL) return;
+        if (pop_metrics_records.first == NULL
+                && node_records.first == NULL
+                && region_records.first == NULL) return;
 
         /* Check file extension */
         typedef enum Extension {
@@ -1490,15 +1561,15 @@ void talp_output_finalize(const char *output_file) {
 
         /* Specific case where output file needs to be split */
         if (extension == EXT_CSV
-                && !!(pop_metrics_records != NULL)
-                    + !!(node_records != NULL)
-                    + !!(region_records != NULL) > 1) {
+                && !!(pop_metrics_records.first != NULL)
+                    + !!(node_records.first != NULL)
+                    + !!(region_records.first != NULL) > 1) {
 
             /* Length without extension */
             int filename_useful_len = ext - output_file;
 
             /* POP */
-            if (pop_metrics_records != NULL) {
+            if (pop_metrics_records.first != NULL) {
                 const char *pop_ext = "-pop.csv";
                 size_t pop_file_len = filename_useful_len + strlen(pop_ext) + 1;
                 char *pop_filename = malloc(sizeof(char)*pop_file_len);
@@ -1521,7 +1592,7 @@ void talp_output_finalize(const char *output_file) {
             }
 
             /* Node */
-            if (node_records != NULL) {
+            if (node_records.first != NULL) {
                 const char *node_ext = "-node.csv";
                 size_t node_file_len = filename_useful_len + strlen(node_ext) + 1;
                 char *node_filename = malloc(sizeof(char)*node_file_len);
@@ -1544,7 +1615,7 @@ void talp_output_finalize(const char *output_file) {
             }
 
             /* Process */
-            if (region_records != NULL) {
+            if (region_records.first != NULL) {
                 const char *process_ext = "-process.csv";
                 size_t process_file_len = filename_useful_len + strlen(process_ext) + 1;
                 char *process_filename = malloc(sizeof(char)*process_file_len);
@@ -1631,4 +1702,5 @@ void talp_output_finalize(const char *output_file) {
     pop_metrics_finalize();
     node_finalize();
     process_finalize();
+    arena_free_all(&records_arena);
 }
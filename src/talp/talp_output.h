@@ -43,6 +43,22 @@ typedef struct node_record_t {
     process_in_node_record_t processes[];
 } node_record_t;
 
+/* Metrics derived from the events selected with --talp-counters.
+ * Zero values mean that the required events were not collected. */
+typedef struct hwc_metrics_t {
+    float gflops;           /* floating point operations per elapsed second, in G */
+    float mem_bound;        /* fraction of useful cycles stalled on memory */
+} hwc_metrics_t;
+
+static inline void hwc_metrics_compute(hwc_metrics_t *hwc_metrics, double flops,
+        double mem_stalls, double cycles, int64_t elapsed_time) {
+    /* Operations per nanosecond are GFLOP/s */
+    *hwc_metrics = (const hwc_metrics_t) {
+        .gflops = elapsed_time > 0 ? flops / elapsed_time : 0.0f,
+        .mem_bound = cycles > 0 ? mem_stalls / cycles : 0.0f,
+    };
+}
+
 enum { TALP_OUTPUT_CPUSET_MAX = 128 };
 typedef struct process_record_t {
     int rank;
@@ -52,12 +68,15 @@ typedef struct process_record_t {
     char cpuset[TALP_OUTPUT_CPUSET_MAX];
     char cpuset_quoted[TALP_OUTPUT_CPUSET_MAX];
     dlb_monitor_t monitor;
+    hwc_metrics_t hwc_metrics;
 } process_record_t;
 
 void talp_output_print_monitoring_region(const dlb_monitor_t *monitor,
-        const char *cpuset_str, bool have_mpi, bool have_openmp, bool have_papi);
+        const char *cpuset_str, bool have_mpi, bool have_openmp, bool have_papi,
+        const hwc_metrics_t *hwc_metrics);
 
-void talp_output_record_pop_metrics(const dlb_pop_metrics_t *metrics);
+void talp_output_record_pop_metrics(const dlb_pop_metrics_t *metrics,
+        const hwc_metrics_t *hwc_metrics);
 
 void talp_output_record_resources(int num_cpus, int num_nodes, int num_mpi_ranks);
 
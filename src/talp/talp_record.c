@@ -55,6 +55,8 @@ void talp_record_monitor(const subprocess_descriptor_t *spd,
             .monitor = *monitor,
         };
 
+        region_get_hwc_metrics(spd, monitor, &process_record.hwc_metrics);
+
         /* Fill hostname and CPU mask strings in process_record */
         gethostname(process_record.hostname, HOST_NAME_MAX);
         snprintf(process_record.cpuset, TALP_OUTPUT_CPUSET_MAX, "%s",
@@ -71,33 +73,14 @@ void talp_record_monitor(const subprocess_descriptor_t *spd,
             verbose(VB_TALP, "TALP summary: recording region %s", monitor->name);
 
             talp_info_t *talp_info = spd->talp_info;
-            const pop_base_metrics_t base_metrics = {
-                .num_cpus                = monitor->num_cpus,
-                .num_mpi_ranks           = 0,
-                .num_nodes               = 1,
-                .avg_cpus                = monitor->avg_cpus,
-                .cycles                  = (double)monitor->cycles,
-                .instructions            = (double)monitor->instructions,
-                .num_measurements        = monitor->num_measurements,
-                .num_mpi_calls           = monitor->num_mpi_calls,
-                .num_omp_parallels       = monitor->num_omp_parallels,
-                .num_omp_tasks           = monitor->num_omp_tasks,
-                .elapsed_time            = monitor->elapsed_time,
-                .useful_time             = monitor->useful_time,
-                .mpi_time                = monitor->mpi_time,
-                .omp_load_imbalance_time = monitor->omp_load_imbalance_time,
-                .omp_scheduling_time     = monitor->omp_scheduling_time,
-                .omp_serialization_time  = monitor->omp_serialization_time,
-                .useful_normd_app        = (double)monitor->useful_time / monitor->num_cpus,
-                .mpi_normd_app           = (double)monitor->mpi_time / monitor->num_cpus,
-                .max_useful_normd_proc   = (double)monitor->useful_time / monitor->num_cpus,
-                .max_useful_normd_node   = (double)monitor->useful_time / monitor->num_cpus,
-                .mpi_normd_of_max_useful = (double)monitor->mpi_time / monitor->num_cpus,
-            };
+            pop_base_metrics_t base_metrics;
+            perf_metrics__local_monitor_into_base_metrics(&base_metrics, monitor);
 
             dlb_pop_metrics_t pop_metrics;
             perf_metrics__base_to_pop_metrics(monitor->name, &base_metrics, &pop_metrics);
-            talp_output_record_pop_metrics(&pop_metrics);
+            hwc_metrics_t hwc_metrics;
+            perf_metrics__base_to_hwc_metrics(&base_metrics, &hwc_metrics);
+            talp_output_record_pop_metrics(&pop_metrics, &hwc_metrics);
 
             if(monitor == talp_info->monitor) {
                 talp_output_record_resources(monitor->num_cpus,
@@ -108,7 +91,7 @@ void talp_record_monitor(const subprocess_descriptor_t *spd,
             verbose(VB_TALP, "TALP summary: recording empty region %s", monitor->name);
             dlb_pop_metrics_t pop_metrics = {0};
             snprintf(pop_metrics.name, DLB_MONITOR_NAME_MAX, "%s", monitor->name);
-            talp_output_record_pop_metrics(&pop_metrics);
+            talp_output_record_pop_metrics(&pop_metrics, NULL);
         }
     }
 }
@@ -269,6 +252,8 @@ void talp_record_process_summary(const subprocess_descriptor_t *spd,
         .monitor = *monitor,
     };
 
+    region_get_hwc_metrics(spd, monitor, &process_record_send.hwc_metrics);
+
     /* Invalidate pointers of the copied monitor */
     process_record_send.monitor.name = NULL;
     process_record_send.monitor._data = NULL;
@@ -338,9 +323,9 @@ void talp_record_process_summary(const subprocess_descriptor_t *spd,
     /* MPI struct type: process_record_t */
     MPI_Datatype mpi_process_record_type;
     {
-        int count = 7;
+        int count = 8;
         int blocklengths[] = {1, 1, 1, HOST_NAME_MAX,
-            TALP_OUTPUT_CPUSET_MAX, TALP_OUTPUT_CPUSET_MAX, 1};
+            TALP_OUTPUT_CPUSET_MAX, TALP_OUTPUT_CPUSET_MAX, 1, 2};
         MPI_Aint displacements[] = {
             offsetof(process_record_t, rank),
             offsetof(process_record_t, pid),
@@ -348,9 +333,10 @@ void talp_record_process_summary(const subprocess_descriptor_t *spd,
             offsetof(process_record_t, hostname),
             offsetof(process_record_t, cpuset),
             offsetof(process_record_t, cpuset_quoted),
-            offsetof(process_record_t, monitor)};
+            offsetof(process_record_t, monitor),
+            offsetof(process_record_t, hwc_metrics)};
         MPI_Datatype types[] = {MPI_INT, mpi_pid_type, MPI_INT, MPI_CHAR, MPI_CHAR,
-            MPI_CHAR, mpi_dlb_monitor_type};
+            MPI_CHAR, mpi_dlb_monitor_type, MPI_FLOAT};
         MPI_Datatype tmp_type;
         PMPI_Type_create_struct(count, blocklengths, displacements, types, &tmp_type);
         PMPI_Type_create_resized(tmp_type, 0, sizeof(process_record_t),
@@ -413,17 +399,19 @@ void talp_record_pop_summary(const subprocess_descriptor_t *spd,
             /* Construct pop_metrics out of base metrics */
             dlb_pop_metrics_t pop_metrics;
             perf_metrics__base_to_pop_metrics(monitor->name, &base_metrics, &pop_metrics);
+            hwc_metrics_t hwc_metrics;
+            perf_metrics__base_to_hwc_metrics(&base_metrics, &hwc_metrics);
 
             /* Record */
             verbose(VB_TALP, "TALP summary: recording region %s", monitor->name);
-            talp_output_record_pop_metrics(&pop_metrics);
+            talp_output_record_pop_metrics(&pop_metrics, &hwc_metrics);
 
         } else {
             /* Record empty */
             verbose(VB_TALP, "TALP summary: recording empty region %s", monitor->name);
             dlb_pop_metrics_t pop_metrics = {0};
             snprintf(pop_metrics.name, DLB_MONITOR_NAME_MAX, "%s", monitor->name);
-            talp_output_record_pop_metrics(&pop_metrics);
+            talp_output_record_pop_metrics(&pop_metrics, NULL);
         }
     }
 }
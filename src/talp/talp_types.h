@@ -21,12 +21,18 @@
 #define TALP_TYPES_H
 
 #include "apis/dlb_types.h"
+#include "support/arena.h"
 #include "support/atomic.h"
-#include "support/gtree.h"
 #include "support/gslist.h"
+#include "support/perf_event.h"
+#include "support/strmap.h"
 
 #include <pthread.h>
 
+/* Maximum number of hardware counters collected with --talp-counters */
+enum { TALP_MAX_COUNTERS = 8 };
+enum { TALP_COUNTER_NAME_MAX = 64 };
+
 /* The structs below are only for private DLB_talp.c use, but they are defined
  * in this header for testing purposes. */
 
@@ -47,12 +53,6 @@ typedef struct DLB_ALIGN_CACHE talp_sample_t {
         atomic_int_least64_t not_useful_omp_in;
         atomic_int_least64_t not_useful_omp_out;
     } timers;
-#if PAPI_LIB
-    struct {
-        atomic_int_least64_t cycles;
-        atomic_int_least64_t instructions;
-    } counters;
-#endif
     struct {
         atomic_int_least64_t num_mpi_calls;
         atomic_int_least64_t num_omp_parallels;
@@ -66,6 +66,8 @@ typedef struct DLB_ALIGN_CACHE talp_sample_t {
         not_useful_omp_in,
         not_useful_omp_out,
     } state;
+    /* One value per event in talp_info->counters, allocated with the sample */
+    atomic_int_least64_t counters[];
 } talp_sample_t;
 
 /* The macrosample is a temporary aggregation of all metrics in samples of all,
@@ -80,12 +82,7 @@ typedef struct talp_macrosample_t {
         int64_t not_useful_omp_in_sched;
         int64_t not_useful_omp_out;
     } timers;
-#ifdef PAPI_LIB
-    struct {
-        int64_t cycles;
-        int64_t instructions;
-    } counters;
-#endif
+    int64_t counters[TALP_MAX_COUNTERS];
     struct {
         int64_t num_mpi_calls;
         int64_t num_omp_parallels;
@@ -100,13 +97,29 @@ typedef struct talp_info_t {
         bool have_minimal_shmem:1;  /* whether to create a shmem for the global region */
         bool external_profiler:1;   /* whether to update shmem on every sample */
         bool papi:1;                /* whether to collect PAPI counters */
+        bool perf:1;                /* whether to collect perf_event counters */
+        bool counters:1;            /* whether to collect counters with any of the above */
         bool have_mpi:1;            /* whether TALP regions have MPI events */
         bool have_openmp:1;         /* whether TALP regions have OpenMP events */
     } flags;
+    struct {
+        int     num;                /* Number of events in the PAPI event set */
+        int     codes[TALP_MAX_COUNTERS];                   /* PAPI */
+        perf_event_desc_t perf_events[TALP_MAX_COUNTERS];   /* perf_event */
+        char    names[TALP_MAX_COUNTERS][TALP_COUNTER_NAME_MAX];
+        int64_t threshold;          /* Minimum not useful interval (ns) to read counters */
+        /* Index of the events with a special meaning, or -1 if not collected */
+        int     cycles;
+        int     instructions;
+        int     flops;
+        int     mem_stalls;
+    } counters;
     int             ncpus;          /* Number of process CPUs (also num samples) */
     dlb_monitor_t   *monitor;       /* Convenience pointer to the global region */
-    GTree           *regions;       /* Tree of monitoring regions */
-    GSList          *open_regions;  /* List of open regions */
+    strmap_t        regions;        /* Map of monitoring regions by name */
+    dlb_monitor_t   *open_regions;  /* List of open regions, innermost first */
+    arena_t         regions_arena;  /* Storage of all monitoring regions */
+    int             regions_generation; /* Unique id of this set of regions */
     pthread_mutex_t regions_mutex;  /* Mutex to protect regions allocation/iteration */
     talp_sample_t   **samples;      /* Per-thread ongoing sample,
                                        added to all monitors when finished */
@@ -121,7 +134,11 @@ typedef struct monitor_data_t {
         bool started:1;
         bool internal:1;                    /* internal regions are not reported */
         bool enabled:1;
+        bool iteration:1;                   /* starts delimit --lewi-shrink iterations */
     } flags;
+    int64_t         counters[TALP_MAX_COUNTERS];    /* same order as talp_info->counters */
+    dlb_monitor_t   *open_prev;             /* links in talp_info->open_regions */
+    dlb_monitor_t   *open_next;
 } monitor_data_t;
 
 
@@ -0,0 +1,260 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*! \page dlb_exporter Export DLB node metrics.
+ *  \section synopsis SYNOPSIS
+ *      <B>dlb_exporter</B> [-i SECS] [-n SAMPLES] [-k KEY] [-o FILE | -p PORT]
+ *  \section description DESCRIPTION
+ *      Utility command that attaches to the DLB shared memory of the node and
+ *      exports its state in the OpenMetrics text format: LeWI lend and borrow
+ *      counters, CPU state residency, and POP metrics of each TALP region.
+ *
+ *      The shared memory is sampled periodically and counters are accumulated
+ *      incrementally between samples, so they remain monotonic even if the
+ *      shared memory is recreated. TALP times are tracked per process, so a
+ *      process leaving the node does not decrease the region counters. CPU
+ *      state residency is estimated by
+ *      attributing each sampling interval to the state observed at the end of
+ *      it. TALP regions are only available if the DLB processes are run with
+ *      the option --talp-external-profiler.
+ *
+ *      By default, metrics are printed to the standard output after every
+ *      sample.
+ *
+ *      <DL>
+ *          <DT>-i, --interval=SECS</DT>
+ *          <DD>Sampling interval in seconds, decimals allowed (default: 1).</DD>
+ *
+ *          <DT>-n, --samples=N</DT>
+ *          <DD>Number of samples before exiting (default: unlimited).</DD>
+ *
+ *          <DT>-k, --shm-key=KEY</DT>
+ *          <DD>Shared memory key to attach to.</DD>
+ *
+ *          <DT>-o, --output=FILE</DT>
+ *          <DD>Atomically rewrite FILE after every sample, suitable for
+ *          textfile collectors.</DD>
+ *
+ *          <DT>-p, --port=PORT</DT>
+ *          <DD>Serve metrics over HTTP on the loopback interface.</DD>
+ *
+ *          <DT>-h, --help</DT>
+ *          <DD>Print usage.</DD>
+ *      </DL>
+ *  \section author AUTHOR
+ *      Barcelona Supercomputing Center (dlb@bsc.es)
+ *  \section seealso SEE ALSO
+ *      \ref dlb "dlb"(1), \ref dlb_shm "dlb_shm"(1), \ref dlb_top "dlb_top"(1)
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "apis/dlb.h"
+#include "apis/dlb_talp.h"
+#include "talp/talp_exporter.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void __attribute__((__noreturn__)) version(void) {
+    fprintf(stdout, "%s\n", DLB_VERSION_STRING);
+    fprintf(stdout, "Configured with: %s\n", DLB_CONFIGURE_ARGS);
+    exit(EXIT_SUCCESS);
+}
+
+static void __attribute__((__noreturn__)) usage(const char *program, FILE *out) {
+    fprintf(out, "DLB - Dynamic Load Balancing, version %s.\n", VERSION);
+    fprintf(out, (
+                "usage:\n"
+                "\t%1$s [-i SECS] [-n SAMPLES] [-k KEY] [-o FILE | -p PORT]\n"
+                "\n"
+                ), program);
+
+    fputs("Export DLB node metrics in the OpenMetrics text format.\n\n", out);
+
+    fputs((
+                "Options:\n"
+                "  -i, --interval=SECS      sampling interval (default: 1)\n"
+                "  -n, --samples=N          exit after N samples\n"
+                "  -k, --shm-key=KEY        shared memory key to attach to\n"
+                "  -o, --output=FILE        rewrite FILE after every sample\n"
+                "  -p, --port=PORT          serve metrics over HTTP on localhost:PORT\n"
+                "  -h, --help               print this help\n"
+                ), out);
+
+    exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static void signal_handler(int signum) {
+    keep_running = 0;
+}
+
+static void set_shm_key(const char *shm_key) {
+    /* Modify DLB_ARGS */
+    const char *dlb_args_env = getenv("DLB_ARGS");
+    size_t dlb_args_env_len = dlb_args_env ? strlen(dlb_args_env) + 1 : 0;
+    const char * const new_dlb_args_base = "--shm-key=";
+    char *dlb_args = malloc(dlb_args_env_len + strlen(new_dlb_args_base)
+            + strlen(shm_key) + 1);
+    sprintf(dlb_args, "%s %s%s", dlb_args_env ? dlb_args_env : "",
+            new_dlb_args_base, shm_key);
+    setenv("DLB_ARGS", dlb_args, 1);
+    free(dlb_args);
+}
+
+static int64_t get_monotonic_time_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    double interval = 1.0;
+    long samples = -1;
+    const char *output_filename = NULL;
+    int port = 0;
+
+    int opt;
+    struct option long_options[] = {
+        {"interval",    required_argument, NULL, 'i'},
+        {"samples",     required_argument, NULL, 'n'},
+        {"shm-key",     required_argument, NULL, 'k'},
+        {"output",      required_argument, NULL, 'o'},
+        {"port",        required_argument, NULL, 'p'},
+        {"help",        no_argument,       NULL, 'h'},
+        {"version",     no_argument,       NULL, 'v'},
+        {0,             0,                 NULL, 0 }
+    };
+
+    while ( (opt = getopt_long(argc, argv, "i:n:k:o:p:hv", long_options, NULL)) != -1 ) {
+        switch (opt) {
+            case 'i':
+                interval = strtod(optarg, NULL);
+                if (interval <= 0.0) {
+                    fprintf(stderr, "Invalid interval: %s\n", optarg);
+                    usage(argv[0], stderr);
+                }
+                break;
+            case 'n':
+                samples = strtol(optarg, NULL, 0);
+                if (samples <= 0) {
+                    fprintf(stderr, "Invalid number of samples: %s\n", optarg);
+                    usage(argv[0], stderr);
+                }
+                break;
+            case 'k':
+                set_shm_key(optarg);
+                break;
+            case 'o':
+                output_filename = optarg;
+                break;
+            case 'p':
+                port = strtol(optarg, NULL, 0);
+                if (port <= 0 || port > 65535) {
+                    fprintf(stderr, "Invalid port: %s\n", optarg);
+                    usage(argv[0], stderr);
+                }
+                break;
+            case 'h':
+                usage(argv[0], stdout);
+                break;
+            case 'v':
+                version();
+                break;
+            default:
+                usage(argv[0], stderr);
+                break;
+        }
+    }
+
+    if (output_filename != NULL && port > 0) {
+        fprintf(stderr, "Options --output and --port are mutually exclusive\n");
+        usage(argv[0], stderr);
+    }
+
+    struct sigaction sa = { .sa_handler = signal_handler };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (DLB_TALP_Attach() != DLB_SUCCESS) {
+        fprintf(stderr, "DLB ERROR: can't attach to DLB\n");
+        return EXIT_FAILURE;
+    }
+
+    int listen_fd = -1;
+    if (port > 0) {
+        listen_fd = talp_exporter_open_socket(port);
+        if (listen_fd == -1) {
+            DLB_TALP_Detach();
+            return EXIT_FAILURE;
+        }
+    }
+    int interval_ms = (int)(interval * 1000);
+
+    talp_exporter_t exporter;
+    talp_exporter_init(&exporter);
+
+    int error = DLB_SUCCESS;
+    for (long i = 0; keep_running && (samples < 0 || i < samples); ++i) {
+        talp_exporter_sample(&exporter);
+
+        if (output_filename != NULL) {
+            error = talp_exporter_write_file(output_filename, &exporter);
+            if (error != DLB_SUCCESS) break;
+        } else if (listen_fd == -1) {
+            talp_exporter_write_metrics(stdout, &exporter);
+            fflush(stdout);
+        }
+
+        if (samples > 0 && i == samples-1) break;
+
+        /* Wait until the next sample, serving any incoming request */
+        int64_t deadline = get_monotonic_time_ns() + interval_ms * 1000000LL;
+        int timeout_ms;
+        while (keep_running
+                && (timeout_ms = (deadline - get_monotonic_time_ns()) / 1000000) > 0) {
+            struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+            int ret = poll(&pfd, listen_fd != -1 ? 1 : 0, timeout_ms);
+            if (ret > 0 && pfd.revents & POLLIN) {
+                talp_exporter_serve_request(listen_fd, &exporter);
+            }
+        }
+    }
+
+    if (listen_fd != -1) {
+        close(listen_fd);
+    }
+    talp_exporter_finalize(&exporter);
+    DLB_TALP_Detach();
+
+    return error == DLB_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
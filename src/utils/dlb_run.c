@@ -19,7 +19,7 @@
 
 /*! \page dlb_run Execute application with DLB pre-initialized.
  *  \section synopsis SYNOPSIS
- *      <B>dlb_run</B> [--verbose] <B>\<application\></B>
+ *      <B>dlb_run</B> [--verbose] [--cgroup=PATH] <B>\<application\></B>
  *  \section description DESCRIPTION
  *      Execute \underline{application} in a pre-initialized DLB environment.
  *
@@ -33,6 +33,12 @@
  *          <DT>--verbose</DT>
  *          <DD>Enable verbose mode. Print the command to be executed and
  *          its return code upon finalization.</DD>
+ *
+ *          <DT>--cgroup=PATH</DT>
+ *          <DD>Run the application in its own child cgroup of PATH, a cgroup
+ *          v2 directory with the cpuset controller available. DROM mask
+ *          changes of the application are then enforced through
+ *          cpuset.cpus, even if the application never polls DLB.</DD>
  *      </DL>
  *  \section author AUTHOR
  *      Barcelona Supercomputing Center (dlb@bsc.es)
@@ -46,6 +52,7 @@
 #endif
 
 #include "apis/dlb.h"
+#include "support/cgroup.h"
 
 #include <sched.h>
 #include <unistd.h>
@@ -60,6 +67,7 @@
 #include <stdarg.h>
 
 static bool verbose = false;
+static const char *cgroup_parent_path = NULL;
 
 static void dlb_run_info_(FILE *out, const char *fmt, va_list list) {
     fprintf(out, "[dlb_run]: ");
@@ -101,6 +109,7 @@ static void __attribute__((__noreturn__)) usage(const char *program, FILE *out)
                 "Options:\n"
                 "  -h, --help               print this help\n"
                 "      --verbose            enable verbose mode\n"
+                "      --cgroup=PATH        run application in a child cpuset cgroup of PATH\n"
                 ), out);
 
     exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
@@ -161,6 +170,13 @@ static void __attribute__((__noreturn__)) execute(char **argv) {
     /* PreInit from current process */
     cpu_set_t mask;
     sched_getaffinity(0, sizeof(cpu_set_t), &mask);
+
+    /* Move to a new cpuset cgroup before forking, the child will inherit it */
+    if (cgroup_parent_path != NULL) {
+        int error = cgroup_cpuset_create(cgroup_parent_path, &mask);
+        dlb_check(error, "cgroup_cpuset_create");
+    }
+
     int error = DLB_PreInit(&mask, NULL);
     dlb_check(error, __FUNCTION__);
 
@@ -202,7 +218,8 @@ int main(int argc, char *argv[]) {
 
     /* Long options that have no corresponding short option */
     enum {
-        VERBOSE_OPTION = CHAR_MAX + 1
+        VERBOSE_OPTION = CHAR_MAX + 1,
+        CGROUP_OPTION
     };
 
     int opt;
@@ -212,6 +229,7 @@ int main(int argc, char *argv[]) {
         {"help",     no_argument,       NULL, 'h'},
         {"version",  no_argument,       NULL, 'v'},
         {"verbose",  no_argument,       NULL, VERBOSE_OPTION},
+        {"cgroup",   required_argument, NULL, CGROUP_OPTION},
         {0,          0,                 NULL, 0 }
     };
 
@@ -226,6 +244,9 @@ int main(int argc, char *argv[]) {
             case VERBOSE_OPTION:
                 verbose = true;
                 break;
+            case CGROUP_OPTION:
+                cgroup_parent_path = optarg;
+                break;
             default:
                 usage(argv[0], stderr);
                 break;
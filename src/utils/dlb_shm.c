@@ -45,6 +45,7 @@
 #endif
 
 #include "apis/dlb.h"
+#include "support/mask_utils.h"
 
 #include <unistd.h>
 #include <stdlib.h>
@@ -266,6 +267,12 @@ void delete_shdata( void ) {
     }
 
     closedir(dp);
+
+    // The node topology cache may be stored in another directory
+    int num_cache_files = mu_delete_topology_cache();
+    if ( num_cache_files > 0 ) {
+        fprintf( stdout, "Deleted %d topology cache file(s)\n", num_cache_files );
+    }
 }
 
 int main(int argc, char *argv[]) {
@@ -0,0 +1,266 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*! \page dlb_top Monitor DLB shared memory.
+ *  \section synopsis SYNOPSIS
+ *      <B>dlb_top</B> [-d SECS] [-n ITERATIONS] [-k KEY]
+ *  \section description DESCRIPTION
+ *      Utility command to periodically display the DLB shared memory of the
+ *      node: CPU owners, guests and states, per-process masks and CPU
+ *      counts, LeWI lend and borrow rates, barriers and TALP regions.
+ *
+ *      The shared memory tables are only opened for reading and copied without
+ *      locking them, so they can be polled at high rates without disturbing
+ *      the running processes.
+ *      LeWI rates are computed between two consecutive updates.
+ *
+ *      <DL>
+ *          <DT>-d, --delay=SECS</DT>
+ *          <DD>Delay between updates in seconds, decimals allowed (default: 1).</DD>
+ *
+ *          <DT>-n, --iterations=N</DT>
+ *          <DD>Number of updates before exiting (default: unlimited).</DD>
+ *
+ *          <DT>-k, --shm-key=KEY</DT>
+ *          <DD>Shared memory key to monitor.</DD>
+ *
+ *          <DT>-l, --columns=N</DT>
+ *          <DD>Number of columns for the CPU table.</DD>
+ *
+ *          <DT>--color[=no]</DT>
+ *          <DD>Override automatic color detection.</DD>
+ *
+ *          <DT>-h, --help</DT>
+ *          <DD>Print usage.</DD>
+ *      </DL>
+ *  \section author AUTHOR
+ *      Barcelona Supercomputing Center (dlb@bsc.es)
+ *  \section seealso SEE ALSO
+ *      \ref dlb "dlb"(1), \ref dlb_run "dlb_run"(1),
+ *      \ref dlb_shm "dlb_shm"(1), \ref dlb_taskset "dlb_taskset"(1)
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "apis/dlb.h"
+#include "apis/dlb_talp.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void __attribute__((__noreturn__)) version(void) {
+    fprintf(stdout, "%s\n", DLB_VERSION_STRING);
+    fprintf(stdout, "Configured with: %s\n", DLB_CONFIGURE_ARGS);
+    exit(EXIT_SUCCESS);
+}
+
+static void __attribute__((__noreturn__)) usage(const char *program, FILE *out) {
+    fprintf(out, "DLB - Dynamic Load Balancing, version %s.\n", VERSION);
+    fprintf(out, (
+                "usage:\n"
+                "\t%1$s [-d SECS] [-n ITERATIONS] [-k KEY]\n"
+                "\n"
+                ), program);
+
+    fputs("Monitor DLB shared memory.\n\n", out);
+
+    fputs((
+                "Options:\n"
+                "  -d, --delay=SECS         delay between updates (default: 1)\n"
+                "  -n, --iterations=N       exit after N updates\n"
+                "  -k, --shm-key=KEY        shared memory key to monitor\n"
+                "  -l, --columns=N          override num columns of the CPU table\n"
+                "  --color[=no]             override automatic color detection\n"
+                "  -h, --help               print this help\n"
+                ), out);
+
+    exit(out == stderr ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+static void signal_handler(int signum) {
+    keep_running = 0;
+}
+
+static void set_shm_key(const char *shm_key) {
+    /* Modify DLB_ARGS */
+    const char *dlb_args_env = getenv("DLB_ARGS");
+    size_t dlb_args_env_len = dlb_args_env ? strlen(dlb_args_env) + 1 : 0;
+    const char * const new_dlb_args_base = "--shm-key=";
+    char *dlb_args = malloc(dlb_args_env_len + strlen(new_dlb_args_base)
+            + strlen(shm_key) + 1);
+    sprintf(dlb_args, "%s %s%s", dlb_args_env ? dlb_args_env : "",
+            new_dlb_args_base, shm_key);
+    setenv("DLB_ARGS", dlb_args, 1);
+    free(dlb_args);
+}
+
+static void sleep_seconds(double seconds) {
+    struct timespec req = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9),
+    };
+    while (nanosleep(&req, &req) == -1 && errno == EINTR && keep_running);
+}
+
+static int64_t get_monotonic_time_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* The rates are computed from the counters of the previous update. If the
+ * counters went backwards, the shared memory was recreated in between. */
+static void print_lewi_rates(void) {
+    static int64_t last_time = 0;
+    static int64_t last_num_lends = 0;
+    static int64_t last_num_borrows = 0;
+
+    int64_t num_lends, num_borrows;
+    if (DLB_TALP_GetLeWICounters(&num_lends, &num_borrows) != DLB_SUCCESS) return;
+    int64_t now = get_monotonic_time_ns();
+
+    if (last_time > 0 && now > last_time
+            && num_lends >= last_num_lends
+            && num_borrows >= last_num_borrows) {
+        double elapsed = (double)(now - last_time) / 1e9;
+        fprintf(stdout, "LeWI rates: %.1f lends/s, %.1f borrows/s"
+                " (total: %"PRId64", %"PRId64")\n",
+                (num_lends - last_num_lends) / elapsed,
+                (num_borrows - last_num_borrows) / elapsed,
+                num_lends, num_borrows);
+    } else {
+        fprintf(stdout, "LeWI totals: %"PRId64" lends, %"PRId64" borrows\n",
+                num_lends, num_borrows);
+    }
+
+    last_time = now;
+    last_num_lends = num_lends;
+    last_num_borrows = num_borrows;
+}
+
+int main(int argc, char *argv[]) {
+    double delay = 1.0;
+    long iterations = -1;
+    int list_columns = 0;
+    dlb_printshmem_flags_t print_flags = DLB_COLOR_AUTO;
+
+    /* Long options that have no corresponding short option */
+    enum {
+        COLOR_OPTION = CHAR_MAX + 1
+    };
+
+    int opt;
+    struct option long_options[] = {
+        {"delay",       required_argument, NULL, 'd'},
+        {"iterations",  required_argument, NULL, 'n'},
+        {"shm-key",     required_argument, NULL, 'k'},
+        {"columns",     required_argument, NULL, 'l'},
+        {"color",       optional_argument, NULL, COLOR_OPTION},
+        {"help",        no_argument,       NULL, 'h'},
+        {"version",     no_argument,       NULL, 'v'},
+        {0,             0,                 NULL, 0 }
+    };
+
+    while ( (opt = getopt_long(argc, argv, "d:n:k:l:hv", long_options, NULL)) != -1 ) {
+        switch (opt) {
+            case 'd':
+                delay = strtod(optarg, NULL);
+                if (delay <= 0.0) {
+                    fprintf(stderr, "Invalid delay: %s\n", optarg);
+                    usage(argv[0], stderr);
+                }
+                break;
+            case 'n':
+                iterations = strtol(optarg, NULL, 0);
+                if (iterations <= 0) {
+                    fprintf(stderr, "Invalid number of iterations: %s\n", optarg);
+                    usage(argv[0], stderr);
+                }
+                break;
+            case 'k':
+                set_shm_key(optarg);
+                break;
+            case 'l':
+                list_columns = strtol(optarg, NULL, 0);
+                break;
+            case COLOR_OPTION:
+                if (optarg && strcasecmp (optarg, "no") == 0) {
+                    print_flags &= ~DLB_COLOR_AUTO;
+                    print_flags &= ~DLB_COLOR_ALWAYS;
+                } else {
+                    print_flags |= DLB_COLOR_ALWAYS;
+                }
+                break;
+            case 'h':
+                usage(argv[0], stdout);
+                break;
+            case 'v':
+                version();
+                break;
+            default:
+                usage(argv[0], stderr);
+                break;
+        }
+    }
+
+    struct sigaction sa = { .sa_handler = signal_handler };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    bool is_tty = isatty(STDOUT_FILENO);
+
+    for (long i = 0; keep_running && (iterations < 0 || i < iterations); ++i) {
+        /* Clear screen and move cursor to the top-left corner */
+        if (is_tty) {
+            fputs("\033[H\033[2J", stdout);
+        }
+
+        time_t now = time(NULL);
+        char time_str[32];
+        strftime(time_str, sizeof(time_str), "%H:%M:%S", localtime(&now));
+        fprintf(stdout, "dlb_top - %s, refresh every %gs\n\n", time_str, delay);
+        fflush(stdout);
+
+        DLB_PrintShmem(list_columns, print_flags);
+        fflush(stderr);
+        print_lewi_rates();
+        fflush(stdout);
+
+        if (iterations < 0 || i < iterations-1) {
+            sleep_seconds(delay);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,52 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "support/cgroup.h"
+
+#include "apis/dlb_errors.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <assert.h>
+
+int main(int argc, char **argv) {
+
+    cpu_set_t empty_mask, mask;
+    CPU_ZERO(&empty_mask);
+    sched_getaffinity(0, sizeof(cpu_set_t), &mask);
+
+    /* Empty masks are never applied */
+    assert( cgroup_cpuset_create("/tmp", &empty_mask) == DLB_ERR_PERM );
+    assert( cgroup_cpuset_set_cpus(getpid(), &empty_mask) == DLB_ERR_PERM );
+
+    /* Not a cgroup v2 directory */
+    assert( cgroup_cpuset_create("/non-existent-dir", &mask) == DLB_ERR_NOENT );
+
+    /* This process is not in a cgroup created by dlb_run */
+    assert( cgroup_cpuset_set_cpus(getpid(), &mask) == DLB_ERR_NOENT );
+
+    /* Non-existent process */
+    assert( cgroup_cpuset_set_cpus(-1, &mask) == DLB_ERR_NOENT );
+
+    return 0;
+}
@@ -104,6 +104,13 @@ int main(int argc, char *argv[]) {
         assert( mu_get_cpu_next_core(&system_mask, 31) == -1 );
         assert( mu_get_cpu_next_core(&system_mask, 32) == -1 );
 
+        /* Test node functions */
+        assert( mu_get_num_nodes() == SYS_NNODES );
+        assert( mu_get_node_id(0) == 0 );
+        assert( mu_get_node_id(8) == 1 );
+        assert( mu_get_node_id(31) == 3 );
+        assert( mu_get_node_id(-1) == -1 );
+
         /* Test core mask functions */
         cpu_set_t mask;
         mu_parse_mask("0-3", &mask);
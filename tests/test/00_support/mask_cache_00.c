@@ -0,0 +1,162 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+// Test the node topology cache file
+
+#include "support/mask_utils.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char cache_dir[] = "/tmp/dlb_topology_cache_XXXXXX";
+
+/* Return the number of cache files in cache_dir, and the name of the last one */
+static int find_cache_files(char *filename, size_t len) {
+    int num_files = 0;
+    DIR *dir = opendir(cache_dir);
+    assert( dir != NULL );
+    struct dirent *d;
+    while ((d = readdir(dir))) {
+        if (strncmp(d->d_name, "DLB_topology_cache_", 19) == 0) {
+            snprintf(filename, len, "%s/%s", cache_dir, d->d_name);
+            ++num_files;
+        }
+    }
+    closedir(dir);
+    return num_files;
+}
+
+int main(int argc, char *argv[]) {
+
+    char filename[PATH_MAX];
+    char dlb_args[PATH_MAX];
+    assert( mkdtemp(cache_dir) != NULL );
+
+    /* Cache disabled */
+    snprintf(dlb_args, PATH_MAX, "--no-topology-cache --topology-cache-dir=%s", cache_dir);
+    setenv("DLB_ARGS", dlb_args, 1);
+    mu_init();
+    int system_size = mu_get_system_size();
+    int num_cores = mu_get_num_cores();
+    cpu_set_t system_mask;
+    mu_get_system_mask(&system_mask);
+    mu_finalize();
+    assert( find_cache_files(filename, PATH_MAX) == 0 );
+
+    /* Disabled by default */
+    snprintf(dlb_args, PATH_MAX, "--topology-cache-dir=%s", cache_dir);
+    setenv("DLB_ARGS", dlb_args, 1);
+    mu_init();
+    mu_finalize();
+    assert( find_cache_files(filename, PATH_MAX) == 0 );
+
+    /* The first initialization creates the cache */
+    snprintf(dlb_args, PATH_MAX, "--topology-cache --topology-cache-dir=%s", cache_dir);
+    setenv("DLB_ARGS", dlb_args, 1);
+    mu_init();
+    assert( find_cache_files(filename, PATH_MAX) == 1 );
+    mu_finalize();
+
+    /* The next ones load it */
+    mu_init();
+    assert( mu_get_system_size() == system_size );
+    assert( mu_get_num_cores() == num_cores );
+    cpu_set_t mask;
+    mu_get_system_mask(&mask);
+    assert( CPU_EQUAL(&mask, &system_mask) );
+    for (int cpuid = 0; cpuid < system_size; ++cpuid) {
+        if (CPU_ISSET(cpuid, &system_mask)) {
+            assert( mu_get_core_mask(cpuid) != NULL );
+            assert( CPU_ISSET(cpuid, mu_get_core_mask(cpuid)->set) );
+        }
+    }
+    mu_finalize();
+
+    /* A corrupted cache is ignored and replaced */
+    FILE *fd = fopen(filename, "w");
+    assert( fd != NULL );
+    fputs("corrupted", fd);
+    fclose(fd);
+    mu_init();
+    assert( mu_get_system_size() == system_size );
+    assert( mu_get_num_cores() == num_cores );
+    mu_finalize();
+    assert( find_cache_files(filename, PATH_MAX) == 1 );
+    mu_init();
+    assert( mu_get_system_size() == system_size );
+    mu_finalize();
+
+    /* A cache with inconsistent masks is ignored and replaced */
+    cpu_set_t full_mask;
+    memset(&full_mask, 0xff, sizeof(cpu_set_t));
+    FILE *f = fopen(filename, "r+");
+    assert( f != NULL );
+    assert( fseek(f, -(long)sizeof(cpu_set_t), SEEK_END) == 0 );
+    assert( fwrite(&full_mask, sizeof(cpu_set_t), 1, f) == 1 );
+    fclose(f);
+    mu_init();
+    assert( mu_get_system_size() == system_size );
+    assert( mu_get_num_cores() == num_cores );
+    mu_finalize();
+    assert( find_cache_files(filename, PATH_MAX) == 1 );
+    f = fopen(filename, "r");
+    assert( f != NULL );
+    assert( fseek(f, -(long)sizeof(cpu_set_t), SEEK_END) == 0 );
+    assert( fread(&mask, sizeof(cpu_set_t), 1, f) == 1 );
+    fclose(f);
+    assert( !CPU_EQUAL(&mask, &full_mask) );
+
+    /* A different HWLOC environment uses a different cache */
+    setenv("HWLOC_COMPONENTS", "linux", 1);
+    mu_init();
+    assert( mu_get_system_size() == system_size );
+    mu_finalize();
+    assert( find_cache_files(filename, PATH_MAX) == 2 );
+    unsetenv("HWLOC_COMPONENTS");
+
+    /* Cache files are removed even if the cache is disabled */
+    snprintf(dlb_args, PATH_MAX, "--topology-cache-dir=%s", cache_dir);
+    setenv("DLB_ARGS", dlb_args, 1);
+    assert( mu_delete_topology_cache() == 2 );
+    assert( find_cache_files(filename, PATH_MAX) == 0 );
+
+    /* Clean up */
+    DIR *dir = opendir(cache_dir);
+    struct dirent *d;
+    while ((d = readdir(dir))) {
+        if (d->d_name[0] != '.') {
+            snprintf(filename, PATH_MAX, "%s/%s", cache_dir, d->d_name);
+            assert( unlink(filename) == 0 );
+        }
+    }
+    closedir(dir);
+    assert( rmdir(cache_dir) == 0 );
+
+    return 0;
+}
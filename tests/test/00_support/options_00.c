@@ -218,6 +218,16 @@ int main( int argc, char **argv ) {
     options_parse_entry("--mode", &mode);               assert(mode == MODE_POLLING);
     options_parse_entry("--talp-summary", &talp_sum);   assert(talp_sum == SUMMARY_POP_METRICS);
     options_parse_entry("--talp-model", &talp_model);   assert(talp_model == TALP_MODEL_HYBRID_V2);
+    // 1b) DLB_ARGS is parsed once, but modifications are still observed
+    setenv("DLB_ARGS", "--no-lewi --barrier-id=4 --barrier-id=5 --shm-key=", 1);
+    options_parse_entry("--lewi", &lewi);               assert(lewi == false);
+    options_parse_entry("--barrier-id", &barrier_id);   assert(barrier_id == 5);
+    options_parse_entry("lb_lewi", &lewi);              assert(lewi == false);
+    options_parse_entry("--shm-key", shm_key);          assert(strcmp(shm_key, "") == 0);
+    unsetenv("DLB_ARGS");
+    options_parse_entry("--barrier-id", &barrier_id);   assert(barrier_id == 0);
+    setenv("DLB_ARGS", "--lewi --lewi-mpi --barrier-id=3 --shm-key=custom_key"
+            " --verbose=talp --lewi-ompt=borrow", 1);
     // 2) with existing thread_spd
     spd_enter_dlb(NULL);
     options_init(&thread_spd->options, NULL);
@@ -0,0 +1,91 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "support/perf_event.h"
+
+#include "apis/dlb_errors.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+int main(int argc, char **argv) {
+
+    perf_event_desc_t desc, other_desc;
+    const char *preset;
+
+    int error = perf_event_lookup("cycles", &desc, &preset);
+    if (error == DLB_ERR_NOCOMP) {
+        /* DLB compiled without perf_event support */
+        return 0;
+    }
+
+    /* perf names and PAPI presets resolve to the same event */
+    assert( error == DLB_SUCCESS );
+    assert( strcmp(preset, "PAPI_TOT_CYC") == 0 );
+    assert( perf_event_lookup("PAPI_TOT_CYC", &other_desc, NULL) == DLB_SUCCESS );
+    assert( desc.type == other_desc.type && desc.config == other_desc.config );
+
+    /* Raw events */
+    assert( perf_event_lookup("r01c2", &desc, &preset) == DLB_SUCCESS );
+    assert( desc.config == 0x1c2 );
+    assert( preset == NULL );
+
+    /* Unknown events */
+    assert( perf_event_lookup("foo", &desc, NULL) == DLB_ERR_NOENT );
+    assert( perf_event_lookup("rxyz", &desc, NULL) == DLB_ERR_NOENT );
+    assert( perf_event_lookup(NULL, &desc, NULL) == DLB_ERR_NOENT );
+
+    /* Wrong number of events */
+    perf_event_group_t group;
+    assert( perf_event_group_open(&group, &desc, 0) == DLB_ERR_UNKNOWN );
+    assert( perf_event_group_open(&group, &desc, PERF_EVENT_GROUP_MAX+1)
+            == DLB_ERR_UNKNOWN );
+
+    /* Software events may be opened even if the PMU is not available */
+    perf_event_desc_t sw_descs[2];
+    assert( perf_event_lookup("task-clock", &sw_descs[0], NULL) == DLB_SUCCESS );
+    assert( perf_event_lookup("page-faults", &sw_descs[1], NULL) == DLB_SUCCESS );
+    error = perf_event_group_open(&group, sw_descs, 2);
+    if (error == DLB_SUCCESS) {
+        assert( group.num == 2 );
+
+        int64_t values[2], new_values[2];
+        perf_event_group_read(&group, values);
+        volatile int64_t x = 0;
+        for (int i = 0; i < 1000000; ++i) x += i;
+        perf_event_group_read(&group, new_values);
+
+        /* Counters are never reset */
+        assert( new_values[0] > values[0] );
+        assert( new_values[1] >= values[1] );
+
+        perf_event_group_close(&group);
+        assert( group.num == 0 );
+    } else {
+        /* e.g., restricted by perf_event_paranoid or by a seccomp profile */
+        assert( error == DLB_ERR_PERM || error == DLB_ERR_NOENT );
+    }
+
+    return 0;
+}
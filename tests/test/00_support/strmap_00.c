@@ -0,0 +1,99 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "support/strmap.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+enum { MAX_KEY_LEN = 16 };
+enum { NUM_KEYS = 1000 };
+
+int main(int argc, char **argv) {
+
+    strmap_t map;
+    strmap_init(&map, MAX_KEY_LEN);
+    assert( strmap_size(&map) == 0 );
+    assert( strmap_lookup(&map, "key") == NULL );
+
+    /* Insert in reverse order */
+    static int values[NUM_KEYS];
+    for (int i = NUM_KEYS-1; i >= 0; --i) {
+        char key[MAX_KEY_LEN];
+        snprintf(key, MAX_KEY_LEN, "key %04d", i);
+        values[i] = i;
+        const char *interned_key = strmap_insert(&map, key, &values[i]);
+        assert( interned_key != key );
+        assert( strcmp(interned_key, key) == 0 );
+    }
+    assert( strmap_size(&map) == NUM_KEYS );
+
+    /* Lookup */
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        char key[MAX_KEY_LEN];
+        snprintf(key, MAX_KEY_LEN, "key %04d", i);
+        int *value = strmap_lookup(&map, key);
+        assert( value != NULL && *value == i );
+    }
+    assert( strmap_lookup(&map, "key 1000") == NULL );
+    assert( strmap_lookup(&map, "") == NULL );
+
+    /* Insertion order */
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        int *value = strmap_value_at(&map, i);
+        assert( *value == NUM_KEYS-1 - i );
+    }
+    assert( strmap_value_at(&map, NUM_KEYS) == NULL );
+
+    /* Sorted order */
+    static int *sorted[NUM_KEYS];
+    strmap_sorted_values(&map, (void**)sorted);
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        assert( *sorted[i] == i );
+    }
+
+    /* Replace value, the interned key is the same */
+    int other_value = -1;
+    const char *interned_key = strmap_insert(&map, "key 0000", &other_value);
+    assert( strmap_insert(&map, "key 0000", &other_value) == interned_key );
+    assert( strmap_lookup(&map, "key 0000") == &other_value );
+    assert( strmap_size(&map) == NUM_KEYS );
+
+    /* Keys are compared up to MAX_KEY_LEN characters */
+    const char *long_key = strmap_insert(&map, "0123456789abcdefXXX", &other_value);
+    assert( strlen(long_key) == MAX_KEY_LEN );
+    assert( strmap_lookup(&map, "0123456789abcdefYYY") == &other_value );
+    assert( strmap_lookup(&map, "0123456789abcdef") == &other_value );
+    assert( strmap_lookup(&map, "0123456789abcde") == NULL );
+
+    /* Empty key */
+    strmap_insert(&map, "", &other_value);
+    assert( strmap_lookup(&map, "") == &other_value );
+
+    strmap_destroy(&map);
+    assert( strmap_size(&map) == 0 );
+    assert( strmap_lookup(&map, "key 0000") == NULL );
+
+    return 0;
+}
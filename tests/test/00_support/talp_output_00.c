@@ -97,9 +97,10 @@ static void record_metrics(void) {
         .omp_scheduling_efficiency    = 0.95f,
         .omp_serialization_efficiency = 0.95f,
     };
+    hwc_metrics_t hwc_metrics = { .gflops = 1.5f, .mem_bound = 0.25f };
 
 
-    talp_output_record_pop_metrics(&metrics);
+    talp_output_record_pop_metrics(&metrics, &hwc_metrics);
 
     /* node_record_t contains a flexible array member and it needs to be
      * dynamically allocated */
@@ -169,11 +170,11 @@ int main(int argc, char *argv[]) {
     char *csv_filename, *csv1, *csv2, *csv3;
     asprintf(&csv_filename, "%s/talp.csv", tmpdir);
     dlb_pop_metrics_t metrics_1 = { .name = "Region 1" };
-    talp_output_record_pop_metrics(&metrics_1);
+    talp_output_record_pop_metrics(&metrics_1, NULL);
     talp_output_finalize(csv_filename);
     error += access(csv_filename, F_OK);
     dlb_pop_metrics_t metrics_2 = { .name = "Region 2" };
-    talp_output_record_pop_metrics(&metrics_2);
+    talp_output_record_pop_metrics(&metrics_2, NULL);
     talp_output_finalize(csv_filename);
     error += count_lines(csv_filename) - 3;  // test append, count_lines should return 3
     asprintf(&csv1, "%s/talp-pop.csv", tmpdir);
@@ -0,0 +1,137 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "support/timers.h"
+
+#include "apis/dlb_errors.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <assert.h>
+
+enum { NUM_THREADS = 4 };
+enum { NUM_SAMPLES = 1000 };
+
+/* Each thread records values 1..NUM_SAMPLES (in us) */
+static void* record_samples(void *arg) {
+    for (int i = 1; i <= NUM_SAMPLES; ++i) {
+        timer_record(TIMER_LEND, i * 1000);
+    }
+    return NULL;
+}
+
+/* Percentiles must be within the histogram relative error */
+static void assert_approx(int64_t value, int64_t expected) {
+    assert( value >= expected - expected / 16 - 1 );
+    assert( value <= expected + expected / 16 + 1 );
+}
+
+int main(int argc, char **argv) {
+
+    timer_stats_t stats;
+
+    /* Disabled timers do not record anything */
+    int64_t timer = timer_start();
+    assert( timer == 0 );
+    timer_stop(TIMER_LEND, timer);
+    assert( timers_get_stats(TIMER_LEND, &stats) == DLB_SUCCESS );
+    assert( stats.count == 0 );
+    assert( timers_get_stats(TIMER_NUM_TIMERS, &stats) == DLB_ERR_UNKNOWN );
+    assert( timer_get_name(TIMER_LEND) != NULL );
+    assert( timer_get_name(TIMER_NUM_TIMERS) == NULL );
+
+    timers_init();
+
+    /* Timers started while disabled do not record anything once enabled */
+    timer_stop(TIMER_LEND, timer);
+    assert( timers_get_stats(TIMER_LEND, &stats) == DLB_SUCCESS );
+    assert( stats.count == 0 );
+
+    /* Small values are recorded exactly */
+    timer_record(TIMER_RECLAIM, 3);
+    timer_record(TIMER_RECLAIM, 5);
+    assert( timers_get_stats(TIMER_RECLAIM, &stats) == DLB_SUCCESS );
+    assert( stats.count == 2 && stats.min == 3 && stats.max == 5 && stats.avg == 4 );
+    assert( stats.p50 == 3 && stats.p99 == 5 );
+
+    /* Samples from several threads are aggregated */
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        assert( pthread_create(&threads[i], NULL, record_samples, NULL) == 0 );
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        assert( pthread_join(threads[i], NULL) == 0 );
+    }
+    assert( timers_get_stats(TIMER_LEND, &stats) == DLB_SUCCESS );
+    assert( stats.count == NUM_THREADS * NUM_SAMPLES );
+    assert( stats.min == 1000 );
+    assert( stats.max == NUM_SAMPLES * 1000 );
+    assert( stats.avg == (NUM_SAMPLES + 1) * 1000 / 2 );
+    assert_approx(stats.p50, NUM_SAMPLES * 1000 / 2);
+    assert_approx(stats.p90, NUM_SAMPLES * 1000 * 9 / 10);
+    assert_approx(stats.p99, NUM_SAMPLES * 1000 * 99 / 100);
+
+    /* Huge values are clamped but min/max are exact */
+    timer_record(TIMER_POLLDROM, INT64_C(1) << 50);
+    assert( timers_get_stats(TIMER_POLLDROM, &stats) == DLB_SUCCESS );
+    assert( stats.count == 1 && stats.max == INT64_C(1) << 50 );
+    assert( stats.p99 == stats.max );
+
+    /* Enabled timers measure real elapsed time */
+    timer = timer_start();
+    assert( timer > 0 );
+    timer_stop(TIMER_TALP_FLUSH, timer);
+    assert( timers_get_stats(TIMER_TALP_FLUSH, &stats) == DLB_SUCCESS );
+    assert( stats.count == 1 && stats.min >= 0 );
+
+    timers_report();
+
+    /* A reset clears the samples of all threads, even exited ones */
+    timers_reset();
+    assert( timers_get_stats(TIMER_LEND, &stats) == DLB_SUCCESS );
+    assert( stats.count == 0 );
+    assert( timers_get_stats(TIMER_RECLAIM, &stats) == DLB_SUCCESS );
+    assert( stats.count == 0 );
+    timer_record(TIMER_RECLAIM, 7);
+    assert( timers_get_stats(TIMER_RECLAIM, &stats) == DLB_SUCCESS );
+    assert( stats.count == 1 && stats.min == 7 && stats.max == 7 );
+
+    /* Timers are reference counted, only the last finalize disables them */
+    timers_init();
+    timers_finalize();
+    assert( timers_enabled );
+    assert( timers_get_stats(TIMER_RECLAIM, &stats) == DLB_SUCCESS );
+    assert( stats.count == 1 );
+
+    /* Finalize prints and resets all timers */
+    timers_finalize();
+    assert( !timers_enabled );
+    assert( timers_get_stats(TIMER_LEND, &stats) == DLB_SUCCESS );
+    assert( stats.count == 0 );
+
+    /* Unbalanced finalize calls are ignored */
+    timers_finalize();
+    assert( !timers_enabled );
+
+    return 0;
+}
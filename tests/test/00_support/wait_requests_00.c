@@ -0,0 +1,87 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "LB_MPI/wait_requests.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+/* Test the check of whether a wait call on a list of requests returns
+ * immediately, used to skip LeWI on MPI wait calls */
+
+enum { N = WAIT_REQUEST_NULL, P = WAIT_REQUEST_PENDING, C = WAIT_REQUEST_COMPLETED };
+
+static int num_queries = 0;
+
+static wait_request_state_t get_state(int index, const void *requests) {
+    ++num_queries;
+    return ((const wait_request_state_t*)requests)[index];
+}
+
+static bool wait_all(int count, const wait_request_state_t requests[]) {
+    num_queries = 0;
+    return wait_requests_completed(count, requests, get_state, true);
+}
+
+static bool wait_any(int count, const wait_request_state_t requests[]) {
+    num_queries = 0;
+    return wait_requests_completed(count, requests, get_state, false);
+}
+
+int main(int argc, char *argv[]) {
+
+    /* No requests, or only null requests: both return immediately */
+    assert( wait_all(0, NULL) );
+    assert( wait_any(0, NULL) );
+    const wait_request_state_t all_null[] = {N, N, N};
+    assert( wait_all(3, all_null) );
+    assert( wait_any(3, all_null) );
+
+    /* Only completed requests */
+    const wait_request_state_t all_completed[] = {C, C, C};
+    assert( wait_all(3, all_completed) );
+    assert( wait_any(3, all_completed) );
+    assert( num_queries == 1 );
+
+    /* Only pending requests */
+    const wait_request_state_t all_pending[] = {P, P, P};
+    assert( !wait_all(3, all_pending) );
+    assert( num_queries == 1 );
+    assert( !wait_any(3, all_pending) );
+
+    /* Pending and completed requests: only wait-any returns immediately */
+    const wait_request_state_t mixed[] = {P, C, P};
+    assert( !wait_all(3, mixed) );
+    assert( wait_any(3, mixed) );
+    assert( num_queries == 2 );
+
+    /* Null requests are ignored, unless all of them are null */
+    const wait_request_state_t null_completed[] = {N, C, N};
+    assert( wait_all(3, null_completed) );
+    assert( wait_any(3, null_completed) );
+    const wait_request_state_t null_pending[] = {N, P, N};
+    assert( !wait_all(3, null_pending) );
+    assert( !wait_any(3, null_pending) );
+
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+/* Test the update_active_mask_delta callback and the callback window */
+
+#include "LB_numThreads/numThreads.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <assert.h>
+
+static cpu_set_t active_mask;
+static volatile int num_callbacks = 0;
+
+static void cb_enable_cpu(int cpuid, void *arg) {
+    CPU_SET(cpuid, &active_mask);
+    ++num_callbacks;
+}
+
+static void cb_disable_cpu(int cpuid, void *arg) {
+    CPU_CLR(cpuid, &active_mask);
+    ++num_callbacks;
+}
+
+static int delta_arg = 10;
+static void cb_update_active_mask_delta(const cpu_set_t *enable_mask,
+        const cpu_set_t *disable_mask, void *arg) {
+    assert( arg == &delta_arg );
+    CPU_OR(&active_mask, &active_mask, enable_mask);
+    mu_substract(&active_mask, &active_mask, disable_mask);
+    ++num_callbacks;
+}
+
+static void reset(void) {
+    CPU_ZERO(&active_mask);
+    num_callbacks = 0;
+}
+
+static void* defer_cpu_6(void *arg) {
+    const pm_interface_t *pm = arg;
+    cpu_set_t cpu_set;
+    cpu_set_t empty_set;
+    CPU_ZERO(&cpu_set);
+    CPU_ZERO(&empty_set);
+    CPU_SET(6, &cpu_set);
+    assert( update_mask_delta(pm, &cpu_set, &empty_set, true) == DLB_SUCCESS );
+    return NULL;
+}
+
+int main( int argc, char **argv ) {
+    enum { SYS_SIZE = 8 };
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    cpu_set_t empty_set;
+    cpu_set_t cpus_0_3;
+    cpu_set_t cpus_4_7;
+    CPU_ZERO(&empty_set);
+    mu_parse_mask("0-3", &cpus_0_3);
+    mu_parse_mask("4-7", &cpus_4_7);
+
+    pm_interface_t pm;
+    pm_init(&pm);
+
+    /* No callbacks */
+    assert( update_mask_delta(&pm, &cpus_0_3, &empty_set, false) == DLB_ERR_NOCBK );
+
+    /* Without the delta callback, fall back to one callback per CPU */
+    assert( pm_callback_set(&pm, dlb_callback_enable_cpu,
+                (dlb_callback_t)cb_enable_cpu, NULL) == DLB_SUCCESS );
+    assert( pm_callback_set(&pm, dlb_callback_disable_cpu,
+                (dlb_callback_t)cb_disable_cpu, NULL) == DLB_SUCCESS );
+    reset();
+    assert( update_mask_delta(&pm, &cpus_0_3, &empty_set, false) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&active_mask, &cpus_0_3) );
+    assert( num_callbacks == 4 );
+    assert( update_mask_delta(&pm, &cpus_4_7, &cpus_0_3, false) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&active_mask, &cpus_4_7) );
+    assert( num_callbacks == 12 );
+
+    /* Set and get the delta callback */
+    dlb_callback_t cb;
+    void *arg;
+    assert( pm_callback_set(&pm, dlb_callback_update_active_mask_delta,
+                (dlb_callback_t)cb_update_active_mask_delta, &delta_arg) == DLB_SUCCESS );
+    assert( pm_callback_get(&pm, dlb_callback_update_active_mask_delta,
+                &cb, &arg) == DLB_SUCCESS );
+    assert( cb == (dlb_callback_t)cb_update_active_mask_delta );
+    assert( arg == &delta_arg );
+
+    /* Enable and disable in a single callback */
+    reset();
+    assert( update_mask_delta(&pm, &cpus_0_3, &empty_set, false) == DLB_SUCCESS );
+    assert( update_mask_delta(&pm, &cpus_4_7, &cpus_0_3, false) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&active_mask, &cpus_4_7) );
+    assert( num_callbacks == 2 );
+    assert( update_mask_delta(&pm, &empty_set, &empty_set, false) == DLB_SUCCESS );
+    assert( num_callbacks == 2 );
+
+    /* The set callbacks fall back to the delta callback if they are not defined */
+    assert( pm_callback_set(&pm, dlb_callback_enable_cpu, NULL, NULL) == DLB_SUCCESS );
+    assert( pm_callback_set(&pm, dlb_callback_disable_cpu, NULL, NULL) == DLB_SUCCESS );
+    reset();
+    assert( add_mask(&pm, &cpus_0_3) == DLB_SUCCESS );
+    assert( enable_cpu_set(&pm, &cpus_4_7) == DLB_SUCCESS );
+    assert( CPU_COUNT(&active_mask) == SYS_SIZE );
+    assert( disable_cpu_set(&pm, &cpus_0_3) == DLB_SUCCESS );
+    assert( disable_cpu(&pm, 4) == DLB_SUCCESS );
+    assert( enable_cpu(&pm, 0) == DLB_SUCCESS );
+    assert( CPU_COUNT(&active_mask) == 4 );
+    assert( CPU_ISSET(0, &active_mask) && !CPU_ISSET(4, &active_mask) );
+    assert( num_callbacks == 5 );
+
+    /* Callback window: enabled CPUs are deferred during one minute */
+    pm_set_mask_delta_window(&pm, 60LL * 1000000000LL);
+    reset();
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(0, &cpu_set);
+    /* first update is notified immediately */
+    assert( update_mask_delta(&pm, &cpu_set, &empty_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 1 );
+    /* the following enabled CPUs are deferred */
+    for (int cpuid = 1; cpuid < 4; ++cpuid) {
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpuid, &cpu_set);
+        assert( update_mask_delta(&pm, &cpu_set, &empty_set, true) == DLB_SUCCESS );
+    }
+    assert( num_callbacks == 1 );
+    assert( CPU_COUNT(&active_mask) == 1 );
+    /* a pending CPU that is disabled is never notified */
+    CPU_ZERO(&cpu_set);
+    CPU_SET(3, &cpu_set);
+    assert( update_mask_delta(&pm, &empty_set, &cpu_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 1 );
+    /* disabling a notified CPU is not deferred and carries the pending CPUs */
+    CPU_ZERO(&cpu_set);
+    CPU_SET(0, &cpu_set);
+    assert( update_mask_delta(&pm, &empty_set, &cpu_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 2 );
+    mu_parse_mask("1-2", &cpu_set);
+    assert( CPU_EQUAL(&active_mask, &cpu_set) );
+    /* flush notifies the pending CPUs */
+    assert( update_mask_delta(&pm, &cpus_4_7, &empty_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 2 );
+    assert( flush_mask_delta(&pm) == DLB_SUCCESS );
+    assert( num_callbacks == 3 );
+    mu_parse_mask("1-2,4-7", &cpu_set);
+    assert( CPU_EQUAL(&active_mask, &cpu_set) );
+    assert( flush_mask_delta(&pm) == DLB_SUCCESS );
+    assert( num_callbacks == 3 );
+    /* other callbacks notify the pending CPUs first */
+    assert( update_mask_delta(&pm, &cpus_0_3, &empty_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 3 );
+    assert( disable_cpu_set(&pm, &cpus_4_7) == DLB_SUCCESS );
+    assert( num_callbacks == 5 );
+    assert( CPU_EQUAL(&active_mask, &cpus_0_3) );
+    /* non-deferrable CPUs are notified immediately along with the pending ones */
+    CPU_ZERO(&cpu_set);
+    CPU_SET(4, &cpu_set);
+    assert( update_mask_delta(&pm, &cpu_set, &empty_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 5 );
+    CPU_ZERO(&cpu_set);
+    CPU_SET(5, &cpu_set);
+    assert( update_mask_delta(&pm, &cpu_set, &empty_set, false) == DLB_SUCCESS );
+    assert( num_callbacks == 6 );
+    mu_parse_mask("0-5", &cpu_set);
+    assert( CPU_EQUAL(&active_mask, &cpu_set) );
+    /* CPUs deferred by another thread are notified from any thread */
+    pthread_t thread;
+    assert( pthread_create(&thread, NULL, defer_cpu_6, &pm) == 0 );
+    assert( pthread_join(thread, NULL) == 0 );
+    assert( num_callbacks == 6 );
+    assert( flush_mask_delta(&pm) == DLB_SUCCESS );
+    assert( num_callbacks == 7 );
+    assert( CPU_ISSET(6, &active_mask) );
+    /* a window of zero notifies immediately */
+    pm_set_mask_delta_window(&pm, 0);
+    CPU_ZERO(&cpu_set);
+    CPU_SET(7, &cpu_set);
+    assert( update_mask_delta(&pm, &cpu_set, &empty_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 8 );
+    assert( CPU_COUNT(&active_mask) == SYS_SIZE );
+    /* deferred CPUs are notified when the window expires, without further calls */
+    pm_set_mask_delta_window(&pm, 200LL * 1000000LL);
+    assert( disable_cpu_set(&pm, &cpus_4_7) == DLB_SUCCESS );
+    assert( num_callbacks == 9 );
+    CPU_ZERO(&cpu_set);
+    CPU_SET(4, &cpu_set);
+    assert( update_mask_delta(&pm, &cpu_set, &empty_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 10 );
+    CPU_ZERO(&cpu_set);
+    CPU_SET(5, &cpu_set);
+    assert( update_mask_delta(&pm, &cpu_set, &empty_set, true) == DLB_SUCCESS );
+    assert( num_callbacks == 10 );
+    for (int i = 0; i < 10000 && num_callbacks == 10; ++i) {
+        usleep(1000);
+    }
+    assert( num_callbacks == 11 );
+    mu_parse_mask("0-5", &cpu_set);
+    assert( CPU_EQUAL(&active_mask, &cpu_set) );
+
+    pm_finalize(&pm);
+
+    return 0;
+}
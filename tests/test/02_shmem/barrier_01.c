@@ -27,6 +27,7 @@
 #include "LB_comm/shmem.h"
 #include "LB_core/spd.h"
 #include "support/mask_utils.h"
+#include "support/types.h"
 #include "support/options.h"
 #include "support/debug.h"
 #include "apis/dlb_errors.h"
@@ -121,5 +122,42 @@ int main(int argc, char **argv) {
         shmem_barrier__finalize(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
     }
 
+    /* Test a barrier whose process table is full */
+    {
+        options_t options;
+        options_init(&options, NULL);
+        debug_init(&options);
+        spd_enter_dlb(NULL);
+        shmem_barrier__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
+
+        printf("Testing a barrier with a full process table\n");
+        enum { FIRST_FAKE_PID = 1000 };
+        int max_procs = max_int(mu_get_system_size(), 64);
+        barrier_t *barrier = NULL;
+        for (int i = 0; i < max_procs; ++i) {
+            thread_spd->id = FIRST_FAKE_PID + i;
+            barrier = shmem_barrier__register("Full table", DLB_BARRIER_LEWI_OFF);
+            assert( barrier != NULL );
+        }
+
+        /* Processes that cannot be tracked do not attach */
+        thread_spd->id = FIRST_FAKE_PID + max_procs;
+        assert( shmem_barrier__register("Full table", DLB_BARRIER_LEWI_OFF) == NULL );
+        assert( shmem_barrier__attach(barrier) == DLB_ERR_NOMEM );
+
+        /* Tracked processes may still attach more participants */
+        thread_spd->id = FIRST_FAKE_PID;
+        assert( shmem_barrier__attach(barrier) == max_procs + 1 );
+        assert( shmem_barrier__detach(barrier) == max_procs );
+
+        for (int i = max_procs - 1; i >= 0; --i) {
+            thread_spd->id = FIRST_FAKE_PID + i;
+            assert( shmem_barrier__detach(barrier) == i );
+        }
+
+        thread_spd->id = getpid();
+        shmem_barrier__finalize(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
+    }
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,151 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "LB_comm/shmem_barrier.h"
+#include "LB_comm/shmem.h"
+#include "LB_core/spd.h"
+#include "support/atomic.h"
+#include "support/options.h"
+#include "support/debug.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Stress test for the node barrier: several threads from two processes
+ * perform consecutive barriers and check that no participant leaves a
+ * barrier before all the others have entered it */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { SHMEM_SIZE_MULTIPLIER = 1 };
+enum { NUM_THREADS = 4 };
+enum { NUM_PROCESSES = 2 };
+enum { NUM_PARTICIPANTS = NUM_THREADS * NUM_PROCESSES };
+enum { NUM_ITERATIONS = 2000 };
+
+struct data {
+    pthread_barrier_t start;
+    atomic_int arrived;
+};
+
+static struct data *shdata;
+static barrier_t *barrier;
+
+static void* barrier_fn(void *arg) {
+    for (int i = 0; i < NUM_ITERATIONS; ++i) {
+        DLB_ATOMIC_ADD(&shdata->arrived, 1);
+        shmem_barrier__barrier(barrier);
+        assert( DLB_ATOMIC_LD(&shdata->arrived) == NUM_PARTICIPANTS * (i+1) );
+        shmem_barrier__barrier(barrier);
+    }
+    return NULL;
+}
+
+static void run_participant(void) {
+    options_t options;
+    options_init(&options, NULL);
+    debug_init(&options);
+    spd_enter_dlb(NULL);
+    thread_spd->id = getpid();
+
+    /* Register the barrier, and attach once per extra thread */
+    shmem_barrier__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
+    barrier = shmem_barrier__register("stress", false);
+    assert( barrier != NULL );
+    for (int i = 1; i < NUM_THREADS; ++i) {
+        assert( shmem_barrier__attach(barrier) > 0 );
+    }
+
+    /* Wait until all processes are attached */
+    int error = pthread_barrier_wait(&shdata->start);
+    assert(error == 0 || error == PTHREAD_BARRIER_SERIAL_THREAD);
+
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_create(&threads[i], NULL, barrier_fn, NULL);
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    shmem_barrier__print_info(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
+
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        assert( shmem_barrier__detach(barrier) >= 0 );
+    }
+    shmem_barrier__finalize(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
+}
+
+int main(int argc, char **argv) {
+
+    shmem_handler_t *handler = shmem_init((void**)&shdata,
+            &(const shmem_props_t) {
+                .size = sizeof(struct data),
+                .name = "test",
+                .key = SHMEM_KEY,
+            });
+    pthread_barrierattr_t attr;
+    assert( pthread_barrierattr_init(&attr) == 0 );
+    assert( pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 );
+    assert( pthread_barrier_init(&shdata->start, &attr, NUM_PROCESSES) == 0 );
+    assert( pthread_barrierattr_destroy(&attr) == 0 );
+    shdata->arrived = 0;
+
+    for (int child = 0; child < NUM_PROCESSES; ++child) {
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            run_participant();
+            shmem_finalize(handler, NULL);
+
+            // We need to call _exit so that children don't call assert_shmem destructors,
+            // but that prevents gcov reports, so we'll call it if defined
+            if (__gcov_flush) __gcov_flush();
+            _exit(EXIT_SUCCESS);
+        }
+    }
+
+    // Wait for all child processes
+    int wstatus;
+    while(wait(&wstatus) > 0) {
+        if (!WIFEXITED(wstatus))
+            exit(EXIT_FAILURE);
+        int rc = WEXITSTATUS(wstatus);
+        if (rc != 0) {
+            printf("Child return status: %d\n", rc);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    assert( DLB_ATOMIC_LD(&shdata->arrived) == NUM_PARTICIPANTS * NUM_ITERATIONS );
+    assert( pthread_barrier_destroy(&shdata->start) == 0 );
+    shmem_finalize(handler, NULL);
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "extra_tests.h"
+#include "unique_shmem.h"
+
+#include "LB_comm/comm_lend_light.h"
+#include "support/mask_utils.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Test the NUMA-partitioned idle CPU counters of classic LeWI: borrowing
+ * prefers the local domain, and concurrent processes lending, reclaiming and
+ * borrowing CPUs never create nor lose any CPU */
+
+void __gcov_flush() __attribute__((weak));
+
+enum { SYS_SIZE = 8 };
+enum { NUM_NODES = 2 };
+enum { NUM_PROCS = 4 };
+enum { DEFAULT_CPUS = SYS_SIZE / NUM_PROCS };
+
+static void child_exit(int status) {
+    /* Invoke _exit so that call assert_shmem destructors are not called */
+    if (__gcov_flush) __gcov_flush();
+    _exit(status);
+}
+
+static void wait_child(pid_t pid, int *status) {
+    int wstatus;
+    assert( waitpid(pid, &wstatus, 0) == pid );
+    assert( WIFEXITED(wstatus) );
+    *status = WEXITSTATUS(wstatus);
+}
+
+static void get_process_mask(int proc_id, cpu_set_t *mask) {
+    CPU_ZERO(mask);
+    for (int cpuid = proc_id * DEFAULT_CPUS; cpuid < (proc_id + 1) * DEFAULT_CPUS; ++cpuid) {
+        CPU_SET(cpuid, mask);
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    /* 4 processes of 2 CPUs, processes 0 and 1 in NUMA node 0, 2 and 3 in node 1 */
+    mu_testing_set_sys(SYS_SIZE, SYS_SIZE, NUM_NODES);
+
+    /* The parent process keeps the shmem open */
+    cpu_set_t parent_mask;
+    get_process_mask(0, &parent_mask);
+    ConfigShMem(DEFAULT_CPUS, 0, &parent_mask, SHMEM_KEY);
+    assert( comm_lend_light_testing__get_idle_cpus(-1) == 0 );
+
+    /* Borrowing prefers the local domain */
+    {
+        int status;
+        cpu_set_t mask;
+
+        /* Process 2 (node 1) lends all its CPUs */
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            get_process_mask(2, &mask);
+            ConfigShMem(DEFAULT_CPUS, 0, &mask, SHMEM_KEY);
+            releaseCpus(DEFAULT_CPUS);
+            finalize_comm();
+            child_exit(EXIT_SUCCESS);
+        }
+        wait_child(pid, &status);
+        assert( status == EXIT_SUCCESS );
+        assert( comm_lend_light_testing__get_idle_cpus(0) == 0 );
+        assert( comm_lend_light_testing__get_idle_cpus(1) == DEFAULT_CPUS );
+
+        /* Process 1 (node 0) lends one CPU and borrows 2 CPUs, first the local one */
+        pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            get_process_mask(1, &mask);
+            ConfigShMem(DEFAULT_CPUS, 0, &mask, SHMEM_KEY);
+            releaseCpus(1);
+            assert( comm_lend_light_testing__get_idle_cpus(0) == 1 );
+            int cpus = checkIdleCpus(DEFAULT_CPUS - 1, 2);
+            finalize_comm();
+            child_exit(cpus);
+        }
+        int process_1_cpus;
+        wait_child(pid, &process_1_cpus);
+        assert( process_1_cpus == DEFAULT_CPUS + 1 );
+        assert( comm_lend_light_testing__get_idle_cpus(0) == 0 );
+        assert( comm_lend_light_testing__get_idle_cpus(1) == DEFAULT_CPUS - 1 );
+
+        /* Process 2 reclaims its CPUs, node 1 is in debt */
+        pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            get_process_mask(2, &mask);
+            ConfigShMem(DEFAULT_CPUS, 0, &mask, SHMEM_KEY);
+            int cpus = acquireCpus(0);
+            finalize_comm();
+            child_exit(cpus);
+        }
+        wait_child(pid, &status);
+        assert( status == DEFAULT_CPUS );
+        assert( comm_lend_light_testing__get_idle_cpus(1) == -1 );
+
+        /* Process 1 gives back the borrowed CPU to node 1 */
+        pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            get_process_mask(1, &mask);
+            ConfigShMem(DEFAULT_CPUS, 0, &mask, SHMEM_KEY);
+            int cpus = checkIdleCpus(process_1_cpus, 2);
+            finalize_comm();
+            child_exit(cpus);
+        }
+        wait_child(pid, &status);
+        assert( status == DEFAULT_CPUS );
+        assert( comm_lend_light_testing__get_idle_cpus(0) == 0 );
+        assert( comm_lend_light_testing__get_idle_cpus(1) == 0 );
+        assert( comm_lend_light_testing__get_idle_cpus(-1) == 0 );
+    }
+
+    /* Stress test: processes concurrently lend, reclaim and borrow CPUs */
+    {
+        int num_iterations = DLB_EXTRA_TESTS ? 1000000 : 50000;
+        pid_t pids[NUM_PROCS];
+        for (int proc_id = 0; proc_id < NUM_PROCS; ++proc_id) {
+            pids[proc_id] = fork();
+            assert( pids[proc_id] >= 0 );
+            if (pids[proc_id] == 0) {
+                cpu_set_t mask;
+                get_process_mask(proc_id, &mask);
+                ConfigShMem(DEFAULT_CPUS, proc_id % 2 /* greedy */, &mask, SHMEM_KEY);
+
+                unsigned int seed = proc_id;
+                int cpus = DEFAULT_CPUS;
+                for (int i = 0; i < num_iterations; ++i) {
+                    switch (rand_r(&seed) % 3) {
+                        case 0:
+                            /* Blocking call: lend all CPUs and reclaim them back */
+                            releaseCpus(cpus);
+                            cpus = acquireCpus(0);
+                            break;
+                        case 1:
+                            /* Lend all CPUs but one and reclaim them back */
+                            releaseCpus(cpus - 1);
+                            cpus = acquireCpus(1);
+                            break;
+                        case 2:
+                            /* Borrow, or give back reclaimed CPUs */
+                            cpus = checkIdleCpus(cpus, 1 + rand_r(&seed) % SYS_SIZE);
+                            break;
+                    }
+                    assert( cpus >= DEFAULT_CPUS );
+                }
+
+                finalize_comm();
+                child_exit(cpus);
+            }
+        }
+
+        /* Conservation of CPUs: used CPUs plus idle CPUs is the total */
+        int used_cpus = 0;
+        for (int proc_id = 0; proc_id < NUM_PROCS; ++proc_id) {
+            int cpus;
+            wait_child(pids[proc_id], &cpus);
+            used_cpus += cpus;
+        }
+        int idle_cpus = comm_lend_light_testing__get_idle_cpus(-1);
+        assert( used_cpus + idle_cpus == SYS_SIZE );
+    }
+
+    finalize_comm();
+
+    return 0;
+}
@@ -349,6 +349,67 @@ int main( int argc, char **argv ) {
         array_cpuinfo_task_t_clear(&tasks);
     }
 
+    /*** AcquireCpus with ticket, only with request queues ***/
+    if (async) {
+        int ticket_slot;
+        array_cpuid_t_clear(&cpus_priority_array);
+        for (int cpuid = 0; cpuid < SYS_SIZE; ++cpuid) {
+            array_cpuid_t_push(&cpus_priority_array, cpuid);
+        }
+
+        // Process 1 acquires 2 CPUs, both enqueued in the request of the slot
+        requested_ncpus = 2;
+        assert( shmem_cpuinfo__acquire_ncpus_with_ticket(p1_pid, &ticket_slot,
+                    &requested_ncpus, &cpus_priority_array, LEWI_AFFINITY_AUTO,
+                    0 /* max_parallelism */, last_borrow, &tasks) == DLB_NOTED );
+        assert( tasks.count == 0 );
+        assert( ticket_slot >= 0 );
+        assert( shmem_cpuinfo__get_ticket_ncpus(ticket_slot) == 2 );
+
+        // Process 2 releases CPUs 3 and 2, the slot is updated on each one
+        assert( shmem_cpuinfo__lend_cpu(p2_pid, 3, &tasks) == DLB_SUCCESS );
+        assert( tasks.count == 1 && tasks.items[0].pid == p1_pid
+                && tasks.items[0].cpuid == 3 && tasks.items[0].action == ENABLE_CPU );
+        array_cpuinfo_task_t_clear(&tasks);
+        assert( shmem_cpuinfo__get_ticket_ncpus(ticket_slot) == 1 );
+        assert( shmem_cpuinfo__lend_cpu(p2_pid, 2, &tasks) == DLB_SUCCESS );
+        assert( tasks.count == 1 && tasks.items[0].pid == p1_pid
+                && tasks.items[0].cpuid == 2 && tasks.items[0].action == ENABLE_CPU );
+        array_cpuinfo_task_t_clear(&tasks);
+        assert( shmem_cpuinfo__get_ticket_ncpus(ticket_slot) == 0 );
+        assert( shmem_cpuinfo_testing__get_num_proc_requests() == 0 );
+        shmem_cpuinfo__release_ticket_slot(ticket_slot);
+
+        // Process 1 acquires 1 more CPU and removes the request of the slot
+        requested_ncpus = 1;
+        assert( shmem_cpuinfo__acquire_ncpus_with_ticket(p1_pid, &ticket_slot,
+                    &requested_ncpus, &cpus_priority_array, LEWI_AFFINITY_AUTO,
+                    0 /* max_parallelism */, last_borrow, &tasks) == DLB_NOTED );
+        assert( shmem_cpuinfo__get_ticket_ncpus(ticket_slot) == 1 );
+        assert( shmem_cpuinfo__remove_ticket_request(p1_pid, ticket_slot) == 1 );
+        assert( shmem_cpuinfo__get_ticket_ncpus(ticket_slot) == 0 );
+        assert( shmem_cpuinfo_testing__get_num_proc_requests() == 0 );
+        shmem_cpuinfo__release_ticket_slot(ticket_slot);
+
+        // Removing all the requests of the process also completes the slot
+        requested_ncpus = 1;
+        assert( shmem_cpuinfo__acquire_ncpus_with_ticket(p1_pid, &ticket_slot,
+                    &requested_ncpus, &cpus_priority_array, LEWI_AFFINITY_AUTO,
+                    0 /* max_parallelism */, last_borrow, &tasks) == DLB_NOTED );
+        assert( shmem_cpuinfo__get_ticket_ncpus(ticket_slot) == 1 );
+        shmem_cpuinfo__remove_requests(p1_pid);
+        assert( shmem_cpuinfo__get_ticket_ncpus(ticket_slot) == 0 );
+        shmem_cpuinfo__release_ticket_slot(ticket_slot);
+
+        // Process 2 acquires its CPUs back
+        assert( shmem_cpuinfo__lend_cpu(p1_pid, 2, &tasks) == DLB_SUCCESS );
+        assert( shmem_cpuinfo__lend_cpu(p1_pid, 3, &tasks) == DLB_SUCCESS );
+        array_cpuinfo_task_t_clear(&tasks);
+        assert( shmem_cpuinfo__acquire_cpu(p2_pid, 2, &tasks) == DLB_SUCCESS );
+        assert( shmem_cpuinfo__acquire_cpu(p2_pid, 3, &tasks) == DLB_SUCCESS );
+        array_cpuinfo_task_t_clear(&tasks);
+    }
+
     // Finalize
     assert( shmem_cpuinfo__finalize(p1_pid, SHMEM_KEY, 0) == DLB_SUCCESS );
     assert( shmem_cpuinfo__finalize(p2_pid, SHMEM_KEY, 0) == DLB_SUCCESS );
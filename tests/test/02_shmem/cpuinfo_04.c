@@ -0,0 +1,154 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "LB_comm/shmem.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/types.h"
+
+#include <sched.h>
+#include <sys/types.h>
+#include <assert.h>
+
+/* array_cpuid_t */
+#define ARRAY_T cpuid_t
+#include "support/array_template.h"
+
+/* array_cpuinfo_task_t */
+#define ARRAY_T cpuinfo_task_t
+#define ARRAY_KEY_T pid_t
+#include "support/array_template.h"
+
+// Checks for lending CPUs directly to a list of recipients (CPU handoff)
+
+int main( int argc, char **argv ) {
+    enum { SYS_SIZE = 4 };
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    // Initialize local masks to [1100], [0010] and [0001]
+    pid_t p1_pid = 111;
+    cpu_set_t p1_mask;
+    mu_parse_mask("0-1", &p1_mask);
+    pid_t p2_pid = 222;
+    cpu_set_t p2_mask;
+    mu_parse_mask("2", &p2_mask);
+    pid_t p3_pid = 333;
+    cpu_set_t p3_mask;
+    mu_parse_mask("3", &p3_mask);
+    array_cpuinfo_task_t tasks;
+    array_cpuinfo_task_t_init(&tasks, SYS_SIZE);
+    array_cpuid_t cpu_subset;
+    array_cpuid_t_init(&cpu_subset, SYS_SIZE);
+
+    assert( shmem_cpuinfo__init(p1_pid, 0, &p1_mask, SHMEM_KEY, 0) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__init(p2_pid, 0, &p2_mask, SHMEM_KEY, 0) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__init(p3_pid, 0, &p3_mask, SHMEM_KEY, 0) == DLB_SUCCESS );
+
+    /* Without recipients, it behaves like a regular lend */
+    {
+        assert( shmem_cpuinfo__lend_cpu_mask_to(p1_pid, &p1_mask, NULL, 0, &tasks)
+                == DLB_SUCCESS );
+        assert( tasks.count == 0 );
+        assert( shmem_cpuinfo__reclaim_cpu_mask(p1_pid, &p1_mask, &tasks) == DLB_SUCCESS );
+        array_cpuinfo_task_t_clear(&tasks);
+    }
+
+    /* P1 hands off its CPUs to P2 and P3, the lender itself is skipped */
+    {
+        const pid_t recipients[] = {p1_pid, p2_pid, p3_pid};
+        assert( shmem_cpuinfo__lend_cpu_mask_to(p1_pid, &p1_mask, recipients, 3, &tasks)
+                == DLB_SUCCESS );
+        assert( tasks.count == 2 );
+        assert( tasks.items[0].pid == p2_pid
+                && tasks.items[0].cpuid == 0
+                && tasks.items[0].action == ENABLE_CPU );
+        assert( tasks.items[1].pid == p3_pid
+                && tasks.items[1].cpuid == 1
+                && tasks.items[1].action == ENABLE_CPU );
+        array_cpuinfo_task_t_clear(&tasks);
+
+        /* P1 acquires back its CPUs, guests must be disabled */
+        array_cpuid_t_push(&cpu_subset, 0);
+        array_cpuid_t_push(&cpu_subset, 1);
+        assert( shmem_cpuinfo__acquire_from_cpu_subset(p1_pid, &cpu_subset, &tasks)
+                == DLB_NOTED );
+        int ndisabled = 0;
+        for (size_t i = 0; i < tasks.count; ++i) {
+            if (tasks.items[i].pid != p1_pid) {
+                assert( tasks.items[i].action == DISABLE_CPU );
+                ++ndisabled;
+            }
+        }
+        assert( ndisabled == 2 );
+        array_cpuinfo_task_t_clear(&tasks);
+
+        /* Guests return the CPUs */
+        assert( shmem_cpuinfo__return_cpu(p2_pid, 0, &tasks) == DLB_SUCCESS );
+        assert( shmem_cpuinfo__return_cpu(p3_pid, 1, &tasks) == DLB_SUCCESS );
+        array_cpuinfo_task_t_clear(&tasks);
+    }
+
+    /* A single recipient may receive more than one CPU */
+    {
+        const pid_t recipients[] = {p3_pid};
+        assert( shmem_cpuinfo__lend_cpu_mask_to(p1_pid, &p1_mask, recipients, 1, &tasks)
+                == DLB_SUCCESS );
+        assert( tasks.count == 2 );
+        assert( tasks.items[0].pid == p3_pid && tasks.items[0].cpuid == 0 );
+        assert( tasks.items[1].pid == p3_pid && tasks.items[1].cpuid == 1 );
+        array_cpuinfo_task_t_clear(&tasks);
+    }
+
+    /* Recipients do not receive more CPUs than their max parallelism allows */
+    {
+        /* P1 reclaims its CPUs and P3 returns them */
+        assert( shmem_cpuinfo__reclaim_cpu_mask(p1_pid, &p1_mask, &tasks) == DLB_NOTED );
+        array_cpuinfo_task_t_clear(&tasks);
+        assert( shmem_cpuinfo__return_cpu(p3_pid, 0, &tasks) == DLB_SUCCESS );
+        assert( shmem_cpuinfo__return_cpu(p3_pid, 1, &tasks) == DLB_SUCCESS );
+        array_cpuinfo_task_t_clear(&tasks);
+
+        /* P3 already guests CPU 3, so it may only receive one more CPU */
+        shmem_cpuinfo__set_max_parallelism(p3_pid, 2);
+        const pid_t recipients[] = {p3_pid};
+        assert( shmem_cpuinfo__lend_cpu_mask_to(p1_pid, &p1_mask, recipients, 1, &tasks)
+                == DLB_SUCCESS );
+        assert( tasks.count == 1 );
+        assert( tasks.items[0].pid == p3_pid && tasks.items[0].cpuid == 0 );
+        array_cpuinfo_task_t_clear(&tasks);
+        shmem_cpuinfo__set_max_parallelism(p3_pid, 0);
+    }
+
+    assert( shmem_cpuinfo__finalize(p1_pid, SHMEM_KEY, 0) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__finalize(p2_pid, SHMEM_KEY, 0) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__finalize(p3_pid, SHMEM_KEY, 0) == DLB_SUCCESS );
+
+    array_cpuid_t_destroy(&cpu_subset);
+    array_cpuinfo_task_t_destroy(&tasks);
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "LB_comm/shmem_cpuinfo.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+
+#include <assert.h>
+
+/* array_cpuinfo_task_t */
+#define ARRAY_T cpuinfo_task_t
+#define ARRAY_KEY_T pid_t
+#include "support/array_template.h"
+
+/* The binding cache is invalidated on every lend, borrow and reclaim */
+int main(int argc, char *argv[]) {
+    // This test needs at least room for 4 CPUs
+    enum { SYS_SIZE = 4 };
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    array_cpuinfo_task_t tasks;
+    array_cpuinfo_task_t_init(&tasks, SYS_SIZE);
+
+    // Initialize local masks to [1100] and [0011]
+    pid_t p1_pid = 111;
+    cpu_set_t p1_mask;
+    CPU_ZERO(&p1_mask);
+    CPU_SET(0, &p1_mask);
+    CPU_SET(1, &p1_mask);
+    pid_t p2_pid = 222;
+    cpu_set_t p2_mask;
+    CPU_ZERO(&p2_mask);
+    CPU_SET(2, &p2_mask);
+    CPU_SET(3, &p2_mask);
+
+    // Init
+    assert( shmem_cpuinfo__init(p1_pid, 0, &p1_mask, SHMEM_KEY, 0) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__init(p2_pid, 0, &p2_mask, SHMEM_KEY, 0) == DLB_SUCCESS );
+
+    // Fill the caches, queries alone do not modify the version
+    uint64_t version = shmem_cpuinfo_testing__get_bindings_version();
+    assert( shmem_cpuinfo__get_number_of_bindings(p1_pid) == 2 );
+    assert( shmem_cpuinfo__get_number_of_bindings(p2_pid) == 2 );
+    assert( shmem_cpuinfo__get_thread_binding(p2_pid, 1) == 3 );
+    assert( shmem_cpuinfo__get_number_of_non_owned_cpus(p1_pid) == 2 );
+    assert( shmem_cpuinfo_testing__get_bindings_version() == version );
+
+    // P2 lends CPU 3
+    assert( shmem_cpuinfo__lend_cpu(p2_pid, 3, &tasks) == DLB_SUCCESS );
+    array_cpuinfo_task_t_clear(&tasks);
+    assert( shmem_cpuinfo_testing__get_bindings_version() != version );
+    version = shmem_cpuinfo_testing__get_bindings_version();
+    assert( shmem_cpuinfo__get_number_of_bindings(p2_pid) == 1 );
+    assert( shmem_cpuinfo__get_thread_binding(p2_pid, 1) == -1 );
+
+    // P1 borrows CPU 3
+    assert( shmem_cpuinfo__borrow_cpu(p1_pid, 3, &tasks) == DLB_SUCCESS );
+    array_cpuinfo_task_t_clear(&tasks);
+    assert( shmem_cpuinfo_testing__get_bindings_version() != version );
+    version = shmem_cpuinfo_testing__get_bindings_version();
+    assert( shmem_cpuinfo__get_number_of_bindings(p1_pid) == 3 );
+    assert( shmem_cpuinfo__get_thread_binding(p1_pid, 2) == 3 );
+    assert( shmem_cpuinfo__get_number_of_bindings(p2_pid) == 1 );
+
+    // P2 reclaims CPU 3, P1 still runs on it until it returns it
+    assert( shmem_cpuinfo__reclaim_cpu(p2_pid, 3, &tasks) == DLB_NOTED );
+    array_cpuinfo_task_t_clear(&tasks);
+    assert( shmem_cpuinfo_testing__get_bindings_version() != version );
+    version = shmem_cpuinfo_testing__get_bindings_version();
+    assert( shmem_cpuinfo__get_number_of_bindings(p2_pid) == 2 );
+    assert( shmem_cpuinfo__get_thread_binding(p2_pid, 1) == 3 );
+    assert( shmem_cpuinfo__get_number_of_bindings(p1_pid) == 3 );
+
+    // P1 returns CPU 3
+    assert( shmem_cpuinfo__return_cpu(p1_pid, 3, &tasks) == DLB_SUCCESS );
+    array_cpuinfo_task_t_clear(&tasks);
+    assert( shmem_cpuinfo_testing__get_bindings_version() != version );
+    assert( shmem_cpuinfo__get_number_of_bindings(p1_pid) == 2 );
+    assert( shmem_cpuinfo__get_thread_binding(p1_pid, 2) == -1 );
+    assert( shmem_cpuinfo__get_number_of_bindings(p2_pid) == 2 );
+
+    // Finalize
+    assert( shmem_cpuinfo__finalize(p1_pid, SHMEM_KEY, 0) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__finalize(p2_pid, SHMEM_KEY, 0) == DLB_SUCCESS );
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*********************************************************************************/
+/*  Copyright 2009-2021 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "LB_comm/shmem_procinfo.h"
+#include "apis/dlb_errors.h"
+#include "apis/dlb_types.h"
+#include "support/cgroup.h"
+#include "support/mask_utils.h"
+
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <assert.h>
+
+// DROM masks enforced through a cgroup created by dlb_run, using a fake
+// proc filesystem and a fake cgroup v2 hierarchy
+
+static char root[] = "/tmp/dlb_procinfo_05_XXXXXX";
+
+static void write_file(const char *path, const char *content) {
+    FILE *fd = fopen(path, "w");
+    assert( fd != NULL );
+    fputs(content, fd);
+    fclose(fd);
+}
+
+static void read_file(const char *path, char *content, size_t len) {
+    FILE *fd = fopen(path, "r");
+    assert( fd != NULL );
+    assert( fgets(content, len, fd) != NULL );
+    fclose(fd);
+}
+
+int main( int argc, char **argv ) {
+
+    enum { SHMEM_SIZE_MULTIPLIER = 1 };
+
+    // This test needs at least room for 4 CPUs
+    enum { SYS_SIZE = 4 };
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    // Process p1 runs in a cgroup created by dlb_run, p2 does not
+    const pid_t p1_pid = 111;
+    const pid_t p2_pid = 222;
+
+    char path[PATH_MAX];
+    char content[PATH_MAX];
+    char cpuset_cpus[PATH_MAX];
+    assert( mkdtemp(root) != NULL );
+    snprintf(path, PATH_MAX, "%s/proc", root);                  mkdir(path, 0755);
+    snprintf(path, PATH_MAX, "%s/proc/self", root);             mkdir(path, 0755);
+    snprintf(path, PATH_MAX, "%s/proc/%d", root, p1_pid);       mkdir(path, 0755);
+    snprintf(path, PATH_MAX, "%s/cg", root);                    mkdir(path, 0755);
+    snprintf(path, PATH_MAX, "%s/cg/" DLB_CGROUP_PREFIX "1", root);  mkdir(path, 0755);
+    snprintf(path, PATH_MAX, "%s/proc/self/mounts", root);
+    snprintf(content, PATH_MAX, "proc /proc proc rw 0 0\ncgroup2 %s/cg cgroup2 rw 0 0\n", root);
+    write_file(path, content);
+    snprintf(path, PATH_MAX, "%s/proc/%d/cgroup", root, p1_pid);
+    write_file(path, "0::/" DLB_CGROUP_PREFIX "1\n");
+    snprintf(cpuset_cpus, PATH_MAX, "%s/cg/" DLB_CGROUP_PREFIX "1/cpuset.cpus", root);
+    write_file(cpuset_cpus, "");
+    snprintf(path, PATH_MAX, "%s/proc", root);
+    cgroup_testing__set_proc_root(path);
+
+    assert( cgroup_cpuset_is_managed(p1_pid) );
+    assert( !cgroup_cpuset_is_managed(p2_pid) );
+
+    cpu_set_t mask;
+    cpu_set_t p1_mask;
+    cpu_set_t p2_mask;
+
+    // Successful write through the cgroup interface
+    mu_parse_mask("0-1,3", &mask);
+    assert( cgroup_cpuset_set_cpus(p1_pid, &mask) == DLB_SUCCESS );
+    read_file(cpuset_cpus, content, sizeof(content));
+    assert( strcmp(content, "0,1,3") == 0 );
+    assert( cgroup_cpuset_set_cpus(p2_pid, &mask) == DLB_ERR_NOENT );
+
+    assert( shmem_procinfo_ext__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER) == DLB_SUCCESS );
+
+    // Preregister p1 with all the CPUs
+    mu_parse_mask("0-3", &p1_mask);
+    assert( shmem_procinfo_ext__preinit(p1_pid, &p1_mask, 0) == DLB_SUCCESS );
+
+    // Shrink p1, the new mask is written to its cgroup and does not need polling
+    mu_parse_mask("0-1", &p1_mask);
+    assert( shmem_procinfo__setprocessmask(p1_pid, &p1_mask, DLB_SYNC_QUERY, NULL)
+            == DLB_SUCCESS );
+    read_file(cpuset_cpus, content, sizeof(content));
+    assert( strcmp(content, "0,1") == 0 );
+    assert( shmem_procinfo__getprocessmask(p1_pid, &mask, DLB_SYNC_QUERY) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&mask, &p1_mask) );
+
+    // Preregister p2 with the free CPUs, and steal CPU 1 from p1
+    mu_parse_mask("2-3", &p2_mask);
+    assert( shmem_procinfo_ext__preinit(p2_pid, &p2_mask, 0) == DLB_SUCCESS );
+    mu_parse_mask("1-3", &p2_mask);
+    assert( shmem_procinfo__setprocessmask(p2_pid, &p2_mask, 0, NULL) == DLB_SUCCESS );
+    read_file(cpuset_cpus, content, sizeof(content));
+    assert( strcmp(content, "0") == 0 );
+    mu_parse_mask("0", &p1_mask);
+    assert( shmem_procinfo__getprocessmask(p1_pid, &mask, 0) == DLB_SUCCESS );
+    assert( CPU_EQUAL(&mask, &p1_mask) );
+
+    // Finalize p2 returning the stolen CPU, which is written back to p1's cgroup
+    assert( shmem_procinfo_ext__postfinalize(p2_pid, true) == DLB_SUCCESS );
+    read_file(cpuset_cpus, content, sizeof(content));
+    assert( strcmp(content, "0,1") == 0 );
+
+    assert( shmem_procinfo_ext__postfinalize(p1_pid, false) == DLB_SUCCESS );
+    assert( shmem_procinfo_ext__finalize() == DLB_SUCCESS );
+
+    // Clean up fake trees
+    snprintf(path, PATH_MAX, "rm -rf %s", root);
+    assert( system(path) == 0 );
+
+    return 0;
+}
@@ -59,7 +59,7 @@ int main(int argc, char *argv[]) {
         assert( shmem_async_init(child_pid, NULL, &process_mask, SHMEM_KEY, 1) == DLB_SUCCESS );
         shmem_barrier__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
         shmem_barrier__register("barrier", 0);
-        ConfigShMem(1, 0, SHMEM_KEY);
+        ConfigShMem(1, 0, &process_mask, SHMEM_KEY);
 
         /* Invoke _exit so that call assert_shmem destructors are not called */
         if (__gcov_flush) __gcov_flush();
@@ -79,7 +79,7 @@ int main(int argc, char *argv[]) {
         shmem_barrier__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER);
         barrier_t *barrier = shmem_barrier__register("barrier", 0);
         assert( barrier != NULL );
-        ConfigShMem(1, 0, SHMEM_KEY);
+        ConfigShMem(1, 0, &process_mask, SHMEM_KEY);
 
         /* Barrier must not block because I'm the only participant */
         shmem_barrier__barrier(barrier);
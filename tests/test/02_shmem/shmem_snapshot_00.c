@@ -0,0 +1,116 @@
+/*********************************************************************************/
+/*  Copyright 2009-2021 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "LB_comm/shmem.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <assert.h>
+
+/* Read-only attachment and lock-free snapshots of a shmem */
+
+enum { SHMEM_VERSION = 42 };
+enum { DATA_LEN = 256 };
+enum { NUM_SNAPSHOTS = 10000 };
+
+struct data {
+    int values[DATA_LEN];
+};
+
+static shmem_handler_t *handler;
+static struct data *shdata;
+static volatile bool writer_done = false;
+
+/* Writer: every update sets all values to the same number under the lock.
+ * Readers give up after many retries, so the lock is not held continuously */
+static void* writer(void *arg) {
+    for (int i = 1; !writer_done; ++i) {
+        shmem_lock(handler);
+        {
+            for (int j = 0; j < DATA_LEN; ++j) {
+                shdata->values[j] = i;
+            }
+        }
+        shmem_unlock(handler);
+        usleep(10);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    const shmem_props_t props = {
+        .size = sizeof(struct data),
+        .name = "test",
+        .key = SHMEM_KEY,
+        .version = SHMEM_VERSION,
+    };
+
+    /* The shmem does not exist yet */
+    struct data *ro_data;
+    assert( shmem_init_readonly((void**)&ro_data, &props) == NULL );
+
+    handler = shmem_init((void**)&shdata, &props);
+    shmem_lock(handler);
+    {
+        for (int j = 0; j < DATA_LEN; ++j) {
+            shdata->values[j] = 1;
+        }
+    }
+    shmem_unlock(handler);
+
+    /* Incompatible version or size */
+    shmem_props_t wrong_props = props;
+    wrong_props.version = SHMEM_VERSION + 1;
+    assert( shmem_init_readonly((void**)&ro_data, &wrong_props) == NULL );
+    wrong_props = props;
+    wrong_props.size = sizeof(struct data) * 2;
+    assert( shmem_init_readonly((void**)&ro_data, &wrong_props) == NULL );
+
+    /* Read-only attachment maps the same data */
+    shmem_handler_t *ro_handler = shmem_init_readonly((void**)&ro_data, &props);
+    assert( ro_handler != NULL );
+    assert( ro_data != shdata );
+    struct data copy;
+    shmem_snapshot(ro_handler, &copy, ro_data, sizeof(struct data));
+    assert( copy.values[0] == 1 && copy.values[DATA_LEN-1] == 1 );
+
+    /* Snapshots are consistent while another thread writes */
+    pthread_t thread;
+    assert( pthread_create(&thread, NULL, writer, NULL) == 0 );
+    for (int i = 0; i < NUM_SNAPSHOTS; ++i) {
+        shmem_snapshot(ro_handler, &copy, ro_data, sizeof(struct data));
+        for (int j = 1; j < DATA_LEN; ++j) {
+            assert( copy.values[j] == copy.values[0] );
+        }
+    }
+    writer_done = true;
+    assert( pthread_join(thread, NULL) == 0 );
+
+    shmem_finalize_readonly(ro_handler);
+    shmem_finalize(handler, NULL);
+
+    return 0;
+}
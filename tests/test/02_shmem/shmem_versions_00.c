@@ -22,6 +22,7 @@
 </testinfo>*/
 
 #include "apis/dlb_talp.h"
+#include "LB_comm/comm_lend_light.h"
 #include "LB_comm/shmem.h"
 #include "LB_comm/shmem_async.h"
 #include "LB_comm/shmem_barrier.h"
@@ -31,6 +32,7 @@
 #include "LB_comm/shmem_talp.h"
 #include "support/mask_utils.h"
 #include "support/atomic.h"
+#include "support/types.h"
 
 #include <sched.h>
 #include <unistd.h>
@@ -51,6 +53,7 @@ typedef struct {
     pid_t        pid;
     unsigned int howmany;
     cpu_set_t    allowed;
+    int          ticket;
 } lewi_mask_request_t;
 #define QUEUE_T lewi_mask_request_t
 #define QUEUE_KEY_T pid_t
@@ -61,7 +64,7 @@ typedef struct {
 
 
 static void check_shmem_sync_version(void) {
-    enum { KNOWN_SHMEM_SYNC_VERSION = 3 };
+    enum { KNOWN_SHMEM_SYNC_VERSION = 4 };
     struct KnownShmemSync {
         unsigned int        uint1;
         unsigned int        uint2;
@@ -69,6 +72,7 @@ static void check_shmem_sync_version(void) {
         int                 int2;
         enum {ENUM1}        enum1;
         pthread_mutex_t     mutex;
+        atomic_uint         uint3;
         pid_t               pidlist[];
     };
 
@@ -127,7 +131,8 @@ static void check_async_version(void) {
 }
 
 static void check_barrier_version(void) {
-    enum { KNOWN_BARRIER_VERSION = 7 };
+    enum { KNOWN_BARRIER_VERSION = 10 };
+    enum { KNOWN_MIN_PROCS_PER_BARRIER = 64 };
     enum { KNOWN_BARRIER_NAME_MAX = 32 };
     struct KnownBarrierFlags {
         bool flag1:1;
@@ -136,11 +141,20 @@ static void check_barrier_version(void) {
     struct KnownBarrier {
         char char1[KNOWN_BARRIER_NAME_MAX];
         struct KnownBarrierFlags flags;
-        unsigned int int2;
-        atomic_uint  int3;
+        atomic_uint  int2;
+        DLB_ALIGN_CACHE atomic_uint_least64_t uint64_1;
+        DLB_ALIGN_CACHE atomic_uint int3;
         atomic_uint  int4;
-        pthread_barrier_t barrier;
-        pthread_rwlock_t rwlock;
+        DLB_ALIGN_CACHE atomic_uint int5;
+        atomic_uint  int6;
+        atomic_uint_least64_t uint64_2;
+        atomic_uint_least64_t uint64_3;
+    };
+    struct KnownBarrierProc {
+        pid_t pid;
+        bool bool1;
+        atomic_uint int1;
+        atomic_uint int2;
     };
     struct KnownBarrierShdata {
         bool bool1;
@@ -152,7 +166,10 @@ static void check_barrier_version(void) {
     int version = shmem_barrier__version();
     size_t size = shmem_barrier__size();
     size_t known_size = sizeof(struct KnownBarrierShdata)
-        + sizeof(struct KnownBarrier) * mu_get_system_size();
+        + (sizeof(struct KnownBarrier)
+                + sizeof(struct KnownBarrierProc)
+                * max_int(mu_get_system_size(), KNOWN_MIN_PROCS_PER_BARRIER))
+        * mu_get_system_size();
     fprintf(stderr, "shmem_barrier version %d, size: %zu, known_size: %zu\n",
             version, size, known_size);
     assert( version == KNOWN_BARRIER_VERSION );
@@ -160,14 +177,16 @@ static void check_barrier_version(void) {
 }
 
 static void check_cpuinfo_version(void) {
-    enum { KNOWN_CPUINFO_VERSION = 6 };
+    enum { KNOWN_CPUINFO_VERSION = 11 };
     enum { KNOWN_QUEUE_PROC_REQS_SIZE = 4096 };
     enum { KNOWN_QUEUE_PIDS_SIZE = 8 };
+    enum { KNOWN_MAX_TICKET_REQUESTS = 1024 };
     struct KnownCpuinfo {
         int int1;
         pid_t pid1;
         pid_t pid2;
         enum {ENUM1} enum1;
+        unsigned int uint1;
         queue_pid_t queue;
     };
     struct KnownCpuinfoFlags {
@@ -182,6 +201,13 @@ static void check_cpuinfo_version(void) {
         queue_lewi_mask_request_t queue;
         cpu_set_t mask1;
         cpu_set_t mask2;
+        uint64_t uint1;
+        uint64_t uint2;
+        atomic_uint_least64_t uint3;
+        struct KnownTicketRequest {
+            pid_t pid;
+            atomic_int int1;
+        } ticket_requests[KNOWN_MAX_TICKET_REQUESTS];
         struct KnownCpuinfo info[];
     };
 
@@ -195,6 +221,31 @@ static void check_cpuinfo_version(void) {
     assert( size == known_size );
 }
 
+static void check_lewi_version(void) {
+    enum { KNOWN_LEWI_VERSION = 1 };
+
+    struct DLB_ALIGN_CACHE KnownIdleDomain {
+        atomic_int int1;
+    };
+
+    struct KnownLewiShdata {
+        atomic_int int1;
+        int int2;
+        struct KnownIdleDomain domains[];
+    };
+
+    int num_nodes = mu_get_num_nodes() > 0 ? mu_get_num_nodes() : 1;
+
+    int version = comm_lend_light__version();
+    size_t size = comm_lend_light__size();
+    size_t known_size = sizeof(struct KnownLewiShdata)
+        + sizeof(struct KnownIdleDomain) * num_nodes;
+    fprintf(stderr, "shmem_lewi version %d, size: %zu, known_size: %zu\n",
+            version, size, known_size);
+    assert( version == KNOWN_LEWI_VERSION );
+    assert( size == known_size );
+}
+
 static void check_lewi_async_version(void) {
     enum {KNOWN_LEWI_ASYNC_VERSION = 3 };
 
@@ -224,12 +275,14 @@ static void check_lewi_async_version(void) {
 }
 
 static void check_procinfo_version(void) {
-    enum { KNOWN_PROCINFO_VERSION = 10 };
+    enum { KNOWN_PROCINFO_VERSION = 11 };
 
     struct DLB_ALIGN_CACHE KnownProcinfo {
         pid_t pid;
         bool bool1;
         bool bool2;
+        bool bool3;
+        bool bool4;
         cpu_set_t mask1;
         cpu_set_t mask2;
         cpu_set_t mask3;
@@ -269,12 +322,16 @@ static void check_procinfo_version(void) {
 }
 
 static void check_talp_version(void) {
-    enum { KNOWN_TALP_VERSION = 4 };
+    enum { KNOWN_TALP_VERSION = 5 };
 
     struct DLB_ALIGN_CACHE TalpRegion {
         char name[DLB_MONITOR_NAME_MAX];
         atomic_int_least64_t int1;
         atomic_int_least64_t int2;
+        atomic_int_least64_t int3;
+        atomic_int_least64_t int4;
+        atomic_int_least64_t int5;
+        atomic_int int6;
         pid_t pid;
         float float1;
     };
@@ -301,6 +358,7 @@ int main(int argc, char **argv) {
     check_async_version();
     check_barrier_version();
     check_cpuinfo_version();
+    check_lewi_version();
     check_lewi_async_version();
     check_procinfo_version();
     check_talp_version();
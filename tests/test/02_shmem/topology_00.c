@@ -0,0 +1,120 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+// Test the node topology shared memory
+
+#include "unique_shmem.h"
+
+#include "LB_comm/shmem_topology.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+
+    char shm_filename[64];
+    snprintf(shm_filename, sizeof(shm_filename), "/dev/shm/DLB_topology_%s", SHMEM_KEY);
+
+    /* The first process parses and publishes the topology */
+    assert( !mu_is_initialized() );
+    assert( shmem_topology__init(SHMEM_KEY) == DLB_NOTED );
+    assert( mu_is_initialized() );
+    assert( shmem_topology__exists() );
+    assert( access(shm_filename, F_OK) == 0 );
+
+    int system_size = mu_get_system_size();
+    int num_cores = mu_get_num_cores();
+    cpu_set_t system_mask;
+    mu_get_system_mask(&system_mask);
+
+    /* Already initialized */
+    assert( shmem_topology__init(SHMEM_KEY) == DLB_NOTED );
+
+    /* Once published, the topology is obtained from the shared memory */
+    mu_finalize();
+    assert( !mu_is_initialized() );
+    assert( shmem_topology__init(SHMEM_KEY) == DLB_SUCCESS );
+    assert( mu_get_system_size() == system_size );
+    assert( mu_get_num_cores() == num_cores );
+    cpu_set_t mask;
+    mu_get_system_mask(&mask);
+    assert( CPU_EQUAL(&mask, &system_mask) );
+
+    /* Also from another process (that inherits the mapping) */
+    pid_t pid = fork();
+    assert( pid >= 0 );
+    if (pid == 0) {
+        mu_finalize();
+        assert( shmem_topology__init(SHMEM_KEY) == DLB_SUCCESS );
+        assert( mu_get_system_size() == system_size );
+        assert( mu_get_num_cores() == num_cores );
+        _exit(EXIT_SUCCESS);
+    }
+    int wstatus;
+    assert( waitpid(pid, &wstatus, 0) == pid );
+    assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+
+    /* The last process to finalize removes the shared memory */
+    shmem_topology__finalize();
+    assert( !shmem_topology__exists() );
+    assert( access(shm_filename, F_OK) != 0 );
+
+    /* A process that does not finalize is cleaned up by the next one */
+    pid = fork();
+    assert( pid >= 0 );
+    if (pid == 0) {
+        mu_finalize();
+        assert( shmem_topology__init(SHMEM_KEY) == DLB_NOTED );
+        assert( shmem_topology__exists() );
+        _exit(EXIT_SUCCESS);
+    }
+    assert( waitpid(pid, &wstatus, 0) == pid );
+    assert( WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == EXIT_SUCCESS );
+    assert( access(shm_filename, F_OK) == 0 );
+    mu_finalize();
+    assert( shmem_topology__init(SHMEM_KEY) == DLB_SUCCESS );
+    shmem_topology__finalize();
+    assert( access(shm_filename, F_OK) != 0 );
+
+    /* A shared memory with a different size is ignored */
+    int fd = open(shm_filename, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    assert( fd != -1 );
+    assert( ftruncate(fd, 64) == 0 );
+    close(fd);
+    mu_finalize();
+    assert( shmem_topology__init(SHMEM_KEY) == DLB_NOTED );
+    assert( mu_is_initialized() );
+    assert( mu_get_system_size() == system_size );
+    assert( !shmem_topology__exists() );
+    assert( unlink(shm_filename) == 0 );
+
+    return 0;
+}
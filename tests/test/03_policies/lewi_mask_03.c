@@ -0,0 +1,342 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator -a --mode=polling|--mode=async"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "apis/dlb_errors.h"
+#include "LB_core/spd.h"
+#include "LB_policies/lewi_mask.h"
+#include "LB_comm/shmem_procinfo.h"
+#include "LB_comm/shmem_cpuinfo.h"
+#include "LB_comm/shmem_async.h"
+#include "LB_numThreads/numThreads.h"
+#include "support/mask_utils.h"
+#include "support/debug.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+static subprocess_descriptor_t spd1;
+static subprocess_descriptor_t spd2;
+static cpu_set_t sp1_mask;
+static cpu_set_t sp2_mask;
+static interaction_mode_t mode;
+
+/* Subprocess 1 callbacks */
+static void sp1_cb_enable_cpu(int cpuid, void *arg) {
+    CPU_SET(cpuid, &sp1_mask);
+}
+
+static void sp1_cb_disable_cpu(int cpuid, void *arg) {
+    CPU_CLR(cpuid, &sp1_mask);
+}
+
+/* Subprocess 2 callbacks */
+static void sp2_cb_enable_cpu(int cpuid, void *arg) {
+    CPU_SET(cpuid, &sp2_mask);
+}
+
+static void sp2_cb_disable_cpu(int cpuid, void *arg) {
+    CPU_CLR(cpuid, &sp2_mask);
+}
+
+static void wait_for_async_completion(void) {
+    if (mode == MODE_ASYNC) {
+        shmem_async_wait_for_completion(spd1.id);
+        shmem_async_wait_for_completion(spd2.id);
+        __sync_synchronize();
+    }
+}
+
+static void check_no_requests(void) {
+    assert( shmem_cpuinfo_testing__get_num_proc_requests() == 0 );
+    for (int i=0; i<4; ++i) {
+        assert( shmem_cpuinfo_testing__get_num_cpu_requests(i) == 0 );
+    }
+}
+
+int main( int argc, char **argv ) {
+    // This test needs at least room for 4 CPUs
+    enum { SYS_SIZE = 4 };
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    // Options
+    char options[64] = "--verbose=shmem --shm-key=";
+    strcat(options, SHMEM_KEY);
+
+    // Initialize constant masks for fast reference
+    const cpu_set_t sp1_process_mask = {.__bits={0x3}};   /* [0011] */
+    const cpu_set_t sp2_process_mask = {.__bits={0xc}};   /* [1100] */
+
+    // Initialize local masks to [1100] and [0011]
+    memcpy(&sp1_mask, &sp1_process_mask, sizeof(cpu_set_t));
+    memcpy(&sp2_mask, &sp2_process_mask, sizeof(cpu_set_t));
+
+    // Subprocess 1 init
+    spd1.id = 111;
+    options_init(&spd1.options, options);
+    debug_init(&spd1.options);
+    memcpy(&spd1.process_mask, &sp1_mask, sizeof(cpu_set_t));
+    assert( shmem_procinfo__init(spd1.id, 0, &spd1.process_mask, NULL, spd1.options.shm_key,
+                spd1.options.shm_size_multiplier) == DLB_SUCCESS);
+    assert( shmem_cpuinfo__init(spd1.id, 0, &spd1.process_mask, spd1.options.shm_key,
+                spd1.options.lewi_color) == DLB_SUCCESS);
+    assert( pm_callback_set(&spd1.pm, dlb_callback_enable_cpu,
+                (dlb_callback_t)sp1_cb_enable_cpu, NULL) == DLB_SUCCESS);
+    assert( pm_callback_set(&spd1.pm, dlb_callback_disable_cpu,
+                (dlb_callback_t)sp1_cb_disable_cpu, NULL) == DLB_SUCCESS);
+    assert( lewi_mask_Init(&spd1) == DLB_SUCCESS );
+
+    // Subprocess 2 init
+    spd2.id = 222;
+    options_init(&spd2.options, options);
+    memcpy(&spd2.process_mask, &sp2_mask, sizeof(cpu_set_t));
+    assert( shmem_procinfo__init(spd2.id, 0, &spd2.process_mask, NULL, spd2.options.shm_key,
+                spd2.options.shm_size_multiplier) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__init(spd2.id, 0, &spd2.process_mask, spd2.options.shm_key,
+                spd2.options.lewi_color) == DLB_SUCCESS );
+    assert( pm_callback_set(&spd2.pm, dlb_callback_enable_cpu,
+                (dlb_callback_t)sp2_cb_enable_cpu, NULL) == DLB_SUCCESS );
+    assert( pm_callback_set(&spd2.pm, dlb_callback_disable_cpu,
+                (dlb_callback_t)sp2_cb_disable_cpu, NULL) == DLB_SUCCESS );
+    assert( lewi_mask_Init(&spd2) == DLB_SUCCESS );
+
+    // Get interaction mode
+    assert( spd1.options.mode == spd2.options.mode );
+    mode = spd1.options.mode;
+    if (mode == MODE_ASYNC) {
+        assert( shmem_async_init(spd2.id, &spd2.pm, &spd2.process_mask,
+                    spd2.options.shm_key, spd2.options.shm_size_multiplier) == DLB_SUCCESS );
+        assert( shmem_async_init(spd1.id, &spd1.pm, &spd1.process_mask,
+                    spd1.options.shm_key, spd1.options.shm_size_multiplier) == DLB_SUCCESS );
+    }
+
+    dlb_ticket_t ticket1, ticket2;
+
+    /* Null and unknown tickets */
+    {
+        assert( lewi_mask_TestTicket(&spd1, DLB_TICKET_NULL) == DLB_SUCCESS );
+        assert( lewi_mask_CancelTicket(&spd1, DLB_TICKET_NULL) == DLB_SUCCESS );
+        assert( lewi_mask_TestTicket(&spd1, 42) == DLB_ERR_NOENT );
+        assert( lewi_mask_CancelTicket(&spd1, 42) == DLB_ERR_NOENT );
+
+        // Special values are not allowed
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 0, &ticket1) == DLB_NOUPDT );
+        assert( ticket1 == DLB_TICKET_NULL );
+    }
+
+    /* Acquire tests, tickets are served in order */
+    if (mode == MODE_ASYNC) {
+        // Subprocess 1 requests 2 CPUs and then 1 more CPU
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 2, &ticket1) == DLB_NOTED );
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 1, &ticket2) == DLB_NOTED );
+        assert( ticket1 != DLB_TICKET_NULL && ticket2 != DLB_TICKET_NULL
+                && ticket1 != ticket2 );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_NOTED );
+        assert( lewi_mask_TestTicket(&spd1, ticket2) == DLB_NOTED );
+
+        // Subprocess 2 lends CPU 3, ticket 1 is still pending
+        CPU_CLR(3, &sp2_mask);
+        assert( lewi_mask_LendCpu(&spd2, 3) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_ISSET(3, &sp1_mask) );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_NOTED );
+
+        // Subprocess 2 lends CPU 2, ticket 1 is done and released
+        CPU_CLR(2, &sp2_mask);
+        assert( lewi_mask_LendCpu(&spd2, 2) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_ISSET(2, &sp1_mask) );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_SUCCESS );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_ERR_NOENT );
+        assert( lewi_mask_TestTicket(&spd1, ticket2) == DLB_NOTED );
+
+        // Subprocess 1 cancels ticket 2
+        assert( lewi_mask_CancelTicket(&spd1, ticket2) == DLB_SUCCESS );
+        assert( lewi_mask_TestTicket(&spd1, ticket2) == DLB_ERR_NOENT );
+        check_no_requests();
+
+        // Subprocess 1 returns the CPUs
+        CPU_CLR(2, &sp1_mask);
+        CPU_CLR(3, &sp1_mask);
+        assert( lewi_mask_LendCpuMask(&spd1, &sp2_process_mask) == DLB_SUCCESS );
+        assert( lewi_mask_AcquireCpuMask(&spd2, &sp2_process_mask) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_EQUAL(&sp1_process_mask, &sp1_mask) );
+        assert( CPU_EQUAL(&sp2_process_mask, &sp2_mask) );
+    } else {
+        // Requests are not enqueued in polling mode
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 2, &ticket1) == DLB_NOUPDT );
+        assert( ticket1 == DLB_TICKET_NULL );
+    }
+
+    /* Cancel removes only the CPUs of the ticket */
+    if (mode == MODE_ASYNC) {
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 2, &ticket1) == DLB_NOTED );
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 1, &ticket2) == DLB_NOTED );
+
+        // Ticket 2 advances its position
+        assert( lewi_mask_CancelTicket(&spd1, ticket1) == DLB_SUCCESS );
+        assert( shmem_cpuinfo_testing__get_num_proc_requests() == 1 );
+
+        // Subprocess 2 lends CPU 3, ticket 2 is done
+        CPU_CLR(3, &sp2_mask);
+        assert( lewi_mask_LendCpu(&spd2, 3) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_ISSET(3, &sp1_mask) );
+        assert( lewi_mask_TestTicket(&spd1, ticket2) == DLB_SUCCESS );
+        check_no_requests();
+
+        // Subprocess 2 recovers CPU 3
+        CPU_CLR(3, &sp1_mask);
+        assert( lewi_mask_LendCpu(&spd1, 3) == DLB_SUCCESS );
+        assert( lewi_mask_AcquireCpu(&spd2, 3) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_ISSET(3, &sp2_mask) );
+    }
+
+    /* Removing all requests invalidates the tickets */
+    if (mode == MODE_ASYNC) {
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 1, &ticket1) == DLB_NOTED );
+        assert( lewi_mask_AcquireCpus(&spd1, 0) == DLB_SUCCESS );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_ERR_NOENT );
+        check_no_requests();
+    }
+
+    /* Synchronous requests do not interfere with the tickets */
+    if (mode == MODE_ASYNC) {
+        assert( lewi_mask_AcquireCpusAsync(&spd1, 1, &ticket1) == DLB_NOTED );
+        assert( lewi_mask_AcquireCpus(&spd1, 1) == DLB_NOTED );
+        assert( shmem_cpuinfo_testing__get_num_proc_requests() == 2 );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_NOTED );
+
+        // Subprocess 2 lends CPU 3, the ticket is served first
+        CPU_CLR(3, &sp2_mask);
+        assert( lewi_mask_LendCpu(&spd2, 3) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_ISSET(3, &sp1_mask) );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_SUCCESS );
+
+        // Subprocess 2 lends CPU 2, the synchronous request is served
+        CPU_CLR(2, &sp2_mask);
+        assert( lewi_mask_LendCpu(&spd2, 2) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_ISSET(2, &sp1_mask) );
+        check_no_requests();
+
+        // Subprocess 1 returns the CPUs
+        CPU_CLR(2, &sp1_mask);
+        CPU_CLR(3, &sp1_mask);
+        assert( lewi_mask_LendCpuMask(&spd1, &sp2_process_mask) == DLB_SUCCESS );
+        assert( lewi_mask_AcquireCpuMask(&spd2, &sp2_process_mask) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_EQUAL(&sp1_process_mask, &sp1_mask) );
+        assert( CPU_EQUAL(&sp2_process_mask, &sp2_mask) );
+    }
+
+    /* Reclaim tests */
+    {
+        // Subprocess 1 lends CPU 1
+        CPU_CLR(1, &sp1_mask);
+        assert( lewi_mask_LendCpu(&spd1, 1) == DLB_SUCCESS );
+
+        // Subprocess 2 acquires CPU 1
+        assert( lewi_mask_AcquireCpu(&spd2, 1) == DLB_SUCCESS );
+        wait_for_async_completion();
+        assert( CPU_ISSET(1, &sp2_mask) );
+
+        // Subprocess 1 reclaims CPU 1
+        assert( lewi_mask_ReclaimCpusAsync(&spd1, 1, &ticket1) == DLB_NOTED );
+        if (mode == MODE_POLLING) {
+            // Subprocess 2 still guests CPU 1 until it returns it
+            assert( ticket1 != DLB_TICKET_NULL );
+            assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_NOTED );
+            CPU_CLR(1, &sp2_mask);
+            assert( lewi_mask_ReturnCpu(&spd2, 1) == DLB_SUCCESS );
+            assert( lewi_mask_CheckCpuAvailability(&spd1, 1) == DLB_SUCCESS );
+        } else {
+            wait_for_async_completion();
+
+            // Subprocess 2 no longer wants CPU 1
+            assert( lewi_mask_LendCpu(&spd2, 1) == DLB_SUCCESS );
+        }
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_SUCCESS );
+        assert(  CPU_ISSET(1, &sp1_mask) );
+        assert( !CPU_ISSET(1, &sp2_mask) );
+        check_no_requests();
+    }
+
+    /* Reclaimed CPUs are tracked individually */
+    if (mode == MODE_POLLING) {
+        // Subprocess 2 borrows CPUs 0 and 1
+        CPU_CLR(0, &sp1_mask);
+        CPU_CLR(1, &sp1_mask);
+        assert( lewi_mask_LendCpuMask(&spd1, &sp1_process_mask) == DLB_SUCCESS );
+        assert( lewi_mask_AcquireCpuMask(&spd2, &sp1_process_mask) == DLB_SUCCESS );
+        assert( CPU_ISSET(0, &sp2_mask) && CPU_ISSET(1, &sp2_mask) );
+
+        // Subprocess 1 reclaims both CPUs and lends CPU 1 again
+        assert( lewi_mask_ReclaimCpusAsync(&spd1, 2, &ticket1) == DLB_NOTED );
+        assert( ticket1 != DLB_TICKET_NULL );
+        CPU_CLR(1, &sp1_mask);
+        assert( lewi_mask_LendCpu(&spd1, 1) == DLB_SUCCESS );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_NOTED );
+
+        // Subprocess 2 returns CPU 0, CPU 1 is no longer waited for
+        CPU_CLR(0, &sp2_mask);
+        assert( lewi_mask_ReturnCpu(&spd2, 0) == DLB_SUCCESS );
+        assert( lewi_mask_TestTicket(&spd1, ticket1) == DLB_SUCCESS );
+        assert( lewi_mask_CheckCpuAvailability(&spd1, 0) == DLB_SUCCESS );
+
+        // Subprocess 2 releases CPU 1 and subprocess 1 acquires it
+        CPU_CLR(1, &sp2_mask);
+        assert( lewi_mask_LendCpu(&spd2, 1) == DLB_SUCCESS );
+        assert( lewi_mask_AcquireCpu(&spd1, 1) == DLB_SUCCESS );
+        assert( CPU_EQUAL(&sp1_process_mask, &sp1_mask) );
+        assert( CPU_EQUAL(&sp2_process_mask, &sp2_mask) );
+        check_no_requests();
+    }
+
+    // Finalize both subprocesses
+    assert( lewi_mask_Finalize(&spd1) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__finalize(spd1.id, spd1.options.shm_key, spd1.options.lewi_color)
+            == DLB_SUCCESS );
+    assert( shmem_procinfo__finalize(spd1.id, false, spd1.options.shm_key,
+                spd1.options.shm_size_multiplier) == DLB_SUCCESS );
+    assert( lewi_mask_Finalize(&spd2) == DLB_SUCCESS );
+    assert( shmem_cpuinfo__finalize(spd2.id, spd2.options.shm_key, spd2.options.lewi_color)
+            == DLB_SUCCESS );
+    assert( shmem_procinfo__finalize(spd2.id, false, spd2.options.shm_key,
+                spd2.options.shm_size_multiplier) == DLB_SUCCESS );
+    if (mode == MODE_ASYNC) {
+        assert( shmem_async_finalize(spd1.id) == DLB_SUCCESS );
+        assert( shmem_async_finalize(spd2.id) == DLB_SUCCESS );
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*********************************************************************************/
+/*  Copyright 2009-2025 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "LB_policies/lewi_shrink.h"
+
+#include <assert.h>
+
+/* Test the iteration-aware shrinking heuristic with synthetic timestamps */
+
+int main(int argc, char *argv[]) {
+
+    lewi_shrink_t shrink;
+
+    /* Process with 4 CPUs, the interval before the first iteration is not evaluated */
+    lewi_shrink_init(&shrink, 4, 0);
+    lewi_shrink_into_blocking_call(&shrink, 4, 100);
+    lewi_shrink_out_of_blocking_call(&shrink, 200);
+    assert( lewi_shrink_new_iteration(&shrink, 4, false, 1000) == 4 );
+
+    /* 2400 ns x CPU of computation fit in 1000 ns with 3 CPUs */
+    lewi_shrink_into_blocking_call(&shrink, 4, 1500);
+    lewi_shrink_into_blocking_call(&shrink, 4, 1800);   /* ignored, not in computation */
+    lewi_shrink_out_of_blocking_call(&shrink, 1900);
+    assert( lewi_shrink_new_iteration(&shrink, 4, false, 2000) == 3 );
+
+    /* 1800 ns x CPU of computation fit in 1000 ns with 2 CPUs */
+    lewi_shrink_into_blocking_call(&shrink, 3, 2500);
+    lewi_shrink_out_of_blocking_call(&shrink, 2900);
+    assert( lewi_shrink_new_iteration(&shrink, 3, false, 3000) == 2 );
+
+    /* 1800 ns x CPU of computation do not fit in 1000 ns with 1 CPU */
+    lewi_shrink_into_blocking_call(&shrink, 2, 3900);
+    lewi_shrink_out_of_blocking_call(&shrink, 4000);
+    lewi_shrink_out_of_blocking_call(&shrink, 4050);    /* ignored, already in computation */
+    assert( lewi_shrink_new_iteration(&shrink, 2, false, 4000) == 2 );
+
+    /* Small variations of the iteration time are not a slowdown */
+    lewi_shrink_into_blocking_call(&shrink, 2, 4950);
+    lewi_shrink_out_of_blocking_call(&shrink, 5000);
+    assert( lewi_shrink_new_iteration(&shrink, 2, false, 5040) == 2 );
+
+    /* Slowdown, recover one CPU */
+    lewi_shrink_into_blocking_call(&shrink, 2, 6000);
+    lewi_shrink_out_of_blocking_call(&shrink, 6240);
+    assert( lewi_shrink_new_iteration(&shrink, 2, false, 6240) == 3 );
+    assert( shrink.max_cpus == 3 );
+
+    /* A new loop is not evaluated */
+    lewi_shrink_into_blocking_call(&shrink, 3, 6300);
+    lewi_shrink_out_of_blocking_call(&shrink, 9000);
+    assert( lewi_shrink_new_iteration(&shrink, 3, true, 10000) == 3 );
+
+    /* The first iteration of the loop has no previous iteration to compare
+     * with, but it may still release CPUs */
+    lewi_shrink_into_blocking_call(&shrink, 3, 10100);
+    lewi_shrink_out_of_blocking_call(&shrink, 10900);
+    assert( lewi_shrink_new_iteration(&shrink, 3, false, 11000) == 2 );
+
+    /* The limit never exceeds the initial number of CPUs */
+    lewi_shrink_init(&shrink, 2, 0);
+    assert( lewi_shrink_new_iteration(&shrink, 2, false, 1000) == 2 );
+    lewi_shrink_into_blocking_call(&shrink, 2, 2000);
+    lewi_shrink_out_of_blocking_call(&shrink, 2000);
+    assert( lewi_shrink_new_iteration(&shrink, 2, false, 2000) == 2 );
+    lewi_shrink_into_blocking_call(&shrink, 2, 4000);
+    lewi_shrink_out_of_blocking_call(&shrink, 4000);
+    assert( lewi_shrink_new_iteration(&shrink, 2, false, 4000) == 2 );
+
+    /* The limit is never lower than 1 */
+    lewi_shrink_init(&shrink, 1, 0);
+    assert( lewi_shrink_new_iteration(&shrink, 1, false, 1000) == 1 );
+    lewi_shrink_into_blocking_call(&shrink, 1, 1001);
+    lewi_shrink_out_of_blocking_call(&shrink, 2000);
+    assert( lewi_shrink_new_iteration(&shrink, 1, false, 2000) == 1 );
+
+    return 0;
+}
@@ -42,7 +42,7 @@ int main(int argc, char *argv[]) {
     spd_register(&spd2);
 
     const subprocess_descriptor_t **spds = spd_get_spds();
-    /* spds comes from a gtree, order is undetermined */
+    /* spds order is undetermined */
     assert( (spds[0]->id == spd1.id && spds[1]->id == spd2.id)
             || (spds[0]->id == spd2.id && spds[1]->id == spd1.id) );
     assert( spds[2] == NULL );
@@ -58,5 +58,31 @@ int main(int argc, char *argv[]) {
     spd_unregister(&spd2);
     spd_unregister(&spd1);
 
+    /* Register many spds and unregister half of them */
+    enum { NUM_SPDS = 100 };
+    subprocess_descriptor_t many_spds[NUM_SPDS];
+    for (int i = 0; i < NUM_SPDS; ++i) {
+        many_spds[i].id = i;
+        spd_register(&many_spds[i]);
+    }
+    for (int i = 0; i < NUM_SPDS; i += 2) {
+        spd_unregister(&many_spds[i]);
+    }
+    spds = spd_get_spds();
+    int num_spds = 0;
+    for (const subprocess_descriptor_t **spd = spds; *spd != NULL; ++spd) {
+        assert( (*spd)->id % 2 == 1 );
+        assert( *spd == &many_spds[(*spd)->id] );
+        ++num_spds;
+    }
+    assert( num_spds == NUM_SPDS / 2 );
+    free(spds);
+    for (int i = 1; i < NUM_SPDS; i += 2) {
+        spd_unregister(&many_spds[i]);
+    }
+    spds = spd_get_spds();
+    assert( spds[0] == NULL );
+    free(spds);
+
     return 0;
 }
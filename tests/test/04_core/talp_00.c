@@ -117,7 +117,7 @@ int main(int argc, char *argv[]) {
         assert( global_monitor->useful_time > 0 );
         assert( global_monitor->useful_time > monitor->useful_time );
         assert( global_monitor->elapsed_time > monitor->elapsed_time );
-        if (talp_info->flags.papi) {
+        if (talp_info->flags.counters) {
             assert( global_monitor->instructions > monitor->instructions );
             assert( global_monitor->cycles > monitor->cycles );
         }
@@ -130,7 +130,7 @@ int main(int argc, char *argv[]) {
         assert( monitor->num_resets == 1 );
         assert( monitor->mpi_time == 0 );
         assert( monitor->useful_time == 0 );
-        if (talp_info->flags.papi) {
+        if (talp_info->flags.counters) {
             assert( monitor->instructions == 0 );
             assert( monitor->cycles == 0 );
         }
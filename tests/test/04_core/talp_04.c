@@ -0,0 +1,145 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "LB_comm/shmem_talp.h"
+#include "LB_core/spd.h"
+#include "apis/dlb_talp.h"
+#include "apis/dlb_errors.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+#include "talp/regions.h"
+#include "talp/talp.h"
+#include "talp/talp_types.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Test POP metrics queried without synchronization: local and node hybrid */
+
+static void set_state_and_wait(const subprocess_descriptor_t *spd,
+        enum talp_sample_state state) {
+    talp_sample_t *sample = talp_get_thread_sample(spd);
+    talp_update_sample(sample, /* counters */ false, TALP_NO_TIMESTAMP);
+    talp_set_sample_state(sample, state, /* counters */ false);
+    usleep(1000);
+}
+
+int main(int argc, char *argv[]) {
+    enum { SYS_SIZE = 4 };
+    mu_init();
+    mu_testing_set_sys_size(SYS_SIZE);
+
+    char options[128] = "--talp --talp-external-profiler --shm-key=";
+    strcat(options, SHMEM_KEY);
+
+    subprocess_descriptor_t spd = {.id = 111};
+    spd_enter_dlb(&spd);
+    options_init(&spd.options, options);
+    mu_parse_mask("0", &spd.process_mask);
+    talp_init(&spd);
+
+    /* Local POP metrics of a started region */
+    dlb_monitor_t *monitor = region_register(&spd, "Region 1");
+    assert( region_start(&spd, monitor) == DLB_SUCCESS );
+    set_state_and_wait(&spd, useful);
+    set_state_and_wait(&spd, not_useful_mpi);
+    set_state_and_wait(&spd, not_useful_omp_out);
+    set_state_and_wait(&spd, useful);
+
+    dlb_pop_metrics_t pop_metrics1;
+    assert( talp_query_pop_metrics(&spd, monitor, &pop_metrics1) == DLB_SUCCESS );
+    assert( region_is_started(monitor) );
+    assert( strcmp(pop_metrics1.name, "Region 1") == 0 );
+    assert( pop_metrics1.num_cpus == 1 );
+    assert( pop_metrics1.num_mpi_ranks == 0 );
+    assert( pop_metrics1.useful_time > 0 );
+    assert( pop_metrics1.mpi_time > 0 );
+    assert( pop_metrics1.omp_serialization_time > 0 );
+    assert( pop_metrics1.elapsed_time >= pop_metrics1.useful_time
+            + pop_metrics1.mpi_time + pop_metrics1.omp_serialization_time );
+    assert( pop_metrics1.parallel_efficiency > 0.0f );
+    assert( pop_metrics1.parallel_efficiency < 1.0f );
+    assert( pop_metrics1.mpi_communication_efficiency < 1.0f );
+    assert( pop_metrics1.omp_serialization_efficiency < 1.0f );
+    assert( pop_metrics1.mpi_load_balance == 1.0f );
+
+    /* The ongoing time is included on every query */
+    usleep(1000);
+    dlb_pop_metrics_t pop_metrics2;
+    assert( talp_query_pop_metrics(&spd, monitor, &pop_metrics2) == DLB_SUCCESS );
+    assert( pop_metrics2.elapsed_time > pop_metrics1.elapsed_time );
+    assert( pop_metrics2.useful_time > pop_metrics1.useful_time );
+
+    /* Once stopped, queries return the monitor values */
+    assert( region_stop(&spd, monitor) == DLB_SUCCESS );
+    dlb_pop_metrics_t pop_metrics3;
+    assert( talp_query_pop_metrics(&spd, monitor, &pop_metrics3) == DLB_SUCCESS );
+    assert( pop_metrics3.elapsed_time == monitor->elapsed_time );
+    assert( pop_metrics3.useful_time == monitor->useful_time );
+    assert( pop_metrics3.mpi_time == monitor->mpi_time );
+
+    /* Global region */
+    assert( talp_query_pop_metrics(&spd, DLB_GLOBAL_REGION, &pop_metrics3) == DLB_SUCCESS );
+    assert( strcmp(pop_metrics3.name, region_get_global_name()) == 0 );
+
+    /* Node hybrid POP metrics with only this process */
+    dlb_pop_metrics_t node_metrics;
+    assert( talp_query_pop_node_hybrid_metrics("Region 1", &node_metrics) == DLB_SUCCESS );
+    assert( node_metrics.num_mpi_ranks == 1 );
+    assert( node_metrics.num_cpus == 1 );
+    assert( node_metrics.useful_time == monitor->useful_time );
+    assert( node_metrics.mpi_time == monitor->mpi_time );
+    assert( node_metrics.omp_serialization_time == monitor->omp_serialization_time );
+    assert( node_metrics.mpi_load_balance == 1.0f );
+    assert( talp_query_pop_node_hybrid_metrics("Unknown", &node_metrics) == DLB_ERR_NOENT );
+
+    /* Add a fake process with 2 CPUs, double the useful time per CPU and
+     * some OpenMP load imbalance */
+    int region_id;
+    assert( shmem_talp__init(spd.options.shm_key, 1) == DLB_SUCCESS );
+    assert( shmem_talp__register(222, 2.0f, "Region 1", &region_id) == DLB_SUCCESS );
+    int64_t useful_time = monitor->useful_time * 4;
+    int64_t omp_load_imbalance_time = monitor->useful_time;
+    assert( shmem_talp__set_times(region_id, 0, useful_time) == DLB_SUCCESS );
+    assert( shmem_talp__set_omp_times(region_id, 2, omp_load_imbalance_time, 0, 0)
+            == DLB_SUCCESS );
+    assert( talp_query_pop_node_hybrid_metrics("Region 1", &node_metrics) == DLB_SUCCESS );
+    assert( node_metrics.num_mpi_ranks == 2 );
+    assert( node_metrics.num_cpus == 3 );
+    assert( node_metrics.useful_time == monitor->useful_time + useful_time );
+    assert( node_metrics.omp_load_imbalance_time == omp_load_imbalance_time );
+    assert( node_metrics.max_useful_normd_proc == (double)useful_time / 2 );
+    assert( node_metrics.mpi_normd_of_max_useful == 0.0 );
+    assert( node_metrics.mpi_load_balance < 1.0f );
+    assert( node_metrics.omp_load_balance < 1.0f );
+    assert( node_metrics.elapsed_time > 0 );
+
+    assert( shmem_talp__finalize(222) == DLB_SUCCESS );
+    talp_finalize(&spd);
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "LB_core/spd.h"
+#include "apis/dlb_talp.h"
+#include "support/mask_utils.h"
+#include "support/options.h"
+#include "talp/regions.h"
+#include "talp/talp.h"
+#include "talp/talp_mpi.h"
+#include "talp/talp_types.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+/* Test the pieces used to register the common regions among MPI processes:
+ * merge of sorted sets of hashes, and bulk registration of region names */
+
+int main(int argc, char *argv[]) {
+
+    /* Merge of two sorted sets, with common, leading and trailing hashes */
+    {
+        const region_hash_count_t a[] = {
+            { .hash = 1, .count = 1, .owner = 0 },
+            { .hash = 3, .count = 2, .owner = 2 },
+            { .hash = 7, .count = 1, .owner = 0 },
+        };
+        const region_hash_count_t b[] = {
+            { .hash = 2, .count = 1, .owner = 1 },
+            { .hash = 3, .count = 1, .owner = 1 },
+            { .hash = 7, .count = 3, .owner = 3 },
+            { .hash = 9, .count = 1, .owner = 1 },
+        };
+        region_hash_count_t out[7];
+        int n = talp_merge_region_hashes(a, 3, b, 4, out);
+        assert( n == 5 );
+        assert( out[0].hash == 1 && out[0].count == 1 && out[0].owner == 0 );
+        assert( out[1].hash == 2 && out[1].count == 1 && out[1].owner == 1 );
+        assert( out[2].hash == 3 && out[2].count == 3 && out[2].owner == 1 );
+        assert( out[3].hash == 7 && out[3].count == 4 && out[3].owner == 0 );
+        assert( out[4].hash == 9 && out[4].count == 1 && out[4].owner == 1 );
+
+        /* Empty sets */
+        assert( talp_merge_region_hashes(a, 3, NULL, 0, out) == 3 );
+        assert( out[2].hash == 7 && out[2].count == 1 );
+        assert( talp_merge_region_hashes(NULL, 0, b, 4, out) == 4 );
+        assert( out[0].hash == 2 );
+        assert( talp_merge_region_hashes(NULL, 0, NULL, 0, out) == 0 );
+    }
+
+    /* Bulk registration */
+    {
+        char options[64] = "--talp --shm-key=";
+        strcat(options, SHMEM_KEY);
+        subprocess_descriptor_t spd = {.id = 111};
+        options_init(&spd.options, options);
+        spd_enter_dlb(&spd);
+        mu_parse_mask("0", &spd.process_mask);
+        talp_init(&spd);
+        talp_info_t *talp_info = spd.talp_info;
+
+        dlb_monitor_t *existing = region_register(&spd, "Region B");
+        assert( existing != NULL );
+        unsigned int nregions = strmap_size(&talp_info->regions);
+
+        /* Anonymous, forbidden, global and existing names are skipped */
+        enum { NUM_NAMES = 7 };
+        char names[NUM_NAMES * DLB_MONITOR_NAME_MAX] = {};
+        const char *list[NUM_NAMES] = { "Region A", "", "ALL", "Global",
+            "Region B", "Region A", "Region C" };
+        for (int i = 0; i < NUM_NAMES; ++i) {
+            snprintf(&names[i*DLB_MONITOR_NAME_MAX], DLB_MONITOR_NAME_MAX, "%s", list[i]);
+        }
+        region_register_bulk(&spd, names, NUM_NAMES);
+        assert( strmap_size(&talp_info->regions) == nregions + 2 );
+        assert( strmap_lookup(&talp_info->regions, "Region A") != NULL );
+        assert( strmap_lookup(&talp_info->regions, "Region C") != NULL );
+        assert( strmap_lookup(&talp_info->regions, "ALL") == NULL );
+        assert( strmap_lookup(&talp_info->regions, "Region B") == existing );
+
+        /* Bulk registered regions are found by region_register */
+        dlb_monitor_t *region_a = region_register(&spd, "Region A");
+        assert( region_a == strmap_lookup(&talp_info->regions, "Region A") );
+
+        /* Forbidden names are rejected by region_register as well */
+        assert( region_register(&spd, "all") == NULL );
+
+        talp_finalize(&spd);
+    }
+
+    return 0;
+}
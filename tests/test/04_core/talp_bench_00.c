@@ -0,0 +1,94 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+/* Microbenchmark of TALP region bookkeeping: register, start and stop many
+ * regions and finalize TALP, recording all of them in the process summary.
+ * Use DLB_EXTRA_TESTS=1 to register 100k regions. */
+
+#include "extra_tests.h"
+#include "unique_shmem.h"
+
+#include "LB_core/spd.h"
+#include "apis/dlb_talp.h"
+#include "apis/dlb_errors.h"
+#include "support/mytime.h"
+#include "support/options.h"
+#include "talp/regions.h"
+#include "talp/talp.h"
+#include "talp/talp_types.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char *argv[]) {
+
+    int num_regions = DLB_EXTRA_TESTS ? 100000 : 10000;
+
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(sched_getcpu(), &process_mask);
+
+    char options[128] = "--talp --talp-summary=process --talp-output-file=/dev/null"
+        " --shm-key=";
+    strcat(options, SHMEM_KEY);
+    subprocess_descriptor_t spd = {.id = 111};
+    options_init(&spd.options, options);
+    memcpy(&spd.process_mask, &process_mask, sizeof(cpu_set_t));
+    spd_enter_dlb(&spd);
+    talp_init(&spd);
+
+    /* Register */
+    int64_t t_start = get_time_in_ns();
+    for (int i = 0; i < num_regions; ++i) {
+        char name[DLB_MONITOR_NAME_MAX];
+        snprintf(name, DLB_MONITOR_NAME_MAX, "Region %d", i);
+        dlb_monitor_t *monitor = region_register(&spd, name);
+        assert( monitor != NULL );
+    }
+    int64_t t_register = get_time_in_ns();
+
+    /* Look up */
+    for (int i = 0; i < num_regions; ++i) {
+        char name[DLB_MONITOR_NAME_MAX];
+        snprintf(name, DLB_MONITOR_NAME_MAX, "Region %d", i);
+        dlb_monitor_t *monitor = region_register(&spd, name);
+        assert( monitor != NULL );
+        assert( region_start(&spd, monitor) == DLB_SUCCESS );
+        assert( region_stop(&spd, monitor) == DLB_SUCCESS );
+    }
+    int64_t t_start_stop = get_time_in_ns();
+
+    /* Finalize, recording all regions */
+    talp_finalize(&spd);
+    int64_t t_finalize = get_time_in_ns();
+
+    printf("Regions:    %d\n", num_regions);
+    printf("Register:   %"PRId64" us\n", (t_register - t_start) / 1000);
+    printf("Start/stop: %"PRId64" us\n", (t_start_stop - t_register) / 1000);
+    printf("Finalize:   %"PRId64" us\n", (t_finalize - t_start_stop) / 1000);
+
+    return 0;
+}
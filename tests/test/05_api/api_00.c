@@ -91,6 +91,17 @@ int main( int argc, char **argv ) {
     assert( DLB_AcquireCpuMask(&process_mask) == DLB_ERR_NOLEWI );
     assert( DLB_AcquireCpusInMask(1, &process_mask) == DLB_ERR_NOLEWI );
 
+    // Asynchronous requests
+    dlb_ticket_t ticket = 42;
+    assert( DLB_AcquireCpusAsync(1, &ticket) == DLB_ERR_NOLEWI );
+    assert( ticket == DLB_TICKET_NULL );
+    ticket = 42;
+    assert( DLB_ReclaimCpusAsync(1, &ticket) == DLB_ERR_NOLEWI );
+    assert( ticket == DLB_TICKET_NULL );
+    assert( DLB_TestTicket(DLB_TICKET_NULL) == DLB_ERR_NOLEWI );
+    assert( DLB_WaitTicket(DLB_TICKET_NULL) == DLB_ERR_NOLEWI );
+    assert( DLB_CancelTicket(DLB_TICKET_NULL) == DLB_ERR_NOLEWI );
+
     // Borrow
     assert( DLB_Borrow() == DLB_ERR_NOLEWI );
     assert( DLB_BorrowCpu(1) == DLB_ERR_NOLEWI );
@@ -117,9 +128,11 @@ int main( int argc, char **argv ) {
     assert( DLB_GetVariable("--drom", value) == DLB_SUCCESS );
     assert( DLB_PrintVariables(0) == DLB_SUCCESS );
     assert( DLB_PrintShmem(0, DLB_COLOR_AUTO) == DLB_SUCCESS );
+    assert( DLB_PrintInternalStats() == DLB_ERR_NOCOMP );
     assert( DLB_Strerror(0) != NULL );
 
     assert( DLB_Finalize() == DLB_SUCCESS );
+    assert( DLB_PrintInternalStats() == DLB_ERR_NOINIT );
 
     // Check init again
     CPU_ZERO(&process_mask);
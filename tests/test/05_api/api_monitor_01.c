@@ -0,0 +1,150 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "apis/dlb.h"
+#include "apis/dlb_talp.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+/* Test repeated registration of Monitoring Regions */
+
+static dlb_monitor_t* register_static(void) {
+    return DLB_MonitoringRegionRegisterStatic("Static region");
+}
+
+int main(int argc, char **argv) {
+    cpu_set_t process_mask;
+    CPU_ZERO(&process_mask);
+    CPU_SET(0, &process_mask);
+
+    char options[64] = "--talp --talp-summary=none --shm-key=";
+    strcat(options, SHMEM_KEY);
+
+    /* TALP not enabled */
+    {
+        char notalp_opts[64] = "--shm-key=";
+        strcat(notalp_opts, SHMEM_KEY);
+        assert( DLB_Init(0, &process_mask, notalp_opts) == DLB_SUCCESS );
+        assert( DLB_MonitoringRegionRegister("Solver") == NULL );
+        assert( register_static() == NULL );
+        assert( DLB_Finalize() == DLB_SUCCESS );
+    }
+
+    dlb_monitor_t *first_solver;
+    {
+        assert( DLB_Init(0, &process_mask, options) == DLB_SUCCESS );
+
+        /* Same string literal */
+        first_solver = DLB_MonitoringRegionRegister("Solver");
+        assert( first_solver != NULL );
+        for (int i = 0; i < 100; ++i) {
+            assert( DLB_MonitoringRegionRegister("Solver") == first_solver );
+        }
+
+        /* Same content, different pointer */
+        char name[DLB_MONITOR_NAME_MAX] = "Solver";
+        assert( DLB_MonitoringRegionRegister(name) == first_solver );
+
+        /* Same pointer, different content */
+        snprintf(name, DLB_MONITOR_NAME_MAX, "Region %d", 1);
+        dlb_monitor_t *region_1 = DLB_MonitoringRegionRegister(name);
+        assert( region_1 != first_solver );
+        assert( strcmp(region_1->name, "Region 1") == 0 );
+        snprintf(name, DLB_MONITOR_NAME_MAX, "Region %d", 2);
+        dlb_monitor_t *region_2 = DLB_MonitoringRegionRegister(name);
+        assert( region_2 != region_1 );
+        assert( strcmp(region_2->name, "Region 2") == 0 );
+        snprintf(name, DLB_MONITOR_NAME_MAX, "Region %d", 1);
+        assert( DLB_MonitoringRegionRegister(name) == region_1 );
+
+        /* Global region, case-insensitive */
+        dlb_monitor_t *global_monitor = DLB_MonitoringRegionGetGlobal();
+        for (int i = 0; i < 2; ++i) {
+            assert( DLB_MonitoringRegionRegister("Global") == global_monitor );
+            assert( DLB_MonitoringRegionRegister("global") == global_monitor );
+        }
+
+        /* Forbidden and anonymous regions are never cached */
+        assert( DLB_MonitoringRegionRegister("all") == NULL );
+        assert( DLB_MonitoringRegionRegister("all") == NULL );
+        dlb_monitor_t *anonymous_1 = DLB_MonitoringRegionRegister("");
+        dlb_monitor_t *anonymous_2 = DLB_MonitoringRegionRegister("");
+        assert( anonymous_1 != NULL && anonymous_2 != NULL );
+        assert( anonymous_1 != anonymous_2 );
+
+        /* Static registration */
+        dlb_monitor_t *static_monitor = register_static();
+        assert( static_monitor != NULL );
+        assert( strcmp(static_monitor->name, "Static region") == 0 );
+        int epoch = dlb_talp_regions_epoch;
+        for (int i = 0; i < 100; ++i) {
+            assert( register_static() == static_monitor );
+            assert( DLB_MonitoringRegionStart(static_monitor) == DLB_SUCCESS );
+            assert( DLB_MonitoringRegionStop(static_monitor) == DLB_SUCCESS );
+        }
+        assert( static_monitor->num_measurements == 100 );
+        assert( dlb_talp_regions_epoch == epoch );
+        assert( DLB_MonitoringRegionRegister("Static region") == static_monitor );
+
+        assert( DLB_MonitoringRegionStart(first_solver) == DLB_SUCCESS );
+        assert( DLB_MonitoringRegionStop(first_solver) == DLB_SUCCESS );
+        assert( first_solver->num_measurements == 1 );
+
+        assert( DLB_Finalize() == DLB_SUCCESS );
+    }
+
+    /* Regions of a previous initialization are not returned */
+    {
+        assert( DLB_Init(0, &process_mask, options) == DLB_SUCCESS );
+        dlb_monitor_t *solver = DLB_MonitoringRegionRegister("Solver");
+        assert( solver != NULL );
+        assert( solver->num_measurements == 0 );
+        assert( DLB_MonitoringRegionStart(solver) == DLB_SUCCESS );
+        assert( DLB_MonitoringRegionStop(solver) == DLB_SUCCESS );
+        assert( solver->num_measurements == 1 );
+
+        /* The static handle is registered again */
+        dlb_monitor_t *static_monitor = register_static();
+        assert( static_monitor != NULL );
+        assert( strcmp(static_monitor->name, "Static region") == 0 );
+        assert( static_monitor->num_measurements == 0 );
+        assert( DLB_MonitoringRegionRegister("Static region") == static_monitor );
+        int generation = DLB_MonitoringRegionGetGeneration();
+        assert( generation > 0 );
+        assert( DLB_Finalize() == DLB_SUCCESS );
+
+        int epoch = dlb_talp_regions_epoch;
+        assert( DLB_Init(0, &process_mask, options) == DLB_SUCCESS );
+        assert( dlb_talp_regions_epoch != epoch );
+        assert( DLB_MonitoringRegionGetGeneration() != generation );
+        assert( register_static() == DLB_MonitoringRegionRegister("Static region") );
+        assert( DLB_Finalize() == DLB_SUCCESS );
+    }
+
+    return 0;
+}
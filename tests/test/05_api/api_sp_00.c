@@ -87,6 +87,14 @@ int main( int argc, char **argv ) {
     assert( DLB_AcquireCpuMask_sp(handler, &process_mask) == DLB_ERR_NOLEWI );
     assert( DLB_AcquireCpusInMask_sp(handler, 1, &process_mask) == DLB_ERR_NOLEWI );
 
+    // Asynchronous requests
+    dlb_ticket_t ticket;
+    assert( DLB_AcquireCpusAsync_sp(handler, 1, &ticket) == DLB_ERR_NOLEWI );
+    assert( DLB_ReclaimCpusAsync_sp(handler, 1, &ticket) == DLB_ERR_NOLEWI );
+    assert( DLB_TestTicket_sp(handler, DLB_TICKET_NULL) == DLB_ERR_NOLEWI );
+    assert( DLB_WaitTicket_sp(handler, DLB_TICKET_NULL) == DLB_ERR_NOLEWI );
+    assert( DLB_CancelTicket_sp(handler, DLB_TICKET_NULL) == DLB_ERR_NOLEWI );
+
     // Borrow
     assert( DLB_Borrow_sp(handler) == DLB_ERR_NOLEWI );
     assert( DLB_BorrowCpu_sp(handler, 0) == DLB_ERR_NOLEWI );
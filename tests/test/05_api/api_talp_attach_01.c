@@ -0,0 +1,149 @@
+/*********************************************************************************/
+/*  Copyright 2009-2024 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "apis/dlb.h"
+#include "apis/dlb_talp.h"
+#include "support/env.h"
+#include "support/mask_utils.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Test the node queries used by external exporters */
+
+int main(int argc, char *argv[]) {
+    char dlb_args[128] = "--lewi --talp --talp-external-profiler --shm-size-multiplier=4"
+        " --shm-key=";
+    strcat(dlb_args, SHMEM_KEY);
+    dlb_setenv("DLB_ARGS", dlb_args, NULL, ENV_APPEND);
+
+    int ncpus = mu_get_system_size();
+    dlb_cpu_state_t *states = malloc(sizeof(dlb_cpu_state_t) * ncpus);
+    char names[8][DLB_MONITOR_NAME_MAX];
+    int64_t num_lends, num_borrows;
+    int nelems;
+
+    /* Attach without any process */
+    {
+        assert( DLB_TALP_Attach() == DLB_SUCCESS );
+        assert( DLB_TALP_GetCpuStates(states, &nelems, ncpus) == DLB_SUCCESS );
+        assert( nelems == ncpus );
+        for (int cpuid = 0; cpuid < ncpus; ++cpuid) {
+            assert( states[cpuid] == DLB_CPU_STATE_DISABLED );
+        }
+        assert( DLB_TALP_GetLeWICounters(&num_lends, &num_borrows) == DLB_SUCCESS );
+        assert( num_lends == 0 && num_borrows == 0 );
+        assert( DLB_TALP_GetRegionNames(names, &nelems, 8) == DLB_SUCCESS );
+        assert( nelems == 0 );
+        assert( DLB_TALP_Detach() == DLB_SUCCESS );
+    }
+
+    /* Attach after DLB_Init */
+    {
+        cpu_set_t process_mask;
+        sched_getaffinity(0, sizeof(cpu_set_t), &process_mask);
+        int first_cpu = mu_get_first_cpu(&process_mask);
+        int process_ncpus = CPU_COUNT(&process_mask);
+
+        assert( DLB_Init(0, &process_mask, NULL) == DLB_SUCCESS );
+        assert( DLB_TALP_Attach() == DLB_SUCCESS );
+
+        /* CPU states */
+        assert( DLB_TALP_GetCpuStates(states, &nelems, ncpus) == DLB_SUCCESS );
+        assert( states[first_cpu] == DLB_CPU_STATE_BUSY );
+        assert( DLB_Lend() == DLB_SUCCESS );
+        assert( DLB_TALP_GetCpuStates(states, &nelems, ncpus) == DLB_SUCCESS );
+        assert( states[first_cpu] == DLB_CPU_STATE_IDLE );
+        assert( DLB_Borrow() == DLB_SUCCESS );
+        assert( DLB_TALP_GetCpuStates(states, &nelems, ncpus) == DLB_SUCCESS );
+        assert( states[first_cpu] == DLB_CPU_STATE_BUSY );
+
+        /* max_len is respected */
+        assert( DLB_TALP_GetCpuStates(states, &nelems, 0) == DLB_SUCCESS );
+        assert( nelems == 0 );
+
+        /* LeWI counters */
+        assert( DLB_TALP_GetLeWICounters(&num_lends, &num_borrows) == DLB_SUCCESS );
+        assert( num_lends == process_ncpus );
+        assert( num_borrows == process_ncpus );
+
+        /* Region names are unique */
+        dlb_monitor_t *monitor = DLB_MonitoringRegionRegister("Region 1");
+        assert( DLB_MonitoringRegionStart(monitor) == DLB_SUCCESS );
+        assert( DLB_MonitoringRegionStop(monitor) == DLB_SUCCESS );
+        assert( DLB_TALP_GetRegionNames(names, &nelems, 8) == DLB_SUCCESS );
+        assert( nelems == 2 );
+        assert( strcmp(names[0], "Global") == 0 );
+        assert( strcmp(names[1], "Region 1") == 0 );
+        assert( DLB_TALP_GetRegionNames(names, &nelems, 1) == DLB_SUCCESS );
+        assert( nelems == 1 );
+
+        assert( DLB_TALP_Detach() == DLB_SUCCESS );
+        assert( DLB_Finalize() == DLB_SUCCESS );
+    }
+
+    /* LeWI counters are read without attaching to the shared memory */
+    {
+        assert( DLB_TALP_GetLeWICounters(&num_lends, &num_borrows) == DLB_ERR_NOSHMEM );
+
+        int to_parent[2], to_child[2];
+        assert( pipe(to_parent) == 0 && pipe(to_child) == 0 );
+        cpu_set_t process_mask;
+        sched_getaffinity(0, sizeof(cpu_set_t), &process_mask);
+        int process_ncpus = CPU_COUNT(&process_mask);
+        char c = 0;
+
+        pid_t pid = fork();
+        assert( pid >= 0 );
+        if (pid == 0) {
+            /* Child: lend and borrow its CPUs and wait for the parent */
+            assert( DLB_Init(0, &process_mask, NULL) == DLB_SUCCESS );
+            assert( DLB_Lend() == DLB_SUCCESS );
+            assert( DLB_Borrow() == DLB_SUCCESS );
+            assert( write(to_parent[1], &c, 1) == 1 );
+            assert( read(to_child[0], &c, 1) == 1 );
+            assert( DLB_Finalize() == DLB_SUCCESS );
+            _exit(EXIT_SUCCESS);
+        }
+
+        close(to_parent[1]);
+        assert( read(to_parent[0], &c, 1) == 1 );
+        assert( DLB_TALP_GetLeWICounters(&num_lends, &num_borrows) == DLB_SUCCESS );
+        assert( num_lends == process_ncpus );
+        assert( num_borrows == process_ncpus );
+        assert( write(to_child[1], &c, 1) == 1 );
+
+        int status;
+        assert( waitpid(pid, &status, 0) == pid );
+        assert( WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS );
+    }
+
+    free(states);
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+/*********************************************************************************/
+/*  Copyright 2009-2021 Barcelona Supercomputing Center                          */
+/*                                                                               */
+/*  This file is part of the DLB library.                                        */
+/*                                                                               */
+/*  DLB is free software: you can redistribute it and/or modify                  */
+/*  it under the terms of the GNU Lesser General Public License as published by  */
+/*  the Free Software Foundation, either version 3 of the License, or            */
+/*  (at your option) any later version.                                          */
+/*                                                                               */
+/*  DLB is distributed in the hope that it will be useful,                       */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of               */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the                */
+/*  GNU Lesser General Public License for more details.                          */
+/*                                                                               */
+/*  You should have received a copy of the GNU Lesser General Public License     */
+/*  along with DLB.  If not, see <https://www.gnu.org/licenses/>.                */
+/*********************************************************************************/
+
+/*<testinfo>
+    test_generator="gens/basic-generator"
+</testinfo>*/
+
+#include "unique_shmem.h"
+
+#include "apis/dlb.h"
+#include "apis/dlb_talp.h"
+#include "LB_comm/shmem_talp.h"
+#include "support/env.h"
+#include "talp/talp_exporter.h"
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Test the exporter used by dlb_exporter: per-process TALP counters, output
+ * file and HTTP requests */
+
+enum { SHMEM_SIZE_MULTIPLIER = 4 };
+
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert( fd != -1 );
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    assert( connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 );
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    char dlb_args[64] = "--shm-size-multiplier=4 --shm-key=";
+    strcat(dlb_args, SHMEM_KEY);
+    dlb_setenv("DLB_ARGS", dlb_args, NULL, ENV_APPEND);
+
+    pid_t p1_pid = 111;
+    pid_t p2_pid = 222;
+    pid_t p3_pid = 333;
+    int p1_region, p2_region, p3_region;
+
+    /* Two processes register the same region */
+    assert( shmem_talp__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER) == DLB_SUCCESS );
+    assert( shmem_talp__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER) == DLB_SUCCESS );
+    assert( shmem_talp__register(p1_pid, 1, "Region", &p1_region) == DLB_SUCCESS );
+    assert( shmem_talp__register(p2_pid, 1, "Region", &p2_region) == DLB_SUCCESS );
+    assert( shmem_talp__set_times(p1_region, 10, 100) == DLB_SUCCESS );
+    assert( shmem_talp__set_times(p2_region, 20, 200) == DLB_SUCCESS );
+
+    assert( DLB_TALP_Attach() == DLB_SUCCESS );
+    talp_exporter_t exporter;
+    talp_exporter_init(&exporter);
+
+    /* First sample accumulates the current times */
+    talp_exporter_sample(&exporter);
+    const exporter_region_t *region = talp_exporter_get_region(&exporter, "Region");
+    assert( region != NULL && region->present );
+    assert( region->useful_time == 300 && region->mpi_time == 30 );
+    assert( region->num_processes == 2 );
+
+    /* P2 leaves the node and P1 progresses, counters must not go back */
+    assert( shmem_talp__finalize(p2_pid) == DLB_SUCCESS );
+    assert( shmem_talp__set_times(p1_region, 15, 150) == DLB_SUCCESS );
+    talp_exporter_sample(&exporter);
+    region = talp_exporter_get_region(&exporter, "Region");
+    assert( region->useful_time == 350 && region->mpi_time == 35 );
+    assert( region->num_processes == 1 );
+
+    /* A new process joins */
+    assert( shmem_talp__init(SHMEM_KEY, SHMEM_SIZE_MULTIPLIER) == DLB_SUCCESS );
+    assert( shmem_talp__register(p3_pid, 1, "Region", &p3_region) == DLB_SUCCESS );
+    assert( shmem_talp__set_times(p3_region, 3, 30) == DLB_SUCCESS );
+    talp_exporter_sample(&exporter);
+    region = talp_exporter_get_region(&exporter, "Region");
+    assert( region->useful_time == 380 && region->mpi_time == 38 );
+    assert( region->num_processes == 2 );
+    assert( talp_exporter_get_region(&exporter, "Unknown") == NULL );
+
+    /* A client that does not send any request does not block the exporter */
+    int listen_fd = talp_exporter_open_socket(0);
+    assert( listen_fd != -1 );
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    assert( getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) == 0 );
+    int port = ntohs(addr.sin_port);
+    int client_fd = connect_to(port);
+    talp_exporter_serve_request(listen_fd, &exporter);
+    close(client_fd);
+
+    /* A client request is answered with the metrics */
+    client_fd = connect_to(port);
+    const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    assert( write(client_fd, request, sizeof(request)-1) == sizeof(request)-1 );
+    talp_exporter_serve_request(listen_fd, &exporter);
+    char response[8192];
+    ssize_t len = 0, n;
+    while ((n = read(client_fd, response + len, sizeof(response)-1 - len)) > 0) {
+        len += n;
+    }
+    response[len] = '\0';
+    assert( strncmp(response, "HTTP/1.0 200 OK", 15) == 0 );
+    assert( strstr(response, "dlb_talp_useful_seconds_total{region=\"Region\"}") != NULL );
+    assert( strstr(response, "# EOF") != NULL );
+    close(client_fd);
+    close(listen_fd);
+
+    talp_exporter_finalize(&exporter);
+
+    /* A new exporter writes one sample into a file */
+    char filename[64];
+    snprintf(filename, sizeof(filename), "dlb_exporter_%s.prom", SHMEM_KEY);
+    talp_exporter_init(&exporter);
+    talp_exporter_sample(&exporter);
+    assert( talp_exporter_write_file(filename, &exporter) == DLB_SUCCESS );
+    talp_exporter_finalize(&exporter);
+    assert( DLB_TALP_Detach() == DLB_SUCCESS );
+    FILE *file = fopen(filename, "r");
+    assert( file != NULL );
+    len = fread(response, 1, sizeof(response)-1, file);
+    response[len] = '\0';
+    fclose(file);
+    unlink(filename);
+    assert( strstr(response, "dlb_lewi_lends_total 0") != NULL );
+    assert( strstr(response, "dlb_talp_useful_seconds_total{region=\"Region\"} 1.8e-07")
+            != NULL );
+    assert( strstr(response, "# EOF") != NULL );
+
+    assert( shmem_talp__finalize(p1_pid) == DLB_SUCCESS );
+    assert( shmem_talp__finalize(p3_pid) == DLB_SUCCESS );
+
+    return 0;
+}